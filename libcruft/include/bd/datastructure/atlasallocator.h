@@ -0,0 +1,177 @@
+#ifndef bd_atlasallocator_h
+#define bd_atlasallocator_h
+
+#include <bd/datastructure/residencytable.h>
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <queue>
+#include <functional>
+#include <cstdint>
+
+namespace bd
+{
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief Hands out fixed-size slots inside a few large 3D atlas textures.
+///
+/// Slots are numbered globally. Slot \c s lives in atlas
+/// \c s/slotsPerAtlas() and is laid out x-fastest within the atlas' slot grid.
+/// Every atlas but the last has the full slot grid; the last atlas is shrunk
+/// to the smallest grid that holds the remaining slots.
+///
+/// acquire() always returns the lowest free slot, so released slots are
+/// reused before new ones and live slots stay packed into the first atlases.
+///
+/// No GL calls are made here; the caller creates one texture of
+/// atlasDims(i) for each atlas and uploads a block's voxels at
+/// voxelOffset(slot).
+///////////////////////////////////////////////////////////////////////////////
+class AtlasAllocator
+{
+public:
+  static const uint32_t NO_SLOT = 0xFFFFFFFF;
+
+
+  AtlasAllocator();
+
+
+  /// \param slotDims Voxel dimensions of one slot (one block).
+  /// \param maxAtlasDims Largest voxel dimensions allowed for an atlas.
+  /// \param numSlots Total slots to provide (across all atlases).
+  /// \param numIds Ids passed to acquire() are in [0, numIds).
+  AtlasAllocator(glm::u64vec3 const &slotDims,
+                 glm::u64vec3 const &maxAtlasDims,
+                 size_t numSlots,
+                 size_t numIds);
+
+
+  /// \brief Get the slot for \c id, allocating the lowest free slot if \c id
+  /// has none.
+  /// \return The slot, or NO_SLOT if all slots are in use.
+  uint32_t
+  acquire(uint64_t id);
+
+
+  /// \brief Return the slot held by \c id to the free list.
+  /// \return false if \c id did not hold a slot.
+  bool
+  release(uint64_t id);
+
+
+  /// \brief Release every slot.
+  void
+  releaseAll();
+
+
+  /// \brief The slot held by \c id, or NO_SLOT.
+  uint32_t
+  slotOf(uint64_t id) const;
+
+
+  /// \brief Number of atlas textures needed to hold capacity() slots.
+  size_t
+  atlasCount() const;
+
+
+  /// \brief Voxel dimensions of atlas \c atlas.
+  glm::u64vec3
+  atlasDims(size_t atlas) const;
+
+
+  /// \brief Voxel dimensions of a slot.
+  glm::u64vec3 const &
+  slotDims() const;
+
+
+  /// \brief Slots along each axis of a full atlas.
+  glm::u64vec3 const &
+  slotGrid() const;
+
+
+  /// \brief Number of slots in a full atlas.
+  size_t
+  slotsPerAtlas() const;
+
+
+  /// \brief The atlas that \c slot lives in.
+  size_t
+  atlasOf(uint32_t slot) const;
+
+
+  /// \brief Voxel coordinates of \c slot's min corner within its atlas.
+  glm::u64vec3
+  voxelOffset(uint32_t slot) const;
+
+
+  /// \brief Offset to add to a block's [0,1] texture coordinates (after
+  /// scaling by texScale()) to address \c slot within its atlas.
+  ///
+  /// The block's [0,1] range is mapped to the centers of its first and
+  /// last texels so linear filtering never reads a neighbouring slot.
+  glm::vec3
+  texOffset(uint32_t slot) const;
+
+
+  /// \brief Scale to apply to a block's [0,1] texture coordinates to address
+  /// \c slot within its atlas.
+  glm::vec3
+  texScale(uint32_t slot) const;
+
+
+  /// \brief Like texScale(slot), for a block that only fills the first
+  /// \c extent voxels of the slot.
+  glm::vec3
+  texScale(uint32_t slot, glm::u64vec3 const &extent) const;
+
+
+  /// \brief Total number of slots.
+  size_t
+  capacity() const;
+
+
+  /// \brief Number of slots in use.
+  size_t
+  used() const;
+
+
+  /// \brief Number of free slots.
+  size_t
+  available() const;
+
+
+  /// \brief Number of slots in use in \c atlas.
+  size_t
+  usedInAtlas(size_t atlas) const;
+
+
+  /// \brief Fraction of slots that are free within the atlases that have at
+  /// least one slot in use (0 if every touched atlas is full, or nothing is
+  /// in use).
+  double
+  fragmentation() const;
+
+
+private:
+
+  glm::u64vec3 m_slotDims;    ///< Voxel dims of a slot.
+  glm::u64vec3 m_slotGrid;    ///< Slots along each axis of a full atlas.
+  glm::u64vec3 m_lastGrid;    ///< Slots along each axis of the last atlas.
+  size_t m_slotsPerAtlas;
+  size_t m_capacity;
+  size_t m_atlasCount;
+
+  /// Free slots, lowest first.
+  std::priority_queue<uint32_t,
+                      std::vector<uint32_t>,
+                      std::greater<uint32_t>> m_free;
+
+  ResidencyTable<uint32_t> m_idSlots;  ///< Slot held by each id.
+  std::vector<size_t> m_atlasUsed;     ///< Slots in use per atlas.
+
+}; // class AtlasAllocator
+
+} // namespace bd
+
+#endif // ! bd_atlasallocator_h
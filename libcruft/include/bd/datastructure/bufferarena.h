@@ -0,0 +1,166 @@
+#ifndef bd_bufferarena_h
+#define bd_bufferarena_h
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace bd
+{
+
+/// \brief How a BufferArena asks for huge pages.
+enum class HugePages : int
+{
+  None,         ///< Base pages only.
+  Transparent,  ///< madvise(MADV_HUGEPAGE), the kernel backs what it can.
+  Explicit      ///< MAP_HUGETLB from the reserved huge page pool.
+};
+
+
+/// \brief Parse "none", "thp" or "explicit".
+/// \throws std::invalid_argument for any other string.
+HugePages
+to_hugePages(std::string const &s);
+
+
+std::string
+to_string(HugePages h);
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief A fixed number of equal sized buffers in one reserved range of
+/// address space, committed a slice at a time as they are first used.
+///
+/// Making the arena only reserves address space, so a budget of hundreds of
+/// GB costs nothing until buffers are filled. Before a buffer is written
+/// commit() must be called for it: the slices (runs of pages, at least a
+/// huge page long) that it overlaps are made accessible and, if NUMA binding
+/// was asked for, placed on the node of the calling thread. Slices stay
+/// committed for the life of the arena, buffers are reused not returned.
+///
+/// Where mmap is not available the whole arena is allocated up front and
+/// commit() only does the bookkeeping.
+///////////////////////////////////////////////////////////////////////////////
+class BufferArena
+{
+public:
+  /// \brief What an arena holds and how much of it is committed.
+  struct Usage
+  {
+    std::string name;
+    size_t buffers;               ///< Number of buffers.
+    size_t bufferBytes;           ///< Bytes per buffer.
+    uint64_t reservedBytes;       ///< Address space reserved.
+    uint64_t committedBytes;      ///< Bytes in committed slices.
+    size_t committedSlices;
+    size_t slices;
+    uint64_t sliceBytes;
+    HugePages hugePages;          ///< What was actually used.
+    std::vector<uint64_t> nodeBytes;  ///< Committed bytes bound to each node.
+  };
+
+
+  /// \param name For the usage report.
+  /// \param bufferBytes Bytes per buffer.
+  /// \param count Number of buffers.
+  /// \param hugePages Huge pages to ask for, Explicit falls back to
+  ///                  Transparent if the huge page pool can not hold the arena.
+  /// \param bindNuma Place each slice on the NUMA node of the thread that
+  ///                 commits it.
+  BufferArena(std::string const &name,
+              size_t bufferBytes,
+              size_t count,
+              HugePages hugePages = HugePages::Transparent,
+              bool bindNuma = false);
+
+
+  ~BufferArena();
+
+
+  BufferArena(BufferArena const &) = delete;
+  BufferArena &operator=(BufferArena const &) = delete;
+
+
+  /// \brief Number of buffers.
+  size_t
+  count() const;
+
+
+  size_t
+  bufferBytes() const;
+
+
+  /// \brief Start of buffer \c i. It may not be written until committed.
+  char *
+  buffer(size_t i) const;
+
+
+  /// \brief Make buffer \c i writable. Cheap once it has been committed.
+  void
+  commit(size_t i);
+
+
+  /// \brief commit() the buffer that starts at \c buffer.
+  void
+  commit(char const *buffer);
+
+
+  /// \brief True if buffer \c i may be written.
+  bool
+  committed(size_t i) const;
+
+
+  /// \brief Bytes in committed slices.
+  uint64_t
+  committedBytes() const;
+
+
+  Usage
+  usage() const;
+
+
+private:
+  /// \brief Reserve the address space, returns false if mmap failed.
+  bool
+  reserve(HugePages hugePages);
+
+
+  void
+  commitSlice(size_t s);
+
+
+  std::string m_name;
+  size_t m_bufferBytes;
+  size_t m_count;
+  bool m_bindNuma;
+  HugePages m_hugePages;
+
+  uint64_t m_sliceBytes;
+  size_t m_sliceCount;
+  uint64_t m_reservedBytes;     ///< m_sliceCount * m_sliceBytes.
+
+  char *m_mapping;              ///< What was mmap'd (or nullptr).
+  uint64_t m_mappingBytes;
+  char *m_base;                 ///< Buffer 0, slice aligned.
+  std::unique_ptr<char[]> m_fallback;
+
+  std::unique_ptr<std::atomic<uint8_t>[]> m_sliceCommitted;
+  std::atomic<size_t> m_committedSlices;
+
+  mutable std::mutex m_commitMutex;
+  std::vector<uint64_t> m_nodeBytes;
+
+}; // class BufferArena
+
+
+std::ostream &
+operator<<(std::ostream &os, BufferArena::Usage const &u);
+
+} // namespace bd
+
+#endif // ! bd_bufferarena_h
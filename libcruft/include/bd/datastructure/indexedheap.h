@@ -0,0 +1,275 @@
+#ifndef bd_indexedheap_h
+#define bd_indexedheap_h
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <cassert>
+
+namespace bd
+{
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief Max-priority queue of dense integer ids in [0, capacity) with
+/// O(log n) priority updates.
+///
+/// The heap is D-ary (4 by default, which keeps the tree shallow and a node's
+/// children in one cache line) and each id remembers its position in the
+/// heap, so push(), update() and erase() of an arbitrary id are all
+/// O(log n) and contains() is O(1).
+///
+/// Ties are broken arbitrarily.
+///////////////////////////////////////////////////////////////////////////////
+template<class P, unsigned D = 4>
+class IndexedHeap
+{
+  static_assert(D >= 2, "IndexedHeap arity must be at least 2.");
+
+public:
+  static const uint32_t NOT_QUEUED = 0xFFFFFFFF;
+
+
+  IndexedHeap()
+      : IndexedHeap(0)
+  {
+  }
+
+
+  explicit IndexedHeap(size_t capacity)
+      : m_heap{ }
+      , m_pos{ }
+  {
+    resize(capacity);
+  }
+
+
+  /// \brief Set the number of ids the heap can hold and clear the heap.
+  void
+  resize(size_t capacity)
+  {
+    m_pos.assign(capacity, NOT_QUEUED);
+    m_heap.clear();
+    m_heap.reserve(capacity);
+  }
+
+
+  /// \brief Remove all entries, keeping the capacity.
+  void
+  clear()
+  {
+    for (Entry const &e : m_heap) {
+      m_pos[e.id] = NOT_QUEUED;
+    }
+    m_heap.clear();
+  }
+
+
+  /// \brief True if \c id is queued.
+  bool
+  contains(uint64_t id) const
+  {
+    assert(id<m_pos.size() && "Id out of range for indexed heap.");
+    return m_pos[id]!=NOT_QUEUED;
+  }
+
+
+  /// \brief Queue \c id with priority \c p, or change its priority if it is
+  /// already queued.
+  /// \return true if \c id was not already queued.
+  bool
+  push(uint64_t id, P const &p)
+  {
+    if (contains(id)) {
+      update(id, p);
+      return false;
+    }
+
+    uint32_t const i{ static_cast<uint32_t>(m_heap.size()) };
+    m_heap.push_back({ id, p });
+    m_pos[id] = i;
+    siftUp(i);
+    return true;
+  }
+
+
+  /// \brief Change the priority of queued \c id.
+  void
+  update(uint64_t id, P const &p)
+  {
+    assert(contains(id) && "Id is not in the indexed heap.");
+    uint32_t const i{ m_pos[id] };
+    P const old{ m_heap[i].priority };
+    m_heap[i].priority = p;
+    if (old<p) {
+      siftUp(i);
+    } else if (p<old) {
+      siftDown(i);
+    }
+  }
+
+
+  /// \brief Remove \c id from the heap.
+  /// \return false if \c id was not queued.
+  bool
+  erase(uint64_t id)
+  {
+    if (!contains(id)) {
+      return false;
+    }
+
+    uint32_t const i{ m_pos[id] };
+    m_pos[id] = NOT_QUEUED;
+
+    uint32_t const last{ static_cast<uint32_t>(m_heap.size()-1) };
+    if (i!=last) {
+      P const removed{ m_heap[i].priority };
+      m_heap[i] = m_heap[last];
+      m_pos[m_heap[i].id] = i;
+      m_heap.pop_back();
+      if (removed<m_heap[i].priority) {
+        siftUp(i);
+      } else {
+        siftDown(i);
+      }
+    } else {
+      m_heap.pop_back();
+    }
+
+    return true;
+  }
+
+
+  /// \brief The id with the highest priority.
+  uint64_t
+  top() const
+  {
+    assert(!m_heap.empty() && "top() called on an empty indexed heap.");
+    return m_heap[0].id;
+  }
+
+
+  /// \brief The highest priority.
+  P const &
+  topPriority() const
+  {
+    assert(!m_heap.empty() && "topPriority() called on an empty indexed heap.");
+    return m_heap[0].priority;
+  }
+
+
+  /// \brief Remove and return the id with the highest priority.
+  uint64_t
+  pop()
+  {
+    uint64_t const id{ top() };
+    erase(id);
+    return id;
+  }
+
+
+  /// \brief The priority of queued \c id.
+  P const &
+  priority(uint64_t id) const
+  {
+    assert(contains(id) && "Id is not in the indexed heap.");
+    return m_heap[m_pos[id]].priority;
+  }
+
+
+  /// \brief The \c i'th queued id, in heap order (for scanning all entries,
+  /// i in [0, size())).
+  uint64_t
+  idAt(size_t i) const
+  {
+    return m_heap[i].id;
+  }
+
+
+  size_t
+  size() const
+  {
+    return m_heap.size();
+  }
+
+
+  bool
+  empty() const
+  {
+    return m_heap.empty();
+  }
+
+
+  size_t
+  capacity() const
+  {
+    return m_pos.size();
+  }
+
+
+private:
+  struct Entry
+  {
+    uint64_t id;
+    P priority;
+  };
+
+
+  void
+  siftUp(uint32_t i)
+  {
+    Entry const e{ m_heap[i] };
+    while (i>0) {
+      uint32_t const parent{ ( i-1 )/D };
+      if (!( m_heap[parent].priority<e.priority )) {
+        break;
+      }
+      m_heap[i] = m_heap[parent];
+      m_pos[m_heap[i].id] = i;
+      i = parent;
+    }
+    m_heap[i] = e;
+    m_pos[e.id] = i;
+  }
+
+
+  void
+  siftDown(uint32_t i)
+  {
+    size_t const n{ m_heap.size() };
+    Entry const e{ m_heap[i] };
+    while (true) {
+      size_t const first{ static_cast<size_t>(i)*D+1 };
+      if (first>=n) {
+        break;
+      }
+      size_t const end{ first+D<n ? first+D : n };
+      size_t best{ first };
+      for (size_t c{ first+1 }; c<end; ++c) {
+        if (m_heap[best].priority<m_heap[c].priority) {
+          best = c;
+        }
+      }
+      if (!( e.priority<m_heap[best].priority )) {
+        break;
+      }
+      m_heap[i] = m_heap[best];
+      m_pos[m_heap[i].id] = i;
+      i = static_cast<uint32_t>(best);
+    }
+    m_heap[i] = e;
+    m_pos[e.id] = i;
+  }
+
+
+  std::vector<Entry> m_heap;     ///< The heap, highest priority at [0].
+  std::vector<uint32_t> m_pos;   ///< Position of each id in m_heap.
+
+}; // class IndexedHeap
+
+
+template<class P, unsigned D>
+const uint32_t IndexedHeap<P, D>::NOT_QUEUED;
+
+} // namespace bd
+
+#endif // ! bd_indexedheap_h
@@ -0,0 +1,204 @@
+#ifndef bd_intervaltree_h
+#define bd_intervaltree_h
+
+#include <algorithm>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+namespace bd
+{
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief Static centered interval tree over closed intervals [low, high].
+///
+/// Each node holds a center point, the intervals that contain the center
+/// (sorted once by low and once by high) and the subtrees of intervals
+/// entirely left and right of it. The center is the median endpoint of the
+/// node's intervals, so every node holds at least one interval and the tree
+/// is O(log n) deep.
+///
+/// stab() and overlap() run in O(log n + k) for k reported intervals: a node
+/// is only visited if it reports something or is on one of the two paths
+/// down to the query's endpoints.
+///
+/// The tree is built once and not modified afterwards.
+///////////////////////////////////////////////////////////////////////////////
+template<class T>
+class IntervalTree
+{
+public:
+  struct Interval
+  {
+    double low;
+    double high;
+    T value;
+  };
+
+
+  IntervalTree()
+      : m_nodes{ }
+      , m_byLow{ }
+      , m_byHigh{ }
+      , m_root{ NO_NODE }
+  {
+  }
+
+
+  /// \brief Build the tree from \c intervals.
+  /// Intervals with low > high (no values) are left out.
+  void
+  build(std::vector<Interval> intervals)
+  {
+    intervals.erase(
+        std::remove_if(intervals.begin(), intervals.end(),
+                       [](Interval const &i) { return !( i.low<=i.high ); }),
+        intervals.end());
+
+    m_nodes.clear();
+    m_byLow.clear();
+    m_byHigh.clear();
+    m_nodes.reserve(intervals.size());
+    m_byLow.reserve(intervals.size());
+    m_byHigh.reserve(intervals.size());
+
+    std::vector<double> endpoints;
+    endpoints.reserve(2*intervals.size());
+    m_root = buildNode(intervals.begin(), intervals.end(), endpoints);
+  }
+
+
+  /// \brief Call \c f(value) for each interval that contains \c v.
+  template<class F>
+  void
+  stab(double v, F f) const
+  {
+    overlap(v, v, f);
+  }
+
+
+  /// \brief Call \c f(value) for each interval that intersects [a, b]
+  /// (nothing if a > b).
+  template<class F>
+  void
+  overlap(double a, double b, F f) const
+  {
+    if (a>b) {
+      return;
+    }
+    overlapNode(m_root, a, b, f);
+  }
+
+
+  /// \brief Number of intervals in the tree.
+  size_t
+  size() const
+  {
+    return m_byLow.size();
+  }
+
+
+private:
+  static const uint32_t NO_NODE = 0xFFFFFFFF;
+
+  struct Node
+  {
+    double center;
+    uint32_t first;   ///< This node's intervals are [first, last) of
+    uint32_t last;    ///< m_byLow and m_byHigh.
+    uint32_t left;
+    uint32_t right;
+  };
+
+
+  /// \brief Build the subtree of intervals [begin, end), reordering them.
+  uint32_t
+  buildNode(typename std::vector<Interval>::iterator begin,
+            typename std::vector<Interval>::iterator end,
+            std::vector<double> &endpoints)
+  {
+    if (begin==end) {
+      return NO_NODE;
+    }
+
+    endpoints.clear();
+    for (auto i = begin; i!=end; ++i) {
+      endpoints.push_back(i->low);
+      endpoints.push_back(i->high);
+    }
+    std::nth_element(endpoints.begin(),
+                     endpoints.begin()+endpoints.size()/2,
+                     endpoints.end());
+    double const center{ endpoints[endpoints.size()/2] };
+
+    // [begin, mid) is left of center, [mid, right) contains it and
+    // [right, end) is right of it.
+    auto mid = std::partition(begin, end, [center](Interval const &i) {
+      return i.high<center;
+    });
+    auto right = std::partition(mid, end, [center](Interval const &i) {
+      return i.low<=center;
+    });
+
+    size_t const first{ m_byLow.size() };
+    m_byLow.insert(m_byLow.end(), mid, right);
+    m_byHigh.insert(m_byHigh.end(), mid, right);
+    std::sort(m_byLow.begin()+first, m_byLow.end(),
+              [](Interval const &a, Interval const &b) { return a.low<b.low; });
+    std::sort(m_byHigh.begin()+first, m_byHigh.end(),
+              [](Interval const &a, Interval const &b) { return a.high>b.high; });
+
+    uint32_t const n{ static_cast<uint32_t>(m_nodes.size()) };
+    m_nodes.push_back({ center,
+                        static_cast<uint32_t>(first),
+                        static_cast<uint32_t>(m_byLow.size()),
+                        NO_NODE, NO_NODE });
+
+    uint32_t const l{ buildNode(begin, mid, endpoints) };
+    uint32_t const r{ buildNode(right, end, endpoints) };
+    m_nodes[n].left = l;
+    m_nodes[n].right = r;
+    return n;
+  }
+
+
+  template<class F>
+  void
+  overlapNode(uint32_t n, double a, double b, F &f) const
+  {
+    while (n!=NO_NODE) {
+      Node const &node{ m_nodes[n] };
+      if (b<node.center) {
+        // the node's intervals reach right of b, they overlap iff low <= b.
+        for (uint32_t i{ node.first }; i<node.last && m_byLow[i].low<=b; ++i) {
+          f(m_byLow[i].value);
+        }
+        n = node.left;
+      } else if (a>node.center) {
+        // the node's intervals reach left of a, they overlap iff high >= a.
+        for (uint32_t i{ node.first }; i<node.last && m_byHigh[i].high>=a; ++i) {
+          f(m_byHigh[i].value);
+        }
+        n = node.right;
+      } else {
+        // the center is in [a, b], every interval here overlaps.
+        for (uint32_t i{ node.first }; i<node.last; ++i) {
+          f(m_byLow[i].value);
+        }
+        overlapNode(node.left, a, b, f);
+        n = node.right;
+      }
+    }
+  }
+
+
+  std::vector<Node> m_nodes;
+  std::vector<Interval> m_byLow;   ///< Per node, sorted by ascending low.
+  std::vector<Interval> m_byHigh;  ///< Per node, sorted by descending high.
+  uint32_t m_root;
+
+}; // class IntervalTree
+
+} // namespace bd
+
+#endif // ! bd_intervaltree_h
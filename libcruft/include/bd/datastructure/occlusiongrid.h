@@ -0,0 +1,83 @@
+#ifndef bd_occlusiongrid_h
+#define bd_occlusiongrid_h
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+namespace bd
+{
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief How much of each cell of a regular grid of semi-transparent cells
+/// can be seen from an eye.
+///
+/// Light is marched from the eye outwards one cell at a time: a cell's
+/// transmittance is the transmittance out of its neighbours towards the eye,
+/// weighted by how much the direction to the eye goes through each of them.
+/// That follows the rays to the eye without marching one per cell, so the
+/// whole grid costs one visit per cell.
+///
+/// Cells are indexed x fastest, then y, then z.
+///////////////////////////////////////////////////////////////////////////////
+class OcclusionGrid
+{
+public:
+  /// \brief No grid, valid() is false.
+  OcclusionGrid();
+
+
+  /// \brief A grid of \c dims cells of size \c cell, the min corner of the
+  /// grid at \c lo (world coords).
+  OcclusionGrid(glm::u64vec3 const &dims, glm::vec3 const &lo,
+                glm::vec3 const &cell);
+
+
+  /// \brief True if there is a grid.
+  bool
+  valid() const;
+
+
+  glm::u64vec3 const &
+  dims() const;
+
+
+  /// \brief Number of cells in the grid.
+  size_t
+  size() const;
+
+
+  /// \brief The index of cell \c ijk.
+  size_t
+  index(glm::u64vec3 const &ijk) const
+  {
+    return ijk.x+m_dims.x*( ijk.y+m_dims.y*ijk.z );
+  }
+
+
+  /// \brief The fraction of the light leaving each cell towards \c eye that
+  /// gets there, that is the product of (1 - opacity) of the cells in
+  /// between.
+  ///
+  /// \param opacity One per cell, in [0, 1], the opacity of the cell along a
+  ///                ray crossing it.
+  /// \param transmittance Resized to size().
+  /// \param threads Cells are split into this many bands of rows that run
+  ///                as a pipeline, one layer of cells apart.
+  void
+  transmittance(std::vector<float> const &opacity, glm::vec3 const &eye,
+                std::vector<float> &transmittance, unsigned threads) const;
+
+
+private:
+  glm::u64vec3 m_dims;
+  glm::vec3 m_lo;
+  glm::vec3 m_cell;
+
+}; // class OcclusionGrid
+
+} // namespace bd
+
+#endif // ! bd_occlusiongrid_h
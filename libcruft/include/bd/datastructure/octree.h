@@ -1,76 +1,274 @@
-
 #ifndef bd_octree_h__
 #define bd_octree_h__
 
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <vector>
+#include <cstdint>
 #include <cstddef>
-#include <cmath>
 
-template<class NDataTy>
+namespace bd
+{
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief Implicit octree of value aggregates over a 3D grid of blocks.
+///
+/// The tree is a pyramid of grids stored level after level in one array:
+/// level 0 is the block grid itself and each level above halves the grid
+/// (rounding up) until a single root node is left. Node (i, j, k) of level l
+/// covers the blocks [2^l*(i, j, k), 2^l*(i+1, j+1, k+1)) clipped to the
+/// grid, and its children are the up-to-8 nodes (2i..2i+1, ...) of level
+/// l-1, so no pointers are stored. Grids need not be cubes or powers of two.
+///
+/// Each node keeps the min/max value, average value and min/max ROV of the
+/// blocks under it, so a query can reject (or accept) a whole subtree from
+/// one node.
+///
+/// Below the root, each level is stored as 2x2x2 bricks, one per node of
+/// the level above, so the children of a node are 8 consecutive entries.
+/// Levels are padded to whole bricks; padding entries are never visited.
+///
+/// Leaves are numbered like blocks: i + nx*(j + ny*k).
+///////////////////////////////////////////////////////////////////////////////
 class Octree
 {
+public:
+  /// \brief Per block input to build().
+  struct Leaf
+  {
+    float min;
+    float max;
+    float avg;
+    float rov;
+  };
 
-private:
-  class OcNode
+
+  struct Node
   {
+    float min;
+    float max;
+    float avg;        ///< Average of the blocks' averages.
+    float minRov;
+    float maxRov;
+    uint32_t count;   ///< Number of blocks under this node.
+  };
 
-  public:
-    void
-    insert(OcNode *m_root, NDataTy const &data, float const pos[3])
-    {
-      OcNode *nodes = m_root;
 
+  /// \brief Result of a node test in query().
+  enum class Overlap
+  {
+    None,     ///< No block under the node is wanted.
+    Partial,  ///< Some might be, look at the children.
+    All       ///< Every block under the node is wanted.
+  };
 
 
-    }
+  Octree();
 
 
-  private:
+  /// \brief Build the tree over a grid of \c dims blocks.
+  /// \param leaves One entry per block, in block index order.
+  void
+  build(glm::u64vec3 const &dims, std::vector<Leaf> const &leaves);
 
 
+  /// \brief Number of levels, including the leaves (0 if the grid is empty).
+  size_t
+  levels() const;
 
-  };
 
+  /// \brief Grid dimensions of \c level (level 0 is the block grid).
+  glm::u64vec3
+  levelDims(size_t level) const;
+
+
+  Node const &
+  node(size_t level, glm::u64vec3 const &ijk) const;
+
+
+  Node const &
+  root() const;
+
+
+  size_t
+  leafCount() const;
+
+
+  /// \brief Call \c f(leaf index) for the wanted leaves.
+  ///
+  /// \c test(node, lo, hi) is called top down with the node's block range
+  /// [lo, hi) and decides if the subtree is rejected, accepted whole or
+  /// split further. A leaf is wanted unless its test returns None.
+  template<class Test, class F>
+  void
+  query(Test test, F f) const;
+
+
+  /// \brief Call \c f(leaf index) for each block whose [min, max] intersects
+  /// [a, b].
+  template<class F>
+  void
+  forEachInValueRange(double a, double b, F f) const;
+
+
+  /// \brief Call \c f(leaf index) for each block with ROV in [low, high].
+  template<class F>
+  void
+  forEachInRovRange(double low, double high, F f) const;
 
-public:
-  Octree() = delete;
 
-  Octree(int maxPointsPerNode, int maxDepth)
-      : m_maxPointsPerNode{ maxPointsPerNode }
-      , m_maxDepth{ maxDepth }
+private:
+  /// \brief Position of node \c ijk of \c level within its level's grid
+  /// (row-major, not the storage order).
+  size_t
+  local(size_t level, glm::u64vec3 const &ijk) const
   {
-    size_t totalNodes{ static_cast<size_t>(std::pow(8, maxDepth)) };
-    m_nodes = new OcNode[ totalNodes ];
+    glm::u64vec3 const &d{ m_dims[level] };
+    return ijk.x+d.x*( ijk.y+d.y*ijk.z );
   }
 
-  Octree(Octree const &rhs)
-    : m_nodes{ rhs.m_nodes }
-    , m_maxPointsPerNode{ rhs.m_maxPointsPerNode } { }
 
-  bool operator==(Octree const &other)
+  /// \brief Offset in m_nodes of the first child of the node at \c parent
+  /// (its local()) on level \c level+1.
+  size_t
+  firstChild(size_t level, size_t parent) const
   {
-    return m_nodes == other.m_nodes;
+    return m_offsets[level]+8*parent;
   }
 
-  ~Octree(){ }
 
-  void
-  insert(NDataTy const &data, float const pos[3])
+  static size_t
+  octant(glm::u64vec3 const &ijk)
+  {
+    return ( ijk.x & 1 ) | ( ( ijk.y & 1 ) << 1 ) | ( ( ijk.z & 1 ) << 2 );
+  }
+
+
+  size_t
+  index(size_t level, glm::u64vec3 const &ijk) const
   {
-    insertHelper(data, pos, m_nodes);
+    if (level+1==m_dims.size()) {
+      return m_offsets[level];
+    }
+    return firstChild(level, local(level+1, ijk/uint64_t(2)))+octant(ijk);
   }
 
 
+  std::vector<glm::u64vec3> m_dims;   ///< Grid dimensions of each level.
+  std::vector<size_t> m_offsets;      ///< Start of each level in m_nodes.
+  size_t m_leafCount;
+  std::vector<Node> m_nodes;
 
-private:
-  void insertHelper(NDataTy const &data, float const pos[3], OcNode *node)
+}; // class Octree
+
+
+///////////////////////////////////////////////////////////////////////////////
+template<class Test, class F>
+void
+Octree::query(Test test, F f) const
+{
+  if (m_dims.empty()) {
+    return;
+  }
+
+  struct Item
   {
+    size_t level;
+    glm::u64vec3 ijk;
+  };
+
+  glm::u64vec3 const &leafDims{ m_dims[0] };
+  std::vector<Item> stack;
+  stack.reserve(8*m_dims.size());
+  stack.push_back({ m_dims.size()-1, { 0, 0, 0 }});
+
+  while (!stack.empty()) {
+    Item const item{ stack.back() };
+    stack.pop_back();
 
+    glm::u64vec3 const lo{ item.ijk*( uint64_t(1) << item.level ) };
+    glm::u64vec3 const hi{ glm::min(( item.ijk+uint64_t(1) )*( uint64_t(1) << item.level ),
+                                    leafDims) };
+
+    Overlap const o{ test(m_nodes[index(item.level, item.ijk)], lo, hi) };
+    if (o==Overlap::None) {
+      continue;
+    }
+
+    if (o==Overlap::All || item.level==0) {
+      for (uint64_t k{ lo.z }; k<hi.z; ++k) {
+        for (uint64_t j{ lo.y }; j<hi.y; ++j) {
+          for (uint64_t i{ lo.x }; i<hi.x; ++i) {
+            f(i+leafDims.x*( j+leafDims.y*k ));
+          }
+        }
+      }
+      continue;
+    }
+
+    size_t const child{ item.level-1 };
+    size_t const brick{ firstChild(child, local(item.level, item.ijk)) };
+    glm::u64vec3 const first{ item.ijk*uint64_t(2) };
+    glm::u64vec3 const last{ glm::min(first+uint64_t(2), m_dims[child]) };
+    for (uint64_t k{ first.z }; k<last.z; ++k) {
+      for (uint64_t j{ first.y }; j<last.y; ++j) {
+        for (uint64_t i{ first.x }; i<last.x; ++i) {
+          if (child>0) {
+            stack.push_back({ child, { i, j, k }});
+            continue;
+          }
+          // leaves are tested here rather than going through the stack.
+          glm::u64vec3 const leaf{ i, j, k };
+          if (test(m_nodes[brick+octant(leaf)], leaf, leaf+uint64_t(1))!=Overlap::None) {
+            f(i+leafDims.x*( j+leafDims.y*k ));
+          }
+        }
+      }
+    }
+  }
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+template<class F>
+void
+Octree::forEachInValueRange(double a, double b, F f) const
+{
+  if (a>b) {
+    return;
+  }
+
+  // Never All: a block without values (min > max) under an otherwise
+  // matching node must still be left out at the leaf.
+  query([a, b](Node const &n, glm::u64vec3 const &, glm::u64vec3 const &) {
+          return n.max<a || n.min>b ? Overlap::None : Overlap::Partial;
+        },
+        f);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+template<class F>
+void
+Octree::forEachInRovRange(double low, double high, F f) const
+{
+  if (low>high) {
+    return;
   }
 
-  OcNode *m_nodes;
-  int m_maxPointsPerNode;
-  int m_maxDepth;
-};
+  query([low, high](Node const &n, glm::u64vec3 const &, glm::u64vec3 const &) {
+          if (n.maxRov<low || n.minRov>high) {
+            return Overlap::None;
+          }
+          if (n.minRov>=low && n.maxRov<=high) {
+            return Overlap::All;
+          }
+          return Overlap::Partial;
+        },
+        f);
+}
 
+} // namespace bd
 
 #endif  // ! bd_octree_h__
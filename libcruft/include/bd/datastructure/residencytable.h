@@ -0,0 +1,215 @@
+#ifndef bd_residencytable_h
+#define bd_residencytable_h
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <cassert>
+
+namespace bd
+{
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief Set of values keyed by a dense integer id in [0, capacity).
+///
+/// Membership is kept in a bitset indexed by id, so contains() is a single
+/// bit test. Resident values are packed into a dense array so that scans touch
+/// only the resident entries, and each id remembers its slot in the dense
+/// array so that erase() is O(1) (the last entry is swapped into the hole).
+///
+/// Iteration order is not stable across erase().
+///////////////////////////////////////////////////////////////////////////////
+template<class T>
+class ResidencyTable
+{
+public:
+  static const uint32_t NO_SLOT = 0xFFFFFFFF;
+
+
+  ResidencyTable()
+      : ResidencyTable(0)
+  {
+  }
+
+
+  explicit ResidencyTable(size_t capacity)
+      : m_bits{ }
+      , m_slots{ }
+      , m_ids{ }
+      , m_values{ }
+  {
+    resize(capacity);
+  }
+
+
+  /// \brief Set the number of ids the table can hold and clear the table.
+  void
+  resize(size_t capacity)
+  {
+    m_bits.assign(( capacity+63 )/64, 0);
+    m_slots.assign(capacity, NO_SLOT);
+    m_ids.clear();
+    m_values.clear();
+    m_ids.reserve(capacity);
+    m_values.reserve(capacity);
+  }
+
+
+  /// \brief Remove all entries, keeping the capacity.
+  void
+  clear()
+  {
+    for (uint64_t id : m_ids) {
+      m_slots[id] = NO_SLOT;
+      m_bits[id >> 6] = 0;
+    }
+    m_ids.clear();
+    m_values.clear();
+  }
+
+
+  /// \brief True if \c id is resident.
+  bool
+  contains(uint64_t id) const
+  {
+    assert(id<m_slots.size() && "Id out of range for residency table.");
+    return ( m_bits[id >> 6] >> ( id & 63 ) ) & 1;
+  }
+
+
+  /// \brief Add \c value under \c id.
+  /// \return false if \c id was already resident (value is not replaced).
+  bool
+  insert(uint64_t id, T const &value)
+  {
+    if (contains(id)) {
+      return false;
+    }
+
+    m_bits[id >> 6] |= uint64_t{ 1 } << ( id & 63 );
+    m_slots[id] = static_cast<uint32_t>(m_ids.size());
+    m_ids.push_back(id);
+    m_values.push_back(value);
+    return true;
+  }
+
+
+  /// \brief Remove \c id.
+  /// \return false if \c id was not resident.
+  bool
+  erase(uint64_t id)
+  {
+    if (!contains(id)) {
+      return false;
+    }
+
+    eraseSlot(m_slots[id]);
+    return true;
+  }
+
+
+  /// \brief Get the value stored for \c id.
+  /// \note \c id must be resident.
+  T const &
+  get(uint64_t id) const
+  {
+    assert(contains(id) && "Id is not resident in residency table.");
+    return m_values[m_slots[id]];
+  }
+
+
+  /// \brief Remove every entry for which \c pred(value) is true.
+  /// \c onErase(value) is called for each entry before it is removed.
+  /// \return The number of entries removed.
+  template<class Pred, class OnErase>
+  size_t
+  eraseIf(Pred pred, OnErase onErase, size_t maxErase = SIZE_MAX)
+  {
+    size_t erased{ 0 };
+    size_t i{ 0 };
+    while (i<m_values.size() && erased<maxErase) {
+      if (pred(m_values[i])) {
+        onErase(m_values[i]);
+        eraseSlot(static_cast<uint32_t>(i));
+        ++erased;
+        // the former last entry now sits in slot i, so don't advance.
+      } else {
+        ++i;
+      }
+    }
+    return erased;
+  }
+
+
+  /// \brief Number of resident ids.
+  size_t
+  size() const
+  {
+    return m_ids.size();
+  }
+
+
+  bool
+  empty() const
+  {
+    return m_ids.empty();
+  }
+
+
+  /// \brief Largest id + 1 that may be stored.
+  size_t
+  capacity() const
+  {
+    return m_slots.size();
+  }
+
+
+  /// \brief The resident ids, packed (parallel to values()).
+  std::vector<uint64_t> const &
+  ids() const
+  {
+    return m_ids;
+  }
+
+
+  /// \brief The resident values, packed (parallel to ids()).
+  std::vector<T> const &
+  values() const
+  {
+    return m_values;
+  }
+
+
+private:
+
+  void
+  eraseSlot(uint32_t slot)
+  {
+    uint64_t const id{ m_ids[slot] };
+    uint32_t const last{ static_cast<uint32_t>(m_ids.size()-1) };
+    if (slot!=last) {
+      m_ids[slot] = m_ids[last];
+      m_values[slot] = m_values[last];
+      m_slots[m_ids[slot]] = slot;
+    }
+    m_ids.pop_back();
+    m_values.pop_back();
+
+    m_slots[id] = NO_SLOT;
+    m_bits[id >> 6] &= ~( uint64_t{ 1 } << ( id & 63 ));
+  }
+
+
+  std::vector<uint64_t> m_bits;   ///< Residency bit per id.
+  std::vector<uint32_t> m_slots;  ///< Slot in m_ids/m_values per id.
+  std::vector<uint64_t> m_ids;    ///< Dense resident ids.
+  std::vector<T> m_values;        ///< Dense resident values.
+
+}; // class ResidencyTable
+
+template<class T>
+const uint32_t ResidencyTable<T>::NO_SLOT;
+
+} // namespace bd
+
+#endif // ! bd_residencytable_h
@@ -0,0 +1,142 @@
+#ifndef bd_visibilityorder_h
+#define bd_visibilityorder_h
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+namespace bd
+{
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief Back to front order of the cells of a regular grid, without
+/// sorting by distance.
+///
+/// Along each axis the cells are visited from both ends towards the cell
+/// the eye is in (the farther end first). Nesting the axes (z outermost)
+/// gives a correct visibility order for axis aligned cells: of two cells
+/// on the same side of the eye along an axis, the farther one comes first,
+/// and cells on opposite sides cannot occlude each other.
+///
+/// The order only depends on the eye's cell, so it can be kept while the
+/// eye stays in one cell (see eyeCell()).
+///////////////////////////////////////////////////////////////////////////////
+class VisibilityOrder
+{
+public:
+  /// \brief No grid, valid() is false.
+  VisibilityOrder();
+
+
+  /// \brief A grid of \c dims cells of size \c cell, the min corner of the
+  /// grid at \c lo (world coords).
+  VisibilityOrder(glm::u64vec3 const &dims, glm::vec3 const &lo,
+                  glm::vec3 const &cell);
+
+
+  /// \brief True if there is a grid to order.
+  bool
+  valid() const;
+
+
+  glm::u64vec3 const &
+  dims() const;
+
+
+  /// \brief The cell the eye is in, clamped to [-1, dims] along each axis
+  /// (an eye outside of the grid orders the grid like one just outside).
+  glm::i64vec3
+  eyeCell(glm::vec3 const &eye) const;
+
+
+  /// \brief Put \c items back to front for an eye in cell \c eye.
+  ///
+  /// Three stable counting sorts, one per axis, so this is
+  /// O(items + the grid's dims) rather than O(n log n).
+  ///
+  /// \param ijk ijk(item) is the item's cell.
+  /// \note The grid can be at most 2^21-2 cells along an axis.
+  template<class T, class Ijk>
+  void
+  sort(std::vector<T> &items, glm::i64vec3 const &eye, Ijk ijk) const;
+
+
+private:
+  /// \brief Rank of index \c i along an axis of \c n cells with the eye in
+  /// \c e: 0 for the farthest cells, increasing towards the eye.
+  static uint64_t
+  rank(uint64_t i, int64_t e, uint64_t n)
+  {
+    int64_t const ii{ static_cast<int64_t>(i) };
+    int64_t const far{ std::max<int64_t>(e, static_cast<int64_t>(n)-1-e) };
+    int64_t const d{ ii<e ? e-ii : ii-e };
+    return static_cast<uint64_t>(far-d);
+  }
+
+
+  static uint64_t const RankMask{ ( uint64_t(1) << 21 )-1 };
+
+  glm::u64vec3 m_dims;
+  glm::vec3 m_lo;
+  glm::vec3 m_cell;
+
+}; // class VisibilityOrder
+
+
+///////////////////////////////////////////////////////////////////////////////
+template<class T, class Ijk>
+void
+VisibilityOrder::sort(std::vector<T> &items, glm::i64vec3 const &eye,
+                      Ijk ijk) const
+{
+  if (items.size()<2) {
+    return;
+  }
+
+  // the ranks of each item along x, y, z, packed 21 bits each.
+  struct Keyed
+  {
+    uint64_t key;
+    T item;
+  };
+  std::vector<Keyed> keyed;
+  keyed.reserve(items.size());
+  for (T const &item : items) {
+    glm::u64vec3 const c{ ijk(item) };
+    keyed.push_back({ rank(c.x, eye.x, m_dims.x) |
+                          rank(c.y, eye.y, m_dims.y) << 21 |
+                          rank(c.z, eye.z, m_dims.z) << 42,
+                      item });
+  }
+
+  // least significant (x) first, each pass stable.
+  std::vector<Keyed> scratch(keyed.size());
+  std::vector<size_t> counts;
+  for (int a{ 0 }; a<3; ++a) {
+    // ranks go up to the larger distance from the eye to either end, that
+    // is at most n when the eye is just outside of the grid.
+    counts.assign(m_dims[a]+2, 0);
+    int const shift{ 21*a };
+    for (Keyed const &k : keyed) {
+      ++counts[( k.key >> shift & RankMask )+1];
+    }
+    for (size_t r{ 1 }; r<counts.size(); ++r) {
+      counts[r] += counts[r-1];
+    }
+    for (Keyed const &k : keyed) {
+      scratch[counts[k.key >> shift & RankMask]++] = k;
+    }
+    keyed.swap(scratch);
+  }
+
+  for (size_t i{ 0 }; i<items.size(); ++i) {
+    items[i] = keyed[i].item;
+  }
+}
+
+} // namespace bd
+
+#endif // ! bd_visibilityorder_h
@@ -0,0 +1,99 @@
+#ifndef bd_frustum_h
+#define bd_frustum_h
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+namespace bd
+{
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief The six planes of a view frustum, taken from a view-projection
+/// matrix (OpenGL clip space, -w <= x, y, z <= w).
+///
+/// Each plane is (a, b, c, d) with a unit normal (a, b, c) pointing into
+/// the frustum, so a point p is inside of it if a*p.x + b*p.y + c*p.z + d
+/// >= 0 for all six.
+///////////////////////////////////////////////////////////////////////////////
+class Frustum
+{
+public:
+  /// \brief Planes of a frustum that contains everything.
+  Frustum();
+
+
+  /// \brief The frustum of \c viewProj, in the space \c viewProj maps from.
+  explicit Frustum(glm::mat4 const &viewProj);
+
+
+  /// \brief Plane \c i, in order left, right, bottom, top, near, far.
+  glm::vec4 const &
+  plane(size_t i) const;
+
+
+  /// \brief True if the box [min, max] is at least partly inside.
+  ///
+  /// Conservative: a box near a corner of the frustum, outside of it but
+  /// not entirely behind any one plane, is reported inside.
+  bool
+  intersects(glm::vec3 const &min, glm::vec3 const &max) const;
+
+
+  /// \brief True if the box [min, max] is entirely inside.
+  bool
+  contains(glm::vec3 const &min, glm::vec3 const &max) const;
+
+
+private:
+  glm::vec4 m_planes[6];
+
+}; // class Frustum
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief Axis aligned boxes stored as structure of arrays, so a Frustum
+/// can test them four at a time.
+///////////////////////////////////////////////////////////////////////////////
+class AabbBatch
+{
+public:
+  AabbBatch();
+
+
+  void
+  clear();
+
+
+  void
+  reserve(size_t n);
+
+
+  /// \brief Add the box [min, max] as box size()-1.
+  void
+  push_back(glm::vec3 const &min, glm::vec3 const &max);
+
+
+  size_t
+  size() const;
+
+
+  /// \brief Set \c inside[i] to 1 if box i intersects \c f (as in
+  /// Frustum::intersects()), else 0. \c inside is resized to size().
+  void
+  cull(Frustum const &f, std::vector<uint8_t> &inside) const;
+
+
+private:
+  /// Min and max corners along x, y, z, padded to a multiple of 4 boxes.
+  std::vector<float> m_min[3];
+  std::vector<float> m_max[3];
+  size_t m_size;
+
+}; // class AabbBatch
+
+} // namespace bd
+
+#endif // ! bd_frustum_h
@@ -0,0 +1,64 @@
+#ifndef bd_mvpbatch_h
+#define bd_mvpbatch_h
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <vector>
+
+namespace bd
+{
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief World-view-projection matrices of many boxes, computed in one pass.
+///
+/// Each box's world matrix is a scale followed by a translation (like
+/// Block::transform()), so only the origin and scale are kept, as structure
+/// of arrays. compute() fills one contiguous array of matrices that can be
+/// uploaded to a buffer as is.
+///////////////////////////////////////////////////////////////////////////////
+class MvpBatch
+{
+public:
+  MvpBatch();
+
+
+  void
+  clear();
+
+
+  void
+  reserve(size_t n);
+
+
+  /// \brief Add a box with world matrix translate(origin) * scale(scale) as
+  /// box size()-1.
+  void
+  push_back(glm::vec3 const &origin, glm::vec3 const &scale);
+
+
+  size_t
+  size() const;
+
+
+  /// \brief Set matrices()[i] to viewProj * world(i) for every box.
+  void
+  compute(glm::mat4 const &viewProj);
+
+
+  /// \brief The matrices from the last compute(), one per box (column major
+  /// floats, 64 bytes each).
+  std::vector<glm::mat4> const &
+  matrices() const;
+
+
+private:
+  std::vector<float> m_origin[3];
+  std::vector<float> m_scale[3];
+  std::vector<glm::mat4> m_mvp;
+
+}; // class MvpBatch
+
+} // namespace bd
+
+#endif // ! bd_mvpbatch_h
@@ -0,0 +1,97 @@
+#ifndef bd_framebuffer_h
+#define bd_framebuffer_h
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace bd
+{
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief An rgba image in main memory, what a software renderer draws into.
+///
+/// Pixels are floats in [0,1], row 0 is the bottom row (as glReadPixels
+/// returns it). The writers flip it so images are top row first and
+/// store rgb only, 8 bits per channel.
+///////////////////////////////////////////////////////////////////////////////
+class Framebuffer
+{
+public:
+  Framebuffer();
+
+
+  Framebuffer(unsigned int w, unsigned int h);
+
+
+  /// \brief Change the size, the pixels are undefined until clear().
+  void
+  resize(unsigned int w, unsigned int h);
+
+
+  unsigned int
+  width() const;
+
+
+  unsigned int
+  height() const;
+
+
+  void
+  clear(glm::vec4 const &c);
+
+
+  glm::vec4 &
+  pixel(unsigned int x, unsigned int y);
+
+
+  glm::vec4 const &
+  pixel(unsigned int x, unsigned int y) const;
+
+
+  /// \brief The pixels, width() * height() of them, row by row.
+  std::vector<glm::vec4> const &
+  pixels() const;
+
+
+  /// \brief The rgb bytes, top row first, as written to a file.
+  std::vector<uint8_t>
+  rgb8() const;
+
+
+  /// \brief Largest difference in any rgb channel, on the 0-255 scale.
+  /// \return 255 if the sizes differ.
+  int
+  maxDifference(Framebuffer const &other) const;
+
+
+  /// \brief Write a binary (P6) PPM.
+  /// \return false if the file could not be written.
+  bool
+  writePpm(std::string const &path) const;
+
+
+  /// \brief Read a binary PPM with a max value of 255, as writePpm() writes.
+  /// \return false if the file could not be read or is some other format.
+  bool
+  readPpm(std::string const &path);
+
+
+  /// \brief Write an uncompressed (stored deflate blocks) rgb PNG.
+  /// \return false if the file could not be written.
+  bool
+  writePng(std::string const &path) const;
+
+
+private:
+  unsigned int m_width;
+  unsigned int m_height;
+  std::vector<glm::vec4> m_pixels;
+
+}; // class Framebuffer
+
+} // namespace bd
+
+#endif // ! bd_framebuffer_h
@@ -124,6 +124,12 @@ public:
   resize(unsigned int w, unsigned int h);
 
 
+  /// \brief Set the view port size and projection without touching GL
+  /// (resize() calls this, then glViewport()).
+  void
+  setViewport(unsigned int w, unsigned int h);
+
+
   unsigned int
   getViewPortWidth() const;
 
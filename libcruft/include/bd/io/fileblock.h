@@ -21,6 +21,9 @@ namespace bd
 ///   \note All values in the FileBlock struct are initialized to 0 by the c'tor,
 ///         except for min_val and max_val. min_val is init'd to its max value, and
 ///         max_val is init'd to its lowest possible value.
+///
+///   \note An occupied box with occ_max of 0 (the default) means the index
+///         file did not have one, and the whole block is used.
 /// 
 struct FileBlock
 {
@@ -32,6 +35,8 @@ struct FileBlock
       , data_offset{ 0 }
       , data_bytes{ 0 }
       , voxel_dims{ 0 }
+      , occ_min{ 0 }
+      , occ_max{ 0 }
       , world_dims{ 0 }
       , world_oigin{ 0 }
       , min_val{ std::numeric_limits< decltype(min_val) >::max() }
@@ -50,6 +55,8 @@ struct FileBlock
       , data_offset{ other.data_offset }
       , data_bytes{ other.data_bytes }
       , voxel_dims{ other.voxel_dims[0], other.voxel_dims[1], other.voxel_dims[2] }
+      , occ_min{ other.occ_min[0], other.occ_min[1], other.occ_min[2] }
+      , occ_max{ other.occ_max[0], other.occ_max[1], other.occ_max[2] }
       , world_dims{ other.world_dims[0], other.world_dims[1], other.world_dims[2] }
       , world_oigin{ other.world_oigin[0], other.world_oigin[1], other.world_oigin[2] }
       , min_val{ other.min_val }
@@ -70,6 +77,8 @@ struct FileBlock
   uint64_t data_offset;    ///< Offset into the raw file that the block data starts.
   uint64_t data_bytes;     ///< Size in bytes of this blocks data.
   uint64_t voxel_dims[3];  ///< Dimensions of this block in voxels.
+  uint64_t occ_min[3];     ///< Min corner of the relevant voxels (block voxel coords).
+  uint64_t occ_max[3];     ///< One past the max corner of the relevant voxels.
   double world_dims[3];    ///< Dims of this block in world coordinates
   double world_oigin[3];   ///< Center coordinates within canonical cube.
   double min_val;          ///< The min value found in this block.
@@ -8,6 +8,7 @@
 #include <bd/io/datatypes.h>
 #include <bd/io/fileblock.h>
 #include <bd/volume/volume.h>
+#include <bd/volume/occupancymask.h>
 
 #include <vector>
 
@@ -35,9 +36,26 @@ namespace bd { namespace indexfile { namespace v2 {
         bd::Volume const&
         getVolume() const;
 
+        /// \brief Sub-brick occupancy of each block, in block order (empty
+        ///        if the index file has none).
+        std::vector<bd::OccupancyMask> const&
+        getOccupancyMasks() const;
+
+        /// \brief True if the index file names a normalized value that the
+        ///        transfer function makes fully transparent.
+        bool
+        hasEmptyValue() const;
+
+        /// \brief The transparent value (see hasEmptyValue()).
+        double
+        getEmptyValue() const;
+
     private:
         bd::Volume m_volume;
         std::vector<bd::FileBlock> m_blocks;
+        std::vector<bd::OccupancyMask> m_masks;
+        bool m_hasEmptyValue{ false };
+        double m_emptyValue{ 0.0 };
         std::string m_fname;
         std::string m_fpath;
         std::string m_tffname;
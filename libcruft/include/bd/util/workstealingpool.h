@@ -0,0 +1,107 @@
+#ifndef bd_workstealingpool_h
+#define bd_workstealingpool_h
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace bd
+{
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief A fixed set of threads that run batches of numbered tasks.
+///
+/// run() deals the tasks out to the workers in contiguous runs, so
+/// neighbouring tasks (e.g. screen tiles) tend to stay on one thread. A
+/// worker takes tasks from the back of its own queue and, when that is
+/// empty, steals from the front of the others', so uneven tasks still keep
+/// every thread busy. The thread calling run() works as worker 0.
+///////////////////////////////////////////////////////////////////////////////
+class WorkStealingPool
+{
+public:
+  /// \brief Task \c task, run on worker \c worker (in [0, size())).
+  using Job = std::function<void(size_t task, size_t worker)>;
+
+
+  /// \param threads Workers including the caller of run(), 0 for one per
+  ///                hardware thread.
+  explicit WorkStealingPool(size_t threads = 0);
+
+
+  ~WorkStealingPool();
+
+
+  WorkStealingPool(WorkStealingPool const &) = delete;
+  WorkStealingPool &operator=(WorkStealingPool const &) = delete;
+
+
+  /// \brief Number of workers, including the caller of run().
+  size_t
+  size() const;
+
+
+  /// \brief Run \c job for tasks [0, n) and return when all are done.
+  ///
+  /// Not reentrant: one run() at a time, and not from within a job.
+  void
+  run(size_t n, Job const &job);
+
+
+  /// \brief Tasks taken from another worker's queue since the pool was made.
+  size_t
+  steals() const;
+
+
+private:
+  struct Queue
+  {
+    std::mutex mutex;
+    std::deque<size_t> tasks;
+  };
+
+
+  /// \brief Body of the pool's threads (workers 1 and up).
+  void
+  workerLoop(size_t worker);
+
+
+  /// \brief Run tasks, own then stolen, until there are none left.
+  void
+  drain(size_t worker);
+
+
+  /// \brief Pop from the back of worker's queue.
+  bool
+  popOwn(size_t worker, size_t &task);
+
+
+  /// \brief Pop from the front of some other worker's queue.
+  bool
+  steal(size_t worker, size_t &task);
+
+
+  std::vector<std::unique_ptr<Queue>> m_queues;
+  std::vector<std::thread> m_threads;
+
+  std::mutex m_mutex;
+  std::condition_variable m_wake;   ///< A new batch, or stopping.
+  std::condition_variable m_done;   ///< The last task of a batch finished.
+  uint64_t m_generation;            ///< Batches started, guarded by m_mutex.
+  bool m_stop;
+
+  Job const *m_job;
+  std::atomic<size_t> m_remaining;  ///< Tasks not yet finished.
+  std::atomic<size_t> m_steals;
+
+}; // class WorkStealingPool
+
+} // namespace bd
+
+#endif // ! bd_workstealingpool_h
@@ -3,6 +3,9 @@
 
 #include <bd/graphics/texture.h>
 #include <bd/io/fileblock.h>
+#include <bd/volume/blockstore.h>
+#include <bd/volume/quantizer.h>
+#include <bd/volume/occupancymask.h>
 
 #include <glm/glm.hpp>
 
@@ -20,6 +23,10 @@ namespace bd
 /// A blocks transform can be used to position a set of proxy geometry in
 /// 3D world space. The block's texture contains the GL id/name of the 3D
 /// texture that should be sampled by the proxy geometry.
+///
+/// A Block is a view of one entry of a BlockStore. Copies view the same
+/// block. The state used to load and draw the block (texture slot, occupied
+/// box, pixel data) is made when the block is first shown or asked for it.
 //////////////////////////////////////////////////////////////////////////
 class Block
 {
@@ -32,10 +39,12 @@ public:
   /// \param[in] ijk The block ID (and position with in the grid of blocks).
   /// \param[in] dims The world dimensions in of this block.
   /// \param[in] fb This block's FileBlock.
+  ///
+  /// ijk is used in place of fb.ijk_index. The block gets a BlockStore of its
+  /// own, blocks of a BlockStore are made by the store.
   Block(glm::u64vec3 const &ijk, FileBlock const &fb);
 
 
-  virtual
   ~Block();
 
 
@@ -52,6 +61,8 @@ public:
 
 
   /// \brief Get the FileBlock for this block.
+  /// \note is_empty is the value read from the index file, empty() has the
+  ///       block's current emptiness.
   const FileBlock&
   fileBlock() const;
 
@@ -72,7 +83,8 @@ public:
 
   /// \brief Set if this block is marked empty.
   void empty(bool);
-  /// \brief Get if this block is marked empty.
+  /// \brief Get if this block is marked empty. Safe to call while another
+  /// thread sets it.
   bool
   empty() const;
 
@@ -82,6 +94,11 @@ public:
   avg() const;
 
 
+  /// \brief Get the ratio of visibility of this block.
+  double
+  rov() const;
+
+
   /// \brief Get the center world coordinates of this block.
   glm::vec3 const &
   origin() const;
@@ -98,14 +115,36 @@ public:
   void
   texture(Texture *tex);
 
+  /// \brief Set where in texture() this block's voxels live.
+  ///
+  /// \param voxelOffset Voxel coords of the block's min corner in texture().
+  /// \param texOffset, texScale Map the block's [0,1] texture coordinates into
+  ///        texture(): atlasCoord = texOffset + texScale * blockCoord.
+  void
+  textureSlot(glm::u64vec3 const &voxelOffset,
+              glm::vec3 const &texOffset,
+              glm::vec3 const &texScale);
+
+
+  /// \brief Offset of this block's texture coordinates within texture().
+  glm::vec3 const &
+  texOffset() const;
+
+
+  /// \brief Scale of this block's texture coordinates within texture().
+  glm::vec3 const &
+  texScale() const;
+
+
   /// \brief Remove the Block's texture.
   /// Same as calling texture(nullptr)
   bd::Texture *
   removeTexture();
 
-  /// \brief Get a reference to this blocks model-to-world transform matrix.
-  glm::mat4&
-  transform();
+  /// \brief Get this block's model-to-world transform matrix (a scale then
+  /// a translation to the occupied part of the block).
+  glm::mat4
+  transform() const;
 
 
   /// \brief Construct a vector containing the dimensions of this block in voxels.
@@ -113,6 +152,45 @@ public:
   voxel_extent() const;
 
 
+  /// \brief Min corner (block voxel coords) of the part of this block that
+  /// is read, uploaded and drawn.
+  ///
+  /// This is the FileBlock's occupied box grown by one voxel on each side, so
+  /// that interpolation at its faces still sees the neighbouring voxels, and
+  /// clamped to the block. Blocks without an occupied box use all voxels.
+  glm::u64vec3 const &
+  occupiedOffset() const;
+
+
+  /// \brief Dimensions in voxels of the occupied part of this block.
+  glm::u64vec3 const &
+  occupiedExtent() const;
+
+
+  /// \brief Min corner of the occupied part in the block's [0,1] texture
+  /// coords (which span the centers of its first and last voxels).
+  ///
+  /// transform() and the texture slot cover [occupiedLow(), occupiedHigh()].
+  glm::vec3 const &
+  occupiedLow() const;
+
+
+  /// \brief Max corner of the occupied part in the block's [0,1] texture
+  /// coords.
+  glm::vec3 const &
+  occupiedHigh() const;
+
+
+  /// \brief Sub-brick occupancy of this block (nullptr if unknown).
+  OccupancyMask const *
+  occupancy() const;
+
+
+  /// \brief Set the sub-brick occupancy. The mask is not owned.
+  void
+  occupancy(OccupancyMask const *mask);
+
+
   size_t
   byteSize() const;
 
@@ -131,6 +209,22 @@ public:
   char*
   removePixelData();
 
+
+  /// \brief Times pixel data has been given to this block, so a reload into
+  /// the same buffer can be told from the data already there.
+  uint32_t
+  loadCount() const;
+
+
+  /// \brief Set how pixelData() is stored (see BlockQuantizer).
+  void
+  quantization(QuantizedBlockInfo const &info);
+
+
+  /// \brief How pixelData() is stored.
+  QuantizedBlockInfo const &
+  quantization() const;
+
   /// \brief String rep. of this blockeroo.
   std::string
   to_string() const;
@@ -155,23 +249,15 @@ public:
 
 
 private:
-  FileBlock m_fb;        ///< The FileBlock (contains the info from IndexFile)
-  glm::u64vec3 m_ijk;    ///< Block's location in block coordinates.
-  glm::vec3 m_origin;    ///< This blocks center in world coordinates.
-  glm::vec3 m_worldDims; ///< The size of this block in world coords.
-  glm::mat4 m_transform; ///< Block's model-to-world transform matrix.
+  friend class BlockStore;
 
-  Texture *m_tex ; ///< Texture assoc'd with this block.
-  char *m_pixelData; ///< CPU resident texture data (nullptr if non-resident).
+  /// \brief View of block \c slot of \c store.
+  Block(BlockStore *store, size_t slot);
 
-  ///
-  /// 0x01 -- visible.
-  /// 0x02 -- resident in GPU memory
-  /// 0x04 -- resident in CPU memory
-  /// 0x04 --
-  int m_status;
 
-  bool m_isVisible;
+  BlockStore *m_store; ///< The store this block is a view of.
+  size_t m_slot;       ///< The block's entry in m_store.
+  std::shared_ptr<BlockStore> m_own; ///< m_store if this block owns it.
 
 }; // class Block
 
@@ -0,0 +1,204 @@
+#ifndef bd_blockstore_h
+#define bd_blockstore_h
+
+#include <bd/io/fileblock.h>
+#include <bd/volume/quantizer.h>
+#include <bd/volume/occupancymask.h>
+
+#include <glm/glm.hpp>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace bd
+{
+
+class Block;
+class Texture;
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief The runtime state of a set of blocks, stored as structure of
+/// arrays in one allocation.
+///
+/// The state the filter, sort and draw loops read for every block (index,
+/// ijk, origin, world dims, rov, avg and status) lives in dense arrays, one
+/// entry per block. The FileBlocks are not copied, the store points into the
+/// index file's list.
+///
+/// What is needed only once a block is a candidate for loading (its texture
+/// slot, occupied box and pixel data) is made the first time it is asked
+/// for, in chunks allocated as they fill. Blocks that never pass
+/// classification cost only their dense entries, so memory grows with the
+/// set of blocks that have been shown rather than the grid.
+///
+/// Block i of the store is block(i), a view of entry i of the arrays. The
+/// views live in the same allocation, so their addresses do not change for
+/// the life of the store.
+///////////////////////////////////////////////////////////////////////////////
+class BlockStore
+{
+public:
+  /// \brief Where a block's voxels live in its texture.
+  struct TextureSlot
+  {
+    Texture *tex;             ///< Texture assoc'd with the block.
+    glm::vec3 offset;         ///< Block [0,1] tex coords to tex offset.
+    glm::vec3 scale;          ///< Block [0,1] tex coords to tex scale.
+    glm::u64vec3 voxelOffset; ///< Min corner of the block in tex (voxels).
+  };
+
+
+  /// \brief State of a block that has been a candidate for loading.
+  struct Runtime
+  {
+    TextureSlot texSlot;    ///< Where the block is in its texture.
+    glm::u64vec3 occOffset; ///< Min corner of the occupied voxels.
+    glm::u64vec3 occExtent; ///< Dims of the occupied voxels.
+    glm::vec3 occLow;       ///< Min corner of the occupied voxels in [0,1].
+    glm::vec3 occHigh;      ///< Max corner of the occupied voxels in [0,1].
+    char *pixelData;        ///< CPU resident texture data (or nullptr).
+    QuantizedBlockInfo quant;     ///< Storage format of pixelData.
+    uint32_t loads;         ///< Times pixelData has been set.
+  };
+
+
+  /// \brief One block per FileBlock, block(i) made from fileBlocks[i].
+  /// \note \c fileBlocks is referenced, not copied, and must outlive the
+  ///       store.
+  explicit BlockStore(std::vector<FileBlock> const &fileBlocks);
+
+
+  ~BlockStore();
+
+
+  BlockStore(BlockStore const &) = delete;
+  BlockStore &operator=(BlockStore const &) = delete;
+
+
+  /// \brief Number of blocks.
+  size_t
+  size() const;
+
+
+  /// \brief Bytes allocated for the blocks, including their runtime state.
+  size_t
+  bytes() const;
+
+
+  /// \brief Number of blocks that have runtime state.
+  size_t
+  materialized() const;
+
+
+  /// \brief The view of block \c i.
+  Block *
+  block(size_t i);
+
+
+  Block const *
+  block(size_t i) const;
+
+
+  /// \brief The world center of each block, size() of them.
+  glm::vec3 const *
+  origins() const;
+
+
+  /// \brief The world dims of each block, size() of them.
+  glm::vec3 const *
+  worldDims() const;
+
+
+  /// \brief The ratio of visibility of each block, size() of them.
+  double const *
+  rovs() const;
+
+
+  /// \brief The status bits (see Block) of each block, size() of them.
+  int const *
+  statuses() const;
+
+
+  /// \brief Voxels in the occupied boxes of all blocks (see
+  /// Block::occupiedExtent()), without making their runtime state.
+  uint64_t
+  occupiedVoxels() const;
+
+
+private:
+  friend class Block;
+
+  /// \brief A store of one block, for a Block made on its own. Keeps a copy
+  /// of \c fb.
+  explicit BlockStore(FileBlock const &fb);
+
+
+  /// \brief Allocate the arrays for \c n blocks.
+  void
+  allocate(size_t n);
+
+
+  /// \brief Set entry \c i from \c fb.
+  void
+  init(size_t i, FileBlock const &fb);
+
+
+  /// \brief The runtime state of block \c i, nullptr if it has none yet.
+  Runtime *
+  peek(size_t i) const
+  {
+    return m_runtime[i].load(std::memory_order_acquire);
+  }
+
+
+  /// \brief The runtime state of block \c i, made if it has none yet.
+  Runtime &
+  materialize(size_t i)
+  {
+    Runtime *rt{ peek(i) };
+    return rt ? *rt : makeRuntime(i);
+  }
+
+
+  Runtime &
+  makeRuntime(size_t i);
+
+
+  size_t m_size;
+  size_t m_bytes;
+  std::unique_ptr<char[]> m_arena;
+
+  // hot, one entry per block.
+  uint64_t *m_index;
+  glm::u64vec3 *m_ijk;
+  glm::vec3 *m_origin;
+  glm::vec3 *m_worldDims;
+  double *m_rov;
+  double *m_avg;
+  int *m_status;
+  std::atomic<uint8_t> *m_empty;
+  OccupancyMask const **m_occMask;
+  std::atomic<Runtime *> *m_runtime;
+
+  // cold, the FileBlocks the store was made from.
+  FileBlock const *m_fb;
+  std::unique_ptr<FileBlock const> m_ownFb;
+
+  Block *m_views;
+
+  // runtime state, made on demand.
+  mutable std::mutex m_runtimeMutex;
+  std::vector<std::unique_ptr<Runtime[]>> m_chunks;
+  size_t m_chunkSize;
+  size_t m_chunkUsed;
+  std::atomic<size_t> m_materialized;
+
+}; // class BlockStore
+
+} // namespace bd
+
+#endif // ! bd_blockstore_h
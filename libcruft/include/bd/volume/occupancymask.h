@@ -0,0 +1,155 @@
+#ifndef bd_occupancymask_h
+#define bd_occupancymask_h
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace bd
+{
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief One bit per sub-brick of a block: set if the brick has at least
+/// one relevant voxel.
+///
+/// A block of \c blockDims voxels is cut into bricks of brickSide()^3
+/// voxels (the last brick along each axis may be smaller). Bricks are
+/// numbered like blocks, i + nx*(j + ny*k), and bit n lives in bit n%8 of
+/// byte n/8, which is also how the index file stores them.
+///
+/// A mask with no bricks (size() == 0) carries no information and reports
+/// every voxel as occupied, so consumers can use it unconditionally.
+///////////////////////////////////////////////////////////////////////////////
+class OccupancyMask
+{
+public:
+  OccupancyMask();
+
+
+  /// \brief All bricks occupied.
+  OccupancyMask(glm::u64vec3 const &blockDims, uint64_t brickSide);
+
+
+  /// \brief Set the bits from the index file's hex string, two digits per
+  /// byte in byte order.
+  /// \return false (leaving the mask unchanged) if \c hex is not hex or is
+  ///         too short for the bricks.
+  bool
+  fromHex(std::string const &hex);
+
+
+  std::string
+  toHex() const;
+
+
+  /// \brief Number of bricks (0 if the mask carries no information).
+  size_t
+  size() const;
+
+
+  glm::u64vec3 const &
+  blockDims() const;
+
+
+  uint64_t
+  brickSide() const;
+
+
+  /// \brief Number of bricks along each axis.
+  glm::u64vec3 const &
+  brickCount() const;
+
+
+  bool
+  occupied(glm::u64vec3 const &brick) const;
+
+
+  void
+  occupied(glm::u64vec3 const &brick, bool isOccupied);
+
+
+  /// \brief Number of occupied bricks.
+  size_t
+  occupiedCount() const;
+
+
+  /// \brief True if any voxel of the box [lo, hi) (block voxel coords) is in
+  /// an occupied brick.
+  bool
+  anyOccupied(glm::u64vec3 const &lo, glm::u64vec3 const &hi) const;
+
+
+  /// \brief A copy with every brick next to an occupied one (26-neighbours)
+  /// also occupied.
+  ///
+  /// Voxels of an empty brick in the dilated mask are a whole brick away
+  /// from any relevant voxel, so skipping them cannot change interpolated
+  /// samples near relevant voxels.
+  OccupancyMask
+  dilated() const;
+
+
+  /// \brief Call \c f(begin, end) for each run of voxels [begin, end) of the
+  /// row (y, z) within [x0, x1) that lie in occupied bricks.
+  template<class F>
+  void
+  forEachOccupiedRun(uint64_t y, uint64_t z, uint64_t x0, uint64_t x1,
+                     F f) const;
+
+
+private:
+  size_t
+  bit(glm::u64vec3 const &brick) const
+  {
+    return brick.x+m_brickCount.x*( brick.y+m_brickCount.y*brick.z );
+  }
+
+
+  glm::u64vec3 m_blockDims;
+  glm::u64vec3 m_brickCount;
+  uint64_t m_brickSide;
+  std::vector<uint8_t> m_bits;
+
+}; // class OccupancyMask
+
+
+///////////////////////////////////////////////////////////////////////////////
+template<class F>
+void
+OccupancyMask::forEachOccupiedRun(uint64_t y, uint64_t z,
+                                  uint64_t x0, uint64_t x1, F f) const
+{
+  if (x0>=x1) {
+    return;
+  }
+  if (m_bits.empty()) {
+    f(x0, x1);
+    return;
+  }
+
+  uint64_t const bj{ y/m_brickSide };
+  uint64_t const bk{ z/m_brickSide };
+  uint64_t runStart{ x1 };
+  for (uint64_t bi{ x0/m_brickSide }; bi*m_brickSide<x1; ++bi) {
+    uint64_t const begin{ std::max(bi*m_brickSide, x0) };
+    if (occupied({ bi, bj, bk })) {
+      if (runStart==x1) {
+        runStart = begin;
+      }
+    } else if (runStart!=x1) {
+      f(runStart, begin);
+      runStart = x1;
+    }
+  }
+  if (runStart!=x1) {
+    f(runStart, x1);
+  }
+}
+
+} // namespace bd
+
+#endif // ! bd_occupancymask_h
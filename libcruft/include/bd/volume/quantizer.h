@@ -0,0 +1,140 @@
+#ifndef bd_quantizer_h
+#define bd_quantizer_h
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace bd
+{
+
+/// \brief Storage formats for a block's normalized voxel values.
+enum class QuantizeMode : int
+{
+  None,   ///< 32-bit float, unchanged.
+  U8,     ///< 8-bit unsigned, per-block scale/offset.
+  U16,    ///< 16-bit unsigned, per-block scale/offset.
+  F16,    ///< IEEE 754 half float.
+  Auto    ///< Smallest of U8/U16/F16 that meets the error bound.
+};
+
+
+/// \brief Parse "none", "u8", "u16", "f16" or "auto".
+/// \throws std::invalid_argument for any other string.
+QuantizeMode
+to_quantizeMode(std::string const &s);
+
+
+std::string
+to_string(QuantizeMode m);
+
+
+/// \brief How one block was stored by BlockQuantizer.
+struct QuantizedBlockInfo
+{
+  QuantizedBlockInfo()
+      : mode{ QuantizeMode::None }
+      , scale{ 1.0f }
+      , offset{ 0.0f }
+      , maxError{ 0.0 }
+      , bytes{ 0 }
+  {
+  }
+
+
+  /// \brief Uncompressed size / stored size.
+  double
+  ratio(size_t numVoxels) const
+  {
+    return bytes==0 ? 1.0 : numVoxels*sizeof(float)/static_cast<double>(bytes);
+  }
+
+
+  QuantizeMode mode;  ///< The format actually used (never Auto).
+  float scale;        ///< value = offset + scale * q (integer modes).
+  float offset;
+  double maxError;    ///< Largest |value - dequantized value| in the block.
+  size_t bytes;       ///< Stored size of the block.
+};
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief Converts a block of float voxels to a reduced precision format
+/// (and back).
+///
+/// The integer formats store (value - min) / (max - min) of the block, so a
+/// block with a narrow value range keeps most of its precision. Half floats
+/// are converted with F16C instructions on cpus that have them (x86 builds
+/// with CRUFT_USE_F16C), otherwise with a scalar conversion.
+///////////////////////////////////////////////////////////////////////////////
+class BlockQuantizer
+{
+public:
+  /// \param mode The format to store blocks in.
+  /// \param errorBound For Auto, the largest absolute error allowed. Auto
+  ///        falls back to the most precise 16-bit format if nothing meets it.
+  BlockQuantizer(QuantizeMode mode, double errorBound);
+
+
+  /// \brief Quantize \c n voxels from \c src into \c dst.
+  /// \c dst must hold at least bytesPerVoxel(mode())*n bytes. \c src and
+  /// \c dst may be the same buffer.
+  QuantizedBlockInfo
+  quantize(float const *src, size_t n, char *dst) const;
+
+
+  /// \brief Expand \c n voxels stored as described by \c info into \c dst.
+  static void
+  dequantize(QuantizedBlockInfo const &info, char const *src, size_t n,
+             float *dst);
+
+
+  /// \brief Bytes per voxel a buffer needs to hold any block stored in
+  /// \c mode (Auto needs room for a 16-bit block).
+  static size_t
+  bytesPerVoxel(QuantizeMode mode);
+
+
+  QuantizeMode
+  mode() const
+  {
+    return m_mode;
+  }
+
+
+  double
+  errorBound() const
+  {
+    return m_errorBound;
+  }
+
+
+private:
+  QuantizeMode m_mode;
+  double m_errorBound;
+
+}; // class BlockQuantizer
+
+
+/// \brief Convert float to IEEE half (round to nearest even).
+uint16_t
+floatToHalf(float f);
+
+
+/// \brief Convert IEEE half to float.
+float
+halfToFloat(uint16_t h);
+
+
+/// \brief Convert \c n floats to halves (F16C when available).
+void
+floatsToHalves(float const *src, size_t n, uint16_t *dst);
+
+
+/// \brief Convert \c n halves to floats (F16C when available).
+void
+halvesToFloats(uint16_t const *src, size_t n, float *dst);
+
+} // namespace bd
+
+#endif // ! bd_quantizer_h
@@ -27,10 +27,19 @@ public:
 
 
   /// \brief Get/set the number of voxels in each block.
+  ///
+  /// For a partition of differently sized blocks this is the largest size
+  /// along each axis.
   const glm::u64vec3&
   block_dims() const;
 
 
+  /// \brief Set the block dimensions to \c bd, leaving the block count.
+  /// \note Setting the block count or voxel dims computes them again.
+  void
+  block_dims(glm::u64vec3 const &bd);
+
+
   /// \brief Get/Set the number of blocks along each axis.
   glm::u64vec3 const&
   block_count() const;
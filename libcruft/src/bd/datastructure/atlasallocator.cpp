@@ -0,0 +1,284 @@
+#include <bd/datastructure/atlasallocator.h>
+
+#include <algorithm>
+#include <cassert>
+
+namespace bd
+{
+
+const uint32_t AtlasAllocator::NO_SLOT;
+
+namespace
+{
+
+/// \brief Smallest slot grid, x-fastest within \c full, that holds \c n slots.
+glm::u64vec3
+shrinkGrid(glm::u64vec3 const &full, size_t n)
+{
+  uint64_t const perLayer{ full.x*full.y };
+  if (n>=perLayer) {
+    return { full.x, full.y, ( n+perLayer-1 )/perLayer };
+  }
+  if (n>=full.x) {
+    return { full.x, ( n+full.x-1 )/full.x, 1 };
+  }
+  return { n, 1, 1 };
+}
+
+} // namespace
+
+
+///////////////////////////////////////////////////////////////////////////////
+AtlasAllocator::AtlasAllocator()
+    : AtlasAllocator({ 1, 1, 1 }, { 1, 1, 1 }, 0, 0)
+{
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+AtlasAllocator::AtlasAllocator(glm::u64vec3 const &slotDims,
+                               glm::u64vec3 const &maxAtlasDims,
+                               size_t numSlots,
+                               size_t numIds)
+    : m_slotDims{ slotDims }
+    , m_slotGrid{ 1, 1, 1 }
+    , m_lastGrid{ 1, 1, 1 }
+    , m_slotsPerAtlas{ 1 }
+    , m_capacity{ numSlots }
+    , m_atlasCount{ 0 }
+    , m_free{ }
+    , m_idSlots{ numIds }
+    , m_atlasUsed{ }
+{
+  // A slot larger than the max atlas along some axis still gets an atlas of
+  // its own along that axis.
+  for (int i{ 0 }; i<3; ++i) {
+    uint64_t const n{ slotDims[i]>0 ? maxAtlasDims[i]/slotDims[i] : 0 };
+    m_slotGrid[i] = std::max<uint64_t>(n, 1);
+  }
+  m_slotsPerAtlas = m_slotGrid.x*m_slotGrid.y*m_slotGrid.z;
+
+  m_atlasCount = ( m_capacity+m_slotsPerAtlas-1 )/m_slotsPerAtlas;
+  if (m_atlasCount>0) {
+    size_t const lastSlots{ m_capacity-( m_atlasCount-1 )*m_slotsPerAtlas };
+    m_lastGrid = shrinkGrid(m_slotGrid, lastSlots);
+  }
+  m_atlasUsed.assign(m_atlasCount, 0);
+
+  releaseAll();
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+uint32_t
+AtlasAllocator::acquire(uint64_t id)
+{
+  if (m_idSlots.contains(id)) {
+    return m_idSlots.get(id);
+  }
+
+  if (m_free.empty()) {
+    return NO_SLOT;
+  }
+
+  uint32_t const slot{ m_free.top() };
+  m_free.pop();
+
+  m_idSlots.insert(id, slot);
+  m_atlasUsed[atlasOf(slot)] += 1;
+
+  return slot;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+bool
+AtlasAllocator::release(uint64_t id)
+{
+  if (!m_idSlots.contains(id)) {
+    return false;
+  }
+
+  uint32_t const slot{ m_idSlots.get(id) };
+  m_idSlots.erase(id);
+  m_atlasUsed[atlasOf(slot)] -= 1;
+  m_free.push(slot);
+
+  return true;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+void
+AtlasAllocator::releaseAll()
+{
+  m_idSlots.clear();
+  std::fill(m_atlasUsed.begin(), m_atlasUsed.end(), 0);
+
+  std::vector<uint32_t> slots(m_capacity);
+  for (size_t i{ 0 }; i<m_capacity; ++i) {
+    slots[i] = static_cast<uint32_t>(i);
+  }
+  // ascending order is already a valid min-heap.
+  m_free = decltype(m_free)(std::greater<uint32_t>(), std::move(slots));
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+uint32_t
+AtlasAllocator::slotOf(uint64_t id) const
+{
+  return m_idSlots.contains(id) ? m_idSlots.get(id) : NO_SLOT;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+size_t
+AtlasAllocator::atlasCount() const
+{
+  return m_atlasCount;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+glm::u64vec3
+AtlasAllocator::atlasDims(size_t atlas) const
+{
+  assert(atlas<m_atlasCount && "Atlas index out of range.");
+  glm::u64vec3 const &grid{ atlas+1==m_atlasCount ? m_lastGrid : m_slotGrid };
+  return grid*m_slotDims;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+glm::u64vec3 const &
+AtlasAllocator::slotDims() const
+{
+  return m_slotDims;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+glm::u64vec3 const &
+AtlasAllocator::slotGrid() const
+{
+  return m_slotGrid;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+size_t
+AtlasAllocator::slotsPerAtlas() const
+{
+  return m_slotsPerAtlas;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+size_t
+AtlasAllocator::atlasOf(uint32_t slot) const
+{
+  assert(slot<m_capacity && "Slot out of range.");
+  return slot/m_slotsPerAtlas;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+glm::u64vec3
+AtlasAllocator::voxelOffset(uint32_t slot) const
+{
+  uint64_t const local{ slot%m_slotsPerAtlas };
+  glm::u64vec3 const cell{ local%m_slotGrid.x,
+                           ( local/m_slotGrid.x )%m_slotGrid.y,
+                           local/( m_slotGrid.x*m_slotGrid.y ) };
+  return cell*m_slotDims;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+glm::vec3
+AtlasAllocator::texOffset(uint32_t slot) const
+{
+  glm::vec3 const dims{ atlasDims(atlasOf(slot)) };
+  glm::vec3 const off{ voxelOffset(slot) };
+  return ( off+0.5f )/dims;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+glm::vec3
+AtlasAllocator::texScale(uint32_t slot) const
+{
+  glm::vec3 const dims{ atlasDims(atlasOf(slot)) };
+  glm::vec3 const slotDims{ m_slotDims };
+  return ( slotDims-1.0f )/dims;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+glm::vec3
+AtlasAllocator::texScale(uint32_t slot, glm::u64vec3 const &extent) const
+{
+  assert(extent.x<=m_slotDims.x && extent.y<=m_slotDims.y &&
+             extent.z<=m_slotDims.z &&
+             "Extent does not fit in an atlas slot.");
+  glm::vec3 const dims{ atlasDims(atlasOf(slot)) };
+  glm::vec3 const ext{ extent };
+  return ( ext-1.0f )/dims;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+size_t
+AtlasAllocator::capacity() const
+{
+  return m_capacity;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+size_t
+AtlasAllocator::used() const
+{
+  return m_idSlots.size();
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+size_t
+AtlasAllocator::available() const
+{
+  return m_free.size();
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+size_t
+AtlasAllocator::usedInAtlas(size_t atlas) const
+{
+  assert(atlas<m_atlasCount && "Atlas index out of range.");
+  return m_atlasUsed[atlas];
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+double
+AtlasAllocator::fragmentation() const
+{
+  size_t touchedSlots{ 0 };
+  for (size_t a{ 0 }; a<m_atlasCount; ++a) {
+    if (m_atlasUsed[a]>0) {
+      touchedSlots += a+1==m_atlasCount
+                      ? m_capacity-a*m_slotsPerAtlas
+                      : m_slotsPerAtlas;
+    }
+  }
+
+  if (touchedSlots==0) {
+    return 0.0;
+  }
+
+  return 1.0-static_cast<double>(used())/touchedSlots;
+}
+
+} // namespace bd
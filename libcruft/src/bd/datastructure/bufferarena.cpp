@@ -0,0 +1,382 @@
+#include <bd/datastructure/bufferarena.h>
+#include <bd/log/logger.h>
+
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define BD_ARENA_MMAP
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#if defined(__linux__)
+#include <sys/syscall.h>
+#endif
+
+namespace bd
+{
+
+namespace
+{
+
+/// Slices are whole huge pages (2 MiB on x86-64).
+uint64_t const HUGE_PAGE_BYTES{ 2*1024*1024 };
+
+/// Each committed slice can split the mapping, stay well below the kernel's
+/// limit on mappings per process (vm.max_map_count, 65530 by default).
+size_t const MAX_SLICES{ 4096 };
+
+/// Node masks passed to mbind() have this many bits.
+int const MAX_NODES{ 64 };
+
+/// mbind() mode: allocate on the given node while it has free memory.
+int const MPOL_PREFERRED_MODE{ 1 };
+
+
+/// \brief The NUMA node of the cpu the calling thread is on, 0 if unknown.
+int
+currentNode()
+{
+#if defined(__linux__) && defined(SYS_getcpu)
+  unsigned cpu{ 0 };
+  unsigned node{ 0 };
+  if (syscall(SYS_getcpu, &cpu, &node, nullptr)==0) {
+    return static_cast<int>(node);
+  }
+#endif
+  return 0;
+}
+
+
+/// \brief Ask for the pages of [addr, addr+bytes) to come from \c node.
+bool
+bindToNode(char *addr, uint64_t bytes, int node)
+{
+#if defined(__linux__) && defined(SYS_mbind)
+  if (node<0 || node>=MAX_NODES) {
+    return false;
+  }
+  unsigned long mask{ 1UL << node };
+  // maxnode counts one past the last bit the kernel reads.
+  return syscall(SYS_mbind, addr, bytes, MPOL_PREFERRED_MODE, &mask,
+                 MAX_NODES+1, 0)==0;
+#else
+  (void)addr;
+  (void)bytes;
+  (void)node;
+  return false;
+#endif
+}
+
+} // namespace
+
+
+///////////////////////////////////////////////////////////////////////////////
+HugePages
+to_hugePages(std::string const &s)
+{
+  if (s=="none") {
+    return HugePages::None;
+  } else if (s=="thp") {
+    return HugePages::Transparent;
+  } else if (s=="explicit") {
+    return HugePages::Explicit;
+  }
+  throw std::invalid_argument("Unknown huge pages mode: " + s);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+std::string
+to_string(HugePages h)
+{
+  switch (h) {
+    case HugePages::Transparent:
+      return "thp";
+    case HugePages::Explicit:
+      return "explicit";
+    case HugePages::None:
+    default:
+      return "none";
+  }
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+BufferArena::BufferArena(std::string const &name,
+                         size_t bufferBytes,
+                         size_t count,
+                         HugePages hugePages,
+                         bool bindNuma)
+    : m_name{ name }
+    , m_bufferBytes{ bufferBytes }
+    , m_count{ count }
+    , m_bindNuma{ bindNuma }
+    , m_hugePages{ HugePages::None }
+    , m_sliceBytes{ HUGE_PAGE_BYTES }
+    , m_sliceCount{ 0 }
+    , m_reservedBytes{ 0 }
+    , m_mapping{ nullptr }
+    , m_mappingBytes{ 0 }
+    , m_base{ nullptr }
+    , m_fallback{ nullptr }
+    , m_sliceCommitted{ nullptr }
+    , m_committedSlices{ 0 }
+    , m_commitMutex{ }
+    , m_nodeBytes{ }
+{
+  uint64_t const bytes{ static_cast<uint64_t>(bufferBytes)*count };
+  if (bytes==0) {
+    return;
+  }
+
+  // Fewer, larger slices for big arenas, always whole huge pages.
+  uint64_t const perSlice{ ( bytes+MAX_SLICES-1 )/MAX_SLICES };
+  m_sliceBytes = std::max(HUGE_PAGE_BYTES,
+                          ( perSlice+HUGE_PAGE_BYTES-1 )/HUGE_PAGE_BYTES*
+                              HUGE_PAGE_BYTES);
+  m_sliceCount = ( bytes+m_sliceBytes-1 )/m_sliceBytes;
+  m_reservedBytes = m_sliceCount*m_sliceBytes;
+
+  m_sliceCommitted.reset(new std::atomic<uint8_t>[m_sliceCount]);
+  for (size_t s{ 0 }; s<m_sliceCount; ++s) {
+    m_sliceCommitted[s].store(0);
+  }
+
+  if (hugePages==HugePages::Explicit && !reserve(HugePages::Explicit)) {
+    Warn() << m_name << ": the huge page pool can not hold "
+           << m_reservedBytes << " bytes, using transparent huge pages.";
+    hugePages = HugePages::Transparent;
+  }
+  if (m_base==nullptr && !reserve(hugePages)) {
+    Warn() << m_name << ": could not reserve " << m_reservedBytes
+           << " bytes of address space, allocating them now.";
+    m_fallback.reset(new char[m_reservedBytes]);
+    m_base = m_fallback.get();
+    m_hugePages = HugePages::None;
+  }
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+BufferArena::~BufferArena()
+{
+#ifdef BD_ARENA_MMAP
+  if (m_mapping!=nullptr) {
+    munmap(m_mapping, m_mappingBytes);
+  }
+#endif
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+bool
+BufferArena::reserve(HugePages hugePages)
+{
+#ifdef BD_ARENA_MMAP
+  int flags{ MAP_PRIVATE | MAP_ANONYMOUS };
+
+  // Huge page mappings come aligned, others are over-reserved so the
+  // slices can start on a huge page.
+  uint64_t bytes{ m_reservedBytes+HUGE_PAGE_BYTES };
+  if (hugePages==HugePages::Explicit) {
+#ifdef MAP_HUGETLB
+    // The pool's pages are reserved by the mmap (no MAP_NORESERVE), so a
+    // pool too small fails here instead of with SIGBUS on a later write.
+    flags |= MAP_HUGETLB;
+    bytes = m_reservedBytes;
+#else
+    return false;
+#endif
+  } else {
+#ifdef MAP_NORESERVE
+    flags |= MAP_NORESERVE;
+#endif
+  }
+
+  void *p{ mmap(nullptr, bytes, PROT_NONE, flags, -1, 0) };
+  if (p==MAP_FAILED) {
+    return false;
+  }
+
+  m_mapping = static_cast<char *>(p);
+  m_mappingBytes = bytes;
+  uintptr_t const misalign{ reinterpret_cast<uintptr_t>(p)%HUGE_PAGE_BYTES };
+  m_base = m_mapping+( misalign==0 ? 0 : HUGE_PAGE_BYTES-misalign );
+  m_hugePages = hugePages;
+
+  if (hugePages==HugePages::Transparent) {
+#ifdef MADV_HUGEPAGE
+    if (madvise(m_base, m_reservedBytes, MADV_HUGEPAGE)!=0) {
+      Warn() << m_name << ": transparent huge pages are not available.";
+      m_hugePages = HugePages::None;
+    }
+#else
+    m_hugePages = HugePages::None;
+#endif
+  }
+  return true;
+#else
+  (void)hugePages;
+  return false;
+#endif
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+size_t
+BufferArena::count() const
+{
+  return m_count;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+size_t
+BufferArena::bufferBytes() const
+{
+  return m_bufferBytes;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+char *
+BufferArena::buffer(size_t i) const
+{
+  assert(i<m_count && "Buffer index out of range.");
+  return m_base+static_cast<uint64_t>(i)*m_bufferBytes;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+void
+BufferArena::commit(size_t i)
+{
+  assert(i<m_count && "Buffer index out of range.");
+  uint64_t const start{ static_cast<uint64_t>(i)*m_bufferBytes };
+  size_t const first{ start/m_sliceBytes };
+  size_t const last{ ( start+m_bufferBytes-1 )/m_sliceBytes };
+  for (size_t s{ first }; s<=last; ++s) {
+    if (m_sliceCommitted[s].load(std::memory_order_acquire)==0) {
+      commitSlice(s);
+    }
+  }
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+void
+BufferArena::commit(char const *buffer)
+{
+  assert(buffer>=m_base && "Buffer is not in this arena.");
+  commit(static_cast<size_t>(( buffer-m_base )/m_bufferBytes));
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+void
+BufferArena::commitSlice(size_t s)
+{
+  std::unique_lock<std::mutex> lock(m_commitMutex);
+  if (m_sliceCommitted[s].load(std::memory_order_relaxed)!=0) {
+    return;
+  }
+
+  char *const slice{ m_base+s*m_sliceBytes };
+  int node{ -1 };
+#ifdef BD_ARENA_MMAP
+  if (m_mapping!=nullptr) {
+    if (mprotect(slice, m_sliceBytes, PROT_READ | PROT_WRITE)!=0) {
+      throw std::runtime_error(m_name+": could not commit a buffer slice.");
+    }
+    // Bound before the first write, which is when the pages are placed.
+    if (m_bindNuma) {
+      node = currentNode();
+      if (!bindToNode(slice, m_sliceBytes, node)) {
+        Warn() << m_name << ": could not bind a slice to NUMA node " << node
+               << ", not binding the rest.";
+        m_bindNuma = false;
+        node = -1;
+      }
+    }
+  }
+#endif
+
+  if (node>=0) {
+    if (m_nodeBytes.size()<=static_cast<size_t>(node)) {
+      m_nodeBytes.resize(node+1, 0);
+    }
+    m_nodeBytes[node] += m_sliceBytes;
+  }
+  m_sliceCommitted[s].store(1, std::memory_order_release);
+  ++m_committedSlices;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+bool
+BufferArena::committed(size_t i) const
+{
+  assert(i<m_count && "Buffer index out of range.");
+  uint64_t const start{ static_cast<uint64_t>(i)*m_bufferBytes };
+  size_t const first{ start/m_sliceBytes };
+  size_t const last{ ( start+m_bufferBytes-1 )/m_sliceBytes };
+  for (size_t s{ first }; s<=last; ++s) {
+    if (m_sliceCommitted[s].load(std::memory_order_acquire)==0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+uint64_t
+BufferArena::committedBytes() const
+{
+  return m_committedSlices.load()*m_sliceBytes;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+BufferArena::Usage
+BufferArena::usage() const
+{
+  Usage u;
+  u.name = m_name;
+  u.buffers = m_count;
+  u.bufferBytes = m_bufferBytes;
+  u.reservedBytes = m_reservedBytes;
+  u.committedSlices = m_committedSlices.load();
+  u.committedBytes = committedBytes();
+  u.slices = m_sliceCount;
+  u.sliceBytes = m_sliceBytes;
+  u.hugePages = m_hugePages;
+  {
+    std::unique_lock<std::mutex> lock(m_commitMutex);
+    u.nodeBytes = m_nodeBytes;
+  }
+  return u;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+std::ostream &
+operator<<(std::ostream &os, BufferArena::Usage const &u)
+{
+  os << u.name << ": " << u.buffers << " buffers of " << u.bufferBytes
+     << " bytes, " << u.committedBytes << " of " << u.reservedBytes
+     << " bytes committed (" << u.committedSlices << "/" << u.slices
+     << " slices of " << u.sliceBytes << "), huge pages: "
+     << to_string(u.hugePages);
+  for (size_t n{ 0 }; n<u.nodeBytes.size(); ++n) {
+    if (u.nodeBytes[n]>0) {
+      os << ", node " << n << ": " << u.nodeBytes[n];
+    }
+  }
+  return os;
+}
+
+} // namespace bd
@@ -0,0 +1,227 @@
+#include <bd/datastructure/occlusiongrid.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cmath>
+#include <memory>
+#include <thread>
+
+namespace bd
+{
+
+namespace
+{
+
+/// \brief The cell of the eye along an axis of \c n cells, clamped to
+/// [-1, n] (see VisibilityOrder::eyeCell()).
+int64_t
+eyeCellAlong(float eye, float lo, float cell, uint64_t n)
+{
+  float const f{ std::floor(( eye-lo )/cell) };
+  if (f<0.0f) {
+    return -1;
+  }
+  if (f>=static_cast<float>(n)) {
+    return static_cast<int64_t>(n);
+  }
+  return static_cast<int64_t>(f);
+}
+
+
+/// \brief 0 to n-1 nearest to \c e first, so each index comes after its
+/// neighbour towards \c e.
+std::vector<int64_t>
+outwardOrder(int64_t e, int64_t n)
+{
+  std::vector<int64_t> order;
+  order.reserve(n);
+  if (e>=0 && e<n) {
+    order.push_back(e);
+  }
+  for (int64_t d{ 1 }; static_cast<int64_t>(order.size())<n; ++d) {
+    if (e-d>=0 && e-d<n) {
+      order.push_back(e-d);
+    }
+    if (e+d>=0 && e+d<n) {
+      order.push_back(e+d);
+    }
+  }
+  return order;
+}
+
+} // namespace
+
+
+///////////////////////////////////////////////////////////////////////////////
+OcclusionGrid::OcclusionGrid()
+    : m_dims{ 0, 0, 0 }
+    , m_lo{ 0.0f, 0.0f, 0.0f }
+    , m_cell{ 1.0f, 1.0f, 1.0f }
+{
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+OcclusionGrid::OcclusionGrid(glm::u64vec3 const &dims, glm::vec3 const &lo,
+                             glm::vec3 const &cell)
+    : m_dims{ dims }
+    , m_lo{ lo }
+    , m_cell{ cell }
+{
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+bool
+OcclusionGrid::valid() const
+{
+  return m_dims.x>0 && m_dims.y>0 && m_dims.z>0;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+glm::u64vec3 const &
+OcclusionGrid::dims() const
+{
+  return m_dims;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+size_t
+OcclusionGrid::size() const
+{
+  return m_dims.x*m_dims.y*m_dims.z;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+void
+OcclusionGrid::transmittance(std::vector<float> const &opacity,
+                             glm::vec3 const &eye,
+                             std::vector<float> &transmittance,
+                             unsigned threads) const
+{
+  assert(opacity.size()==size() && "One opacity per cell.");
+  transmittance.resize(size());
+  if (size()==0) {
+    return;
+  }
+
+  int64_t const nx{ static_cast<int64_t>(m_dims.x) };
+  int64_t const ny{ static_cast<int64_t>(m_dims.y) };
+  int64_t const nz{ static_cast<int64_t>(m_dims.z) };
+  int64_t const ex{ eyeCellAlong(eye.x, m_lo.x, m_cell.x, m_dims.x) };
+  int64_t const ey{ eyeCellAlong(eye.y, m_lo.y, m_cell.y, m_dims.y) };
+  int64_t const ez{ eyeCellAlong(eye.z, m_lo.z, m_cell.z, m_dims.z) };
+
+  // Visiting y and z nearest the eye first, every cell comes after its
+  // neighbours towards the eye along them. Rows are swept from the eye's
+  // column out both ways, see below.
+  std::vector<int64_t> const ys{ outwardOrder(ey, ny) };
+  std::vector<int64_t> const zs{ outwardOrder(ez, nz) };
+
+  // How far the eye is from each layer of cell centers along an axis, 0 for
+  // the eye's own layer (the ray to the eye crosses no cell along the axis).
+  auto distances = [](float eye, float lo, float cell, int64_t n, int64_t e) {
+    std::vector<float> d(n);
+    for (int64_t i{ 0 }; i<n; ++i) {
+      d[i] = i==e ? 0.0f : std::abs(eye-( lo+( i+0.5f )*cell ));
+    }
+    return d;
+  };
+  std::vector<float> const dxs{ distances(eye.x, m_lo.x, m_cell.x, nx, ex) };
+  std::vector<float> const dys{ distances(eye.y, m_lo.y, m_cell.y, ny, ey) };
+  std::vector<float> const dzs{ distances(eye.z, m_lo.z, m_cell.z, nz, ez) };
+
+  // transmittance out of the far side of each cell.
+  std::vector<float> out(size());
+  float *const tin{ transmittance.data() };
+  float *const tout{ out.data() };
+  float const *const alpha{ opacity.data() };
+
+  size_t const bands{ std::max<size_t>(1, std::min<size_t>(threads, ny)) };
+  size_t const bandRows{ ( ys.size()+bands-1 )/bands };
+
+  // layers of z each band has finished.
+  std::unique_ptr<std::atomic<size_t>[]> done{
+      new std::atomic<size_t>[bands] };
+  for (size_t b{ 0 }; b<bands; ++b) {
+    done[b].store(0);
+  }
+
+  auto band = [&](size_t b) {
+    size_t const yBegin{ std::min(b*bandRows, ys.size()) };
+    size_t const yEnd{ std::min(yBegin+bandRows, ys.size()) };
+
+    for (size_t kz{ 0 }; kz<zs.size(); ++kz) {
+      // rows of this layer nearer the eye belong to the band before.
+      if (b>0) {
+        while (done[b-1].load(std::memory_order_acquire)<=kz) {
+          std::this_thread::yield();
+        }
+      }
+
+      int64_t const z{ zs[kz] };
+      int64_t const sz{ z<ez ? 1 : ( z>ez ? -1 : 0 ) };
+      bool const hasZ{ sz!=0 && z+sz>=0 && z+sz<nz };
+      float const dz{ dzs[z] };
+
+      for (size_t ky{ yBegin }; ky<yEnd; ++ky) {
+        int64_t const y{ ys[ky] };
+        int64_t const sy{ y<ey ? 1 : ( y>ey ? -1 : 0 ) };
+        bool const hasY{ sy!=0 && y+sy>=0 && y+sy<ny };
+        float const dy{ dys[y] };
+        ptrdiff_t const row{ nx*( y+ny*z ) };
+
+        // the rows next to this one towards the eye, nullptr if that is
+        // outside of the grid (clear).
+        float const *yRow{ hasY ? tout+row+sy*nx : nullptr };
+        float const *zRow{ hasZ ? tout+row+sz*nx*ny : nullptr };
+
+        auto visit = [&](int64_t x, float tx) {
+          float const ty{ yRow ? yRow[x] : 1.0f };
+          float const tz{ zRow ? zRow[x] : 1.0f };
+          float const sum{ dxs[x]+dy+dz };
+          float t{ 1.0f };
+          if (sum>0.0f) {
+            float const inv{ 1.0f/sum };
+            t = dxs[x]*inv*tx+( dy*ty+dz*tz )*inv;
+          }
+          tin[row+x] = t;
+          tout[row+x] = t*( 1.0f-alpha[row+x] );
+          return tout[row+x];
+        };
+
+        // Out from the eye's column both ways, so the x neighbour towards
+        // the eye is always the cell just visited.
+        float near{ 1.0f };
+        if (ex>=0 && ex<nx) {
+          near = visit(ex, 1.0f);
+        }
+        float prev{ near };
+        for (int64_t x{ std::min(ex, nx)-1 }; x>=0; --x) {
+          prev = visit(x, prev);
+        }
+        prev = near;
+        for (int64_t x{ std::max<int64_t>(ex, -1)+1 }; x<nx; ++x) {
+          prev = visit(x, prev);
+        }
+      }
+
+      done[b].store(kz+1, std::memory_order_release);
+    }
+  };
+
+  std::vector<std::thread> workers;
+  for (size_t b{ 1 }; b<bands; ++b) {
+    workers.emplace_back(band, b);
+  }
+  band(0);
+  for (std::thread &w : workers) {
+    w.join();
+  }
+}
+
+} // namespace bd
@@ -0,0 +1,151 @@
+#include <bd/datastructure/octree.h>
+
+#include <cassert>
+#include <limits>
+
+namespace bd
+{
+
+///////////////////////////////////////////////////////////////////////////////
+Octree::Octree()
+    : m_dims{ }
+    , m_offsets{ }
+    , m_leafCount{ 0 }
+    , m_nodes{ }
+{
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+void
+Octree::build(glm::u64vec3 const &dims, std::vector<Leaf> const &leaves)
+{
+  assert(leaves.size()==dims.x*dims.y*dims.z &&
+             "One leaf per block is needed to build the octree.");
+
+  m_dims.clear();
+  m_offsets.clear();
+  m_nodes.clear();
+  m_leafCount = leaves.size();
+  if (leaves.empty()) {
+    return;
+  }
+
+  // level sizes, halving (rounding up) down to the 1x1x1 root.
+  glm::u64vec3 d{ dims };
+  while (true) {
+    m_dims.push_back(d);
+    if (d==glm::u64vec3{ 1, 1, 1 }) {
+      break;
+    }
+    d = ( d+uint64_t(1) )/uint64_t(2);
+  }
+
+  // every level but the root holds one brick of 8 per node of the next.
+  size_t total{ 0 };
+  for (size_t level{ 0 }; level<m_dims.size(); ++level) {
+    m_offsets.push_back(total);
+    if (level+1<m_dims.size()) {
+      glm::u64vec3 const &pd{ m_dims[level+1] };
+      total += 8*pd.x*pd.y*pd.z;
+    } else {
+      total += 1;
+    }
+  }
+
+  Node const padding{ std::numeric_limits<float>::max(),
+                      std::numeric_limits<float>::lowest(),
+                      0,
+                      std::numeric_limits<float>::max(),
+                      std::numeric_limits<float>::lowest(),
+                      0 };
+  m_nodes.assign(total, padding);
+
+  size_t idx{ 0 };
+  for (uint64_t k{ 0 }; k<dims.z; ++k) {
+    for (uint64_t j{ 0 }; j<dims.y; ++j) {
+      for (uint64_t i{ 0 }; i<dims.x; ++i) {
+        Leaf const &l{ leaves[idx++] };
+        m_nodes[index(0, { i, j, k })] = { l.min, l.max, l.avg, l.rov, l.rov, 1 };
+      }
+    }
+  }
+
+  for (size_t level{ 1 }; level<m_dims.size(); ++level) {
+    glm::u64vec3 const &ld{ m_dims[level] };
+    glm::u64vec3 const &cd{ m_dims[level-1] };
+    for (uint64_t k{ 0 }; k<ld.z; ++k) {
+      for (uint64_t j{ 0 }; j<ld.y; ++j) {
+        for (uint64_t i{ 0 }; i<ld.x; ++i) {
+
+          Node n{ padding };
+          double sum{ 0 };
+
+          glm::u64vec3 const first{ 2*i, 2*j, 2*k };
+          glm::u64vec3 const last{ glm::min(first+uint64_t(2), cd) };
+          for (uint64_t z{ first.z }; z<last.z; ++z) {
+            for (uint64_t y{ first.y }; y<last.y; ++y) {
+              for (uint64_t x{ first.x }; x<last.x; ++x) {
+                Node const &c{ m_nodes[index(level-1, { x, y, z })] };
+                n.min = std::min(n.min, c.min);
+                n.max = std::max(n.max, c.max);
+                n.minRov = std::min(n.minRov, c.minRov);
+                n.maxRov = std::max(n.maxRov, c.maxRov);
+                sum += static_cast<double>(c.avg)*c.count;
+                n.count += c.count;
+              }
+            }
+          }
+
+          n.avg = static_cast<float>(sum/n.count);
+          m_nodes[index(level, { i, j, k })] = n;
+        }
+      }
+    }
+  }
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+size_t
+Octree::levels() const
+{
+  return m_dims.size();
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+glm::u64vec3
+Octree::levelDims(size_t level) const
+{
+  assert(level<m_dims.size() && "Octree level out of range.");
+  return m_dims[level];
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+Octree::Node const &
+Octree::node(size_t level, glm::u64vec3 const &ijk) const
+{
+  assert(level<m_dims.size() && "Octree level out of range.");
+  return m_nodes[index(level, ijk)];
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+Octree::Node const &
+Octree::root() const
+{
+  assert(!m_nodes.empty() && "Octree is empty.");
+  return m_nodes.back();
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+size_t
+Octree::leafCount() const
+{
+  return m_leafCount;
+}
+
+} // namespace bd
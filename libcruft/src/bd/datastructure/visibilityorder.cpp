@@ -0,0 +1,62 @@
+#include <bd/datastructure/visibilityorder.h>
+
+#include <cmath>
+
+namespace bd
+{
+
+///////////////////////////////////////////////////////////////////////////////
+VisibilityOrder::VisibilityOrder()
+    : m_dims{ 0, 0, 0 }
+    , m_lo{ 0.0f, 0.0f, 0.0f }
+    , m_cell{ 1.0f, 1.0f, 1.0f }
+{
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+VisibilityOrder::VisibilityOrder(glm::u64vec3 const &dims, glm::vec3 const &lo,
+                                 glm::vec3 const &cell)
+    : m_dims{ dims }
+    , m_lo{ lo }
+    , m_cell{ cell }
+{
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+bool
+VisibilityOrder::valid() const
+{
+  return m_dims.x>0 && m_dims.y>0 && m_dims.z>0;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+glm::u64vec3 const &
+VisibilityOrder::dims() const
+{
+  return m_dims;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+glm::i64vec3
+VisibilityOrder::eyeCell(glm::vec3 const &eye) const
+{
+  glm::i64vec3 c{ 0, 0, 0 };
+  for (int a{ 0 }; a<3; ++a) {
+    float const f{ std::floor(( eye[a]-m_lo[a] )/m_cell[a]) };
+    int64_t const n{ static_cast<int64_t>(m_dims[a]) };
+    if (f<0.0f) {
+      c[a] = -1;
+    } else if (f>=static_cast<float>(n)) {
+      c[a] = n;
+    } else {
+      c[a] = static_cast<int64_t>(f);
+    }
+  }
+  return c;
+}
+
+} // namespace bd
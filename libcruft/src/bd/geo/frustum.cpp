@@ -0,0 +1,197 @@
+#include <bd/geo/frustum.h>
+
+#include <cassert>
+#include <cmath>
+
+#if defined(__SSE__)
+#include <xmmintrin.h>
+#endif
+
+namespace bd
+{
+
+///////////////////////////////////////////////////////////////////////////////
+Frustum::Frustum()
+{
+  for (glm::vec4 &p : m_planes) {
+    p = glm::vec4{ 0.0f, 0.0f, 0.0f, 1.0f };
+  }
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+Frustum::Frustum(glm::mat4 const &m)
+{
+  // Gribb/Hartmann: each plane is the last row of the matrix plus or minus
+  // one of the others (glm matrices are indexed [column][row]).
+  glm::vec4 row[4];
+  for (int r{ 0 }; r<4; ++r) {
+    row[r] = glm::vec4{ m[0][r], m[1][r], m[2][r], m[3][r] };
+  }
+
+  m_planes[0] = row[3]+row[0];  // left
+  m_planes[1] = row[3]-row[0];  // right
+  m_planes[2] = row[3]+row[1];  // bottom
+  m_planes[3] = row[3]-row[1];  // top
+  m_planes[4] = row[3]+row[2];  // near
+  m_planes[5] = row[3]-row[2];  // far
+
+  for (glm::vec4 &p : m_planes) {
+    float const len{ std::sqrt(p.x*p.x+p.y*p.y+p.z*p.z) };
+    if (len>0.0f) {
+      p = p/len;
+    }
+  }
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+glm::vec4 const &
+Frustum::plane(size_t i) const
+{
+  assert(i<6 && "A frustum has six planes.");
+  return m_planes[i];
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+bool
+Frustum::intersects(glm::vec3 const &min, glm::vec3 const &max) const
+{
+  // The box is outside if its corner farthest along a plane's normal is
+  // behind that plane.
+  for (glm::vec4 const &p : m_planes) {
+    float const d{ p.x*( p.x>=0.0f ? max.x : min.x )+
+                   p.y*( p.y>=0.0f ? max.y : min.y )+
+                   p.z*( p.z>=0.0f ? max.z : min.z )+p.w };
+    if (d<0.0f) {
+      return false;
+    }
+  }
+  return true;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+bool
+Frustum::contains(glm::vec3 const &min, glm::vec3 const &max) const
+{
+  // The box is inside if its corner nearest along each plane's normal is in
+  // front of that plane.
+  for (glm::vec4 const &p : m_planes) {
+    float const d{ p.x*( p.x>=0.0f ? min.x : max.x )+
+                   p.y*( p.y>=0.0f ? min.y : max.y )+
+                   p.z*( p.z>=0.0f ? min.z : max.z )+p.w };
+    if (d<0.0f) {
+      return false;
+    }
+  }
+  return true;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+AabbBatch::AabbBatch()
+    : m_min{ }
+    , m_max{ }
+    , m_size{ 0 }
+{
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+void
+AabbBatch::clear()
+{
+  for (int a{ 0 }; a<3; ++a) {
+    m_min[a].clear();
+    m_max[a].clear();
+  }
+  m_size = 0;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+void
+AabbBatch::reserve(size_t n)
+{
+  for (int a{ 0 }; a<3; ++a) {
+    m_min[a].reserve(n+3);
+    m_max[a].reserve(n+3);
+  }
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+void
+AabbBatch::push_back(glm::vec3 const &min, glm::vec3 const &max)
+{
+  // grow four boxes at a time, the padding is never reported.
+  if (m_size%4==0) {
+    for (int a{ 0 }; a<3; ++a) {
+      m_min[a].resize(m_size+4, 0.0f);
+      m_max[a].resize(m_size+4, 0.0f);
+    }
+  }
+  for (int a{ 0 }; a<3; ++a) {
+    m_min[a][m_size] = min[a];
+    m_max[a][m_size] = max[a];
+  }
+  ++m_size;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+size_t
+AabbBatch::size() const
+{
+  return m_size;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+void
+AabbBatch::cull(Frustum const &f, std::vector<uint8_t> &inside) const
+{
+  inside.resize(m_size);
+
+  // Per plane, the corner to test is chosen by the signs of the normal,
+  // which are the same for every box.
+  float const *corner[6][3];
+  for (int p{ 0 }; p<6; ++p) {
+    for (int a{ 0 }; a<3; ++a) {
+      corner[p][a] = f.plane(p)[a]>=0.0f ? m_max[a].data() : m_min[a].data();
+    }
+  }
+
+  size_t i{ 0 };
+#if defined(__SSE__)
+  __m128 const zero{ _mm_setzero_ps() };
+  for (; i+4<=m_min[0].size(); i += 4) {
+    __m128 in{ _mm_cmpeq_ps(zero, zero) };
+    for (int p{ 0 }; p<6; ++p) {
+      glm::vec4 const &pl{ f.plane(p) };
+      __m128 d{ _mm_set1_ps(pl.w) };
+      d = _mm_add_ps(d, _mm_mul_ps(_mm_set1_ps(pl.x), _mm_loadu_ps(corner[p][0]+i)));
+      d = _mm_add_ps(d, _mm_mul_ps(_mm_set1_ps(pl.y), _mm_loadu_ps(corner[p][1]+i)));
+      d = _mm_add_ps(d, _mm_mul_ps(_mm_set1_ps(pl.z), _mm_loadu_ps(corner[p][2]+i)));
+      in = _mm_and_ps(in, _mm_cmpge_ps(d, zero));
+    }
+    int const bits{ _mm_movemask_ps(in) };
+    for (size_t k{ 0 }; k<4 && i+k<m_size; ++k) {
+      inside[i+k] = static_cast<uint8_t>(( bits >> k ) & 1);
+    }
+  }
+#endif
+  for (; i<m_size; ++i) {
+    bool in{ true };
+    for (int p{ 0 }; p<6 && in; ++p) {
+      glm::vec4 const &pl{ f.plane(p) };
+      in = pl.x*corner[p][0][i]+pl.y*corner[p][1][i]+pl.z*corner[p][2][i]+
+           pl.w>=0.0f;
+    }
+    inside[i] = static_cast<uint8_t>(in);
+  }
+}
+
+} // namespace bd
@@ -0,0 +1,112 @@
+#include <bd/geo/mvpbatch.h>
+
+#if defined(__SSE__)
+#include <xmmintrin.h>
+#endif
+
+namespace bd
+{
+
+///////////////////////////////////////////////////////////////////////////////
+MvpBatch::MvpBatch()
+    : m_origin{ }
+    , m_scale{ }
+    , m_mvp{ }
+{
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+void
+MvpBatch::clear()
+{
+  for (int a{ 0 }; a<3; ++a) {
+    m_origin[a].clear();
+    m_scale[a].clear();
+  }
+  m_mvp.clear();
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+void
+MvpBatch::reserve(size_t n)
+{
+  for (int a{ 0 }; a<3; ++a) {
+    m_origin[a].reserve(n);
+    m_scale[a].reserve(n);
+  }
+  m_mvp.reserve(n);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+void
+MvpBatch::push_back(glm::vec3 const &origin, glm::vec3 const &scale)
+{
+  for (int a{ 0 }; a<3; ++a) {
+    m_origin[a].push_back(origin[a]);
+    m_scale[a].push_back(scale[a]);
+  }
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+size_t
+MvpBatch::size() const
+{
+  return m_origin[0].size();
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+void
+MvpBatch::compute(glm::mat4 const &vp)
+{
+  size_t const n{ size() };
+  m_mvp.resize(n);
+
+  // With world = T * S, column a < 3 of vp * world is column a of vp times
+  // scale[a], and the last column is vp times (origin, 1).
+  float const *ox{ m_origin[0].data() };
+  float const *oy{ m_origin[1].data() };
+  float const *oz{ m_origin[2].data() };
+  float const *sx{ m_scale[0].data() };
+  float const *sy{ m_scale[1].data() };
+  float const *sz{ m_scale[2].data() };
+
+#if defined(__SSE__)
+  __m128 const c0{ _mm_loadu_ps(&vp[0][0]) };
+  __m128 const c1{ _mm_loadu_ps(&vp[1][0]) };
+  __m128 const c2{ _mm_loadu_ps(&vp[2][0]) };
+  __m128 const c3{ _mm_loadu_ps(&vp[3][0]) };
+  for (size_t i{ 0 }; i<n; ++i) {
+    float *out{ &m_mvp[i][0][0] };
+    _mm_storeu_ps(out, _mm_mul_ps(c0, _mm_set1_ps(sx[i])));
+    _mm_storeu_ps(out+4, _mm_mul_ps(c1, _mm_set1_ps(sy[i])));
+    _mm_storeu_ps(out+8, _mm_mul_ps(c2, _mm_set1_ps(sz[i])));
+    __m128 t{ _mm_add_ps(c3, _mm_mul_ps(c0, _mm_set1_ps(ox[i]))) };
+    t = _mm_add_ps(t, _mm_mul_ps(c1, _mm_set1_ps(oy[i])));
+    t = _mm_add_ps(t, _mm_mul_ps(c2, _mm_set1_ps(oz[i])));
+    _mm_storeu_ps(out+12, t);
+  }
+#else
+  for (size_t i{ 0 }; i<n; ++i) {
+    glm::mat4 &m{ m_mvp[i] };
+    m[0] = vp[0]*sx[i];
+    m[1] = vp[1]*sy[i];
+    m[2] = vp[2]*sz[i];
+    m[3] = vp[3]+vp[0]*ox[i]+vp[1]*oy[i]+vp[2]*oz[i];
+  }
+#endif
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+std::vector<glm::mat4> const &
+MvpBatch::matrices() const
+{
+  return m_mvp;
+}
+
+} // namespace bd
@@ -0,0 +1,306 @@
+#include <bd/graphics/framebuffer.h>
+#include <bd/log/logger.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+
+namespace bd
+{
+
+namespace
+{
+
+/// Largest stored deflate block.
+size_t const MAX_STORED_BLOCK{ 65535 };
+
+
+uint8_t
+toByte(float c)
+{
+  return static_cast<uint8_t>(std::lround(glm::clamp(c, 0.0f, 1.0f)*255.0f));
+}
+
+
+/// \brief CRC-32 (ISO 3309, as PNG chunks use) of \c n bytes, continuing
+/// from \c crc.
+uint32_t
+crc32(uint32_t crc, uint8_t const *p, size_t n)
+{
+  static std::vector<uint32_t> const table{ []() {
+    std::vector<uint32_t> t(256);
+    for (uint32_t i{ 0 }; i<256; ++i) {
+      uint32_t c{ i };
+      for (int k{ 0 }; k<8; ++k) {
+        c = ( c & 1 ) ? 0xEDB88320u ^ ( c >> 1 ) : c >> 1;
+      }
+      t[i] = c;
+    }
+    return t;
+  }() };
+
+  crc = ~crc;
+  for (size_t i{ 0 }; i<n; ++i) {
+    crc = table[( crc ^ p[i] ) & 0xFF] ^ ( crc >> 8 );
+  }
+  return ~crc;
+}
+
+
+/// \brief Adler-32 of \c n bytes, continuing from \c adler (start with 1).
+uint32_t
+adler32(uint32_t adler, uint8_t const *p, size_t n)
+{
+  uint32_t a{ adler & 0xFFFF };
+  uint32_t b{ adler >> 16 };
+  for (size_t i{ 0 }; i<n; ++i) {
+    a = ( a+p[i] )%65521;
+    b = ( b+a )%65521;
+  }
+  return ( b << 16 ) | a;
+}
+
+
+void
+putBigEndian(std::vector<uint8_t> &out, uint32_t v)
+{
+  out.push_back(static_cast<uint8_t>(v >> 24));
+  out.push_back(static_cast<uint8_t>(v >> 16));
+  out.push_back(static_cast<uint8_t>(v >> 8));
+  out.push_back(static_cast<uint8_t>(v));
+}
+
+
+/// \brief Append a PNG chunk: length, type, data and crc.
+void
+putChunk(std::vector<uint8_t> &out, char const *type,
+         std::vector<uint8_t> const &data)
+{
+  putBigEndian(out, static_cast<uint32_t>(data.size()));
+  size_t const start{ out.size() };
+  out.insert(out.end(), type, type+4);
+  out.insert(out.end(), data.begin(), data.end());
+  putBigEndian(out, crc32(0, out.data()+start, out.size()-start));
+}
+
+} // namespace
+
+
+///////////////////////////////////////////////////////////////////////////////
+Framebuffer::Framebuffer()
+    : Framebuffer{ 0, 0 }
+{
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+Framebuffer::Framebuffer(unsigned int w, unsigned int h)
+    : m_width{ w }
+    , m_height{ h }
+    , m_pixels(static_cast<size_t>(w)*h)
+{
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+void
+Framebuffer::resize(unsigned int w, unsigned int h)
+{
+  m_width = w;
+  m_height = h;
+  m_pixels.resize(static_cast<size_t>(w)*h);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+unsigned int
+Framebuffer::width() const
+{
+  return m_width;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+unsigned int
+Framebuffer::height() const
+{
+  return m_height;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+void
+Framebuffer::clear(glm::vec4 const &c)
+{
+  std::fill(m_pixels.begin(), m_pixels.end(), c);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+glm::vec4 &
+Framebuffer::pixel(unsigned int x, unsigned int y)
+{
+  assert(x<m_width && y<m_height && "Pixel out of range.");
+  return m_pixels[static_cast<size_t>(y)*m_width+x];
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+glm::vec4 const &
+Framebuffer::pixel(unsigned int x, unsigned int y) const
+{
+  assert(x<m_width && y<m_height && "Pixel out of range.");
+  return m_pixels[static_cast<size_t>(y)*m_width+x];
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+std::vector<glm::vec4> const &
+Framebuffer::pixels() const
+{
+  return m_pixels;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+std::vector<uint8_t>
+Framebuffer::rgb8() const
+{
+  std::vector<uint8_t> out;
+  out.reserve(m_pixels.size()*3);
+  for (unsigned int row{ 0 }; row<m_height; ++row) {
+    unsigned int const y{ m_height-1-row };
+    for (unsigned int x{ 0 }; x<m_width; ++x) {
+      glm::vec4 const &p{ pixel(x, y) };
+      out.push_back(toByte(p.r));
+      out.push_back(toByte(p.g));
+      out.push_back(toByte(p.b));
+    }
+  }
+  return out;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+int
+Framebuffer::maxDifference(Framebuffer const &other) const
+{
+  if (other.m_width!=m_width || other.m_height!=m_height) {
+    return 255;
+  }
+
+  std::vector<uint8_t> const a{ rgb8() };
+  std::vector<uint8_t> const b{ other.rgb8() };
+  int diff{ 0 };
+  for (size_t i{ 0 }; i<a.size(); ++i) {
+    diff = std::max(diff, std::abs(int{ a[i] }-int{ b[i] }));
+  }
+  return diff;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+bool
+Framebuffer::writePpm(std::string const &path) const
+{
+  std::ofstream f{ path, std::ios::binary };
+  if (!f.is_open()) {
+    Err() << "Could not open " << path << " for writing.";
+    return false;
+  }
+
+  std::vector<uint8_t> const rgb{ rgb8() };
+  f << "P6\n" << m_width << " " << m_height << "\n255\n";
+  f.write(reinterpret_cast<char const *>(rgb.data()), rgb.size());
+  return f.good();
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+bool
+Framebuffer::readPpm(std::string const &path)
+{
+  std::ifstream f{ path, std::ios::binary };
+  std::string magic;
+  unsigned int w{ 0 };
+  unsigned int h{ 0 };
+  int maxVal{ 0 };
+  if (!( f >> magic >> w >> h >> maxVal ) || magic!="P6" || maxVal!=255) {
+    Err() << path << " is not a binary PPM with 8 bit channels.";
+    return false;
+  }
+  f.get();  // the one whitespace character after the header.
+
+  std::vector<uint8_t> rgb(static_cast<size_t>(w)*h*3);
+  f.read(reinterpret_cast<char *>(rgb.data()), rgb.size());
+  if (!f) {
+    Err() << path << " is shorter than its header says.";
+    return false;
+  }
+
+  resize(w, h);
+  size_t i{ 0 };
+  for (unsigned int row{ 0 }; row<h; ++row) {
+    for (unsigned int x{ 0 }; x<w; ++x, i += 3) {
+      pixel(x, h-1-row) = { rgb[i]/255.0f, rgb[i+1]/255.0f, rgb[i+2]/255.0f,
+                            1.0f };
+    }
+  }
+  return true;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+bool
+Framebuffer::writePng(std::string const &path) const
+{
+  std::ofstream f{ path, std::ios::binary };
+  if (!f.is_open()) {
+    Err() << "Could not open " << path << " for writing.";
+    return false;
+  }
+
+  // Each scanline is its filter type (0, none) then its pixels.
+  std::vector<uint8_t> const rgb{ rgb8() };
+  size_t const rowBytes{ static_cast<size_t>(m_width)*3 };
+  std::vector<uint8_t> raw;
+  raw.reserve(( rowBytes+1 )*m_height);
+  for (unsigned int row{ 0 }; row<m_height; ++row) {
+    raw.push_back(0);
+    raw.insert(raw.end(), rgb.begin()+row*rowBytes,
+               rgb.begin()+( row+1 )*rowBytes);
+  }
+
+  // A zlib stream of stored (not compressed) deflate blocks.
+  std::vector<uint8_t> z{ 0x78, 0x01 };
+  size_t pos{ 0 };
+  do {
+    size_t const len{ std::min(MAX_STORED_BLOCK, raw.size()-pos) };
+    bool const last{ pos+len==raw.size() };
+    z.push_back(last ? 1 : 0);
+    z.push_back(static_cast<uint8_t>(len & 0xFF));
+    z.push_back(static_cast<uint8_t>(len >> 8));
+    z.push_back(static_cast<uint8_t>(~len & 0xFF));
+    z.push_back(static_cast<uint8_t>(( ~len >> 8 ) & 0xFF));
+    z.insert(z.end(), raw.begin()+pos, raw.begin()+pos+len);
+    pos += len;
+  } while (pos<raw.size());
+  putBigEndian(z, adler32(1, raw.data(), raw.size()));
+
+  std::vector<uint8_t> ihdr;
+  putBigEndian(ihdr, m_width);
+  putBigEndian(ihdr, m_height);
+  ihdr.insert(ihdr.end(), { 8, 2, 0, 0, 0 });  // 8 bit rgb, not interlaced.
+
+  std::vector<uint8_t> png{ 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+  putChunk(png, "IHDR", ihdr);
+  putChunk(png, "IDAT", z);
+  putChunk(png, "IEND", { });
+
+  f.write(reinterpret_cast<char const *>(png.data()), png.size());
+  return f.good();
+}
+
+} // namespace bd
@@ -45,22 +45,29 @@ Renderer::~Renderer()
 
 void
 Renderer::resize(unsigned int w, unsigned int h)
+{
+  setViewport(w, h);
+  glViewport(0, 0, w, h);
+
+  bd::Dbg() << "Resized render viewport: " << w << "X" << h;
+
+
+}
+
+
+void
+Renderer::setViewport(unsigned int w, unsigned int h)
 {
   m_viewPortXPos = 0;
   m_viewPortYPos = 0;
   m_viewPortWidth = w;
   m_viewPortHeight = h;
   m_aspectRatio = w / static_cast<float>(h);
-  glViewport(0, 0, w, h);
 
 //  setViewMatrix(I4x4);
 //  setWorldMatrix(I4x4);
 
   updateProjectionMatrix();
-
-  bd::Dbg() << "Resized render viewport: " << w << "X" << h;
-
-
 }
 
 unsigned int
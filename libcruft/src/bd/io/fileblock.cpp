@@ -23,6 +23,10 @@ FileBlock::to_string() const
       "      \"data_bytes\": " << data_bytes << ",\n"
       "      \"voxel_dims\": [" << voxel_dims[0] << ", " << voxel_dims[1] << ", "
      << voxel_dims[2] << "],\n"
+      "      \"occ_min\": [" << occ_min[0] << ", " << occ_min[1] << ", "
+     << occ_min[2] << "],\n"
+      "      \"occ_max\": [" << occ_max[0] << ", " << occ_max[1] << ", "
+     << occ_max[2] << "],\n"
       "      \"world_dims\": [" << world_dims[0] << ", " << world_dims[1] << ", "
      << world_dims[2] << "],\n"
       "      \"world_oigin\": [" << world_oigin[0] << ", " << world_oigin[1] << ", "
@@ -311,6 +311,11 @@ IndexFile::init(bd::DataType type)
         blk.voxel_dims[1] = static_cast<decltype(blk.voxel_dims[1])>(bd.y);
         blk.voxel_dims[2] = static_cast<decltype(blk.voxel_dims[2])>(bd.z);
 
+        // no relevance info here, the whole block is occupied.
+        blk.occ_max[0] = blk.voxel_dims[0];
+        blk.occ_max[1] = blk.voxel_dims[1];
+        blk.occ_max[2] = blk.voxel_dims[2];
+
         blk.world_oigin[0] = blkOrigin.x;
         blk.world_oigin[1] = blkOrigin.y;
         blk.world_oigin[2] = blkOrigin.z;
@@ -3,10 +3,12 @@
 //
 
 #include <bd/io/indexfile/v2/jsonindexfile.h>
+#include <bd/log/logger.h>
 
 #include <glm/glm.hpp>
 #include <nlohmann/json.hpp>
 
+#include <algorithm>
 #include <fstream>
 #include <string>
 
@@ -37,6 +39,23 @@ from_json(const json &j, FileBlock &b)
   j.at("offset").get_to(b.data_offset);
   j.at("data_bytes").get_to(b.data_bytes);
   j.at("rel").get_to(b.rov);
+
+  // older index files have no per-block value range, keep the defaults.
+  if (j.find("min_val")!=j.end() && j.find("max_val")!=j.end()) {
+    j.at("min_val").get_to(b.min_val);
+    j.at("max_val").get_to(b.max_val);
+  }
+
+  // older index files have no occupied box either, the zero default means
+  // the whole block.
+  if (j.find("occ_min")!=j.end() && j.find("occ_max")!=j.end()) {
+    auto occMin = j.at("occ_min").get<std::vector<uint64_t>>();
+    auto occMax = j.at("occ_max").get<std::vector<uint64_t>>();
+    for (int i{ 0 }; i<3; ++i) {
+      b.occ_min[i] = occMin[i];
+      b.occ_max[i] = occMax[i];
+    }
+  }
 }
 }
 
@@ -98,6 +117,44 @@ JsonIndexFile::open(std::string const &fname)
 
   auto blocks = js.at("blocks").get<std::vector<bd::FileBlock>>();
 
+  // Blocks of an adaptive partition have different sizes, the buffers and
+  // texture slots are made for the largest one.
+  glm::u64vec3 maxDims{ 0, 0, 0 };
+  bool sameDims{ true };
+  for (FileBlock const &fb : blocks) {
+    for (int i{ 0 }; i<3; ++i) {
+      sameDims = sameDims && fb.voxel_dims[i]==blocks[0].voxel_dims[i];
+      maxDims[i] = std::max<uint64_t>(maxDims[i], fb.voxel_dims[i]);
+    }
+  }
+  if (!sameDims) {
+    v.block_dims(maxDims);
+    bd::Info() << blocks.size() << " blocks of different sizes, largest is "
+               << maxDims.x << "x" << maxDims.y << "x" << maxDims.z << ".";
+  }
+
+  // sub-brick occupancy masks and the transparent value are optional.
+  m_masks.clear();
+  auto brick = js.find("occ_brick");
+  if (brick!=js.end() && brick->get<uint64_t>()>0) {
+    auto const &jsBlocks = js.at("blocks");
+    for (size_t i{ 0 }; i<blocks.size(); ++i) {
+      FileBlock const &fb{ blocks[i] };
+      OccupancyMask mask{ { fb.voxel_dims[0], fb.voxel_dims[1], fb.voxel_dims[2] },
+                          brick->get<uint64_t>() };
+      auto bits = jsBlocks[i].find("occ_bits");
+      if (bits==jsBlocks[i].end() || !mask.fromHex(bits->get<std::string>())) {
+        bd::Warn() << "Block " << fb.block_index << " has no valid occupancy "
+                      "mask, all of its bricks are read.";
+      }
+      m_masks.push_back(mask);
+    }
+  }
+
+  auto empty = js.find("empty_val");
+  m_hasEmptyValue = empty!=js.end() && empty->is_number();
+  m_emptyValue = m_hasEmptyValue ? empty->get<double>() : 0.0;
+
   m_volume = v;
   m_blocks = blocks;
 
@@ -146,6 +203,27 @@ JsonIndexFile::getVolume() const
   return m_volume;
 }
 
+
+std::vector<bd::OccupancyMask> const &
+JsonIndexFile::getOccupancyMasks() const
+{
+  return m_masks;
+}
+
+
+bool
+JsonIndexFile::hasEmptyValue() const
+{
+  return m_hasEmptyValue;
+}
+
+
+double
+JsonIndexFile::getEmptyValue() const
+{
+  return m_emptyValue;
+}
+
 }
 }
 }
\ No newline at end of file
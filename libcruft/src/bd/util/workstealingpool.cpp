@@ -0,0 +1,168 @@
+#include <bd/util/workstealingpool.h>
+
+#include <algorithm>
+
+namespace bd
+{
+
+///////////////////////////////////////////////////////////////////////////////
+WorkStealingPool::WorkStealingPool(size_t threads)
+    : m_queues{ }
+    , m_threads{ }
+    , m_mutex{ }
+    , m_wake{ }
+    , m_done{ }
+    , m_generation{ 0 }
+    , m_stop{ false }
+    , m_job{ nullptr }
+    , m_remaining{ 0 }
+    , m_steals{ 0 }
+{
+  if (threads==0) {
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+
+  for (size_t w{ 0 }; w<threads; ++w) {
+    m_queues.emplace_back(new Queue);
+  }
+  for (size_t w{ 1 }; w<threads; ++w) {
+    m_threads.emplace_back([this, w]() { workerLoop(w); });
+  }
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+WorkStealingPool::~WorkStealingPool()
+{
+  {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_stop = true;
+  }
+  m_wake.notify_all();
+  for (std::thread &t : m_threads) {
+    t.join();
+  }
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+size_t
+WorkStealingPool::size() const
+{
+  return m_queues.size();
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+size_t
+WorkStealingPool::steals() const
+{
+  return m_steals.load();
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+void
+WorkStealingPool::run(size_t n, Job const &job)
+{
+  if (n==0) {
+    return;
+  }
+
+  // Set before any task is queued: a worker still draining the last batch
+  // may pick up a new task as soon as it is pushed.
+  m_job = &job;
+  m_remaining.store(n);
+
+  size_t const workers{ m_queues.size() };
+  size_t const run{ ( n+workers-1 )/workers };
+  for (size_t w{ 0 }; w<workers; ++w) {
+    Queue &q{ *m_queues[w] };
+    std::unique_lock<std::mutex> lock(q.mutex);
+    for (size_t t{ w*run }; t<std::min(n, ( w+1 )*run); ++t) {
+      q.tasks.push_back(t);
+    }
+  }
+
+  {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    ++m_generation;
+  }
+  m_wake.notify_all();
+
+  drain(0);
+
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_done.wait(lock, [this]() { return m_remaining.load()==0; });
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+void
+WorkStealingPool::workerLoop(size_t worker)
+{
+  uint64_t seen{ 0 };
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_wake.wait(lock, [&]() { return m_stop || m_generation!=seen; });
+      if (m_stop) {
+        return;
+      }
+      seen = m_generation;
+    }
+    drain(worker);
+  }
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+void
+WorkStealingPool::drain(size_t worker)
+{
+  size_t task{ 0 };
+  while (popOwn(worker, task) || steal(worker, task)) {
+    ( *m_job )(task, worker);
+    if (m_remaining.fetch_sub(1)==1) {
+      // Under the lock so run() can not miss the wake up.
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_done.notify_all();
+    }
+  }
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+bool
+WorkStealingPool::popOwn(size_t worker, size_t &task)
+{
+  Queue &q{ *m_queues[worker] };
+  std::unique_lock<std::mutex> lock(q.mutex);
+  if (q.tasks.empty()) {
+    return false;
+  }
+  task = q.tasks.back();
+  q.tasks.pop_back();
+  return true;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+bool
+WorkStealingPool::steal(size_t worker, size_t &task)
+{
+  size_t const workers{ m_queues.size() };
+  for (size_t i{ 1 }; i<workers; ++i) {
+    Queue &q{ *m_queues[( worker+i )%workers] };
+    std::unique_lock<std::mutex> lock(q.mutex);
+    if (!q.tasks.empty()) {
+      task = q.tasks.front();
+      q.tasks.pop_front();
+      ++m_steals;
+      return true;
+    }
+  }
+  return false;
+}
+
+} // namespace bd
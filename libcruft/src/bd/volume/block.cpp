@@ -18,25 +18,21 @@ namespace bd
 
 ///////////////////////////////////////////////////////////////////////////////
 Block::Block(const glm::u64vec3& ijk, const FileBlock &fb)
-  : m_fb{ fb }
-  , m_ijk{ fb.ijk_index[0], fb.ijk_index[1], fb.ijk_index[2] }
-  , m_origin{ fb.world_oigin[0], fb.world_oigin[1], fb.world_oigin[2] }
-  , m_worldDims{ fb.world_dims[0], fb.world_dims[1], fb.world_dims[2] }
-  , m_transform{ 1.0f }  // identity matrix
-  , m_tex{ nullptr }
-  , m_pixelData{ nullptr }
-  , m_status{ 0x0 }
-  , m_isVisible{ false }
+  : m_store{ nullptr }
+  , m_slot{ 0 }
+  , m_own{ new BlockStore{ fb }}
 {
+  m_store = m_own.get();
+  m_store->m_ijk[0] = ijk;
+}
 
-  glm::vec3 wld_dims{ fb.world_dims[0], fb.world_dims[1], fb.world_dims[2] };
-
-  glm::mat4 s{ glm::scale(glm::mat4{ 1.0f }, wld_dims) };
-
-  glm::mat4 t{ glm::translate(glm::mat4{ 1.0f }, m_origin) };
-
-  m_transform = t * s;
 
+///////////////////////////////////////////////////////////////////////////////
+Block::Block(BlockStore *store, size_t slot)
+  : m_store{ store }
+  , m_slot{ slot }
+  , m_own{ nullptr }
+{
 }
 
 
@@ -56,11 +52,34 @@ Block::~Block()
 void
 Block::sendToGpu()
 {
-  if (m_status & GPU_WAIT)
-    m_tex->subImage3D(m_pixelData);
+  int &status{ m_store->m_status[m_slot] };
+  if (status & GPU_WAIT) {
+    BlockStore::Runtime const &load{ m_store->materialize(m_slot) };
+    BlockStore::TextureSlot const &slot{ load.texSlot };
+    glm::u64vec3 const ext{ load.occExtent };
+
+    // Quantized blocks are expanded back to floats for the R32F atlas.
+    char const *pixels{ load.pixelData };
+    if (load.quant.mode != QuantizeMode::None) {
+      static thread_local std::vector<float> expanded;
+      size_t const n{ ext.x * ext.y * ext.z };
+      expanded.resize(n);
+      BlockQuantizer::dequantize(load.quant, load.pixelData, n,
+                                 expanded.data());
+      pixels = reinterpret_cast<char const *>(expanded.data());
+    }
+
+    slot.tex->subImage3D(static_cast<int>(slot.voxelOffset.x),
+                         static_cast<int>(slot.voxelOffset.y),
+                         static_cast<int>(slot.voxelOffset.z),
+                         static_cast<int>(ext.x),
+                         static_cast<int>(ext.y),
+                         static_cast<int>(ext.z),
+                         pixels);
+  }
 
-  m_status |= GPU_RES;
-  m_status &= ~GPU_WAIT;
+  status |= GPU_RES;
+  status &= ~GPU_WAIT;
 }
 
 
@@ -89,21 +108,21 @@ Block::sendToGpu()
 const FileBlock&
 Block::fileBlock() const
 {
-  return m_fb;
+  return m_store->m_fb[m_slot];
 }
 
 
 uint64_t
 Block::index() const
 {
-  return m_fb.block_index;
+  return m_store->m_index[m_slot];
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 const glm::u64vec3&
 Block::ijk() const
 {
-  return m_ijk;
+  return m_store->m_ijk[m_slot];
 }
 
 
@@ -111,7 +130,7 @@ Block::ijk() const
 void
 Block::ijk(const glm::u64vec3& ijk)
 {
-  m_ijk = ijk;
+  m_store->m_ijk[m_slot] = ijk;
 }
 
 
@@ -119,19 +138,27 @@ Block::ijk(const glm::u64vec3& ijk)
 bool
 Block::empty() const
 {
-  return m_fb.is_empty == 1;
+  // Relaxed: the load thread polls it (LoadTicket) while the classifier
+  // sets it, the queue lock orders everything else about the block.
+  return m_store->m_empty[m_slot].load(std::memory_order_relaxed) == 1;
 }
 
 
 void
 Block::empty(bool isEmpty)
 {
-  m_fb.is_empty = (decltype(m_fb.is_empty)) isEmpty;
+  m_store->m_empty[m_slot].store(static_cast<uint8_t>(isEmpty),
+                                 std::memory_order_relaxed);
+  if (!isEmpty) {
+    // a shown block is a candidate for loading.
+    m_store->materialize(m_slot);
+  }
 
+  int &status{ m_store->m_status[m_slot] };
   if (!isEmpty) {
-    m_status |= NOT_EMPTY;
+    status |= NOT_EMPTY;
   } else {
-    m_status &= ~NOT_EMPTY;
+    status &= ~NOT_EMPTY;
   }
 
 }
@@ -141,20 +168,28 @@ Block::empty(bool isEmpty)
 glm::vec3 const &
 Block::origin() const
 {
-  return m_origin;
+  return m_store->m_origin[m_slot];
 }
 
 glm::vec3 const &
 Block::worldDims() const
 {
-  return m_worldDims;
+  return m_store->m_worldDims[m_slot];
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 double
 Block::avg() const
 {
-  return m_fb.avg_val;
+  return m_store->m_avg[m_slot];
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+double
+Block::rov() const
+{
+  return m_store->m_rov[m_slot];
 }
 
 
@@ -162,7 +197,8 @@ Block::avg() const
 bd::Texture *
 Block::texture() 
 {
-  return m_tex;
+  BlockStore::Runtime const *rt{ m_store->peek(m_slot) };
+  return rt ? rt->texSlot.tex : nullptr;
 }
 
 
@@ -170,14 +206,46 @@ Block::texture()
 void
 Block::texture(bd::Texture * tex)
 {
+  int &status{ m_store->m_status[m_slot] };
   if (tex){
-    m_status |= GPU_WAIT;
+    status |= GPU_WAIT;
   } else {
     // if we are removing our texture, we aren't gpu resident anymore.
-    m_status &= ~(GPU_RES | GPU_WAIT);
+    status &= ~(GPU_RES | GPU_WAIT);
+  }
+
+  if (tex || m_store->peek(m_slot)) {
+    m_store->materialize(m_slot).texSlot.tex = tex;
   }
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+void
+Block::textureSlot(glm::u64vec3 const &voxelOffset,
+                   glm::vec3 const &texOffset,
+                   glm::vec3 const &texScale)
+{
+  BlockStore::TextureSlot &slot{ m_store->materialize(m_slot).texSlot };
+  slot.voxelOffset = voxelOffset;
+  slot.offset = texOffset;
+  slot.scale = texScale;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+glm::vec3 const &
+Block::texOffset() const
+{
+  return m_store->materialize(m_slot).texSlot.offset;
+}
+
 
-  m_tex = tex;
+///////////////////////////////////////////////////////////////////////////////
+glm::vec3 const &
+Block::texScale() const
+{
+  return m_store->materialize(m_slot).texSlot.scale;
 }
 
 
@@ -185,17 +253,27 @@ Block::texture(bd::Texture * tex)
 bd::Texture *
 Block::removeTexture()   
 {
-  Texture *rval{ m_tex };
+  Texture *rval{ texture() };
   texture(nullptr);
   return rval;
 }
 
 
 ///////////////////////////////////////////////////////////////////////////////
-glm::mat4&
-Block::transform()
+glm::mat4
+Block::transform() const
 {
-  return m_transform;
+  BlockStore::Runtime const &load{ m_store->materialize(m_slot) };
+  glm::vec3 const &dims{ worldDims() };
+  glm::vec3 const wld_dims{ dims*( load.occHigh-load.occLow ) };
+  glm::vec3 const center{
+      origin()+dims*( ( load.occLow+load.occHigh )*0.5f-0.5f ) };
+
+  glm::mat4 s{ glm::scale(glm::mat4{ 1.0f }, wld_dims) };
+
+  glm::mat4 t{ glm::translate(glm::mat4{ 1.0f }, center) };
+
+  return t * s;
 }
 
 
@@ -203,7 +281,56 @@ Block::transform()
 glm::u64vec3
 Block::voxel_extent() const
 {
-  return { m_fb.voxel_dims[0], m_fb.voxel_dims[1], m_fb.voxel_dims[2] };
+  FileBlock const &fb{ m_store->m_fb[m_slot] };
+  return { fb.voxel_dims[0], fb.voxel_dims[1], fb.voxel_dims[2] };
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+glm::u64vec3 const &
+Block::occupiedOffset() const
+{
+  return m_store->materialize(m_slot).occOffset;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+glm::u64vec3 const &
+Block::occupiedExtent() const
+{
+  return m_store->materialize(m_slot).occExtent;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+glm::vec3 const &
+Block::occupiedLow() const
+{
+  return m_store->materialize(m_slot).occLow;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+glm::vec3 const &
+Block::occupiedHigh() const
+{
+  return m_store->materialize(m_slot).occHigh;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+OccupancyMask const *
+Block::occupancy() const
+{
+  return m_store->m_occMask[m_slot];
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+void
+Block::occupancy(OccupancyMask const *mask)
+{
+  m_store->m_occMask[m_slot] = mask;
 }
 
 
@@ -211,7 +338,7 @@ Block::voxel_extent() const
 size_t 
 Block::byteSize() const
 {
-  return m_fb.data_bytes;
+  return m_store->m_fb[m_slot].data_bytes;
 }
 
 
@@ -219,7 +346,7 @@ Block::byteSize() const
 int
 Block::status() const
 {
-  return m_status;
+  return m_store->m_status[m_slot];
 }
 
 
@@ -227,7 +354,8 @@ Block::status() const
 char* 
 Block::pixelData() 
 {
-  return m_pixelData;
+  BlockStore::Runtime const *rt{ m_store->peek(m_slot) };
+  return rt ? rt->pixelData : nullptr;
 }
 
 
@@ -235,15 +363,25 @@ Block::pixelData()
 void
 Block::pixelData(char *data)
 {
+  int &status{ m_store->m_status[m_slot] };
   if (data) {
     // if we have texture data, we know we have CPU residency.
-    m_status |= CPU_RES;
+    status |= CPU_RES;
   } else {
     // data is nullptr, so block is not cpu or gpu res
-    m_status &= ~(CPU_RES | GPU_RES);
+    status &= ~(CPU_RES | GPU_RES);
   }
 
-  m_pixelData = data;
+  if (data) {
+    BlockStore::Runtime &rt{ m_store->materialize(m_slot) };
+    rt.pixelData = data;
+    rt.loads += 1;
+  } else {
+    BlockStore::Runtime *rt{ m_store->peek(m_slot) };
+    if (rt) {
+      rt->pixelData = nullptr;
+    }
+  }
 }
 
 
@@ -257,20 +395,48 @@ Block::removePixelData()
 }
 
 
+///////////////////////////////////////////////////////////////////////////////
+uint32_t
+Block::loadCount() const
+{
+  BlockStore::Runtime const *rt{ m_store->peek(m_slot) };
+  return rt ? rt->loads : 0;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+void
+Block::quantization(QuantizedBlockInfo const &info)
+{
+  m_store->materialize(m_slot).quant = info;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+QuantizedBlockInfo const &
+Block::quantization() const
+{
+  return m_store->materialize(m_slot).quant;
+}
+
+
 ///////////////////////////////////////////////////////////////////////////////
 std::string
 Block::to_string() const
 {
+  glm::u64vec3 const &b{ ijk() };
+  FileBlock const &fb{ m_store->m_fb[m_slot] };
+  BlockStore::Runtime const *rt{ m_store->peek(m_slot) };
   std::stringstream ss;
   ss << "{ ijk: ("
-     << m_ijk.x << ',' << m_ijk.y << ',' << m_ijk.z << "),\n"
+     << b.x << ',' << b.y << ',' << b.z << "),\n"
          "Origin: ("
-     << m_fb.world_oigin[0]
-     << ',' << m_fb.world_oigin[1]
-     << ',' << m_fb.world_oigin[2] << "),\n"
+     << fb.world_oigin[0]
+     << ',' << fb.world_oigin[1]
+     << ',' << fb.world_oigin[2] << "),\n"
          "Empty: " << (empty() ? "True" : "False") << "\n"
-         "Texture: " << m_tex << "\n"
-         "Status: " << std::ios::hex << m_status << " }";
+         "Texture: " << ( rt ? rt->texSlot.tex : nullptr ) << "\n"
+         "Status: " << std::ios::hex << status() << " }";
 
   return ss.str();
 }
@@ -0,0 +1,356 @@
+#include <bd/volume/blockstore.h>
+#include <bd/volume/block.h>
+
+#include <algorithm>
+#include <cassert>
+#include <new>
+
+namespace bd
+{
+
+namespace
+{
+
+/// Arrays start on their own cache line.
+size_t const ARRAY_ALIGN{ 64 };
+
+/// Most blocks of runtime state allocated at a time.
+size_t const RUNTIME_CHUNK{ 4096 };
+
+
+/// \brief Carves the arrays of a BlockStore out of one allocation.
+class ArenaLayout
+{
+public:
+  ArenaLayout()
+      : m_bytes{ 0 }
+  {
+  }
+
+
+  /// \brief Reserve room for \c n T's, returns their offset from the start.
+  template<class T>
+  size_t
+  add(size_t n)
+  {
+    static_assert(alignof(T)<=ARRAY_ALIGN, "Arrays are cache line aligned.");
+    size_t const offset{ m_bytes };
+    m_bytes += ( n*sizeof(T)+ARRAY_ALIGN-1 )/ARRAY_ALIGN*ARRAY_ALIGN;
+    return offset;
+  }
+
+
+  size_t
+  bytes() const
+  {
+    return m_bytes;
+  }
+
+
+private:
+  size_t m_bytes;
+};
+
+
+/// \brief The array at \c offset of \c base, its elements are constructed
+/// by BlockStore::init().
+template<class T>
+T *
+arrayAt(char *base, size_t offset)
+{
+  return reinterpret_cast<T *>(base+offset);
+}
+
+
+/// \brief The part of the block described by \c fb that is read, uploaded
+/// and drawn (see Block::occupiedOffset()).
+void
+occupiedBox(FileBlock const &fb, glm::u64vec3 &offset, glm::u64vec3 &extent,
+            glm::vec3 &low, glm::vec3 &high)
+{
+  glm::u64vec3 const vd{ fb.voxel_dims[0], fb.voxel_dims[1], fb.voxel_dims[2] };
+  glm::u64vec3 const occMin{ fb.occ_min[0], fb.occ_min[1], fb.occ_min[2] };
+  glm::u64vec3 const occMax{ fb.occ_max[0], fb.occ_max[1], fb.occ_max[2] };
+
+  offset = { 0, 0, 0 };
+  extent = vd;
+  low = { 0.0f, 0.0f, 0.0f };
+  high = { 1.0f, 1.0f, 1.0f };
+
+  // The proxy's [0,1] coords span the centers of the first and last voxel,
+  // so the occupied voxels [lo, hi) cover [lo/(d-1), (hi-1)/(d-1)] of the
+  // block. Dimensions with one voxel (or no box) keep the whole block.
+  for (int a{ 0 }; a<3; ++a) {
+    if (occMin[a]>=occMax[a] || occMax[a]>vd[a] || vd[a]<2) {
+      continue;
+    }
+    uint64_t const lo{ occMin[a]>0 ? occMin[a]-1 : 0 };
+    uint64_t const hi{ std::min(occMax[a]+1, vd[a]) };
+    offset[a] = lo;
+    extent[a] = hi-lo;
+    low[a] = static_cast<float>(lo)/( vd[a]-1 );
+    high[a] = static_cast<float>(hi-1)/( vd[a]-1 );
+  }
+}
+
+} // namespace
+
+
+///////////////////////////////////////////////////////////////////////////////
+BlockStore::BlockStore(std::vector<FileBlock> const &fileBlocks)
+    : m_size{ 0 }
+    , m_bytes{ 0 }
+    , m_arena{ nullptr }
+    , m_index{ nullptr }
+    , m_ijk{ nullptr }
+    , m_origin{ nullptr }
+    , m_worldDims{ nullptr }
+    , m_rov{ nullptr }
+    , m_avg{ nullptr }
+    , m_status{ nullptr }
+    , m_empty{ nullptr }
+    , m_occMask{ nullptr }
+    , m_runtime{ nullptr }
+    , m_fb{ fileBlocks.data() }
+    , m_ownFb{ nullptr }
+    , m_views{ nullptr }
+    , m_runtimeMutex{ }
+    , m_chunks{ }
+    , m_chunkSize{ 0 }
+    , m_chunkUsed{ 0 }
+    , m_materialized{ 0 }
+{
+  allocate(fileBlocks.size());
+  for (size_t i{ 0 }; i<m_size; ++i) {
+    init(i, fileBlocks[i]);
+  }
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+BlockStore::BlockStore(FileBlock const &fb)
+    : m_size{ 0 }
+    , m_bytes{ 0 }
+    , m_arena{ nullptr }
+    , m_index{ nullptr }
+    , m_ijk{ nullptr }
+    , m_origin{ nullptr }
+    , m_worldDims{ nullptr }
+    , m_rov{ nullptr }
+    , m_avg{ nullptr }
+    , m_status{ nullptr }
+    , m_empty{ nullptr }
+    , m_occMask{ nullptr }
+    , m_runtime{ nullptr }
+    , m_fb{ nullptr }
+    , m_ownFb{ new FileBlock{ fb }}
+    , m_views{ nullptr }
+    , m_runtimeMutex{ }
+    , m_chunks{ }
+    , m_chunkSize{ 0 }
+    , m_chunkUsed{ 0 }
+    , m_materialized{ 0 }
+{
+  m_fb = m_ownFb.get();
+  allocate(1);
+  init(0, fb);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+BlockStore::~BlockStore()
+{
+  // the rest of the arena is trivially destructible.
+  for (size_t i{ 0 }; i<m_size; ++i) {
+    m_views[i].~Block();
+  }
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+void
+BlockStore::allocate(size_t n)
+{
+  ArenaLayout layout;
+  size_t const index{ layout.add<uint64_t>(n) };
+  size_t const ijk{ layout.add<glm::u64vec3>(n) };
+  size_t const origin{ layout.add<glm::vec3>(n) };
+  size_t const worldDims{ layout.add<glm::vec3>(n) };
+  size_t const rov{ layout.add<double>(n) };
+  size_t const avg{ layout.add<double>(n) };
+  size_t const status{ layout.add<int>(n) };
+  size_t const empty{ layout.add<std::atomic<uint8_t>>(n) };
+  size_t const occMask{ layout.add<OccupancyMask const *>(n) };
+  size_t const runtime{ layout.add<std::atomic<Runtime *>>(n) };
+  size_t const views{ layout.add<Block>(n) };
+
+  m_size = n;
+  m_bytes = layout.bytes();
+  m_arena.reset(new char[m_bytes+ARRAY_ALIGN]);
+  m_chunkSize = std::max<size_t>(1, std::min(RUNTIME_CHUNK, n));
+
+  char *base{ m_arena.get() };
+  size_t const misalign{ reinterpret_cast<uintptr_t>(base)%ARRAY_ALIGN };
+  if (misalign!=0) {
+    base += ARRAY_ALIGN-misalign;
+  }
+
+  m_index = arrayAt<uint64_t>(base, index);
+  m_ijk = arrayAt<glm::u64vec3>(base, ijk);
+  m_origin = arrayAt<glm::vec3>(base, origin);
+  m_worldDims = arrayAt<glm::vec3>(base, worldDims);
+  m_rov = arrayAt<double>(base, rov);
+  m_avg = arrayAt<double>(base, avg);
+  m_status = arrayAt<int>(base, status);
+  m_empty = arrayAt<std::atomic<uint8_t>>(base, empty);
+  m_occMask = arrayAt<OccupancyMask const *>(base, occMask);
+  m_runtime = arrayAt<std::atomic<Runtime *>>(base, runtime);
+  m_views = arrayAt<Block>(base, views);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+void
+BlockStore::init(size_t i, FileBlock const &fb)
+{
+  // each element is written once, straight into the arena.
+  new (m_views+i) Block{ this, i };
+  new (m_runtime+i) std::atomic<Runtime *>{ nullptr };
+  new (m_empty+i) std::atomic<uint8_t>{
+      static_cast<uint8_t>(fb.is_empty==1) };
+
+  m_index[i] = fb.block_index;
+  m_ijk[i] = { fb.ijk_index[0], fb.ijk_index[1], fb.ijk_index[2] };
+  m_origin[i] = glm::vec3(fb.world_oigin[0], fb.world_oigin[1],
+                          fb.world_oigin[2]);
+  m_worldDims[i] = glm::vec3(fb.world_dims[0], fb.world_dims[1],
+                             fb.world_dims[2]);
+  m_rov[i] = fb.rov;
+  m_avg[i] = fb.avg_val;
+  m_status[i] = 0x0;
+  m_occMask[i] = nullptr;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+BlockStore::Runtime &
+BlockStore::makeRuntime(size_t i)
+{
+  std::unique_lock<std::mutex> lock(m_runtimeMutex);
+
+  // made by another thread while we waited.
+  Runtime *rt{ peek(i) };
+  if (rt) {
+    return *rt;
+  }
+
+  if (m_chunks.empty() || m_chunkUsed==m_chunkSize) {
+    m_chunks.emplace_back(new Runtime[m_chunkSize]);
+    m_chunkUsed = 0;
+  }
+  rt = &m_chunks.back()[m_chunkUsed++];
+
+  rt->texSlot = { nullptr,
+                  { 0.0f, 0.0f, 0.0f },
+                  { 1.0f, 1.0f, 1.0f },
+                  { 0, 0, 0 }};
+  occupiedBox(m_fb[i], rt->occOffset, rt->occExtent, rt->occLow, rt->occHigh);
+  rt->pixelData = nullptr;
+  rt->loads = 0;
+
+  m_runtime[i].store(rt, std::memory_order_release);
+  ++m_materialized;
+  return *rt;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+size_t
+BlockStore::size() const
+{
+  return m_size;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+size_t
+BlockStore::bytes() const
+{
+  std::unique_lock<std::mutex> lock(m_runtimeMutex);
+  return m_bytes+m_chunks.size()*m_chunkSize*sizeof(Runtime);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+size_t
+BlockStore::materialized() const
+{
+  return m_materialized.load();
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+Block *
+BlockStore::block(size_t i)
+{
+  assert(i<m_size && "Block index out of range.");
+  return m_views+i;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+Block const *
+BlockStore::block(size_t i) const
+{
+  assert(i<m_size && "Block index out of range.");
+  return m_views+i;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+glm::vec3 const *
+BlockStore::origins() const
+{
+  return m_origin;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+glm::vec3 const *
+BlockStore::worldDims() const
+{
+  return m_worldDims;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+double const *
+BlockStore::rovs() const
+{
+  return m_rov;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+int const *
+BlockStore::statuses() const
+{
+  return m_status;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+uint64_t
+BlockStore::occupiedVoxels() const
+{
+  uint64_t voxels{ 0 };
+  for (size_t i{ 0 }; i<m_size; ++i) {
+    glm::u64vec3 offset, extent;
+    glm::vec3 low, high;
+    occupiedBox(m_fb[i], offset, extent, low, high);
+    voxels += extent.x*extent.y*extent.z;
+  }
+  return voxels;
+}
+
+} // namespace bd
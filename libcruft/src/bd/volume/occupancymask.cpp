@@ -0,0 +1,224 @@
+#include <bd/volume/occupancymask.h>
+
+#include <cassert>
+
+namespace bd
+{
+
+namespace
+{
+
+/// \brief Value of hex digit \c c, or -1 if it is not one.
+int
+hexDigit(char c)
+{
+  if (c>='0' && c<='9') {
+    return c-'0';
+  }
+  if (c>='a' && c<='f') {
+    return c-'a'+10;
+  }
+  if (c>='A' && c<='F') {
+    return c-'A'+10;
+  }
+  return -1;
+}
+
+} // namespace
+
+
+///////////////////////////////////////////////////////////////////////////////
+OccupancyMask::OccupancyMask()
+    : m_blockDims{ 0, 0, 0 }
+    , m_brickCount{ 0, 0, 0 }
+    , m_brickSide{ 1 }
+    , m_bits{ }
+{
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+OccupancyMask::OccupancyMask(glm::u64vec3 const &blockDims, uint64_t brickSide)
+    : m_blockDims{ blockDims }
+    , m_brickCount{ 0, 0, 0 }
+    , m_brickSide{ brickSide }
+    , m_bits{ }
+{
+  assert(brickSide>0 && "Brick side must be at least one voxel.");
+  m_brickCount = ( blockDims+brickSide-uint64_t(1) )/brickSide;
+  size_t const n{ m_brickCount.x*m_brickCount.y*m_brickCount.z };
+  m_bits.assign(( n+7 )/8, 0xFF);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+bool
+OccupancyMask::fromHex(std::string const &hex)
+{
+  if (hex.size()<2*m_bits.size()) {
+    return false;
+  }
+
+  std::vector<uint8_t> bits(m_bits.size());
+  for (size_t i{ 0 }; i<bits.size(); ++i) {
+    int const hi{ hexDigit(hex[2*i]) };
+    int const lo{ hexDigit(hex[2*i+1]) };
+    if (hi<0 || lo<0) {
+      return false;
+    }
+    bits[i] = static_cast<uint8_t>(( hi << 4 ) | lo);
+  }
+
+  m_bits.swap(bits);
+  return true;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+std::string
+OccupancyMask::toHex() const
+{
+  char const *const digits{ "0123456789abcdef" };
+  std::string hex;
+  hex.reserve(2*m_bits.size());
+  for (uint8_t b : m_bits) {
+    hex.push_back(digits[b >> 4]);
+    hex.push_back(digits[b & 0xF]);
+  }
+  return hex;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+size_t
+OccupancyMask::size() const
+{
+  return m_brickCount.x*m_brickCount.y*m_brickCount.z;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+glm::u64vec3 const &
+OccupancyMask::blockDims() const
+{
+  return m_blockDims;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+uint64_t
+OccupancyMask::brickSide() const
+{
+  return m_brickSide;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+glm::u64vec3 const &
+OccupancyMask::brickCount() const
+{
+  return m_brickCount;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+bool
+OccupancyMask::occupied(glm::u64vec3 const &brick) const
+{
+  if (m_bits.empty()) {
+    return true;
+  }
+  size_t const b{ bit(brick) };
+  return ( m_bits[b/8] >> ( b%8 ) & 1 )!=0;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+void
+OccupancyMask::occupied(glm::u64vec3 const &brick, bool isOccupied)
+{
+  assert(!m_bits.empty() && "Mask has no bricks.");
+  size_t const b{ bit(brick) };
+  if (isOccupied) {
+    m_bits[b/8] |= static_cast<uint8_t>(1 << ( b%8 ));
+  } else {
+    m_bits[b/8] &= static_cast<uint8_t>(~( 1 << ( b%8 ) ));
+  }
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+size_t
+OccupancyMask::occupiedCount() const
+{
+  size_t count{ 0 };
+  size_t const n{ size() };
+  for (size_t b{ 0 }; b<n; ++b) {
+    count += m_bits[b/8] >> ( b%8 ) & 1;
+  }
+  return count;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+bool
+OccupancyMask::anyOccupied(glm::u64vec3 const &lo, glm::u64vec3 const &hi) const
+{
+  if (lo.x>=hi.x || lo.y>=hi.y || lo.z>=hi.z) {
+    return false;
+  }
+  if (m_bits.empty()) {
+    return true;
+  }
+
+  glm::u64vec3 const first{ lo/m_brickSide };
+  glm::u64vec3 const last{ glm::min(( hi+m_brickSide-uint64_t(1) )/m_brickSide,
+                                    m_brickCount) };
+  for (uint64_t k{ first.z }; k<last.z; ++k) {
+    for (uint64_t j{ first.y }; j<last.y; ++j) {
+      for (uint64_t i{ first.x }; i<last.x; ++i) {
+        if (occupied({ i, j, k })) {
+          return true;
+        }
+      }
+    }
+  }
+  return false;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+OccupancyMask
+OccupancyMask::dilated() const
+{
+  if (m_bits.empty()) {
+    return *this;
+  }
+
+  OccupancyMask d{ *this };
+  glm::u64vec3 const &n{ m_brickCount };
+  for (uint64_t k{ 0 }; k<n.z; ++k) {
+    for (uint64_t j{ 0 }; j<n.y; ++j) {
+      for (uint64_t i{ 0 }; i<n.x; ++i) {
+        glm::u64vec3 const b{ i, j, k };
+        if (occupied(b)) {
+          continue;
+        }
+        glm::u64vec3 const lo{ i>0 ? i-1 : 0, j>0 ? j-1 : 0, k>0 ? k-1 : 0 };
+        glm::u64vec3 const hi{ glm::min(b+uint64_t(2), n) };
+        for (uint64_t z{ lo.z }; z<hi.z; ++z) {
+          for (uint64_t y{ lo.y }; y<hi.y; ++y) {
+            for (uint64_t x{ lo.x }; x<hi.x; ++x) {
+              if (occupied({ x, y, z })) {
+                d.occupied(b, true);
+              }
+            }
+          }
+        }
+      }
+    }
+  }
+  return d;
+}
+
+} // namespace bd
@@ -0,0 +1,404 @@
+#include <bd/volume/quantizer.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+// The F16C loops are built with a target attribute, so the rest of the
+// file (and library) runs on any x86 cpu.
+#if defined(CRUFT_USE_F16C) && defined(__GNUC__) && \
+    ( defined(__x86_64__) || defined(__i386__) )
+#define BD_HAVE_F16C_LOOPS
+#include <immintrin.h>
+#endif
+
+namespace bd
+{
+
+namespace
+{
+
+/// \brief Largest error from storing [min, max] in \c levels integer steps.
+double
+integerErrorBound(float min, float max, double levels)
+{
+  return ( static_cast<double>(max)-min )/levels*0.5;
+}
+
+
+/// \brief Largest error from storing values up to |absMax| as halves
+/// (10 bits of mantissa, so half a unit in the last place is 2^-11 relative).
+double
+halfErrorBound(float absMax)
+{
+  return absMax*std::ldexp(1.0, -11);
+}
+
+
+/// Halves converted at a time when the buffers may overlap.
+size_t const HALF_CHUNK{ 8 };
+
+
+template<class Ty>
+double
+quantizeInt(float const *src, size_t n, char *dst, float min, float scale)
+{
+  double const levels{ static_cast<double>(std::numeric_limits<Ty>::max()) };
+  float const inv{ scale>0.0f ? 1.0f/scale : 0.0f };
+  double maxErr{ 0.0 };
+  for (size_t i{ 0 }; i<n; ++i) {
+    // read before write: src and dst may alias. The value is stored with
+    // memcpy so the float loads are not moved past it.
+    float const v{ src[i] };
+    double q{ std::floor(( v-min )*inv+0.5f) };
+    q = std::min(std::max(q, 0.0), levels);
+    Ty const t{ static_cast<Ty>(q) };
+    std::memcpy(dst+i*sizeof(Ty), &t, sizeof(Ty));
+    double const err{ std::abs(v-( min+scale*static_cast<float>(q))) };
+    maxErr = std::max(maxErr, err);
+  }
+  return maxErr;
+}
+
+
+template<class Ty>
+void
+dequantizeInt(char const *src, size_t n, float *dst, float offset, float scale)
+{
+  for (size_t i{ 0 }; i<n; ++i) {
+    Ty t;
+    std::memcpy(&t, src+i*sizeof(Ty), sizeof(Ty));
+    dst[i] = offset+scale*static_cast<float>(t);
+  }
+}
+
+
+#if defined(BD_HAVE_F16C_LOOPS)
+/// \brief True if the cpu (and os) can run the F16C loops.
+bool
+haveF16C()
+{
+  static bool const have{ __builtin_cpu_supports("avx") &&
+                          __builtin_cpu_supports("f16c") };
+  return have;
+}
+
+
+/// \brief Convert whole groups of 8 floats.
+/// \return The number converted.
+__attribute__((target("avx,f16c")))
+size_t
+floatsToHalvesF16C(float const *src, size_t n, uint16_t *dst)
+{
+  size_t i{ 0 };
+  for (; i+8<=n; i += 8) {
+    __m256 const f{ _mm256_loadu_ps(src+i) };
+    __m128i const h{ _mm256_cvtps_ph(f, _MM_FROUND_TO_NEAREST_INT) };
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst+i), h);
+  }
+  return i;
+}
+
+
+/// \brief Convert whole groups of 8 halves.
+/// \return The number converted.
+__attribute__((target("avx,f16c")))
+size_t
+halvesToFloatsF16C(uint16_t const *src, size_t n, float *dst)
+{
+  size_t i{ 0 };
+  for (; i+8<=n; i += 8) {
+    __m128i const h{ _mm_loadu_si128(reinterpret_cast<__m128i const *>(src+i)) };
+    _mm256_storeu_ps(dst+i, _mm256_cvtph_ps(h));
+  }
+  return i;
+}
+#endif
+
+} // namespace
+
+
+///////////////////////////////////////////////////////////////////////////////
+QuantizeMode
+to_quantizeMode(std::string const &s)
+{
+  if (s=="none") {
+    return QuantizeMode::None;
+  } else if (s=="u8") {
+    return QuantizeMode::U8;
+  } else if (s=="u16") {
+    return QuantizeMode::U16;
+  } else if (s=="f16") {
+    return QuantizeMode::F16;
+  } else if (s=="auto") {
+    return QuantizeMode::Auto;
+  }
+  throw std::invalid_argument("Unknown quantization mode: " + s);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+std::string
+to_string(QuantizeMode m)
+{
+  switch (m) {
+    case QuantizeMode::U8:
+      return "u8";
+    case QuantizeMode::U16:
+      return "u16";
+    case QuantizeMode::F16:
+      return "f16";
+    case QuantizeMode::Auto:
+      return "auto";
+    case QuantizeMode::None:
+    default:
+      return "none";
+  }
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+BlockQuantizer::BlockQuantizer(QuantizeMode mode, double errorBound)
+    : m_mode{ mode }
+    , m_errorBound{ errorBound }
+{
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+QuantizedBlockInfo
+BlockQuantizer::quantize(float const *src, size_t n, char *dst) const
+{
+  QuantizedBlockInfo info;
+
+  float min{ 0.0f };
+  float max{ 0.0f };
+  if (n>0) {
+    auto mm = std::minmax_element(src, src+n);
+    min = *mm.first;
+    max = *mm.second;
+  }
+
+  QuantizeMode mode{ m_mode };
+  if (mode==QuantizeMode::Auto) {
+    double const u8Err{ integerErrorBound(min, max, 255.0) };
+    double const u16Err{ integerErrorBound(min, max, 65535.0) };
+    double const f16Err{ halfErrorBound(std::max(std::abs(min), std::abs(max))) };
+    if (u8Err<=m_errorBound) {
+      mode = QuantizeMode::U8;
+    } else {
+      mode = u16Err<=f16Err ? QuantizeMode::U16 : QuantizeMode::F16;
+    }
+  }
+
+  info.mode = mode;
+  info.bytes = bytesPerVoxel(mode)*n;
+
+  switch (mode) {
+    case QuantizeMode::U8:
+      info.offset = min;
+      info.scale = ( max-min )/255.0f;
+      info.maxError = quantizeInt<uint8_t>(src, n, dst, info.offset, info.scale);
+      break;
+
+    case QuantizeMode::U16:
+      info.offset = min;
+      info.scale = ( max-min )/65535.0f;
+      info.maxError = quantizeInt<uint16_t>(src, n, dst, info.offset, info.scale);
+      break;
+
+    case QuantizeMode::F16: {
+      double maxErr{ 0.0 };
+      // convert in small chunks so the error can be measured from the
+      // original values even when converting in place.
+      float chunk[HALF_CHUNK];
+      uint16_t halves[HALF_CHUNK];
+      for (size_t i{ 0 }; i<n; i += HALF_CHUNK) {
+        size_t const cnt{ std::min(HALF_CHUNK, n-i) };
+        std::memcpy(chunk, src+i, cnt*sizeof(float));
+        floatsToHalves(chunk, cnt, halves);
+        std::memcpy(dst+i*sizeof(uint16_t), halves, cnt*sizeof(uint16_t));
+        for (size_t j{ 0 }; j<cnt; ++j) {
+          maxErr = std::max(maxErr,
+                            static_cast<double>(std::abs(chunk[j]-halfToFloat(halves[j]))));
+        }
+      }
+      info.maxError = maxErr;
+      break;
+    }
+
+    case QuantizeMode::None:
+    default:
+      info.mode = QuantizeMode::None;
+      info.bytes = n*sizeof(float);
+      if (reinterpret_cast<char const *>(src)!=dst) {
+        std::memmove(dst, src, info.bytes);
+      }
+      break;
+  }
+
+  return info;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+void
+BlockQuantizer::dequantize(QuantizedBlockInfo const &info,
+                           char const *src, size_t n, float *dst)
+{
+  switch (info.mode) {
+    case QuantizeMode::U8:
+      dequantizeInt<uint8_t>(src, n, dst, info.offset, info.scale);
+      break;
+    case QuantizeMode::U16:
+      dequantizeInt<uint16_t>(src, n, dst, info.offset, info.scale);
+      break;
+    case QuantizeMode::F16: {
+      uint16_t halves[HALF_CHUNK];
+      for (size_t i{ 0 }; i<n; i += HALF_CHUNK) {
+        size_t const cnt{ std::min(HALF_CHUNK, n-i) };
+        std::memcpy(halves, src+i*sizeof(uint16_t), cnt*sizeof(uint16_t));
+        halvesToFloats(halves, cnt, dst+i);
+      }
+      break;
+    }
+    case QuantizeMode::None:
+    default:
+      if (src!=reinterpret_cast<char const *>(dst)) {
+        std::memmove(dst, src, n*sizeof(float));
+      }
+      break;
+  }
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+size_t
+BlockQuantizer::bytesPerVoxel(QuantizeMode mode)
+{
+  switch (mode) {
+    case QuantizeMode::U8:
+      return 1;
+    case QuantizeMode::U16:
+    case QuantizeMode::F16:
+    case QuantizeMode::Auto:
+      return 2;
+    case QuantizeMode::None:
+    default:
+      return sizeof(float);
+  }
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+uint16_t
+floatToHalf(float f)
+{
+  uint32_t x;
+  std::memcpy(&x, &f, sizeof(x));
+
+  uint32_t const sign{ ( x >> 16 ) & 0x8000u };
+  uint32_t const absx{ x & 0x7FFFFFFFu };
+
+  // NaN and Inf
+  if (absx>=0x7F800000u) {
+    return static_cast<uint16_t>(sign | 0x7C00u | ( absx>0x7F800000u ? 0x200u : 0u ));
+  }
+
+  // too large, becomes Inf
+  if (absx>=0x477FF000u) {
+    return static_cast<uint16_t>(sign | 0x7C00u);
+  }
+
+  // subnormal half (or zero)
+  if (absx<0x38800000u) {
+    if (absx<0x33000000u) {
+      return static_cast<uint16_t>(sign);
+    }
+    uint32_t const e{ absx >> 23 };
+    uint32_t const m{ ( absx & 0x7FFFFFu ) | 0x800000u };
+    // half subnormals are multiples of 2^-24
+    uint32_t const shift{ 126u-e };
+    uint32_t const half{ m >> shift };
+    uint32_t const rem{ m & (( 1u << shift )-1u ) };
+    uint32_t const mid{ 1u << ( shift-1u ) };
+    uint32_t const round{ ( rem>mid || ( rem==mid && ( half & 1u ))) ? 1u : 0u };
+    return static_cast<uint16_t>(sign | ( half+round ));
+  }
+
+  // normal: rebias exponent and round mantissa to nearest even.
+  uint32_t const h{ ( absx-0x38000000u ) >> 13 };
+  uint32_t const rem{ absx & 0x1FFFu };
+  uint32_t const round{ ( rem>0x1000u || ( rem==0x1000u && ( h & 1u ))) ? 1u : 0u };
+  return static_cast<uint16_t>(sign | ( h+round ));
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+float
+halfToFloat(uint16_t h)
+{
+  uint32_t const sign{ static_cast<uint32_t>(h & 0x8000u) << 16 };
+  uint32_t e{ ( h >> 10 ) & 0x1Fu };
+  uint32_t m{ h & 0x3FFu };
+
+  uint32_t x;
+  if (e==0) {
+    if (m==0) {
+      x = sign;
+    } else {
+      // subnormal: normalize it.
+      e = 127-15+1;
+      while (( m & 0x400u )==0) {
+        m <<= 1;
+        --e;
+      }
+      m &= 0x3FFu;
+      x = sign | ( e << 23 ) | ( m << 13 );
+    }
+  } else if (e==0x1F) {
+    x = sign | 0x7F800000u | ( m << 13 );
+  } else {
+    x = sign | (( e+127-15 ) << 23 ) | ( m << 13 );
+  }
+
+  float f;
+  std::memcpy(&f, &x, sizeof(f));
+  return f;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+void
+floatsToHalves(float const *src, size_t n, uint16_t *dst)
+{
+  size_t i{ 0 };
+#if defined(BD_HAVE_F16C_LOOPS)
+  if (haveF16C()) {
+    i = floatsToHalvesF16C(src, n, dst);
+  }
+#endif
+  for (; i<n; ++i) {
+    dst[i] = floatToHalf(src[i]);
+  }
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+void
+halvesToFloats(uint16_t const *src, size_t n, float *dst)
+{
+  size_t i{ 0 };
+#if defined(BD_HAVE_F16C_LOOPS)
+  if (haveF16C()) {
+    i = halvesToFloatsF16C(src, n, dst);
+  }
+#endif
+  for (; i<n; ++i) {
+    dst[i] = halfToFloat(src[i]);
+  }
+}
+
+} // namespace bd
@@ -101,6 +101,14 @@ Volume::block_dims() const
 }
 
 
+///////////////////////////////////////////////////////////////////////////////
+void
+Volume::block_dims(glm::u64vec3 const &bd)
+{
+  m_blockDims = bd;
+}
+
+
 ///////////////////////////////////////////////////////////////////////////////
 const glm::u64vec3&
 Volume::block_count() const
@@ -0,0 +1,131 @@
+#include <bd/datastructure/atlasallocator.h>
+
+#include <catch.hpp>
+
+#include <set>
+
+
+TEST_CASE("AtlasAllocator capacity math", "[atlasallocator]")
+{
+  // 4x4x2 slots of 32^3 fit in a 128x128x64 atlas.
+  bd::AtlasAllocator a{ { 32, 32, 32 }, { 128, 128, 64 }, 70, 100 };
+
+  REQUIRE(a.slotGrid() == glm::u64vec3(4, 4, 2));
+  REQUIRE(a.slotsPerAtlas() == 32);
+  REQUIRE(a.capacity() == 70);
+  REQUIRE(a.available() == 70);
+  REQUIRE(a.atlasCount() == 3);
+
+  REQUIRE(a.atlasDims(0) == glm::u64vec3(128, 128, 64));
+  REQUIRE(a.atlasDims(1) == glm::u64vec3(128, 128, 64));
+  // 6 slots left over: a 4x2x1 grid of slots.
+  REQUIRE(a.atlasDims(2) == glm::u64vec3(128, 64, 32));
+
+  SECTION("slot larger than max atlas gets its own atlas")
+  {
+    bd::AtlasAllocator b{ { 64, 64, 64 }, { 32, 32, 32 }, 3, 3 };
+    REQUIRE(b.slotsPerAtlas() == 1);
+    REQUIRE(b.atlasCount() == 3);
+    REQUIRE(b.atlasDims(2) == glm::u64vec3(64, 64, 64));
+  }
+
+  SECTION("zero slots")
+  {
+    bd::AtlasAllocator b;
+    REQUIRE(b.capacity() == 0);
+    REQUIRE(b.atlasCount() == 0);
+    REQUIRE(b.available() == 0);
+  }
+}
+
+
+TEST_CASE("AtlasAllocator slot layout", "[atlasallocator]")
+{
+  bd::AtlasAllocator a{ { 16, 8, 4 }, { 64, 32, 8 }, 64, 64 };
+  // grid is 4x4x2 = 32 slots per atlas, 2 atlases.
+  REQUIRE(a.atlasCount() == 2);
+
+  REQUIRE(a.voxelOffset(0) == glm::u64vec3(0, 0, 0));
+  REQUIRE(a.voxelOffset(1) == glm::u64vec3(16, 0, 0));
+  REQUIRE(a.voxelOffset(4) == glm::u64vec3(0, 8, 0));
+  REQUIRE(a.voxelOffset(16) == glm::u64vec3(0, 0, 4));
+  REQUIRE(a.atlasOf(31) == 0);
+  REQUIRE(a.atlasOf(32) == 1);
+  REQUIRE(a.voxelOffset(33) == glm::u64vec3(16, 0, 0));
+
+  // [0,1] maps to the first and last texel centers of the slot.
+  glm::vec3 const off{ a.texOffset(5) };
+  glm::vec3 const scl{ a.texScale(5) };
+  glm::vec3 const lo{ off };
+  glm::vec3 const hi{ off + scl };
+  REQUIRE(lo.x == Approx(( 16 + 0.5 ) / 64.0));
+  REQUIRE(lo.y == Approx(( 8 + 0.5 ) / 32.0));
+  REQUIRE(lo.z == Approx(0.5 / 8.0));
+  REQUIRE(hi.x == Approx(( 32 - 0.5 ) / 64.0));
+  REQUIRE(hi.y == Approx(( 16 - 0.5 ) / 32.0));
+  REQUIRE(hi.z == Approx(( 4 - 0.5 ) / 8.0));
+
+  // a block filling only part of the slot ends at its own last texel.
+  glm::vec3 const part{ off + a.texScale(5, { 10, 8, 2 }) };
+  REQUIRE(part.x == Approx(( 16 + 10 - 0.5 ) / 64.0));
+  REQUIRE(part.y == Approx(( 8 + 8 - 0.5 ) / 32.0));
+  REQUIRE(part.z == Approx(( 2 - 0.5 ) / 8.0));
+}
+
+
+TEST_CASE("AtlasAllocator acquire and release", "[atlasallocator]")
+{
+  bd::AtlasAllocator a{ { 8, 8, 8 }, { 16, 16, 16 }, 16, 100 };
+  // 8 slots per atlas, 2 atlases.
+
+  std::set<uint32_t> slots;
+  for (uint64_t id{ 0 }; id < 16; ++id) {
+    uint32_t s{ a.acquire(id * 5) };
+    REQUIRE(s == id);  // lowest free slot first
+    slots.insert(s);
+  }
+  REQUIRE(slots.size() == 16);
+  REQUIRE(a.available() == 0);
+  REQUIRE(a.acquire(99) == bd::AtlasAllocator::NO_SLOT);
+
+  // acquiring again for a resident id returns its slot.
+  REQUIRE(a.acquire(10) == 2);
+  REQUIRE(a.slotOf(10) == 2);
+  REQUIRE(a.slotOf(11) == bd::AtlasAllocator::NO_SLOT);
+
+  SECTION("released slots are reused lowest first")
+  {
+    REQUIRE(a.release(50));   // slot 10
+    REQUIRE(a.release(10));   // slot 2
+    REQUIRE_FALSE(a.release(10));
+    REQUIRE(a.used() == 14);
+    REQUIRE(a.usedInAtlas(0) == 7);
+    REQUIRE(a.usedInAtlas(1) == 7);
+
+    REQUIRE(a.acquire(99) == 2);
+    REQUIRE(a.acquire(98) == 10);
+  }
+
+  SECTION("fragmentation")
+  {
+    REQUIRE(a.fragmentation() == Approx(0.0));
+
+    // free half of atlas 1: 4 of 8 touched-atlas slots are holes in atlas 1.
+    for (uint64_t id{ 8 }; id < 12; ++id) {
+      a.release(id * 5);
+    }
+    REQUIRE(a.fragmentation() == Approx(4.0 / 16.0));
+
+    // empty atlas 1 completely: it no longer counts.
+    for (uint64_t id{ 12 }; id < 16; ++id) {
+      a.release(id * 5);
+    }
+    REQUIRE(a.fragmentation() == Approx(0.0));
+
+    a.releaseAll();
+    REQUIRE(a.used() == 0);
+    REQUIRE(a.available() == 16);
+    REQUIRE(a.fragmentation() == Approx(0.0));
+    REQUIRE(a.acquire(7) == 0);
+  }
+}
@@ -0,0 +1,180 @@
+#include <bd/datastructure/bufferarena.h>
+
+#include <catch.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+
+
+namespace
+{
+
+/// \brief Free pages in the explicit huge page pool, 0 if there is none.
+uint64_t
+hugePagesFree()
+{
+  std::ifstream meminfo{ "/proc/meminfo" };
+  std::string key;
+  uint64_t value{ 0 };
+  while (meminfo >> key >> value) {
+    if (key == "HugePages_Free:") {
+      return value;
+    }
+    meminfo.ignore(256, '\n');
+  }
+  return 0;
+}
+
+} // namespace
+
+
+TEST_CASE("BufferArena commits slices as buffers are first used",
+          "[bufferarena]")
+{
+  // 64 buffers of 1 MiB, two buffers to a 2 MiB slice.
+  size_t const MiB{ 1024 * 1024 };
+  bd::BufferArena arena{ "test", MiB, 64, bd::HugePages::None };
+  REQUIRE(arena.count() == 64);
+  REQUIRE(arena.bufferBytes() == MiB);
+
+  bd::BufferArena::Usage u{ arena.usage() };
+  REQUIRE(u.reservedBytes == 64 * MiB);
+  REQUIRE(u.committedBytes == 0);
+  REQUIRE(u.slices == 32);
+
+  for (size_t i{ 1 }; i < arena.count(); ++i) {
+    REQUIRE(arena.buffer(i) - arena.buffer(i - 1) == MiB);
+    REQUIRE_FALSE(arena.committed(i));
+  }
+
+  arena.commit(arena.buffer(5));
+  std::memset(arena.buffer(5), 'a', MiB);
+  REQUIRE(arena.committed(5));
+  // buffer 4 shares the slice.
+  REQUIRE(arena.committed(4));
+  REQUIRE_FALSE(arena.committed(6));
+  REQUIRE(arena.usage().committedBytes == 2 * MiB);
+
+  // committing again is free.
+  arena.commit(5);
+  arena.commit(4);
+  REQUIRE(arena.usage().committedSlices == 1);
+  REQUIRE(arena.buffer(5)[MiB - 1] == 'a');
+
+  std::ostringstream report;
+  report << arena.usage();
+  REQUIRE(report.str().find("test: 64 buffers") == 0);
+}
+
+
+TEST_CASE("BufferArena buffers may straddle slices", "[bufferarena]")
+{
+  // 3 MiB buffers, the second starts in the middle of slice 1.
+  size_t const bytes{ 3 * 1024 * 1024 };
+  bd::BufferArena arena{ "odd", bytes, 4, bd::HugePages::Transparent, true };
+
+  arena.commit(1);
+  REQUIRE(arena.committed(1));
+  REQUIRE(arena.usage().committedSlices == 2);
+  std::memset(arena.buffer(1), 'b', bytes);
+
+  // huge pages and node binding are best effort.
+  bd::BufferArena::Usage const u{ arena.usage() };
+  REQUIRE(u.hugePages != bd::HugePages::Explicit);
+  uint64_t bound{ 0 };
+  for (uint64_t b : u.nodeBytes) {
+    bound += b;
+  }
+  REQUIRE(( bound == 0 || bound == u.committedBytes ));
+}
+
+
+TEST_CASE("BufferArena falls back when the huge page pool is too small",
+          "[bufferarena]")
+{
+  // One 2 MiB buffer more than the pool has free pages for.
+  size_t const bytes{ 2 * 1024 * 1024 };
+  size_t const count{ hugePagesFree() + 1 };
+  bd::BufferArena arena{ "pool", bytes, count, bd::HugePages::Explicit };
+  REQUIRE(arena.usage().hugePages != bd::HugePages::Explicit);
+
+  // the last buffer is past the pool, writing it must not fault.
+  arena.commit(count - 1);
+  std::memset(arena.buffer(count - 1), 'd', bytes);
+  arena.commit(size_t{ 0 });
+  std::memset(arena.buffer(0), 'd', bytes);
+  REQUIRE(arena.buffer(count - 1)[bytes - 1] == 'd');
+}
+
+
+TEST_CASE("BufferArena reserves large budgets up front for free",
+          "[bufferarena]")
+{
+  // 32 GiB of 256 KiB buffers, more than there likely is memory for.
+  size_t const count{ 128 * 1024 };
+  auto start = std::chrono::high_resolution_clock::now();
+  bd::BufferArena arena{ "big", 256 * 1024, count };
+  double const ms{ std::chrono::duration<double, std::milli>(
+      std::chrono::high_resolution_clock::now() - start).count() };
+
+  REQUIRE(arena.usage().committedBytes == 0);
+  REQUIRE(arena.usage().slices <= 4096);
+  arena.commit(count - 1);
+  arena.buffer(count - 1)[0] = 'c';
+  REQUIRE(arena.usage().committedBytes == arena.usage().sliceBytes);
+  REQUIRE(ms < 1000.0);
+}
+
+
+TEST_CASE("BufferArena first fill, base vs huge pages vs new[]",
+          "[.][bench][bufferarena]")
+{
+  size_t const bytes{ 256 * 1024 };
+  size_t const count{ 4096 };
+
+  // first touch times are noisy, keep the best of a few runs.
+  int const RUNS{ 3 };
+  auto best = [&](std::function<double()> f) -> double {
+    double ms{ f() };
+    for (int r{ 1 }; r < RUNS; ++r) {
+      ms = std::min(ms, f());
+    }
+    return ms;
+  };
+
+  auto fill = [&](bd::HugePages hp) -> double {
+    bd::BufferArena arena{ "bench", bytes, count, hp };
+    auto start = std::chrono::high_resolution_clock::now();
+    for (size_t i{ 0 }; i < count; ++i) {
+      arena.commit(i);
+      std::memset(arena.buffer(i), 1, bytes);
+    }
+    return std::chrono::duration<double, std::milli>(
+        std::chrono::high_resolution_clock::now() - start).count();
+  };
+
+  auto plain = [&]() -> double {
+    auto start = std::chrono::high_resolution_clock::now();
+    std::unique_ptr<char[]> mem{ new char[bytes * count] };
+    for (size_t i{ 0 }; i < count; ++i) {
+      std::memset(mem.get() + i * bytes, 1, bytes);
+    }
+    return std::chrono::duration<double, std::milli>(
+        std::chrono::high_resolution_clock::now() - start).count();
+  };
+
+  double const newMs{ best(plain) };
+  double const none{ best([&]() { return fill(bd::HugePages::None); }) };
+  double const thp{ best([&]() { return fill(bd::HugePages::Transparent); }) };
+
+  std::cout << "First fill of " << count << " x " << bytes << " bytes: new[] "
+            << newMs << " ms, arena " << none << " ms, arena (thp) " << thp
+            << " ms" << std::endl;
+}
@@ -0,0 +1,103 @@
+#include <bd/datastructure/indexedheap.h>
+
+#include <catch.hpp>
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+
+TEST_CASE("IndexedHeap pops in priority order", "[indexedheap]")
+{
+  bd::IndexedHeap<double> h{ 1000 };
+  REQUIRE(h.empty());
+  REQUIRE(h.capacity() == 1000);
+
+  std::mt19937 rng{ 42 };
+  std::uniform_real_distribution<double> dist{ 0.0, 1.0 };
+  std::vector<double> prio(1000);
+  for (uint64_t id{ 0 }; id < 1000; ++id) {
+    prio[id] = dist(rng);
+    REQUIRE(h.push(id, prio[id]));
+  }
+  REQUIRE(h.size() == 1000);
+  REQUIRE(h.priority(17) == prio[17]);
+
+  double last{ 2.0 };
+  while (!h.empty()) {
+    double const p{ h.topPriority() };
+    uint64_t const id{ h.pop() };
+    REQUIRE(prio[id] == p);
+    REQUIRE(p <= last);
+    REQUIRE_FALSE(h.contains(id));
+    last = p;
+  }
+}
+
+
+TEST_CASE("IndexedHeap update and erase", "[indexedheap]")
+{
+  bd::IndexedHeap<int, 3> h{ 50 };
+  for (uint64_t id{ 0 }; id < 50; ++id) {
+    h.push(id, static_cast<int>(id));
+  }
+  REQUIRE(h.top() == 49);
+
+  SECTION("increase key moves an id to the top")
+  {
+    REQUIRE_FALSE(h.push(3, 100));
+    REQUIRE(h.size() == 50);
+    REQUIRE(h.top() == 3);
+  }
+
+  SECTION("decrease key moves the top down")
+  {
+    h.update(49, -1);
+    REQUIRE(h.top() == 48);
+    REQUIRE(h.priority(49) == -1);
+  }
+
+  SECTION("erase from the middle keeps heap order")
+  {
+    for (uint64_t id{ 0 }; id < 50; id += 2) {
+      REQUIRE(h.erase(id));
+    }
+    REQUIRE_FALSE(h.erase(0));
+    REQUIRE(h.size() == 25);
+
+    int last{ 100 };
+    while (!h.empty()) {
+      uint64_t const id{ h.pop() };
+      REQUIRE(id % 2 == 1);
+      REQUIRE(static_cast<int>(id) < last);
+      last = static_cast<int>(id);
+    }
+  }
+
+  SECTION("clear keeps capacity")
+  {
+    h.clear();
+    REQUIRE(h.empty());
+    REQUIRE_FALSE(h.contains(10));
+    REQUIRE(h.push(10, 1));
+    REQUIRE(h.top() == 10);
+  }
+}
+
+
+TEST_CASE("IndexedHeap scan by position", "[indexedheap]")
+{
+  bd::IndexedHeap<float> h{ 20 };
+  for (uint64_t id{ 5 }; id < 15; ++id) {
+    h.push(id, static_cast<float>(id % 4));
+  }
+
+  std::vector<uint64_t> ids;
+  for (size_t i{ 0 }; i < h.size(); ++i) {
+    ids.push_back(h.idAt(i));
+  }
+  std::sort(ids.begin(), ids.end());
+  REQUIRE(ids.size() == 10);
+  REQUIRE(ids.front() == 5);
+  REQUIRE(ids.back() == 14);
+}
@@ -0,0 +1,169 @@
+#include <bd/datastructure/intervaltree.h>
+
+#include <catch.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <vector>
+
+namespace
+{
+
+using Tree = bd::IntervalTree<int>;
+
+
+std::vector<Tree::Interval>
+randomIntervals(size_t n, unsigned seed)
+{
+  std::mt19937 rng{ seed };
+  std::uniform_real_distribution<double> start{ 0.0, 1.0 };
+  std::exponential_distribution<double> length{ 20.0 };
+  std::vector<Tree::Interval> intervals;
+  for (size_t i{ 0 }; i < n; ++i) {
+    double const lo{ start(rng) };
+    intervals.push_back({ lo, lo + length(rng), static_cast<int>(i) });
+  }
+  return intervals;
+}
+
+
+std::vector<int>
+query(Tree const &t, double a, double b)
+{
+  std::vector<int> found;
+  t.overlap(a, b, [&found](int v) { found.push_back(v); });
+  std::sort(found.begin(), found.end());
+  return found;
+}
+
+
+std::vector<int>
+scan(std::vector<Tree::Interval> const &intervals, double a, double b)
+{
+  std::vector<int> found;
+  for (Tree::Interval const &i : intervals) {
+    if (i.low <= b && i.high >= a && i.low <= i.high && a <= b) {
+      found.push_back(i.value);
+    }
+  }
+  std::sort(found.begin(), found.end());
+  return found;
+}
+
+} // namespace
+
+
+TEST_CASE("IntervalTree overlap matches a linear scan", "[intervaltree]")
+{
+  std::vector<Tree::Interval> intervals{ randomIntervals(5000, 7) };
+  Tree t;
+  t.build(intervals);
+  REQUIRE(t.size() == intervals.size());
+
+  double const windows[][2]{
+      { 0.0, 1.0 }, { 0.25, 0.3 }, { 0.5, 0.5 }, { 0.999, 2.0 },
+      { -1.0, -0.5 }, { 0.6, 0.4 }, { 1.5, 9.0 } };
+  for (auto const &w : windows) {
+    REQUIRE(query(t, w[0], w[1]) == scan(intervals, w[0], w[1]));
+  }
+
+  std::mt19937 rng{ 3 };
+  std::uniform_real_distribution<double> dist{ -0.1, 1.1 };
+  for (int i{ 0 }; i < 200; ++i) {
+    double const a{ dist(rng) };
+    double const b{ a + dist(rng) * 0.1 };
+    REQUIRE(query(t, a, b) == scan(intervals, a, b));
+  }
+}
+
+
+TEST_CASE("IntervalTree stab finds the intervals containing a value",
+          "[intervaltree]")
+{
+  std::vector<Tree::Interval> intervals{
+      { 0.0, 1.0, 0 }, { 0.5, 0.5, 1 }, { 0.2, 0.6, 2 }, { 0.7, 0.9, 3 },
+      { 0.5, 2.0, 4 } };
+  Tree t;
+  t.build(intervals);
+
+  std::vector<int> found;
+  t.stab(0.5, [&found](int v) { found.push_back(v); });
+  std::sort(found.begin(), found.end());
+  REQUIRE(found == std::vector<int>({ 0, 1, 2, 4 }));
+
+  found.clear();
+  t.stab(1.0, [&found](int v) { found.push_back(v); });
+  std::sort(found.begin(), found.end());
+  REQUIRE(found == std::vector<int>({ 0, 4 }));
+
+  found.clear();
+  t.stab(3.0, [&found](int v) { found.push_back(v); });
+  REQUIRE(found.empty());
+}
+
+
+TEST_CASE("IntervalTree leaves out intervals with no values", "[intervaltree]")
+{
+  // how a FileBlock's min/max look when the index file has no values.
+  std::vector<Tree::Interval> intervals{
+      { std::numeric_limits<double>::max(),
+        std::numeric_limits<double>::lowest(), 0 },
+      { 0.1, 0.2, 1 } };
+  Tree t;
+  t.build(intervals);
+  REQUIRE(t.size() == 1);
+  REQUIRE(query(t, std::numeric_limits<double>::lowest(),
+                std::numeric_limits<double>::max()) == std::vector<int>({ 1 }));
+
+  Tree empty;
+  REQUIRE(empty.size() == 0);
+  REQUIRE(query(empty, 0.0, 1.0).empty());
+}
+
+
+TEST_CASE("IntervalTree vs linear scan for isovalue queries at 884k blocks",
+          "[.][bench][intervaltree]")
+{
+  size_t const NUM_BLOCKS{ 884736 };
+  int const STEPS{ 100 };
+
+  std::vector<Tree::Interval> intervals{ randomIntervals(NUM_BLOCKS, 11) };
+  Tree t;
+  auto start = std::chrono::high_resolution_clock::now();
+  t.build(intervals);
+  double const msBuild{ std::chrono::duration<double, std::milli>(
+      std::chrono::high_resolution_clock::now() - start).count() };
+
+  size_t scanned{ 0 };
+  start = std::chrono::high_resolution_clock::now();
+  for (int i{ 0 }; i < STEPS; ++i) {
+    double const iso{ 0.2 + i * 0.005 };
+    for (Tree::Interval const &iv : intervals) {
+      if (iv.low <= iso && iv.high >= iso) {
+        ++scanned;
+      }
+    }
+  }
+  double const msScan{ std::chrono::duration<double, std::milli>(
+      std::chrono::high_resolution_clock::now() - start).count() / STEPS };
+
+  size_t found{ 0 };
+  start = std::chrono::high_resolution_clock::now();
+  for (int i{ 0 }; i < STEPS; ++i) {
+    double const iso{ 0.2 + i * 0.005 };
+    t.stab(iso, [&found](int) { ++found; });
+  }
+  double const msTree{ std::chrono::duration<double, std::milli>(
+      std::chrono::high_resolution_clock::now() - start).count() / STEPS };
+
+  REQUIRE(found == scanned);
+
+  std::cout << "isovalue queries, " << NUM_BLOCKS << " blocks\n"
+            << "  tree build:           " << msBuild << " ms\n"
+            << "  linear scan per query: " << msScan << " ms\n"
+            << "  tree stab per query:   " << msTree << " ms ("
+            << found / STEPS << " blocks per query)" << std::endl;
+}
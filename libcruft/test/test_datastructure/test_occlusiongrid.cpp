@@ -0,0 +1,146 @@
+#include <bd/datastructure/occlusiongrid.h>
+#include <glm/glm.hpp>
+#include <catch.hpp>
+
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <vector>
+
+TEST_CASE("OcclusionGrid clear grid is fully visible", "[occlusiongrid]")
+{
+  bd::OcclusionGrid g{ { 5, 4, 3 }, { 0.0f, 0.0f, 0.0f }, { 1.0f, 1.0f, 1.0f }};
+  REQUIRE(g.valid());
+  REQUIRE_FALSE(bd::OcclusionGrid{ }.valid());
+  REQUIRE(g.size() == 60);
+  REQUIRE(g.index({ 1, 2, 1 }) == 1 + 5 * ( 2 + 4 * 1 ));
+
+  std::vector<float> const clear(g.size(), 0.0f);
+  std::vector<float> t;
+  for (glm::vec3 eye : { glm::vec3{ 2.5f, 2.5f, 1.5f },
+                         glm::vec3{ -3.0f, 1.0f, 10.0f }}) {
+    g.transmittance(clear, eye, t, 1);
+    REQUIRE(t.size() == g.size());
+    for (float v : t) {
+      REQUIRE(v == Approx(1.0f));
+    }
+  }
+}
+
+
+TEST_CASE("OcclusionGrid along a row of cells", "[occlusiongrid]")
+{
+  // the eye is in line with the row's cell centers, so the light from each
+  // cell only goes through the cells before it.
+  bd::OcclusionGrid g{ { 6, 1, 1 }, { 0.0f, 0.0f, 0.0f }, { 1.0f, 1.0f, 1.0f }};
+  std::vector<float> const half(g.size(), 0.5f);
+  std::vector<float> t;
+
+  g.transmittance(half, { -2.0f, 0.5f, 0.5f }, t, 1);
+  for (size_t x{ 0 }; x < 6; ++x) {
+    REQUIRE(t[x] == Approx(std::pow(0.5f, static_cast<float>(x))));
+  }
+
+  // from inside of the grid both ways.
+  g.transmittance(half, { 2.5f, 0.5f, 0.5f }, t, 1);
+  std::vector<float> const expected{ 0.25f, 0.5f, 1.0f, 0.5f, 0.25f, 0.125f };
+  for (size_t x{ 0 }; x < 6; ++x) {
+    REQUIRE(t[x] == Approx(expected[x]));
+  }
+}
+
+
+TEST_CASE("OcclusionGrid opaque wall hides what is behind it",
+          "[occlusiongrid]")
+{
+  glm::u64vec3 const dims{ 8, 8, 8 };
+  bd::OcclusionGrid g{ dims, { 0.0f, 0.0f, 0.0f }, { 1.0f, 1.0f, 1.0f }};
+  std::vector<float> opacity(g.size(), 0.0f);
+  for (uint64_t y{ 0 }; y < dims.y; ++y) {
+    for (uint64_t x{ 0 }; x < dims.x; ++x) {
+      opacity[g.index({ x, y, 3 })] = 1.0f;
+    }
+  }
+
+  std::vector<float> t;
+  g.transmittance(opacity, { 4.0f, 4.0f, -5.0f }, t, 3);
+  for (uint64_t z{ 0 }; z < dims.z; ++z) {
+    for (uint64_t y{ 0 }; y < dims.y; ++y) {
+      for (uint64_t x{ 0 }; x < dims.x; ++x) {
+        float const v{ t[g.index({ x, y, z })] };
+        if (z < 3) {
+          REQUIRE(v == Approx(1.0f));
+        } else if (z > 3) {
+          REQUIRE(v == Approx(0.0f));
+        }
+      }
+    }
+  }
+}
+
+
+TEST_CASE("OcclusionGrid gives the same result on any number of threads",
+          "[occlusiongrid]")
+{
+  glm::u64vec3 const dims{ 13, 17, 11 };
+  bd::OcclusionGrid g{ dims, { -1.0f, -1.0f, -1.0f }, { 0.2f, 0.1f, 0.3f }};
+  std::mt19937 gen{ 5 };
+  std::uniform_real_distribution<float> dist{ 0.0f, 0.4f };
+  std::vector<float> opacity(g.size());
+  for (float &a : opacity) {
+    a = dist(gen);
+  }
+
+  for (glm::vec3 eye : { glm::vec3{ 0.1f, 0.4f, 0.9f },
+                         glm::vec3{ 5.0f, -4.0f, 2.0f },
+                         glm::vec3{ 0.0f, 0.7f, -3.0f }}) {
+    std::vector<float> one;
+    g.transmittance(opacity, eye, one, 1);
+    for (unsigned threads : { 2u, 4u, 64u }) {
+      std::vector<float> many;
+      g.transmittance(opacity, eye, many, threads);
+      REQUIRE(many == one);
+    }
+  }
+}
+
+
+TEST_CASE("OcclusionGrid at 96^3 cells", "[.][bench][occlusiongrid]")
+{
+  int const STEPS{ 20 };
+  glm::u64vec3 const dims{ 96, 96, 96 };
+  bd::OcclusionGrid g{ dims, glm::vec3{ -0.5f }, glm::vec3{ 1.0f / 96 }};
+
+  // a thick shell around the center.
+  std::vector<float> opacity(g.size(), 0.0f);
+  for (uint64_t z{ 0 }; z < dims.z; ++z) {
+    for (uint64_t y{ 0 }; y < dims.y; ++y) {
+      for (uint64_t x{ 0 }; x < dims.x; ++x) {
+        glm::vec3 const p{ ( glm::vec3(x, y, z) + 0.5f ) / 96.0f - 0.5f };
+        float const r{ glm::length(p) };
+        opacity[g.index({ x, y, z })] = r > 0.35f && r < 0.4f ? 0.8f : 0.05f;
+      }
+    }
+  }
+
+  std::vector<float> t;
+  for (unsigned threads : { 1u, 4u, 8u }) {
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int i{ 0 }; i < STEPS; ++i) {
+      float const a{ 0.1f * i };
+      g.transmittance(opacity, { 2.0f * std::cos(a), 0.3f, 2.0f * std::sin(a) },
+                      t, threads);
+    }
+    double const ms{ std::chrono::duration<double, std::milli>(
+        std::chrono::high_resolution_clock::now() - start).count() / STEPS };
+
+    size_t hidden{ 0 };
+    for (float v : t) {
+      hidden += v < 1.0f / 256 ? 1 : 0;
+    }
+    std::cout << "occlusion grid, " << g.size() << " cells, " << threads
+              << " threads: " << ms << " ms (" << hidden << " hidden)"
+              << std::endl;
+  }
+}
@@ -3,30 +3,383 @@
 //
 
 #include <bd/datastructure/octree.h>
+#include <bd/geo/frustum.h>
 #include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
 #include <catch.hpp>
 
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <vector>
+
 namespace
 {
 
+using Leaf = bd::Octree::Leaf;
+
+
+/// A smooth field: values grow with the distance from the grid center and
+/// ROV falls off with it, plus a little noise.
+std::vector<Leaf>
+smoothLeaves(glm::u64vec3 const &dims, unsigned seed)
+{
+  std::mt19937 rng{ seed };
+  std::uniform_real_distribution<float> noise{ -0.01f, 0.01f };
+  glm::vec3 const center{ glm::vec3(dims)*0.5f };
+  float const radius{ glm::length(center) };
+
+  std::vector<Leaf> leaves;
+  for (uint64_t k{ 0 }; k < dims.z; ++k) {
+    for (uint64_t j{ 0 }; j < dims.y; ++j) {
+      for (uint64_t i{ 0 }; i < dims.x; ++i) {
+        glm::vec3 const p{ i + 0.5f, j + 0.5f, k + 0.5f };
+        float const v{ glm::length(p - center) / radius + noise(rng) };
+        leaves.push_back({ v - 0.02f, v + 0.02f, v, 1.0f - v });
+      }
+    }
+  }
+  return leaves;
 }
 
 
+std::vector<Leaf>
+randomLeaves(size_t n, unsigned seed)
+{
+  std::mt19937 rng{ seed };
+  std::uniform_real_distribution<float> dist{ 0.0f, 1.0f };
+  std::vector<Leaf> leaves;
+  for (size_t i{ 0 }; i < n; ++i) {
+    float const a{ dist(rng) };
+    float const b{ dist(rng) };
+    leaves.push_back({ std::min(a, b), std::max(a, b), ( a + b ) * 0.5f,
+                       dist(rng) });
+  }
+  return leaves;
+}
+
 
-TEST_CASE("testit")
+std::vector<uint64_t>
+valueScan(std::vector<Leaf> const &leaves, double a, double b)
 {
-//  bd::Octree<char> *tree{
-//      new bd::Octree<char>{ glm::vec3{0,0,0}, glm::vec3{50,50,50}, 10 } };
-//
-//  char one{ 1 };
-//  char two{ 2 };
-//  char three{ 3 };
-//
-//  tree->insert(one,   { -25, 25, 25 });
-//  tree->insert(two,   { 25, -25, 25 });
-//  tree->insert(three, { 25, 25, -25 });
-//
-//  tree->insert(three, { 25, 25, -25 });
+  std::vector<uint64_t> found;
+  for (uint64_t i{ 0 }; i < leaves.size(); ++i) {
+    if (a <= b && leaves[i].max >= a && leaves[i].min <= b &&
+        leaves[i].min <= leaves[i].max) {
+      found.push_back(i);
+    }
+  }
+  return found;
+}
+
 
+std::vector<uint64_t>
+rovScan(std::vector<Leaf> const &leaves, double low, double high)
+{
+  std::vector<uint64_t> found;
+  for (uint64_t i{ 0 }; i < leaves.size(); ++i) {
+    if (leaves[i].rov >= low && leaves[i].rov <= high) {
+      found.push_back(i);
+    }
+  }
+  return found;
+}
+
+
+std::vector<uint64_t>
+valueQuery(bd::Octree const &t, double a, double b)
+{
+  std::vector<uint64_t> found;
+  t.forEachInValueRange(a, b, [&found](uint64_t i) { found.push_back(i); });
+  std::sort(found.begin(), found.end());
+  return found;
+}
+
+
+std::vector<uint64_t>
+rovQuery(bd::Octree const &t, double low, double high)
+{
+  std::vector<uint64_t> found;
+  t.forEachInRovRange(low, high, [&found](uint64_t i) { found.push_back(i); });
+  std::sort(found.begin(), found.end());
+  return found;
+}
+
+} // namespace
+
+
+TEST_CASE("Octree levels halve the grid down to one root", "[octree]")
+{
+  glm::u64vec3 const dims{ 5, 3, 7 };
+  bd::Octree t;
+  t.build(dims, randomLeaves(5 * 3 * 7, 1));
+
+  REQUIRE(t.leafCount() == 5 * 3 * 7);
+  REQUIRE(t.levels() == 4);
+  REQUIRE(t.levelDims(0) == dims);
+  REQUIRE(t.levelDims(1) == glm::u64vec3(3, 2, 4));
+  REQUIRE(t.levelDims(2) == glm::u64vec3(2, 1, 2));
+  REQUIRE(t.levelDims(3) == glm::u64vec3(1, 1, 1));
+  REQUIRE(t.root().count == 5 * 3 * 7);
+
+  SECTION("empty grid")
+  {
+    bd::Octree e;
+    e.build({ 0, 0, 0 }, { });
+    REQUIRE(e.levels() == 0);
+    REQUIRE(e.leafCount() == 0);
+    REQUIRE(valueQuery(e, 0.0, 1.0).empty());
+  }
+
+  SECTION("single block")
+  {
+    bd::Octree one;
+    one.build({ 1, 1, 1 }, { { 0.25f, 0.5f, 0.3f, 0.9f } });
+    REQUIRE(one.levels() == 1);
+    REQUIRE(one.root().max == 0.5f);
+    REQUIRE(valueQuery(one, 0.4, 0.45) == std::vector<uint64_t>({ 0 }));
+  }
+}
+
+
+TEST_CASE("Octree aggregates cover the blocks under each node", "[octree]")
+{
+  glm::u64vec3 const dims{ 9, 6, 4 };
+  std::vector<Leaf> leaves{ randomLeaves(9 * 6 * 4, 2) };
+  bd::Octree t;
+  t.build(dims, leaves);
+
+  bd::Octree::Node const &r{ t.root() };
+  float mn{ 1 }, mx{ 0 }, mnRov{ 1 }, mxRov{ 0 };
+  double sum{ 0 };
+  for (Leaf const &l : leaves) {
+    mn = std::min(mn, l.min);
+    mx = std::max(mx, l.max);
+    mnRov = std::min(mnRov, l.rov);
+    mxRov = std::max(mxRov, l.rov);
+    sum += l.avg;
+  }
+  REQUIRE(r.min == mn);
+  REQUIRE(r.max == mx);
+  REQUIRE(r.minRov == mnRov);
+  REQUIRE(r.maxRov == mxRov);
+  REQUIRE(r.avg == Approx(sum / leaves.size()));
+
+  // a level 1 node against the up-to-8 blocks it covers.
+  bd::Octree::Node const &n{ t.node(1, { 4, 2, 1 }) };
+  REQUIRE(n.count == 1 * 2 * 2);
+  float nmx{ 0 };
+  for (uint64_t k{ 2 }; k < 4; ++k) {
+    for (uint64_t j{ 4 }; j < 6; ++j) {
+      nmx = std::max(nmx, leaves[8 + 9 * ( j + 6 * k )].max);
+    }
+  }
+  REQUIRE(n.max == nmx);
+}
 
-}
\ No newline at end of file
+
+TEST_CASE("Octree range queries match a flat scan", "[octree]")
+{
+  for (glm::u64vec3 const dims : { glm::u64vec3{ 16, 16, 16 },
+                                   glm::u64vec3{ 13, 7, 10 } }) {
+    size_t const n{ dims.x * dims.y * dims.z };
+    std::vector<std::vector<Leaf>> const fields{ smoothLeaves(dims, 3),
+                                                 randomLeaves(n, 4) };
+    for (std::vector<Leaf> const &leaves : fields) {
+      bd::Octree t;
+      t.build(dims, leaves);
+
+      double const windows[][2]{
+          { 0.0, 1.0 }, { 0.3, 0.32 }, { 0.5, 0.5 }, { 0.9, 2.0 },
+          { -1.0, -0.5 }, { 0.6, 0.4 } };
+      for (auto const &w : windows) {
+        REQUIRE(valueQuery(t, w[0], w[1]) == valueScan(leaves, w[0], w[1]));
+        REQUIRE(rovQuery(t, w[0], w[1]) == rovScan(leaves, w[0], w[1]));
+      }
+    }
+  }
+}
+
+
+TEST_CASE("Octree leaves out blocks without values", "[octree]")
+{
+  std::vector<Leaf> leaves{ randomLeaves(4 * 4 * 4, 5) };
+  leaves[17].min = std::numeric_limits<float>::max();
+  leaves[17].max = std::numeric_limits<float>::lowest();
+  bd::Octree t;
+  t.build({ 4, 4, 4 }, leaves);
+
+  std::vector<uint64_t> const all{ valueQuery(t, -1.0, 2.0) };
+  REQUIRE(all.size() == leaves.size() - 1);
+  REQUIRE(std::find(all.begin(), all.end(), 17) == all.end());
+}
+
+
+TEST_CASE("Octree query with a spatial test", "[octree]")
+{
+  // keep the blocks in x < 3, like a clip plane would.
+  glm::u64vec3 const dims{ 7, 5, 6 };
+  bd::Octree t;
+  t.build(dims, randomLeaves(7 * 5 * 6, 6));
+
+  size_t tests{ 0 };
+  std::vector<uint64_t> found;
+  t.query([&tests](bd::Octree::Node const &, glm::u64vec3 const &lo,
+                   glm::u64vec3 const &hi) {
+            ++tests;
+            if (lo.x >= 3) {
+              return bd::Octree::Overlap::None;
+            }
+            return hi.x <= 3 ? bd::Octree::Overlap::All
+                             : bd::Octree::Overlap::Partial;
+          },
+          [&found](uint64_t i) { found.push_back(i); });
+  std::sort(found.begin(), found.end());
+
+  std::vector<uint64_t> expect;
+  for (uint64_t i{ 0 }; i < 7 * 5 * 6; ++i) {
+    if (i % 7 < 3) {
+      expect.push_back(i);
+    }
+  }
+  REQUIRE(found == expect);
+  REQUIRE(tests < 7 * 5 * 6);
+}
+
+
+TEST_CASE("Octree vs flat scan at 24^3, 64^3 and 96^3 blocks",
+          "[.][bench][octree]")
+{
+  int const STEPS{ 20 };
+
+  for (uint64_t side : { 24, 64, 96 }) {
+    glm::u64vec3 const dims{ side, side, side };
+    std::vector<Leaf> leaves{ smoothLeaves(dims, 7) };
+
+    bd::Octree t;
+    auto start = std::chrono::high_resolution_clock::now();
+    t.build(dims, leaves);
+    double const msBuild{ std::chrono::duration<double, std::milli>(
+        std::chrono::high_resolution_clock::now() - start).count() };
+
+    auto msPerStep = [STEPS](std::function<void(int)> const &step) {
+      auto start = std::chrono::high_resolution_clock::now();
+      for (int i{ 0 }; i < STEPS; ++i) {
+        step(i);
+      }
+      return std::chrono::duration<double, std::milli>(
+          std::chrono::high_resolution_clock::now() - start).count() / STEPS;
+    };
+
+    // an isovalue sweep (thin value shells) and a high ROV threshold.
+    auto iso = [](int i) { return 0.3 + i * 0.01; };
+    auto rovLow = [](int i) { return 0.9 - i * 0.002; };
+
+    size_t scanIso{ 0 };
+    double const msScanIso{ msPerStep([&](int i) {
+      for (Leaf const &l : leaves) {
+        scanIso += l.min <= iso(i) && l.max >= iso(i);
+      }
+    }) };
+    size_t treeIso{ 0 };
+    double const msTreeIso{ msPerStep([&](int i) {
+      t.forEachInValueRange(iso(i), iso(i), [&treeIso](uint64_t) { ++treeIso; });
+    }) };
+
+    size_t scanRov{ 0 };
+    double const msScanRov{ msPerStep([&](int i) {
+      for (Leaf const &l : leaves) {
+        scanRov += l.rov >= rovLow(i) && l.rov <= 1.0;
+      }
+    }) };
+    size_t treeRov{ 0 };
+    double const msTreeRov{ msPerStep([&](int i) {
+      t.forEachInRovRange(rovLow(i), 1.0, [&treeRov](uint64_t) { ++treeRov; });
+    }) };
+
+    REQUIRE(treeIso == scanIso);
+    REQUIRE(treeRov == scanRov);
+
+    std::cout << "octree, " << side << "^3 blocks, build " << msBuild << " ms\n"
+              << "  isovalue: scan " << msScanIso << " ms, octree "
+              << msTreeIso << " ms (" << treeIso / STEPS << " blocks)\n"
+              << "  rov:      scan " << msScanRov << " ms, octree "
+              << msTreeRov << " ms (" << treeRov / STEPS << " blocks)"
+              << std::endl;
+  }
+}
+
+
+TEST_CASE("Octree frustum culling vs AabbBatch at 96^3 blocks",
+          "[.][bench][octree]")
+{
+  int const STEPS{ 20 };
+  uint64_t const SIDE{ 96 };
+  glm::u64vec3 const dims{ SIDE, SIDE, SIDE };
+  float const cell{ 1.0f / SIDE };
+
+  bd::Octree t;
+  t.build(dims, smoothLeaves(dims, 3));
+  bd::AabbBatch batch;
+  for (uint64_t k{ 0 }; k < SIDE; ++k) {
+    for (uint64_t j{ 0 }; j < SIDE; ++j) {
+      for (uint64_t i{ 0 }; i < SIDE; ++i) {
+        // the boxes the octree makes from its node ranges.
+        glm::u64vec3 const ijk{ i, j, k };
+        batch.push_back(glm::vec3{ ijk } * cell - 0.5f,
+                        glm::vec3{ ijk + uint64_t(1) } * cell - 0.5f);
+      }
+    }
+  }
+
+  // orbit the volume from close enough that part of it is out of view.
+  auto frustum = [](int i) {
+    float const a{ i * 0.3f };
+    glm::vec3 const eye{ 0.8f * std::cos(a), 0.2f, 0.8f * std::sin(a) };
+    return bd::Frustum{
+        glm::perspective(glm::radians(50.0f), 1.0f, 0.1f, 10.0f) *
+        glm::lookAt(eye, glm::vec3{ 0.0f }, glm::vec3{ 0.0f, 1.0f, 0.0f }) };
+  };
+
+  std::vector<uint8_t> inside;
+  size_t scanIn{ 0 };
+  auto start = std::chrono::high_resolution_clock::now();
+  for (int i{ 0 }; i < STEPS; ++i) {
+    batch.cull(frustum(i), inside);
+    scanIn += std::count(inside.begin(), inside.end(), 1);
+  }
+  double const msScan{ std::chrono::duration<double, std::milli>(
+      std::chrono::high_resolution_clock::now() - start).count() / STEPS };
+
+  size_t treeIn{ 0 };
+  start = std::chrono::high_resolution_clock::now();
+  for (int i{ 0 }; i < STEPS; ++i) {
+    bd::Frustum const f{ frustum(i) };
+    inside.assign(SIDE * SIDE * SIDE, 0);
+    t.query([&f, cell](bd::Octree::Node const &, glm::u64vec3 const &lo,
+                       glm::u64vec3 const &hi) {
+              glm::vec3 const min{ glm::vec3{ lo } * cell - 0.5f };
+              glm::vec3 const max{ glm::vec3{ hi } * cell - 0.5f };
+              if (!f.intersects(min, max)) {
+                return bd::Octree::Overlap::None;
+              }
+              return f.contains(min, max) ? bd::Octree::Overlap::All
+                                          : bd::Octree::Overlap::Partial;
+            },
+            [&inside](uint64_t leaf) { inside[leaf] = 1; });
+    treeIn += std::count(inside.begin(), inside.end(), 1);
+  }
+  double const msTree{ std::chrono::duration<double, std::milli>(
+      std::chrono::high_resolution_clock::now() - start).count() / STEPS };
+
+  // AabbBatch sums the plane terms in another order, boxes touching a
+  // plane can round either way.
+  REQUIRE(std::abs(double(treeIn) - double(scanIn)) <= 1e-5 * scanIn);
+  std::cout << "frustum culling, 96^3 blocks: AabbBatch " << msScan
+            << " ms, octree " << msTree << " ms (" << scanIn / STEPS
+            << " blocks in view)" << std::endl;
+}
@@ -0,0 +1,94 @@
+#include <bd/datastructure/residencytable.h>
+
+#include <catch.hpp>
+
+#include <algorithm>
+
+
+TEST_CASE("ResidencyTable insert and contains", "[residencytable]")
+{
+  bd::ResidencyTable<int> t{ 130 };
+
+  REQUIRE(t.capacity() == 130);
+  REQUIRE(t.empty());
+
+  REQUIRE(t.insert(0, 10));
+  REQUIRE(t.insert(63, 11));
+  REQUIRE(t.insert(64, 12));
+  REQUIRE(t.insert(129, 13));
+  REQUIRE_FALSE(t.insert(64, 99));
+
+  REQUIRE(t.size() == 4);
+  REQUIRE(t.contains(0));
+  REQUIRE(t.contains(63));
+  REQUIRE(t.contains(64));
+  REQUIRE(t.contains(129));
+  REQUIRE_FALSE(t.contains(1));
+  REQUIRE_FALSE(t.contains(65));
+
+  REQUIRE(t.get(64) == 12);
+  REQUIRE(t.get(129) == 13);
+}
+
+
+TEST_CASE("ResidencyTable erase keeps dense arrays packed", "[residencytable]")
+{
+  bd::ResidencyTable<int> t{ 100 };
+  for (int i{ 0 }; i < 10; ++i) {
+    t.insert(static_cast<uint64_t>(i * 10), i);
+  }
+
+  REQUIRE(t.erase(0));
+  REQUIRE_FALSE(t.erase(0));
+  REQUIRE(t.erase(50));
+
+  REQUIRE(t.size() == 8);
+  REQUIRE(t.ids().size() == t.values().size());
+  REQUIRE_FALSE(t.contains(0));
+  REQUIRE_FALSE(t.contains(50));
+
+  // every remaining id still maps to its own value.
+  for (size_t i{ 0 }; i < t.ids().size(); ++i) {
+    uint64_t id{ t.ids()[i] };
+    REQUIRE(t.get(id) == static_cast<int>(id / 10));
+    REQUIRE(t.values()[i] == t.get(id));
+  }
+}
+
+
+TEST_CASE("ResidencyTable eraseIf", "[residencytable]")
+{
+  bd::ResidencyTable<int> t{ 64 };
+  for (int i{ 0 }; i < 64; ++i) {
+    t.insert(static_cast<uint64_t>(i), i);
+  }
+
+  std::vector<int> removed;
+  size_t n{ t.eraseIf([](int v) { return v % 2 == 0; },
+                      [&removed](int v) { removed.push_back(v); }) };
+
+  REQUIRE(n == 32);
+  REQUIRE(removed.size() == 32);
+  REQUIRE(t.size() == 32);
+  for (uint64_t i{ 0 }; i < 64; ++i) {
+    REQUIRE(t.contains(i) == ( i % 2 == 1 ));
+  }
+
+  SECTION("limited by maxErase")
+  {
+    n = t.eraseIf([](int) { return true; }, [](int) { }, 5);
+    REQUIRE(n == 5);
+    REQUIRE(t.size() == 27);
+  }
+
+  SECTION("clear")
+  {
+    t.clear();
+    REQUIRE(t.empty());
+    for (uint64_t i{ 0 }; i < 64; ++i) {
+      REQUIRE_FALSE(t.contains(i));
+    }
+    REQUIRE(t.insert(3, 3));
+    REQUIRE(t.get(3) == 3);
+  }
+}
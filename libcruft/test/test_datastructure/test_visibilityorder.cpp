@@ -0,0 +1,173 @@
+#include <bd/datastructure/visibilityorder.h>
+#include <glm/glm.hpp>
+#include <catch.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <vector>
+
+namespace
+{
+
+glm::u64vec3
+ijkOf(uint64_t idx, glm::u64vec3 const &dims)
+{
+  return { idx % dims.x, ( idx / dims.x ) % dims.y, idx / ( dims.x * dims.y ) };
+}
+
+
+/// \brief Some of the cells of the grid, as 1D indexes in random order.
+std::vector<uint64_t>
+someCells(glm::u64vec3 const &dims, double fraction, unsigned seed)
+{
+  std::mt19937 gen{ seed };
+  std::bernoulli_distribution keep{ fraction };
+  std::vector<uint64_t> cells;
+  for (uint64_t i{ 0 }; i < dims.x * dims.y * dims.z; ++i) {
+    if (keep(gen)) {
+      cells.push_back(i);
+    }
+  }
+  std::shuffle(cells.begin(), cells.end(), gen);
+  return cells;
+}
+
+
+/// \brief True if each cell comes after its face neighbours that are
+/// farther from the eye along their common axis.
+bool
+isBackToFront(std::vector<uint64_t> const &order, glm::u64vec3 const &dims,
+              glm::i64vec3 const &eye)
+{
+  std::vector<int64_t> pos(dims.x * dims.y * dims.z, -1);
+  for (size_t p{ 0 }; p < order.size(); ++p) {
+    pos[order[p]] = static_cast<int64_t>(p);
+  }
+
+  for (uint64_t idx : order) {
+    glm::u64vec3 const c{ ijkOf(idx, dims) };
+    for (int a{ 0 }; a < 3; ++a) {
+      int64_t const ca{ static_cast<int64_t>(c[a]) };
+      // the neighbour one step farther from the eye, if any.
+      int64_t const step{ ca < eye[a] ? -1 : 1 };
+      if (ca == eye[a] || ca + step < 0 ||
+          ca + step >= static_cast<int64_t>(dims[a])) {
+        continue;
+      }
+      uint64_t const stride[3]{ 1, dims.x, dims.x * dims.y };
+      uint64_t const farther{ idx + step * static_cast<int64_t>(stride[a]) };
+      if (pos[farther] >= 0 && pos[farther] > pos[idx]) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+} // namespace
+
+
+TEST_CASE("VisibilityOrder eye cells", "[visibilityorder]")
+{
+  bd::VisibilityOrder v{ { 4, 2, 3 }, { -0.5f, -0.5f, -0.5f },
+                         { 0.25f, 0.5f, 0.25f }};
+  REQUIRE(v.valid());
+  REQUIRE_FALSE(bd::VisibilityOrder{ }.valid());
+
+  REQUIRE(v.eyeCell({ 0.0f, 0.0f, 0.0f }) == glm::i64vec3(2, 1, 2));
+  REQUIRE(v.eyeCell({ -0.4f, -0.1f, -0.3f }) == glm::i64vec3(0, 0, 0));
+  REQUIRE(v.eyeCell({ -2.0f, 5.0f, 0.2f }) == glm::i64vec3(-1, 2, 2));
+}
+
+
+TEST_CASE("VisibilityOrder sorts cells back to front", "[visibilityorder]")
+{
+  glm::u64vec3 const dims{ 7, 5, 6 };
+  bd::VisibilityOrder v{ dims, { 0.0f, 0.0f, 0.0f }, { 1.0f, 1.0f, 1.0f }};
+  auto ijk = [&dims](uint64_t idx) { return ijkOf(idx, dims); };
+
+  // inside, on a face, at a corner and outside on each side.
+  std::vector<glm::vec3> const eyes{
+      { 3.5f, 2.5f, 3.5f }, { 0.5f, 2.5f, 3.5f }, { 6.5f, 4.5f, 0.5f },
+      { -3.0f, 2.5f, 3.5f }, { 10.0f, -1.0f, 20.0f }, { 3.5f, 9.0f, -4.0f }};
+
+  for (float fraction : { 1.0f, 0.4f }) {
+    std::vector<uint64_t> const cells{ someCells(dims, fraction, 11) };
+    for (glm::vec3 const &eye : eyes) {
+      glm::i64vec3 const e{ v.eyeCell(eye) };
+      std::vector<uint64_t> order{ cells };
+      v.sort(order, e, ijk);
+
+      REQUIRE(order.size() == cells.size());
+      std::vector<uint64_t> a{ order };
+      std::vector<uint64_t> b{ cells };
+      std::sort(a.begin(), a.end());
+      std::sort(b.begin(), b.end());
+      REQUIRE(a == b);
+
+      REQUIRE(isBackToFront(order, dims, e));
+    }
+  }
+}
+
+
+TEST_CASE("VisibilityOrder vs distance sort at 100k+ blocks",
+          "[.][bench][visibilityorder]")
+{
+  int const STEPS{ 20 };
+  glm::u64vec3 const dims{ 64, 64, 64 };
+  glm::vec3 const cell{ 1.0f / 64 };
+  glm::vec3 const lo{ -0.5f };
+  bd::VisibilityOrder v{ dims, lo, cell };
+
+  struct Blk
+  {
+    glm::u64vec3 ijk;
+    glm::vec3 origin;
+  };
+
+  std::vector<uint64_t> const cells{ someCells(dims, 0.5, 3) };
+  std::vector<Blk> blocks;
+  for (uint64_t idx : cells) {
+    glm::u64vec3 const c{ ijkOf(idx, dims) };
+    blocks.push_back({ c, lo + ( glm::vec3(c) + 0.5f ) * cell });
+  }
+  std::vector<Blk *> shown;
+  for (Blk &b : blocks) {
+    shown.push_back(&b);
+  }
+
+  // an orbit around the volume.
+  auto eyeAt = [](int i) {
+    float const t{ 0.1f * i };
+    return glm::vec3{ 2.0f * std::cos(t), 0.3f, 2.0f * std::sin(t) };
+  };
+
+  std::vector<Blk *> bySort{ shown };
+  auto start = std::chrono::high_resolution_clock::now();
+  for (int i{ 0 }; i < STEPS; ++i) {
+    glm::vec3 const eye{ eyeAt(i) };
+    std::sort(bySort.begin(), bySort.end(), [&eye](Blk *a, Blk *b) {
+      return glm::distance(eye, a->origin) > glm::distance(eye, b->origin);
+    });
+  }
+  double const msSort{ std::chrono::duration<double, std::milli>(
+      std::chrono::high_resolution_clock::now() - start).count() / STEPS };
+
+  std::vector<Blk *> byGrid{ shown };
+  start = std::chrono::high_resolution_clock::now();
+  for (int i{ 0 }; i < STEPS; ++i) {
+    v.sort(byGrid, v.eyeCell(eyeAt(i)), [](Blk *b) { return b->ijk; });
+  }
+  double const msGrid{ std::chrono::duration<double, std::milli>(
+      std::chrono::high_resolution_clock::now() - start).count() / STEPS };
+
+  REQUIRE(byGrid.size() == shown.size());
+
+  std::cout << "visibility order, " << shown.size() << " blocks\n"
+            << "  std::sort by distance: " << msSort << " ms\n"
+            << "  grid order:            " << msGrid << " ms" << std::endl;
+}
@@ -0,0 +1,163 @@
+#include <bd/geo/frustum.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <catch.hpp>
+
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <vector>
+
+namespace
+{
+
+/// \brief Camera at (0, 0, 3) looking down -z, 90 degree fov, near 1, far 10.
+glm::mat4
+viewProj()
+{
+  glm::mat4 const proj{ glm::perspective(glm::radians(90.0f), 1.0f, 1.0f, 10.0f) };
+  glm::mat4 const view{ glm::lookAt(glm::vec3{ 0.0f, 0.0f, 3.0f },
+                                    glm::vec3{ 0.0f, 0.0f, 0.0f },
+                                    glm::vec3{ 0.0f, 1.0f, 0.0f }) };
+  return proj * view;
+}
+
+
+bool
+boxInside(bd::Frustum const &f, glm::vec3 const &center, float half)
+{
+  return f.intersects(center - glm::vec3{ half }, center + glm::vec3{ half });
+}
+
+} // namespace
+
+
+TEST_CASE("Frustum planes from a view-projection matrix", "[frustum]")
+{
+  bd::Frustum const f{ viewProj() };
+
+  // near plane at z = 2, facing -z, far plane at z = -7.
+  REQUIRE(f.plane(4).z == Approx(-1.0f));
+  REQUIRE(f.plane(4).w == Approx(2.0f));
+  REQUIRE(f.plane(5).z == Approx(1.0f));
+  REQUIRE(f.plane(5).w == Approx(7.0f));
+
+  REQUIRE(boxInside(f, { 0.0f, 0.0f, 0.0f }, 0.5f));
+  // straddles the left plane (x = -(3 - z) at z = 0).
+  REQUIRE(boxInside(f, { -3.0f, 0.0f, 0.0f }, 0.5f));
+  REQUIRE_FALSE(boxInside(f, { -4.5f, 0.0f, 0.0f }, 0.5f));
+  REQUIRE_FALSE(boxInside(f, { 0.0f, 4.5f, 0.0f }, 0.5f));
+  // behind the camera, and past the far plane.
+  REQUIRE_FALSE(boxInside(f, { 0.0f, 0.0f, 5.0f }, 0.5f));
+  REQUIRE_FALSE(boxInside(f, { 0.0f, 0.0f, -8.0f }, 0.5f));
+  // the camera is in it, but it is closer than the near plane.
+  REQUIRE_FALSE(boxInside(f, { 0.0f, 0.0f, 3.0f }, 0.5f));
+  REQUIRE(boxInside(f, { 0.0f, 0.0f, 3.0f }, 1.5f));
+
+  bd::Frustum const all;
+  REQUIRE(boxInside(all, { 100.0f, -50.0f, 7.0f }, 0.1f));
+}
+
+
+TEST_CASE("Frustum contains only boxes inside every plane", "[frustum]")
+{
+  bd::Frustum const f{ viewProj() };
+  glm::vec3 const half{ 0.5f };
+
+  REQUIRE(f.contains(-half, half));
+  // straddles the left plane, intersects but is not contained.
+  glm::vec3 const left{ -3.0f, 0.0f, 0.0f };
+  REQUIRE(f.intersects(left - half, left + half));
+  REQUIRE_FALSE(f.contains(left - half, left + half));
+  // straddles the near plane.
+  glm::vec3 const near{ 0.0f, 0.0f, 2.0f };
+  REQUIRE_FALSE(f.contains(near - half, near + half));
+  REQUIRE_FALSE(f.contains(glm::vec3{ 10.0f } - half, glm::vec3{ 10.0f } + half));
+
+  bd::Frustum const all;
+  REQUIRE(all.contains(glm::vec3{ -100.0f }, glm::vec3{ 100.0f }));
+}
+
+
+TEST_CASE("AabbBatch culls like Frustum::intersects", "[frustum]")
+{
+  bd::Frustum const f{ viewProj() };
+  std::mt19937 gen{ 5 };
+  std::uniform_real_distribution<float> pos{ -12.0f, 12.0f };
+  std::uniform_real_distribution<float> size{ 0.0f, 2.0f };
+
+  // not a multiple of 4, so the scalar tail is used too.
+  for (size_t n : { 0, 3, 1001 }) {
+    bd::AabbBatch batch;
+    std::vector<uint8_t> expected;
+    for (size_t i{ 0 }; i < n; ++i) {
+      glm::vec3 const lo{ pos(gen), pos(gen), pos(gen) };
+      glm::vec3 const hi{ lo + glm::vec3{ size(gen), size(gen), size(gen) }};
+      batch.push_back(lo, hi);
+      expected.push_back(static_cast<uint8_t>(f.intersects(lo, hi)));
+    }
+    REQUIRE(batch.size() == n);
+
+    std::vector<uint8_t> inside{ 7, 7 };
+    batch.cull(f, inside);
+    REQUIRE(inside == expected);
+  }
+}
+
+
+TEST_CASE("AabbBatch culling at 884k blocks", "[.][bench][frustum]")
+{
+  int const STEPS{ 20 };
+  int const SIDE{ 96 };
+  float const cell{ 1.0f / SIDE };
+
+  bd::AabbBatch batch;
+  std::vector<glm::vec3> los;
+  std::vector<glm::vec3> his;
+  for (int k{ 0 }; k < SIDE; ++k) {
+    for (int j{ 0 }; j < SIDE; ++j) {
+      for (int i{ 0 }; i < SIDE; ++i) {
+        glm::vec3 const lo{ glm::vec3{ float(i), float(j), float(k) } * cell - 0.5f };
+        los.push_back(lo);
+        his.push_back(lo + glm::vec3{ cell });
+        batch.push_back(lo, lo + glm::vec3{ cell });
+      }
+    }
+  }
+
+  // zoomed in on a corner of the volume.
+  glm::mat4 const proj{ glm::perspective(glm::radians(30.0f), 1.0f, 0.1f, 10.0f) };
+  glm::mat4 const view{ glm::lookAt(glm::vec3{ 0.6f, 0.5f, 0.9f },
+                                    glm::vec3{ 0.3f, 0.3f, 0.3f },
+                                    glm::vec3{ 0.0f, 1.0f, 0.0f }) };
+  bd::Frustum const f{ proj * view };
+
+  std::vector<uint8_t> scalar(los.size());
+  auto start = std::chrono::high_resolution_clock::now();
+  for (int s{ 0 }; s < STEPS; ++s) {
+    for (size_t i{ 0 }; i < los.size(); ++i) {
+      scalar[i] = static_cast<uint8_t>(f.intersects(los[i], his[i]));
+    }
+  }
+  double const msScalar{ std::chrono::duration<double, std::milli>(
+      std::chrono::high_resolution_clock::now() - start).count() / STEPS };
+
+  std::vector<uint8_t> batched;
+  start = std::chrono::high_resolution_clock::now();
+  for (int s{ 0 }; s < STEPS; ++s) {
+    batch.cull(f, batched);
+  }
+  double const msBatch{ std::chrono::duration<double, std::milli>(
+      std::chrono::high_resolution_clock::now() - start).count() / STEPS };
+
+  REQUIRE(batched == scalar);
+
+  size_t in{ 0 };
+  for (uint8_t b : batched) {
+    in += b;
+  }
+  std::cout << "frustum culling, " << los.size() << " boxes (" << in
+            << " inside)\n"
+            << "  scalar:  " << msScalar << " ms\n"
+            << "  batched: " << msBatch << " ms" << std::endl;
+}
@@ -0,0 +1,116 @@
+#include <bd/geo/mvpbatch.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <catch.hpp>
+
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <vector>
+
+namespace
+{
+
+glm::mat4
+viewProj(glm::vec3 const &eye)
+{
+  glm::mat4 const proj{ glm::perspective(glm::radians(60.0f), 1.5f, 0.1f, 100.0f) };
+  glm::mat4 const view{ glm::lookAt(eye, glm::vec3{ 0.0f, 0.0f, 0.0f },
+                                    glm::vec3{ 0.0f, 1.0f, 0.0f }) };
+  return proj * view;
+}
+
+
+glm::mat4
+world(glm::vec3 const &origin, glm::vec3 const &scale)
+{
+  return glm::translate(glm::mat4{ 1.0f }, origin) *
+         glm::scale(glm::mat4{ 1.0f }, scale);
+}
+
+} // namespace
+
+
+TEST_CASE("MvpBatch matches multiplying each world matrix", "[mvpbatch]")
+{
+  std::mt19937 gen{ 7 };
+  std::uniform_real_distribution<float> pos{ -2.0f, 2.0f };
+  std::uniform_real_distribution<float> size{ 0.01f, 0.5f };
+
+  glm::mat4 const vp{ viewProj({ 1.0f, 2.0f, 3.0f }) };
+  bd::MvpBatch batch;
+  std::vector<glm::mat4> expected;
+  for (int i{ 0 }; i < 101; ++i) {
+    glm::vec3 const o{ pos(gen), pos(gen), pos(gen) };
+    glm::vec3 const s{ size(gen), size(gen), size(gen) };
+    batch.push_back(o, s);
+    expected.push_back(vp * world(o, s));
+  }
+  REQUIRE(batch.size() == 101);
+
+  batch.compute(vp);
+  REQUIRE(batch.matrices().size() == expected.size());
+  for (size_t i{ 0 }; i < expected.size(); ++i) {
+    for (int c{ 0 }; c < 4; ++c) {
+      for (int r{ 0 }; r < 4; ++r) {
+        REQUIRE(batch.matrices()[i][c][r] ==
+                Approx(expected[i][c][r]));
+      }
+    }
+  }
+
+  batch.clear();
+  REQUIRE(batch.size() == 0);
+  batch.compute(vp);
+  REQUIRE(batch.matrices().empty());
+}
+
+
+TEST_CASE("MvpBatch vs per block matrix multiplies", "[.][bench][mvpbatch]")
+{
+  int const STEPS{ 20 };
+  size_t const N{ 100000 };
+
+  std::mt19937 gen{ 3 };
+  std::uniform_real_distribution<float> pos{ -1.0f, 1.0f };
+  std::vector<glm::vec3> origins;
+  std::vector<glm::mat4> worlds;
+  bd::MvpBatch batch;
+  glm::vec3 const s{ 0.02f };
+  for (size_t i{ 0 }; i < N; ++i) {
+    glm::vec3 const o{ pos(gen), pos(gen), pos(gen) };
+    origins.push_back(o);
+    worlds.push_back(world(o, s));
+    batch.push_back(o, s);
+  }
+
+  glm::mat4 const proj{ glm::perspective(glm::radians(60.0f), 1.5f, 0.1f, 100.0f) };
+  glm::mat4 const view{ glm::lookAt(glm::vec3{ 0.0f, 0.0f, 3.0f },
+                                    glm::vec3{ 0.0f, 0.0f, 0.0f },
+                                    glm::vec3{ 0.0f, 1.0f, 0.0f }) };
+
+  // what Renderer::setWorldMatrix() does for each block.
+  std::vector<glm::mat4> perBlock(N);
+  auto start = std::chrono::high_resolution_clock::now();
+  for (int k{ 0 }; k < STEPS; ++k) {
+    for (size_t i{ 0 }; i < N; ++i) {
+      perBlock[i] = proj * view * worlds[i];
+    }
+  }
+  double const msEach{ std::chrono::duration<double, std::milli>(
+      std::chrono::high_resolution_clock::now() - start).count() / STEPS };
+
+  start = std::chrono::high_resolution_clock::now();
+  for (int k{ 0 }; k < STEPS; ++k) {
+    batch.compute(proj * view);
+  }
+  double const msBatch{ std::chrono::duration<double, std::milli>(
+      std::chrono::high_resolution_clock::now() - start).count() / STEPS };
+
+  REQUIRE(batch.matrices()[N / 2][3][0] == Approx(perBlock[N / 2][3][0]));
+
+  std::cout << "world-view-projection matrices, " << N << " blocks\n"
+            << "  per block proj * view * world: " << msEach << " ms\n"
+            << "  MvpBatch:                      " << msBatch << " ms"
+            << std::endl;
+}
@@ -0,0 +1,112 @@
+#include <bd/graphics/framebuffer.h>
+
+#include <catch.hpp>
+
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+namespace
+{
+
+std::vector<uint8_t>
+readAll(std::string const &path)
+{
+  std::ifstream f{ path, std::ios::binary };
+  return { std::istreambuf_iterator<char>(f), std::istreambuf_iterator<char>() };
+}
+
+
+/// 4x3, red bottom left, the top row white.
+bd::Framebuffer
+testImage()
+{
+  bd::Framebuffer fb{ 4, 3 };
+  fb.clear({ 0.0f, 0.0f, 0.0f, 1.0f });
+  fb.pixel(0, 0) = { 1.0f, 0.0f, 0.0f, 1.0f };
+  for (unsigned int x{ 0 }; x < 4; ++x) {
+    fb.pixel(x, 2) = { 1.0f, 1.0f, 1.0f, 1.0f };
+  }
+  return fb;
+}
+
+} // namespace
+
+
+TEST_CASE("Framebuffer rgb8 is top row first", "[framebuffer]")
+{
+  bd::Framebuffer const fb{ testImage() };
+  std::vector<uint8_t> const rgb{ fb.rgb8() };
+  REQUIRE(rgb.size() == 4 * 3 * 3);
+
+  // top row white
+  for (size_t i{ 0 }; i < 12; ++i) {
+    REQUIRE(rgb[i] == 255);
+  }
+  // last row starts with the red pixel
+  REQUIRE(rgb[24] == 255);
+  REQUIRE(rgb[25] == 0);
+  REQUIRE(rgb[26] == 0);
+  REQUIRE(fb.maxDifference(fb) == 0);
+  REQUIRE(fb.maxDifference(bd::Framebuffer{ 3, 3 }) == 255);
+}
+
+
+TEST_CASE("Framebuffer PPM round trips", "[framebuffer]")
+{
+  std::string const path{ "test_framebuffer.ppm" };
+  bd::Framebuffer const fb{ testImage() };
+  REQUIRE(fb.writePpm(path));
+
+  bd::Framebuffer back;
+  REQUIRE(back.readPpm(path));
+  REQUIRE(back.width() == 4);
+  REQUIRE(back.height() == 3);
+  REQUIRE(back.maxDifference(fb) == 0);
+  REQUIRE(back.pixel(0, 0).r == 1.0f);
+  std::remove(path.c_str());
+
+  REQUIRE_FALSE(back.readPpm("no_such_file.ppm"));
+}
+
+
+TEST_CASE("Framebuffer PNG has the chunks and pixels", "[framebuffer]")
+{
+  std::string const path{ "test_framebuffer.png" };
+  bd::Framebuffer const fb{ testImage() };
+  REQUIRE(fb.writePng(path));
+  std::vector<uint8_t> const png{ readAll(path) };
+  std::remove(path.c_str());
+
+  std::vector<uint8_t> const signature{ 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A,
+                                        '\n' };
+  REQUIRE(png.size() > 8 + 25 + 12);
+  REQUIRE(std::equal(signature.begin(), signature.end(), png.begin()));
+
+  // IHDR: 13 bytes, width 4, height 3, 8 bit rgb.
+  REQUIRE(png[11] == 13);
+  REQUIRE(std::string(png.begin() + 12, png.begin() + 16) == "IHDR");
+  REQUIRE(png[19] == 4);
+  REQUIRE(png[23] == 3);
+  REQUIRE(png[24] == 8);
+  REQUIRE(png[25] == 2);
+
+  // IEND's crc is the same in every PNG.
+  std::vector<uint8_t> const iend{ 0, 0, 0, 0, 'I', 'E', 'N', 'D',
+                                   0xAE, 0x42, 0x60, 0x82 };
+  REQUIRE(std::equal(iend.begin(), iend.end(), png.end() - 12));
+
+  // IDAT holds one stored block: zlib header, block header, then the
+  // scanlines, each a 0 filter byte and the rgb8() row.
+  size_t const idat{ 8 + 25 };
+  REQUIRE(std::string(png.begin() + idat + 4, png.begin() + idat + 8) == "IDAT");
+  size_t const rows{ idat + 8 + 2 + 5 };
+  REQUIRE(png[idat + 10] == 1);
+  std::vector<uint8_t> const rgb{ fb.rgb8() };
+  for (size_t row{ 0 }; row < 3; ++row) {
+    REQUIRE(png[rows + row * 13] == 0);
+    REQUIRE(std::equal(rgb.begin() + row * 12, rgb.begin() + ( row + 1 ) * 12,
+                       png.begin() + rows + row * 13 + 1));
+  }
+}
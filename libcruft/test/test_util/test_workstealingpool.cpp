@@ -0,0 +1,83 @@
+#include <bd/util/workstealingpool.h>
+
+#include <catch.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+
+TEST_CASE("WorkStealingPool runs every task once", "[util][workstealingpool]")
+{
+  bd::WorkStealingPool pool{ 4 };
+  REQUIRE(pool.size() == 4);
+
+  // several batches through the same pool, including fewer tasks than
+  // workers and none at all.
+  for (size_t n : { 1000, 3, 0, 257 }) {
+    std::vector<std::atomic<int>> runs(n);
+    for (std::atomic<int> &r : runs) {
+      r.store(0);
+    }
+    std::atomic<int> badWorker{ 0 };
+
+    pool.run(n, [&](size_t task, size_t worker) {
+      runs[task]++;
+      if (worker >= pool.size()) {
+        badWorker++;
+      }
+    });
+
+    for (size_t t{ 0 }; t < n; ++t) {
+      REQUIRE(runs[t].load() == 1);
+    }
+    REQUIRE(badWorker.load() == 0);
+  }
+}
+
+
+TEST_CASE("WorkStealingPool idle workers steal", "[util][workstealingpool]")
+{
+  bd::WorkStealingPool pool{ 4 };
+
+  // The first quarter of the tasks, dealt to worker 0, are slow. The other
+  // workers run out of their own tasks and take some of them.
+  size_t const n{ 64 };
+  std::vector<size_t> ranOn(n, 0);
+  pool.run(n, [&](size_t task, size_t worker) {
+    if (task < n / 4) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    ranOn[task] = worker;
+  });
+
+  size_t slowElsewhere{ 0 };
+  for (size_t t{ 0 }; t < n / 4; ++t) {
+    if (ranOn[t] != 0) {
+      ++slowElsewhere;
+    }
+  }
+  REQUIRE(pool.steals() > 0);
+  REQUIRE(slowElsewhere > 0);
+}
+
+
+TEST_CASE("WorkStealingPool with one worker runs on the caller",
+          "[util][workstealingpool]")
+{
+  bd::WorkStealingPool pool{ 1 };
+  std::thread::id const caller{ std::this_thread::get_id() };
+
+  int count{ 0 };
+  bool onCaller{ true };
+  pool.run(10, [&](size_t, size_t worker) {
+    ++count;
+    onCaller = onCaller && worker == 0 &&
+        std::this_thread::get_id() == caller;
+  });
+
+  REQUIRE(count == 10);
+  REQUIRE(onCaller);
+  REQUIRE(pool.steals() == 0);
+}
@@ -53,22 +53,34 @@ TEST_CASE("empty(bool)", "[block][empty]")
     REQUIRE(b.fileBlock().is_empty == b.empty());
   }
 
-  SECTION("empty(false) sets is_empty=0")
+  SECTION("empty(false) clears empty() and leaves the FileBlock")
   {
     b.empty(false);
-    REQUIRE(b.fileBlock().is_empty == 0);
+    REQUIRE_FALSE(b.empty());
+    REQUIRE(b.fileBlock().is_empty == originalFBValue);
     REQUIRE(b.status() == 0x1); // NOT_EMPTY
   }
 
   SECTION("empty(true) sets status visible")
   {
     b.empty(true);
-    REQUIRE(b.fileBlock().is_empty == 1);
+    REQUIRE(b.empty());
+    REQUIRE(b.fileBlock().is_empty == originalFBValue);
     REQUIRE(b.status() == 0x0); // CLEAR
   }
 }
 
 
+TEST_CASE("c'tor uses the given ijk", "[block]")
+{
+  bd::FileBlock fb;
+  fb.ijk_index[0] = 1;
+  bd::Block b{{2,3,4}, fb};
+
+  REQUIRE(b.ijk() == glm::u64vec3(2,3,4));
+}
+
+
 TEST_CASE("status set correct by texture()", "[block][texture]")
 {
   bd::Block b{{0,0,0}, {}};
@@ -125,4 +137,41 @@ TEST_CASE("block has status 13 after setting the stuff", "[block][status]")
 
   b.empty(true);
   REQUIRE(b.status() == 0x00); // 0 CLEAR
-}
\ No newline at end of file
+}
+
+TEST_CASE("occupied box is padded, clamped and sets the transform",
+          "[block][occupied]")
+{
+  bd::FileBlock fb;
+  fb.voxel_dims[0] = fb.voxel_dims[1] = fb.voxel_dims[2] = 16;
+  fb.world_dims[0] = fb.world_dims[1] = fb.world_dims[2] = 1.0;
+
+  SECTION("no occupied box uses the whole block")
+  {
+    bd::Block b{{0,0,0}, fb};
+    REQUIRE(b.occupiedOffset() == glm::u64vec3(0, 0, 0));
+    REQUIRE(b.occupiedExtent() == glm::u64vec3(16, 16, 16));
+    REQUIRE(b.transform()[0][0] == Approx(1.0));
+    REQUIRE(b.transform()[3][0] == Approx(0.0));
+  }
+
+  SECTION("box grows one voxel per side within the block")
+  {
+    fb.occ_min[0] = 4;  fb.occ_max[0] = 6;
+    fb.occ_min[1] = 0;  fb.occ_max[1] = 16;
+    fb.occ_min[2] = 15; fb.occ_max[2] = 16;
+    bd::Block b{{0,0,0}, fb};
+    REQUIRE(b.occupiedOffset() == glm::u64vec3(3, 0, 14));
+    REQUIRE(b.occupiedExtent() == glm::u64vec3(4, 16, 2));
+
+    // voxels 3..6 of 0..15 span [0.2, 0.4] of the block.
+    REQUIRE(b.occupiedLow().x == Approx(0.2));
+    REQUIRE(b.occupiedHigh().x == Approx(0.4));
+    glm::mat4 const &m{ b.transform() };
+    REQUIRE(m[0][0] == Approx(0.2));
+    REQUIRE(m[3][0] == Approx(0.3 - 0.5));
+    REQUIRE(m[1][1] == Approx(1.0));
+    REQUIRE(m[2][2] == Approx(1.0 / 15.0));
+    REQUIRE(m[3][2] == Approx(( 14.5 / 15.0 ) - 0.5));
+  }
+}
@@ -0,0 +1,190 @@
+#include <bd/volume/blockstore.h>
+#include <bd/volume/block.h>
+#include <bd/io/fileblock.h>
+
+#include <catch.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+namespace
+{
+
+std::vector<bd::FileBlock>
+makeFileBlocks(glm::u64vec3 const &nb)
+{
+  std::vector<bd::FileBlock> fbs;
+  fbs.reserve(nb.x * nb.y * nb.z);
+  for (uint64_t k{ 0 }; k < nb.z; ++k) {
+    for (uint64_t j{ 0 }; j < nb.y; ++j) {
+      for (uint64_t i{ 0 }; i < nb.x; ++i) {
+        bd::FileBlock fb;
+        fb.block_index = fbs.size();
+        fb.ijk_index[0] = i;
+        fb.ijk_index[1] = j;
+        fb.ijk_index[2] = k;
+        fb.voxel_dims[0] = fb.voxel_dims[1] = fb.voxel_dims[2] = 16;
+        fb.world_dims[0] = 1.0 / nb.x;
+        fb.world_dims[1] = 1.0 / nb.y;
+        fb.world_dims[2] = 1.0 / nb.z;
+        fb.world_oigin[0] = ( i + 0.5 ) / nb.x - 0.5;
+        fb.world_oigin[1] = ( j + 0.5 ) / nb.y - 0.5;
+        fb.world_oigin[2] = ( k + 0.5 ) / nb.z - 0.5;
+        fb.rov = ( fb.block_index * 7919 % 1000 ) / 1000.0;
+        fb.avg_val = fb.rov * 0.5;
+        fb.data_bytes = 16 * 16 * 16;
+        fbs.push_back(fb);
+      }
+    }
+  }
+  return fbs;
+}
+
+} // namespace
+
+
+TEST_CASE("BlockStore blocks match their FileBlocks", "[blockstore]")
+{
+  std::vector<bd::FileBlock> fbs{ makeFileBlocks({ 4, 3, 2 }) };
+  fbs[5].occ_min[0] = 4;
+  fbs[5].occ_max[0] = 6;
+  fbs[7].is_empty = 1;
+
+  bd::BlockStore store{ fbs };
+  REQUIRE(store.size() == fbs.size());
+  REQUIRE(store.bytes() > 0);
+
+  for (size_t i{ 0 }; i < store.size(); ++i) {
+    bd::Block *b{ store.block(i) };
+    bd::Block alone{ { fbs[i].ijk_index[0], fbs[i].ijk_index[1],
+                       fbs[i].ijk_index[2] }, fbs[i] };
+
+    REQUIRE(b->index() == fbs[i].block_index);
+    REQUIRE(b->ijk() == alone.ijk());
+    REQUIRE(b->origin() == alone.origin());
+    REQUIRE(b->worldDims() == alone.worldDims());
+    REQUIRE(b->origin() == store.origins()[i]);
+    REQUIRE(b->rov() == fbs[i].rov);
+    REQUIRE(b->avg() == fbs[i].avg_val);
+    REQUIRE(b->empty() == ( i == 7 ));
+    REQUIRE(b->byteSize() == fbs[i].data_bytes);
+    REQUIRE(b->occupiedExtent() == alone.occupiedExtent());
+    REQUIRE(b->transform() == alone.transform());
+    REQUIRE(b->status() == 0x0);
+  }
+  REQUIRE(store.block(5)->occupiedExtent() == glm::u64vec3(4, 16, 16));
+
+  // the views write through to the arrays.
+  bd::Block *b{ store.block(3) };
+  char c{ 'a' };
+  b->empty(false);
+  b->pixelData(&c);
+  REQUIRE(store.statuses()[3] == 0x09);
+  REQUIRE_FALSE(b->empty());
+  REQUIRE(store.statuses()[2] == 0x0);
+
+  // copies view the same block.
+  bd::Block copy{ *b };
+  copy.empty(true);
+  REQUIRE(b->empty());
+  REQUIRE(store.statuses()[3] == 0x08);
+}
+
+
+TEST_CASE("BlockStore makes runtime state only for candidate blocks",
+          "[blockstore]")
+{
+  std::vector<bd::FileBlock> fbs{ makeFileBlocks({ 8, 8, 8 }) };
+  fbs[9].occ_min[1] = 2;
+  fbs[9].occ_max[1] = 5;
+  bd::BlockStore store{ fbs };
+  size_t const compact{ store.bytes() };
+
+  // hiding, and reading what the classification reads, makes nothing.
+  for (size_t i{ 0 }; i < store.size(); ++i) {
+    bd::Block *b{ store.block(i) };
+    b->empty(true);
+    REQUIRE(b->texture() == nullptr);
+    REQUIRE(b->pixelData() == nullptr);
+    b->pixelData(nullptr);
+    b->removeTexture();
+    REQUIRE(b->rov() == fbs[i].rov);
+    REQUIRE(b->ijk().x == fbs[i].ijk_index[0]);
+  }
+  REQUIRE(store.materialized() == 0);
+  REQUIRE(store.bytes() == compact);
+  REQUIRE(store.occupiedVoxels() == ( store.size() - 1 ) * 16 * 16 * 16 +
+      16 * 5 * 16);
+
+  // showing a block makes it.
+  store.block(9)->empty(false);
+  REQUIRE(store.materialized() == 1);
+  REQUIRE(store.bytes() > compact);
+  REQUIRE(store.block(9)->occupiedExtent() == glm::u64vec3(16, 5, 16));
+
+  // so does anything that loads or draws it.
+  char c{ 'a' };
+  store.block(20)->pixelData(&c);
+  REQUIRE(store.block(20)->pixelData() == &c);
+  REQUIRE(store.block(30)->occupiedOffset() == glm::u64vec3(0, 0, 0));
+  REQUIRE(store.materialized() == 3);
+
+  store.block(9)->empty(true);
+  store.block(9)->empty(false);
+  REQUIRE(store.materialized() == 3);
+}
+
+
+TEST_CASE("BlockStore at 96^3 blocks", "[.][bench][blockstore]")
+{
+  std::vector<bd::FileBlock> const fbs{ makeFileBlocks({ 96, 96, 96 }) };
+
+  auto start = std::chrono::high_resolution_clock::now();
+  bd::BlockStore store{ fbs };
+  std::vector<bd::Block *> blocks(store.size());
+  for (size_t i{ 0 }; i < store.size(); ++i) {
+    blocks[i] = store.block(i);
+  }
+  double const createMs{ std::chrono::duration<double, std::milli>(
+      std::chrono::high_resolution_clock::now() - start).count() };
+
+  // the classification and draw loops: show the blocks in a rov range (at
+  // most 10% of them, like a typical classification), then order the shown
+  // blocks by distance from the eye.
+  int const STEPS{ 10 };
+  std::vector<bd::Block *> shown;
+  shown.reserve(blocks.size());
+  start = std::chrono::high_resolution_clock::now();
+  for (int s{ 0 }; s < STEPS; ++s) {
+    double const low{ 0.9 + 0.005 * s };
+    shown.clear();
+    for (bd::Block *b : blocks) {
+      bool const show{ b->rov() >= low };
+      b->empty(!show);
+      if (show) {
+        shown.push_back(b);
+      }
+    }
+  }
+  double const filterMs{ std::chrono::duration<double, std::milli>(
+      std::chrono::high_resolution_clock::now() - start).count() / STEPS };
+
+  glm::vec3 const eye{ 2.0f, 1.0f, 3.0f };
+  start = std::chrono::high_resolution_clock::now();
+  std::sort(shown.begin(), shown.end(),
+            [&eye](bd::Block const *a, bd::Block const *b) {
+              return glm::distance(eye, a->origin()) <
+                  glm::distance(eye, b->origin());
+            });
+  double const sortMs{ std::chrono::duration<double, std::milli>(
+      std::chrono::high_resolution_clock::now() - start).count() };
+
+  std::cout << "block store, " << store.size() << " blocks, "
+            << store.bytes() / ( 1024 * 1024 ) << " MiB ("
+            << store.materialized() << " materialized): create " << createMs
+            << " ms, filter " << filterMs << " ms, sort " << shown.size()
+            << " in " << sortMs << " ms" << std::endl;
+}
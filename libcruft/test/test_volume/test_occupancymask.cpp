@@ -0,0 +1,117 @@
+#include <bd/volume/occupancymask.h>
+
+#include <catch.hpp>
+
+#include <utility>
+#include <vector>
+
+namespace
+{
+
+std::vector<std::pair<uint64_t, uint64_t>>
+runs(bd::OccupancyMask const &m, uint64_t y, uint64_t z, uint64_t x0,
+     uint64_t x1)
+{
+  std::vector<std::pair<uint64_t, uint64_t>> r;
+  m.forEachOccupiedRun(y, z, x0, x1, [&r](uint64_t a, uint64_t b) {
+    r.push_back({ a, b });
+  });
+  return r;
+}
+
+} // namespace
+
+
+TEST_CASE("OccupancyMask brick grid and bits", "[occupancymask]")
+{
+  // 20x16x9 voxels in 8^3 bricks: 3x2x2 bricks, the last ones partial.
+  bd::OccupancyMask m{ { 20, 16, 9 }, 8 };
+  REQUIRE(m.size() == 12);
+  REQUIRE(m.brickCount() == glm::u64vec3(3, 2, 2));
+  REQUIRE(m.occupiedCount() == 12);
+
+  m.occupied({ 1, 0, 0 }, false);
+  m.occupied({ 2, 1, 1 }, false);
+  REQUIRE_FALSE(m.occupied({ 1, 0, 0 }));
+  REQUIRE(m.occupied({ 0, 0, 0 }));
+  REQUIRE(m.occupiedCount() == 10);
+
+  SECTION("hex round trip")
+  {
+    bd::OccupancyMask back{ { 20, 16, 9 }, 8 };
+    REQUIRE(back.fromHex(m.toHex()));
+    for (uint64_t k{ 0 }; k < 2; ++k) {
+      for (uint64_t j{ 0 }; j < 2; ++j) {
+        for (uint64_t i{ 0 }; i < 3; ++i) {
+          REQUIRE(back.occupied({ i, j, k }) == m.occupied({ i, j, k }));
+        }
+      }
+    }
+  }
+
+  SECTION("bit order matches the index file")
+  {
+    // bit 1 is brick (1,0,0), bit 11 is brick (2,1,1).
+    REQUIRE(m.toHex().substr(0, 4) == "fdf7");
+    bd::OccupancyMask f{ { 20, 16, 9 }, 8 };
+    REQUIRE(f.fromHex("0100"));
+    REQUIRE(f.occupiedCount() == 1);
+    REQUIRE(f.occupied({ 0, 0, 0 }));
+  }
+
+  SECTION("bad hex leaves the mask alone")
+  {
+    REQUIRE_FALSE(m.fromHex("fd"));
+    REQUIRE_FALSE(m.fromHex("zz00"));
+    REQUIRE(m.occupiedCount() == 10);
+  }
+}
+
+
+TEST_CASE("OccupancyMask box and run queries", "[occupancymask]")
+{
+  bd::OccupancyMask m{ { 32, 8, 8 }, 8 };
+  m.occupied({ 1, 0, 0 }, false);
+  m.occupied({ 2, 0, 0 }, false);
+
+  REQUIRE(m.anyOccupied({ 0, 0, 0 }, { 9, 8, 8 }));
+  REQUIRE_FALSE(m.anyOccupied({ 8, 0, 0 }, { 24, 8, 8 }));
+  REQUIRE_FALSE(m.anyOccupied({ 10, 2, 2 }, { 12, 3, 3 }));
+  REQUIRE(m.anyOccupied({ 23, 0, 0 }, { 25, 1, 1 }));
+  REQUIRE_FALSE(m.anyOccupied({ 5, 0, 0 }, { 5, 8, 8 }));
+
+  using Runs = std::vector<std::pair<uint64_t, uint64_t>>;
+  REQUIRE(runs(m, 3, 3, 0, 32) == Runs({ { 0, 8 }, { 24, 32 } }));
+  REQUIRE(runs(m, 3, 3, 4, 26) == Runs({ { 4, 8 }, { 24, 26 } }));
+  REQUIRE(runs(m, 3, 3, 9, 20).empty());
+
+  SECTION("no bricks means everything is occupied")
+  {
+    bd::OccupancyMask none;
+    REQUIRE(none.size() == 0);
+    REQUIRE(none.occupied({ 5, 5, 5 }));
+    REQUIRE(none.anyOccupied({ 0, 0, 0 }, { 1, 1, 1 }));
+    REQUIRE(runs(none, 0, 0, 3, 7) == Runs({ { 3, 7 } }));
+  }
+}
+
+
+TEST_CASE("OccupancyMask dilation grows by one brick", "[occupancymask]")
+{
+  bd::OccupancyMask m{ { 40, 40, 40 }, 8 };
+  for (uint64_t k{ 0 }; k < 5; ++k) {
+    for (uint64_t j{ 0 }; j < 5; ++j) {
+      for (uint64_t i{ 0 }; i < 5; ++i) {
+        m.occupied({ i, j, k }, i == 2 && j == 2 && k == 2);
+      }
+    }
+  }
+  REQUIRE(m.occupiedCount() == 1);
+
+  bd::OccupancyMask const d{ m.dilated() };
+  REQUIRE(d.occupiedCount() == 27);
+  REQUIRE(d.occupied({ 1, 1, 1 }));
+  REQUIRE(d.occupied({ 3, 3, 3 }));
+  REQUIRE_FALSE(d.occupied({ 0, 2, 2 }));
+  REQUIRE_FALSE(d.occupied({ 4, 2, 2 }));
+}
@@ -0,0 +1,161 @@
+#include <bd/volume/quantizer.h>
+
+#include <catch.hpp>
+
+#include <cmath>
+#include <vector>
+
+namespace
+{
+
+std::vector<float>
+makeRamp(size_t n, float lo, float hi)
+{
+  std::vector<float> v(n);
+  for (size_t i{ 0 }; i < n; ++i) {
+    v[i] = lo + ( hi - lo ) * static_cast<float>(i) / static_cast<float>(n - 1);
+  }
+  return v;
+}
+
+
+double
+roundTripError(bd::QuantizedBlockInfo const &info,
+               std::vector<char> const &q,
+               std::vector<float> const &orig)
+{
+  std::vector<float> back(orig.size());
+  bd::BlockQuantizer::dequantize(info, q.data(), orig.size(), back.data());
+  double err{ 0.0 };
+  for (size_t i{ 0 }; i < orig.size(); ++i) {
+    err = std::max(err, static_cast<double>(std::abs(orig[i] - back[i])));
+  }
+  return err;
+}
+
+} // namespace
+
+
+TEST_CASE("half float conversion", "[quantizer]")
+{
+  REQUIRE(bd::floatToHalf(0.0f) == 0x0000);
+  REQUIRE(bd::floatToHalf(1.0f) == 0x3C00);
+  REQUIRE(bd::floatToHalf(-2.0f) == 0xC000);
+  REQUIRE(bd::floatToHalf(65504.0f) == 0x7BFF);
+  REQUIRE(bd::floatToHalf(1.0e6f) == 0x7C00);
+  REQUIRE(bd::halfToFloat(0x3C00) == 1.0f);
+  REQUIRE(bd::halfToFloat(0x3555) == Approx(0.333251953125f));
+
+  // smallest subnormal
+  REQUIRE(bd::halfToFloat(0x0001) == Approx(std::ldexp(1.0f, -24)));
+  REQUIRE(bd::floatToHalf(std::ldexp(1.0f, -24)) == 0x0001);
+
+  // every half survives the round trip
+  for (uint32_t h{ 0 }; h < 0x7C00; ++h) {
+    REQUIRE(bd::floatToHalf(bd::halfToFloat(static_cast<uint16_t>(h))) == h);
+  }
+
+  std::vector<float> f{ makeRamp(37, -3.0f, 3.0f) };
+  std::vector<uint16_t> h(f.size());
+  std::vector<float> back(f.size());
+  bd::floatsToHalves(f.data(), f.size(), h.data());
+  bd::halvesToFloats(h.data(), h.size(), back.data());
+  for (size_t i{ 0 }; i < f.size(); ++i) {
+    REQUIRE(h[i] == bd::floatToHalf(f[i]));
+    REQUIRE(back[i] == Approx(f[i]).epsilon(1e-3));
+  }
+}
+
+
+TEST_CASE("block quantization modes", "[quantizer]")
+{
+  size_t const n{ 16 * 16 * 16 };
+  std::vector<float> block{ makeRamp(n, 0.40f, 0.45f) };
+
+  SECTION("u8 stores 1 byte per voxel with per-block scale/offset")
+  {
+    bd::BlockQuantizer q{ bd::QuantizeMode::U8, 0.0 };
+    std::vector<char> buf(n * bd::BlockQuantizer::bytesPerVoxel(q.mode()));
+    bd::QuantizedBlockInfo info{ q.quantize(block.data(), n, buf.data()) };
+
+    REQUIRE(info.mode == bd::QuantizeMode::U8);
+    REQUIRE(info.bytes == n);
+    REQUIRE(info.ratio(n) == Approx(4.0));
+    REQUIRE(info.offset == Approx(0.40f));
+    // narrow range keeps precision: half a step of 0.05/255.
+    REQUIRE(info.maxError <= 0.05 / 255.0 * 0.5 + 1e-6);
+    REQUIRE(std::abs(roundTripError(info, buf, block) - info.maxError) <= 1e-6);
+  }
+
+  SECTION("u16")
+  {
+    bd::BlockQuantizer q{ bd::QuantizeMode::U16, 0.0 };
+    std::vector<char> buf(n * 2);
+    bd::QuantizedBlockInfo info{ q.quantize(block.data(), n, buf.data()) };
+    REQUIRE(info.ratio(n) == Approx(2.0));
+    REQUIRE(info.maxError <= 0.05 / 65535.0 * 0.5 + 1e-7);
+    REQUIRE(roundTripError(info, buf, block) <= info.maxError + 1e-7);
+  }
+
+  SECTION("f16")
+  {
+    bd::BlockQuantizer q{ bd::QuantizeMode::F16, 0.0 };
+    std::vector<char> buf(n * 2);
+    bd::QuantizedBlockInfo info{ q.quantize(block.data(), n, buf.data()) };
+    REQUIRE(info.mode == bd::QuantizeMode::F16);
+    REQUIRE(info.maxError <= 0.45 * std::ldexp(1.0, -11));
+    REQUIRE(roundTripError(info, buf, block) == Approx(info.maxError));
+  }
+
+  SECTION("none copies the floats")
+  {
+    bd::BlockQuantizer q{ bd::QuantizeMode::None, 0.0 };
+    std::vector<char> buf(n * 4);
+    bd::QuantizedBlockInfo info{ q.quantize(block.data(), n, buf.data()) };
+    REQUIRE(info.ratio(n) == Approx(1.0));
+    REQUIRE(info.maxError == 0.0);
+    REQUIRE(roundTripError(info, buf, block) == 0.0);
+  }
+
+  SECTION("quantize in place")
+  {
+    for (bd::QuantizeMode mode : { bd::QuantizeMode::U8, bd::QuantizeMode::U16,
+                                   bd::QuantizeMode::F16 }) {
+      INFO(bd::to_string(mode));
+      std::vector<float> copy{ block };
+      bd::BlockQuantizer q{ mode, 0.0 };
+      char *p{ reinterpret_cast<char *>(copy.data()) };
+      bd::QuantizedBlockInfo info{ q.quantize(copy.data(), n, p) };
+      std::vector<char> buf(p, p + info.bytes);
+      REQUIRE(roundTripError(info, buf, block) <= info.maxError + 1e-7);
+    }
+  }
+}
+
+
+TEST_CASE("auto quantization honours the error bound", "[quantizer]")
+{
+  size_t const n{ 4096 };
+
+  // narrow block: u8 meets a 1e-3 bound.
+  std::vector<float> narrow{ makeRamp(n, 0.2f, 0.3f) };
+  // wide block: u8 can't, falls back to a 16-bit format.
+  std::vector<float> wide{ makeRamp(n, 0.0f, 1.0f) };
+
+  bd::BlockQuantizer q{ bd::QuantizeMode::Auto, 1.0e-3 };
+  REQUIRE(bd::BlockQuantizer::bytesPerVoxel(bd::QuantizeMode::Auto) == 2);
+
+  std::vector<char> buf(n * 2);
+  bd::QuantizedBlockInfo info{ q.quantize(narrow.data(), n, buf.data()) };
+  REQUIRE(info.mode == bd::QuantizeMode::U8);
+  REQUIRE(info.maxError <= 1.0e-3);
+
+  info = q.quantize(wide.data(), n, buf.data());
+  REQUIRE(info.mode == bd::QuantizeMode::U16);
+  REQUIRE(info.maxError <= 1.0e-3);
+  REQUIRE(roundTripError(info, buf, wide) <= info.maxError + 1e-7);
+
+  REQUIRE(bd::to_quantizeMode("auto") == bd::QuantizeMode::Auto);
+  REQUIRE(bd::to_string(bd::QuantizeMode::F16) == "f16");
+  REQUIRE_THROWS(bd::to_quantizeMode("u4"));
+}
@@ -18,6 +18,10 @@ class IndexFile:
             - dtype: data type of the volume data set
             - num_blocks: blocks in x, y, z axis
             - blocks: a list of dicts that are the blocks
+            - occ_brick: side of the blocks' occupancy sub-bricks (optional)
+            - empty_val: normalized value the transfer function makes
+              transparent (optional)
+            - partition: 'kd' if the blocks are of different sizes (optional)
         """
         ifile = {}
         if from_file is not None:
@@ -38,6 +42,9 @@ class IndexFile:
                     'vol_stats': vol_stats.__dict__,
                     'blocks': kwargs['blocks']
                     }
+            for key in ('occ_brick', 'empty_val', 'partition'):
+                if kwargs.get(key) is not None:
+                    ifile[key] = kwargs[key]
 
         self.index_file = ifile
 
@@ -52,7 +59,8 @@ class IndexFile:
 def to1D(col, row, slab, maxCols, maxRows):
     return int(col + maxCols * (row + maxRows * slab))
 
-def create_file_blocks(nblocks, dtype, vol: Volume, rels):
+def create_file_blocks(nblocks, dtype, vol: Volume, rels, mins, maxs,
+        occ_mins, occ_maxs, occ_bits=None):
     blk_dims_world = vol.world_dims / nblocks
     blk_dims_vox = np.array(np.divide(vol.vox_dims, nblocks), dtype=np.uint64)
 
@@ -90,10 +98,67 @@ def create_file_blocks(nblocks, dtype, vol: Volume, rels):
                         'ijk': ijk.tolist(),
                         'offset': offset,
                         'data_bytes': int(data_bytes),
-                        'rel': float(rels[blkIdx])
+                        'rel': float(rels[blkIdx]),
+                        'min_val': float(mins[blkIdx]),
+                        'max_val': float(maxs[blkIdx]),
+                        'occ_min': [int(v) for v in occ_mins[blkIdx]],
+                        'occ_max': [int(v) for v in occ_maxs[blkIdx]]
                         }
+                if occ_bits is not None:
+                    blk_args['occ_bits'] = occ_bits[blkIdx]
 
                 blocks.append(blk_args)
 
     return blocks
 
+
+
+def create_kd_file_blocks(starts, exts, dtype, vol: Volume, rels, mins, maxs,
+        occ_mins, occ_maxs, occ_bits=None):
+    """Blocks of a kd partition: block idx starts at voxel starts[idx] and is
+    exts[idx] voxels big. The ijk of block idx is (idx, 0, 0).
+    """
+    vox_dims = np.array(vol.vox_dims, dtype=np.uint64)
+    vox_world = np.array(vol.world_dims) / vox_dims
+
+    blocks = []
+
+    for blkIdx in range(len(starts)):
+        start_vox = np.array(starts[blkIdx], dtype=np.uint64)
+        ext_vox = np.array(exts[blkIdx], dtype=np.uint64)
+
+        # this blocks location and size within the volume (world coords)
+        world_loc = vox_world * start_vox - 0.5
+        blk_dims_world = vox_world * ext_vox
+
+        # block center in world coords
+        origin = world_loc + blk_dims_world * 0.5
+
+        # byte offset into the file that this block starts at
+        offset = dtype.itemsize * \
+                to1D(start_vox[0], start_vox[1], start_vox[2], vox_dims[0],
+                        vox_dims[1])
+
+        data_bytes = dtype.itemsize * np.prod(ext_vox, dtype=np.uint64)
+
+        blk_args = {
+                'dims': blk_dims_world.tolist(),
+                'origin': origin.tolist(),
+                'vox_dims': ext_vox.tolist(),
+                'voxel_start': start_vox.tolist(),
+                'index': blkIdx,
+                'ijk': [blkIdx, 0, 0],
+                'offset': offset,
+                'data_bytes': int(data_bytes),
+                'rel': float(rels[blkIdx]),
+                'min_val': float(mins[blkIdx]),
+                'max_val': float(maxs[blkIdx]),
+                'occ_min': [int(v) for v in occ_mins[blkIdx]],
+                'occ_max': [int(v) for v in occ_maxs[blkIdx]]
+                }
+        if occ_bits is not None:
+            blk_args['occ_bits'] = occ_bits[blkIdx]
+
+        blocks.append(blk_args)
+
+    return blocks
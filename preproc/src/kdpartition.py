@@ -0,0 +1,109 @@
+import numpy as np
+
+
+class CellCounts:
+    """Summed volume table of a 3D grid of 0/1 cells (indexed [z, y, x]) for
+    constant time counts of the occupied cells in a box.
+    """
+    def __init__(self, cells: np.ndarray):
+        nz, ny, nx = cells.shape
+        self.sums = np.zeros((nz + 1, ny + 1, nx + 1), dtype=np.int64)
+        self.sums[1:, 1:, 1:] = cells.astype(np.int64).cumsum(0).cumsum(1).cumsum(2)
+
+    def count(self, lo, hi):
+        """Occupied cells in [lo, hi), both given as (x, y, z)."""
+        s = self.sums
+        x0, y0, z0 = lo
+        x1, y1, z1 = hi
+        return int(s[z1, y1, x1] - s[z0, y1, x1] - s[z1, y0, x1] - s[z1, y1, x0]
+                + s[z0, y0, x1] + s[z0, y1, x0] + s[z1, y0, x0] - s[z0, y0, x0])
+
+
+def box_volume(lo, hi):
+    return int(np.prod([h - l for l, h in zip(lo, hi)]))
+
+
+def best_split(counts: CellCounts, lo, hi, min_cells):
+    """Find the plane that splits [lo, hi) into the smallest non-empty volume,
+    keeping both sides at least min_cells thick.
+
+    Returns (cost, axis, plane), cost being the cells of the non-empty sides, or
+    None if no plane is allowed. Ties go to the plane nearest the middle.
+    """
+    best = None
+    for a in range(3):
+        mid = (lo[a] + hi[a]) / 2.0
+        for p in range(lo[a] + min_cells, hi[a] - min_cells + 1):
+            left_hi = list(hi)
+            left_hi[a] = p
+            right_lo = list(lo)
+            right_lo[a] = p
+            cost = 0
+            if counts.count(lo, left_hi) > 0:
+                cost += box_volume(lo, left_hi)
+            if counts.count(right_lo, hi) > 0:
+                cost += box_volume(right_lo, hi)
+            key = (cost, abs(p - mid))
+            if best is None or key < best[0]:
+                best = (key, a, p)
+
+    if best is None:
+        return None
+    return best[0][0], best[1], best[2]
+
+
+def kd_partition(cells: np.ndarray, min_cells: int, max_cells: int,
+        min_gain=0.125):
+    """Split a grid of cells (indexed [z, y, x], 1 where a cell has relevant
+    voxels) into boxes along planes that separate empty from relevant cells.
+
+    Every box is at most max_cells along each axis, and a box is only split
+    further if that leaves out at least min_gain of its volume as empty boxes.
+    Boxes are kept at least min_cells thick, unless the grid itself is thinner.
+
+    Returns a list of (lo, hi) boxes in cell coords, (x, y, z), covering the grid
+    without overlap.
+    """
+    assert min_cells >= 1 and max_cells >= 2 * min_cells
+
+    counts = CellCounts(cells)
+    dims = (cells.shape[2], cells.shape[1], cells.shape[0])
+
+    leaves = []
+    stack = [((0, 0, 0), dims)]
+    while stack:
+        lo, hi = stack.pop()
+        size = [h - l for l, h in zip(lo, hi)]
+        vol = box_volume(lo, hi)
+        occupied = counts.count(lo, hi)
+        too_big = any(s > max_cells for s in size)
+
+        split = None
+        if too_big or 0 < occupied < vol:
+            split = best_split(counts, lo, hi, min_cells)
+
+        if split is not None and not too_big and split[0] > vol * (1.0 - min_gain):
+            split = None
+
+        if split is not None and too_big and split[0] >= vol:
+            # no empty space to cut off, tile the longest axis at max_cells
+            # (or halve it if the rest would be too thin).
+            a = int(np.argmax(size))
+            p = lo[a] + max_cells
+            if size[a] - max_cells < min_cells:
+                p = lo[a] + size[a] // 2
+            split = (vol, a, p)
+
+        if split is None:
+            leaves.append((lo, hi))
+            continue
+
+        _, a, p = split
+        left_hi = list(hi)
+        left_hi[a] = p
+        right_lo = list(lo)
+        right_lo[a] = p
+        stack.append((tuple(right_lo), hi))
+        stack.append((lo, tuple(left_hi)))
+
+    return leaves
@@ -7,6 +7,7 @@ import numba
 from numba import jit, njit, autojit, config, threading_layer
 
 import indexfile
+import kdpartition
 import volume
 
 #config.THREADING_LAYER = 'tbb'
@@ -28,6 +29,18 @@ def parse_args(args):
 
     parser.add_argument("--tf", default='', type=str, help="Transfer function")
 
+    parser.add_argument("--brick", default=8, type=int,
+            help="Side of the occupancy sub-bricks in voxels (0 for none)")
+
+    parser.add_argument("--kd", action='store_true',
+            help="Adaptive kd partition instead of bx*by*bz equal blocks")
+    parser.add_argument("--min-block", default=16, type=int,
+            help="Smallest kd block side in voxels")
+    parser.add_argument("--max-block", default=128, type=int,
+            help="Largest kd block side in voxels")
+    parser.add_argument("--align", default=8, type=int,
+            help="kd block starts and sides are multiples of this many voxels")
+
     return parser.parse_args(args)
 
 
@@ -58,6 +71,34 @@ def run_volume(fd, num_vox):
     return vol_min, vol_max, vol_tot
 
 
+@njit(fastmath=True)
+def relevance_jit(xp, yp, x):
+    """Opacity of normalized value x from the transfer function (xp, yp)
+    """
+    #if x <= xp[0]:
+    #    return yp[0]
+
+    max_idx = len(xp) - 1
+
+    #if x >= xp[-1]:
+    #    return yp[-1]
+
+    idx = int((x * max_idx) + 0.5)
+
+    if idx > max_idx:
+        k0 = int(max_idx - 1)
+        k1 = int(max_idx)
+    elif idx == 0:
+        k0 = int(0)
+        k1 = int(1)
+    else:
+        k0 = int(idx - 1)
+        k1 = int(idx)
+
+    d = (x - xp[k0]) / (xp[k1] - xp[k0])
+    return numba.float64(yp[k0] * (1.0 - d) + yp[k1] * d)
+
+
 @njit(fastmath=True, parallel=True)
 def block_analysis_jit(fd, xp, yp,
                      vmin: np.float64, vmax: np.float64,
@@ -74,32 +115,273 @@ def block_analysis_jit(fd, xp, yp,
 
         if bI < bcount[0] and bJ < bcount[1] and bK < bcount[2]:
             x = numba.float64((fd[i] - vmin) / diff)
+            rel = relevance_jit(xp, yp, x)
 
-            #if x <= xp[0]:
-            #    return yp[0]
+            bIdx = bI + bcount[0] * (bJ + bK * bcount[1])
+            blocks[bIdx] += rel
 
-            max_idx = len(xp) - 1
 
-            #if x >= xp[-1]:
-            #    return yp[-1]
+@njit(fastmath=True)
+def block_occupied_jit(fd, xp, yp,
+                     vmin: np.float64, vmax: np.float64,
+                     vdims: np.ndarray, bdims: np.ndarray,
+                     bcount: np.ndarray,
+                     omin: np.ndarray, omax: np.ndarray,
+                     brick, brick_count: np.ndarray, bricks: np.ndarray):
+    diff = vmax - vmin
+    num_vox = np.prod(vdims)
+    bx = numba.uint64(bdims[0])
+    by = numba.uint64(bdims[1])
+    bz = numba.uint64(bdims[2])
+
+    # not parallel, the box updates of a block would race.
+    for i in range(num_vox):
+        vI = numba.uint64(i % vdims[0])
+        vJ = numba.uint64((i // vdims[0]) % vdims[1])
+        vK = numba.uint64((i // vdims[0]) // vdims[1])
+        bI = vI // bx
+        bJ = vJ // by
+        bK = vK // bz
+
+        if bI < bcount[0] and bJ < bcount[1] and bK < bcount[2]:
+            x = numba.float64((fd[i] - vmin) / diff)
+            if relevance_jit(xp, yp, x) > 0.0:
+                bIdx = bI + bcount[0] * (bJ + bK * bcount[1])
+                # block local voxel coords
+                lx = vI - bI * bx
+                ly = vJ - bJ * by
+                lz = vK - bK * bz
+                omin[bIdx, 0] = min(omin[bIdx, 0], lx)
+                omin[bIdx, 1] = min(omin[bIdx, 1], ly)
+                omin[bIdx, 2] = min(omin[bIdx, 2], lz)
+                omax[bIdx, 0] = max(omax[bIdx, 0], lx + 1)
+                omax[bIdx, 1] = max(omax[bIdx, 1], ly + 1)
+                omax[bIdx, 2] = max(omax[bIdx, 2], lz + 1)
+                if brick > 0:
+                    rI = lx // brick
+                    rJ = ly // brick
+                    rK = lz // brick
+                    bricks[bIdx, rI + brick_count[0] * (rJ + rK * brick_count[1])] = 1
 
-            idx = int((x * max_idx) + 0.5)
 
-            if idx > max_idx:
-                k0 = int(max_idx - 1)
-                k1 = int(max_idx)
-            elif idx == 0:
-                k0 = int(0)
-                k1 = int(1)
-            else:
-                k0 = int(idx - 1)
-                k1 = int(idx)
+@njit(fastmath=True)
+def block_minmax_jit(fd, vdims: np.ndarray, bdims: np.ndarray,
+                     bcount: np.ndarray,
+                     bmin: np.ndarray, bmax: np.ndarray):
+    num_vox = np.prod(vdims)
 
-            d = (x - xp[k0]) / (xp[k1] - xp[k0])
-            rel = numba.float64(yp[k0] * (1.0 - d) + yp[k1] * d)
+    # not parallel, the min/max updates of a block would race.
+    for i in range(num_vox):
+        bI = numba.uint64((i % vdims[0]) / bdims[0])
+        bJ = numba.uint64(((i / vdims[0]) % vdims[1]) / bdims[1])
+        bK = numba.uint64(((i / vdims[0]) / vdims[1]) / bdims[2])
 
+        if bI < bcount[0] and bJ < bcount[1] and bK < bcount[2]:
+            x = numba.float64(fd[i])
             bIdx = bI + bcount[0] * (bJ + bK * bcount[1])
-            blocks[bIdx] += rel
+            if x < bmin[bIdx]:
+                bmin[bIdx] = x
+            if x > bmax[bIdx]:
+                bmax[bIdx] = x
+
+
+def run_block_minmax(fd,
+        vdims: np.ndarray,
+        bdims: np.ndarray,
+        bcount: np.ndarray):
+    """Find the min and max voxel value of each block, returned as two lists of np.float64
+    """
+    bmin = np.full(np.prod(bcount), np.inf, dtype=np.float64)
+    bmax = np.full(np.prod(bcount), -np.inf, dtype=np.float64)
+    start = time.time()
+    block_minmax_jit(fd, vdims, bdims, bcount, bmin, bmax)
+    mmend = time.time()
+    print(f"Block min/max time: {mmend - start}")
+
+    return bmin, bmax
+
+
+def run_block_occupied(fd,
+        xp: np.ndarray,
+        yp: np.ndarray,
+        vmin: np.float64,
+        vmax: np.float64,
+        vdims: np.ndarray,
+        bdims: np.ndarray,
+        bcount: np.ndarray,
+        brick: int):
+    """Find the box of relevant voxels in each block, returned as two (n, 3) arrays
+    of block local voxel coords: the min corner and one past the max corner.
+    Blocks without relevant voxels get an empty box (all zeros).
+
+    Also returns the occupancy mask of each block's brick^3 sub-bricks as a hex
+    string, bit n set if sub-brick n has a relevant voxel (bit n%8 of byte n/8,
+    sub-bricks numbered like blocks), or None if brick is 0.
+    """
+    nblk = int(np.prod(bcount))
+    omin = np.empty((nblk, 3), dtype=np.uint64)
+    omin[:] = np.array(bdims, dtype=np.uint64)
+    omax = np.zeros((nblk, 3), dtype=np.uint64)
+    brick_count = np.ones(3, dtype=np.uint64)
+    if brick > 0:
+        brick_count = np.array(-(-np.array(bdims, dtype=np.int64) // brick),
+                dtype=np.uint64)
+    bricks = np.zeros((nblk, int(np.prod(brick_count))), dtype=np.uint8)
+    start = time.time()
+    block_occupied_jit(fd, xp, yp, vmin, vmax, vdims, bdims, bcount, omin, omax,
+            np.uint64(brick), brick_count, bricks)
+    occend = time.time()
+    print(f"Block occupied box time: {occend - start}")
+
+    empty = np.any(omax == 0, axis=1)
+    omin[empty] = 0
+    occ = np.prod(omax.astype(np.float64) - omin, axis=1)
+    print(f"Occupied fraction of block voxels: {np.sum(occ) / (nblk * np.prod(bdims))}")
+
+    occ_bits = None
+    if brick > 0:
+        print(f"Occupied fraction of sub-bricks: {np.mean(bricks)}")
+        packed = np.packbits(bricks, axis=1, bitorder='little')
+        occ_bits = [row.tobytes().hex() for row in packed]
+
+    return omin, omax, occ_bits
+
+
+def tf_empty_value(xp: np.ndarray, yp: np.ndarray):
+    """A normalized value the transfer function makes fully transparent, used for
+    the voxels of skipped sub-bricks, or None if there is none. Prefers the middle
+    of a transparent segment over a single transparent point.
+    """
+    zero = np.flatnonzero(yp == 0.0)
+    if len(zero) == 0:
+        return None
+    for a, b in zip(zero[:-1], zero[1:]):
+        if b == a + 1:
+            return float((xp[a] + xp[b]) * 0.5)
+    return float(xp[zero[0]])
+
+
+@njit(fastmath=True)
+def cell_occupied_jit(fd, xp, yp,
+                     vmin: np.float64, vmax: np.float64,
+                     vdims: np.ndarray, cell, cells: np.ndarray):
+    diff = vmax - vmin
+    num_vox = np.prod(vdims)
+
+    for i in range(num_vox):
+        vI = numba.uint64(i % vdims[0])
+        vJ = numba.uint64((i // vdims[0]) % vdims[1])
+        vK = numba.uint64((i // vdims[0]) // vdims[1])
+        x = numba.float64((fd[i] - vmin) / diff)
+        if relevance_jit(xp, yp, x) > 0.0:
+            cells[vK // cell, vJ // cell, vI // cell] = 1
+
+
+@njit(fastmath=True)
+def box_analysis_jit(sub, xp, yp,
+                     vmin: np.float64, vmax: np.float64,
+                     omin: np.ndarray, omax: np.ndarray,
+                     brick, bricks: np.ndarray):
+    """Relevance total, min and max value, occupied box and sub-brick bits of the
+    voxels of one block, sub indexed [z, y, x]
+    """
+    diff = vmax - vmin
+    rel_tot = numba.float64(0.0)
+    mn = numba.float64(np.inf)
+    mx = numba.float64(-np.inf)
+    nz, ny, nx = sub.shape
+
+    for k in range(nz):
+        for j in range(ny):
+            for i in range(nx):
+                v = numba.float64(sub[k, j, i])
+                mn = min(mn, v)
+                mx = max(mx, v)
+                rel = relevance_jit(xp, yp, (v - vmin) / diff)
+                rel_tot += rel
+                if rel > 0.0:
+                    omin[0] = min(omin[0], i)
+                    omin[1] = min(omin[1], j)
+                    omin[2] = min(omin[2], k)
+                    omax[0] = max(omax[0], i + 1)
+                    omax[1] = max(omax[1], j + 1)
+                    omax[2] = max(omax[2], k + 1)
+                    if brick > 0:
+                        bricks[k // brick, j // brick, i // brick] = 1
+
+    return rel_tot, mn, mx
+
+
+def run_kd_blocks(fd,
+        xp: np.ndarray,
+        yp: np.ndarray,
+        vmin: np.float64,
+        vmax: np.float64,
+        vdims: np.ndarray,
+        min_block: int,
+        max_block: int,
+        align: int,
+        brick: int):
+    """Partition the volume into variable size blocks with kd splits that cut off
+    empty space, then run the block analysis on each of them.
+
+    Block starts and sides are multiples of align voxels (except at the far faces
+    of the volume), and sides are between min_block and max_block voxels.
+    Returns the block starts and extents in voxels, and the same per block lists
+    as run_block, run_block_minmax and run_block_occupied.
+    """
+    start = time.time()
+    cdims = -(-vdims.astype(np.int64) // align)
+    cells = np.zeros((cdims[2], cdims[1], cdims[0]), dtype=np.uint8)
+    cell_occupied_jit(fd, xp, yp, vmin, vmax, vdims, np.uint64(align), cells)
+
+    leaves = kdpartition.kd_partition(cells, max(1, min_block // align),
+            max(2, max_block // align))
+    kdend = time.time()
+    print(f"kd partition time: {kdend - start}, {len(leaves)} blocks")
+
+    vox = fd.reshape((int(vdims[2]), int(vdims[1]), int(vdims[0])))
+    starts = []
+    exts = []
+    rels = []
+    mins = []
+    maxs = []
+    occ_mins = []
+    occ_maxs = []
+    occ_bits = [] if brick > 0 else None
+    for lo, hi in leaves:
+        s = np.array(lo, dtype=np.uint64) * np.uint64(align)
+        e = np.minimum(np.array(hi, dtype=np.uint64) * np.uint64(align), vdims) - s
+        sub = vox[s[2]:s[2] + e[2], s[1]:s[1] + e[1], s[0]:s[0] + e[0]]
+
+        omin = e.copy()
+        omax = np.zeros(3, dtype=np.uint64)
+        bcount = -(-e.astype(np.int64) // max(brick, 1))
+        bricks = np.zeros((bcount[2], bcount[1], bcount[0]), dtype=np.uint8)
+        rel_tot, mn, mx = box_analysis_jit(sub, xp, yp, vmin, vmax, omin, omax,
+                brick, bricks)
+        if np.any(omax == 0):
+            omin[:] = 0
+
+        starts.append(s)
+        exts.append(e)
+        rels.append(rel_tot / np.prod(e))
+        mins.append(mn)
+        maxs.append(mx)
+        occ_mins.append(omin)
+        occ_maxs.append(omax)
+        if brick > 0:
+            occ_bits.append(np.packbits(bricks.ravel(), bitorder='little')
+                    .tobytes().hex())
+
+    blkend = time.time()
+    print(f"kd block analysis time: {blkend - kdend}")
+
+    occ = sum(np.prod(omax.astype(np.float64) - omin)
+            for omin, omax in zip(occ_mins, occ_maxs))
+    print(f"Occupied fraction of volume voxels: {occ / np.prod(vdims)}")
+
+    return starts, exts, rels, mins, maxs, occ_mins, occ_maxs, occ_bits
 
 
 def run_block(fd,
@@ -143,8 +425,26 @@ def main():
     print('Running volume analysis')
     vol_min, vol_max, vol_tot = run_volume(fd, np.prod(vdims))
 
-    print('Running relevance analysis')
-    relevancies = run_block(fd, tf_x, tf_y, vol_min, vol_max, vdims, bdims, bcount)
+    if cargs.kd:
+        print('Running kd partition and block analysis')
+        (kd_starts, kd_exts, relevancies, blk_mins, blk_maxs,
+                occ_mins, occ_maxs, occ_bits) = run_kd_blocks(fd, tf_x, tf_y,
+                        vol_min, vol_max, vdims, cargs.min_block, cargs.max_block,
+                        cargs.align, cargs.brick)
+        # the blocks are not a grid, list them along x.
+        bcount = np.array([len(kd_starts), 1, 1], dtype=np.uint64)
+        block_extent = vdims
+    else:
+        print('Running relevance analysis')
+        relevancies = run_block(fd, tf_x, tf_y, vol_min, vol_max, vdims, bdims, bcount)
+
+        print('Running block min/max analysis')
+        blk_mins, blk_maxs = run_block_minmax(fd, vdims, bdims, bcount)
+
+        print('Running block occupied box analysis')
+        occ_mins, occ_maxs, occ_bits = run_block_occupied(fd, tf_x, tf_y, vol_min,
+                vol_max, vdims, bdims, bcount, cargs.brick)
+
     rov_min = np.min(relevancies)
     rov_max = np.max(relevancies)
 
@@ -159,7 +459,12 @@ def main():
     vol = volume.Volume(world_dims, vdims.tolist(), rov_min, rov_max)
 
     idx_start = time.time()
-    blocks = indexfile.create_file_blocks(bcount, fd.dtype, vol, relevancies)
+    if cargs.kd:
+        blocks = indexfile.create_kd_file_blocks(kd_starts, kd_exts, fd.dtype, vol,
+                relevancies, blk_mins, blk_maxs, occ_mins, occ_maxs, occ_bits)
+    else:
+        blocks = indexfile.create_file_blocks(bcount, fd.dtype, vol, relevancies,
+                blk_mins, blk_maxs, occ_mins, occ_maxs, occ_bits)
 
     ifile = indexfile.IndexFile(**{
         'world_dims': world_dims,
@@ -172,6 +477,9 @@ def main():
         'num_blocks': bcount,
         'blocks_extent': block_extent,
         'blocks': blocks,
+        'occ_brick': cargs.brick if occ_bits is not None else None,
+        'empty_val': tf_empty_value(tf_x, tf_y),
+        'partition': 'kd' if cargs.kd else None,
         })
     ifile.write(cargs.out)
     idx_end = time.time()
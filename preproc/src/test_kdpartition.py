@@ -0,0 +1,74 @@
+"""Tests for kdpartition, run with: python3 -m unittest test_kdpartition
+from this directory.
+"""
+import itertools
+import unittest
+
+import numpy as np
+
+import kdpartition
+
+
+def cells_of(boxes, dims):
+    """How many boxes cover each cell of a grid of dims (x, y, z)."""
+    cover = np.zeros((dims[2], dims[1], dims[0]), dtype=np.int64)
+    for lo, hi in boxes:
+        cover[lo[2]:hi[2], lo[1]:hi[1], lo[0]:hi[0]] += 1
+    return cover
+
+
+class CellCountsTest(unittest.TestCase):
+
+    def test_counts_match_brute_force(self):
+        rng = np.random.default_rng(7)
+        cells = (rng.random((4, 5, 6)) < 0.3).astype(np.uint8)
+        counts = kdpartition.CellCounts(cells)
+        for lo in itertools.product(range(0, 6, 2), range(0, 5, 2), range(0, 4, 2)):
+            for hi in itertools.product(range(lo[0], 7, 3), range(lo[1], 6, 3),
+                                        range(lo[2], 5, 3)):
+                expected = cells[lo[2]:hi[2], lo[1]:hi[1], lo[0]:hi[0]].sum()
+                self.assertEqual(counts.count(lo, hi), expected)
+
+
+class KdPartitionTest(unittest.TestCase):
+
+    def check_cover(self, boxes, dims):
+        # every cell is in exactly one box.
+        self.assertTrue((cells_of(boxes, dims) == 1).all())
+
+    def test_empty_and_full_grids_stay_whole(self):
+        for fill in (0, 1):
+            cells = np.full((8, 8, 8), fill, dtype=np.uint8)
+            boxes = kdpartition.kd_partition(cells, 1, 8)
+            self.assertEqual(boxes, [((0, 0, 0), (8, 8, 8))])
+
+    def test_cuts_off_empty_space(self):
+        # a 2^3 occupied corner in an 8^3 grid.
+        cells = np.zeros((8, 8, 8), dtype=np.uint8)
+        cells[:2, :2, :2] = 1
+        boxes = kdpartition.kd_partition(cells, 1, 8)
+        self.check_cover(boxes, (8, 8, 8))
+
+        counts = kdpartition.CellCounts(cells)
+        kept = [b for b in boxes if counts.count(*b) > 0]
+        self.assertEqual(sum(kdpartition.box_volume(*b) for b in kept), 8)
+
+    def test_boxes_respect_the_size_limits(self):
+        rng = np.random.default_rng(3)
+        cells = (rng.random((10, 12, 20)) < 0.1).astype(np.uint8)
+        min_cells, max_cells = 2, 6
+        boxes = kdpartition.kd_partition(cells, min_cells, max_cells)
+        self.check_cover(boxes, (20, 12, 10))
+        for lo, hi in boxes:
+            for l, h in zip(lo, hi):
+                self.assertLessEqual(h - l, max_cells)
+                self.assertGreaterEqual(h - l, min_cells)
+
+    def test_grid_thinner_than_min_cells(self):
+        cells = np.ones((1, 3, 16), dtype=np.uint8)
+        boxes = kdpartition.kd_partition(cells, 2, 4)
+        self.check_cover(boxes, (16, 3, 1))
+
+
+if __name__ == '__main__':
+    unittest.main()
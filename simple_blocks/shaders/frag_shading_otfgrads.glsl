@@ -7,6 +7,10 @@ uniform sampler3D volume_sampler;
 uniform sampler1D tf_sampler;
 uniform float tfScalingVal;
 
+// Where this block lives in the atlas texture bound to volume_sampler.
+uniform vec3 tex_offset;
+uniform vec3 tex_scale;
+
 uniform float n;   // n_shiney!
 uniform vec3  L;    // light vector (expected normalized)
 uniform vec3  V;    // viewing vector (expected normalized)
@@ -17,17 +21,22 @@ const vec3 col_diffuse = vec3(1, 1, 1);
 const vec3 col_spec = vec3(1, 1, 1);
 const vec3 stepSize = vec3(0.01, 0.01, 0.01);
 
+// Sample the block at block-local tex coord p, staying inside the block's slot.
+float sampleBlock(vec3 p) {
+	return texture(volume_sampler, tex_offset + tex_scale*clamp(p, 0.0, 1.0)).x;
+}
+
 void main() {
     
-	float volVal = texture(volume_sampler, vcol).x;
+	float volVal = sampleBlock(vcol);
 	
 	// compute the gradient
-	float Xp = texture(volume_sampler, vcol.xyz + vec3(+stepSize.x, 0, 0)).x;
-	float Xm = texture(volume_sampler, vcol.xyz + vec3(-stepSize.x, 0, 0)).x;
-	float Yp = texture(volume_sampler, vcol.xyz + vec3(0, -stepSize.y, 0)).x;
-	float Ym = texture(volume_sampler, vcol.xyz + vec3(0, +stepSize.y, 0)).x;
-	float Zp = texture(volume_sampler, vcol.xyz + vec3(0, 0, +stepSize.z)).x;
-	float Zm = texture(volume_sampler, vcol.xyz + vec3(0, 0, -stepSize.z)).x;
+	float Xp = sampleBlock(vcol.xyz + vec3(+stepSize.x, 0, 0));
+	float Xm = sampleBlock(vcol.xyz + vec3(-stepSize.x, 0, 0));
+	float Yp = sampleBlock(vcol.xyz + vec3(0, -stepSize.y, 0));
+	float Ym = sampleBlock(vcol.xyz + vec3(0, +stepSize.y, 0));
+	float Zp = sampleBlock(vcol.xyz + vec3(0, 0, +stepSize.z));
+	float Zm = sampleBlock(vcol.xyz + vec3(0, 0, -stepSize.z));
 	vec3 grad3 = normalize(vec3((Xm - Xp) * 0.5, (Yp - Ym) * 0.5, (Zm - Zp) * 0.5));
 
     // fetch color from transfer function
@@ -11,8 +11,12 @@ uniform sampler3D volume_sampler;
 uniform sampler1D tf_sampler;
 uniform float tfScalingVal;
 
+// Where this block lives in the atlas texture bound to volume_sampler.
+uniform vec3 tex_offset;
+uniform vec3 tex_scale;
+
 void main() {
-	float volVal = texture(volume_sampler, vcol).x;
+	float volVal = texture(volume_sampler, tex_offset + tex_scale*clamp(vcol, 0.0, 1.0)).x;
 	color = texture(tf_sampler, volVal*tfScalingVal);
 
 //  	color = vec4(volVal, volVal, volVal, volVal) * 1.5f;
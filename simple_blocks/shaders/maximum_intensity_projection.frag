@@ -42,6 +42,9 @@ uniform float step_length;
 //uniform float threshold;
 
 uniform sampler3D volume;
+// Where this block lives in the atlas texture bound to volume.
+uniform vec3 tex_offset;
+uniform vec3 tex_scale;
 //uniform sampler2D jitter;
 
 uniform float gamma;
@@ -58,13 +61,19 @@ struct AABB {
     vec3 bottom;
 };
 
+// Sample the block at block-local position, staying inside the block's slot.
+float sample_block(vec3 position)
+{
+    return texture(volume, tex_offset + tex_scale * clamp(position, 0.0, 1.0)).r;
+}
+
 // Estimate normal from a finite difference approximation of the gradient
 vec3 normal(vec3 position, float intensity)
 {
     float d = step_length;
-    float dx = texture(volume, position + vec3(d,0,0)).r - intensity;
-    float dy = texture(volume, position + vec3(0,d,0)).r - intensity;
-    float dz = texture(volume, position + vec3(0,0,d)).r - intensity;
+    float dx = sample_block(position + vec3(d,0,0)) - intensity;
+    float dy = sample_block(position + vec3(0,d,0)) - intensity;
+    float dz = sample_block(position + vec3(0,0,d)) - intensity;
     return -normalize(NormalMatrix * vec3(dx, dy, dz));
 }
 
@@ -121,7 +130,7 @@ void main()
     // Ray march until reaching the end of the volume
     while (ray_length > 0) {
 
-        float intensity = texture(volume, position).r;
+        float intensity = sample_block(position);
 
         if (intensity > maximum_intensity) {
             maximum_intensity = intensity;
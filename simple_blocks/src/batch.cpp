@@ -0,0 +1,579 @@
+#include "batch.h"
+#include "colormap.h"
+#include "renderhelp.h"
+#include "messages/messagebroker.h"
+
+#include <bd/log/logger.h>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <thread>
+
+namespace subvol
+{
+
+namespace
+{
+
+/// Time between checks of the classification and the loader.
+std::chrono::milliseconds const POLL_INTERVAL{ 5 };
+
+/// An empty load queue with no block loaded for this long means the rest of
+/// the blocks in view will not load (they do not fit in main memory).
+double const STALL_MS{ 1000.0 };
+
+
+double
+msSince(std::chrono::steady_clock::time_point const &start)
+{
+  return std::chrono::duration<double, std::milli>(
+      std::chrono::steady_clock::now()-start).count();
+}
+
+
+char const *
+to_string(BatchRunner::Wait w)
+{
+  switch (w) {
+    case BatchRunner::Wait::Resident:
+      return "resident";
+    case BatchRunner::Wait::Stalled:
+      return "stalled";
+    case BatchRunner::Wait::Timeout:
+    default:
+      return "timeout";
+  }
+}
+
+
+/// \brief Read \c n values, and nothing more, from the rest of the line.
+template<class T>
+bool
+readArgs(std::istream &in, T *values, int n)
+{
+  for (int i{ 0 }; i<n; ++i) {
+    if (!( in >> values[i] )) {
+      return false;
+    }
+  }
+  in >> std::ws;
+  return in.eof();
+}
+
+
+bool
+readVec3(std::istream &in, glm::vec3 &v)
+{
+  float xyz[3];
+  if (!readArgs(in, xyz, 3)) {
+    return false;
+  }
+  v = { xyz[0], xyz[1], xyz[2] };
+  return true;
+}
+
+
+/// \brief Read a view count and then \c n floats.
+bool
+readPath(std::istream &in, int &views, float *values, int n)
+{
+  return ( in >> views ) && readArgs(in, values, n);
+}
+
+
+bool
+makeDirectory(std::string const &path)
+{
+  if (mkdir(path.c_str(), 0755)!=0 && errno!=EEXIST) {
+    bd::Err() << "Could not make the directory " << path << ".";
+    return false;
+  }
+  return true;
+}
+
+} // namespace
+
+
+///////////////////////////////////////////////////////////////////////////////
+BatchScript::BatchScript()
+    : m_frames{ }
+{
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+BatchScript::~BatchScript()
+{
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+bool
+BatchScript::open(std::string const &path, BatchFrame const &initial)
+{
+  std::ifstream f{ path };
+  if (!f.is_open()) {
+    bd::Err() << "Could not open the batch script " << path << ".";
+    return false;
+  }
+  return parse(f, initial);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+bool
+BatchScript::parse(std::istream &in, BatchFrame const &initial)
+{
+  m_frames.clear();
+  BatchFrame current{ initial };
+
+  std::string line;
+  int lineNumber{ 0 };
+  while (std::getline(in, line)) {
+    ++lineNumber;
+    std::istringstream words{ line.substr(0, line.find('#')) };
+    std::string cmd;
+    if (!( words >> cmd )) {
+      continue;
+    }
+
+    bool ok{ true };
+    if (cmd=="size") {
+      int wh[2];
+      ok = readArgs(words, wh, 2) && wh[0]>0 && wh[1]>0;
+      if (ok) {
+        current.width = static_cast<unsigned int>(wh[0]);
+        current.height = static_cast<unsigned int>(wh[1]);
+      }
+    } else if (cmd=="background") {
+      glm::vec3 rgb;
+      ok = readVec3(words, rgb);
+      current.background = { rgb, 1.0f };
+    } else if (cmd=="colormap") {
+      ok = readArgs(words, &current.colorMap, 1);
+    } else if (cmd=="scale") {
+      ok = readArgs(words, &current.scale, 1) && current.scale>0.0f;
+    } else if (cmd=="rov") {
+      double range[2];
+      ok = readArgs(words, range, 2) && range[0]<=range[1];
+      current.rovMin = range[0];
+      current.rovMax = range[1];
+    } else if (cmd=="eye") {
+      ok = readVec3(words, current.eye);
+    } else if (cmd=="lookat") {
+      ok = readVec3(words, current.lookAt);
+    } else if (cmd=="up") {
+      ok = readVec3(words, current.up);
+    } else if (cmd=="render") {
+      std::string name;
+      words >> name >> std::ws;
+      ok = words.eof();
+      if (ok) {
+        addFrame(current, name);
+      }
+    } else if (cmd=="orbit") {
+      int views{ 0 };
+      float args[4]{ 0.0f, 0.0f, 1.0f, 0.0f };
+      std::streampos const start{ words.tellg() };
+      if (!readPath(words, views, args, 4)) {
+        // without an axis, about the y axis.
+        words.clear();
+        words.seekg(start);
+        args[1] = 0.0f;
+        args[2] = 1.0f;
+        args[3] = 0.0f;
+        ok = readPath(words, views, args, 1);
+      }
+      glm::vec3 const axis{ args[1], args[2], args[3] };
+      ok = ok && views>0 && glm::length(axis)>0.0f;
+      if (ok) {
+        glm::vec3 const arm{ current.eye-current.lookAt };
+        glm::vec3 const up{ current.up };
+        for (int i{ 1 }; i<=views; ++i) {
+          glm::mat4 const rotation{
+              glm::rotate(glm::mat4{ 1 }, glm::radians(args[0]*i/views), axis) };
+          current.eye = current.lookAt+glm::vec3{ rotation*glm::vec4{ arm, 0 } };
+          current.up = glm::vec3{ rotation*glm::vec4{ up, 0 } };
+          addFrame(current, "");
+        }
+      }
+    } else if (cmd=="fly") {
+      int views{ 0 };
+      float to[3];
+      ok = readPath(words, views, to, 3) && views>0;
+      if (ok) {
+        glm::vec3 const from{ current.eye };
+        for (int i{ 1 }; i<=views; ++i) {
+          current.eye = glm::mix(from, glm::vec3{ to[0], to[1], to[2] },
+                                 i/static_cast<float>(views));
+          addFrame(current, "");
+        }
+      }
+    } else {
+      bd::Err() << "Batch script line " << lineNumber << ": unknown command "
+                << cmd << ".";
+      m_frames.clear();
+      return false;
+    }
+
+    if (!ok) {
+      bd::Err() << "Batch script line " << lineNumber << ": bad arguments for "
+                << cmd << ": " << line;
+      m_frames.clear();
+      return false;
+    }
+  }
+
+  return true;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+std::vector<BatchFrame> const &
+BatchScript::frames() const
+{
+  return m_frames;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+void
+BatchScript::addFrame(BatchFrame const &current, std::string const &name)
+{
+  m_frames.push_back(current);
+  if (name.empty()) {
+    std::ostringstream ss;
+    ss << "frame_" << std::setw(4) << std::setfill('0') << m_frames.size()-1;
+    m_frames.back().name = ss.str();
+  } else {
+    m_frames.back().name = name;
+  }
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+BatchRunner::BatchRunner(std::shared_ptr<BlockCollection> collection,
+                         BlockLoader *loader,
+                         std::shared_ptr<renderer::CpuRaycaster> renderer,
+                         CommandLineOptions const &clo)
+    : Recipient("batch runner")
+    , m_collection{ std::move(collection) }
+    , m_loader{ loader }
+    , m_renderer{ std::move(renderer) }
+    , m_outDir{ clo.batchOutDir.empty() ? "." : clo.batchOutDir }
+    , m_timeoutMs{ clo.batchTimeout*1000.0 }
+    , m_haveRange{ false }
+    , m_rovMin{ 0 }
+    , m_rovMax{ 0 }
+    , m_colorMap{ }
+    , m_scale{ 0.0f }
+    , m_reports{ }
+    , m_statsMutex{ }
+    , m_stats{ }
+{
+  m_stats.CpuCacheSize = 0;
+  m_stats.CancelledLoads = 0;
+  m_stats.WastedBytes = 0;
+  Broker::subscribeRecipient(this);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+BatchRunner::~BatchRunner()
+{
+  Broker::unsubscribeRecipient(this);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+BatchFrame
+BatchRunner::currentFrame() const
+{
+  bd::Camera const &cam{ m_renderer->getCamera() };
+  BatchFrame f;
+  f.eye = cam.getEye();
+  f.lookAt = cam.getLookAt();
+  f.up = cam.getUp();
+  f.rovMin = renderhelp::g_rovMin;
+  f.rovMax = renderhelp::g_rovMax;
+  f.scale = m_renderer->getColorMapScaleValue();
+  f.width = m_renderer->getViewPortWidth();
+  f.height = m_renderer->getViewPortHeight();
+  f.background = m_renderer->getBackgroundColor();
+  return f;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+bool
+BatchRunner::run(std::vector<BatchFrame> const &frames)
+{
+  std::vector<std::string> const maps{ ColorMapManager::getMapNameStrings() };
+  for (BatchFrame const &f : frames) {
+    if (!f.colorMap.empty() &&
+        std::find(maps.begin(), maps.end(), f.colorMap)==maps.end()) {
+      bd::Err() << "View " << f.name << " uses the color map " << f.colorMap
+                << ", which does not exist.";
+      return false;
+    }
+  }
+
+  if (!makeDirectory(m_outDir)) {
+    return false;
+  }
+
+  bool ok{ true };
+  size_t notResident{ 0 };
+  m_reports.clear();
+  for (BatchFrame const &f : frames) {
+    m_reports.push_back(FrameReport{ });
+    FrameReport &r{ m_reports.back() };
+    ok = renderFrame(f, r) && ok;
+    if (r.wait!=Wait::Resident) {
+      ++notResident;
+    }
+
+    bd::Info() << "Batch view " << f.name << ": " << r.resident << "/"
+               << r.inView << " blocks in view resident (" << to_string(r.wait)
+               << "), waited " << r.classifyMs+r.loadMs << " ms, rendered in "
+               << r.renderMs << " ms.";
+  }
+
+  std::string const reportPath{ m_outDir+"/batch_report.csv" };
+  std::ofstream report{ reportPath };
+  if (!report.is_open()) {
+    bd::Err() << "Could not open " << reportPath << " for writing.";
+    return false;
+  }
+  writeReport(report);
+
+  bd::Info() << "Rendered " << frames.size() << " batch views to " << m_outDir
+             << ", " << notResident << " without all of their blocks.";
+  return ok;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+bool
+BatchRunner::renderFrame(BatchFrame const &frame, FrameReport &report)
+{
+  report.name = frame.name;
+  report.rovMin = frame.rovMin;
+  report.rovMax = frame.rovMax;
+
+  m_renderer->setViewport(frame.width, frame.height);
+  m_renderer->setBackgroundColor(frame.background);
+  if (!frame.colorMap.empty() &&
+      frame.colorMap!=ColorMapManager::getCurrentMapName()) {
+    m_renderer->setColorMap(ColorMapManager::getMapByName(frame.colorMap));
+  }
+  m_renderer->setColorMapScaleValue(frame.scale);
+
+  bd::Camera &cam{ m_renderer->getCamera() };
+  cam.setEye(frame.eye);
+  cam.setLookAt(frame.lookAt);
+  cam.setUp(frame.up);
+  m_renderer->setViewMatrix(cam.createViewMatrix());
+
+  auto const start = std::chrono::steady_clock::now();
+  bool classified{ classify(frame.rovMin, frame.rovMax, m_timeoutMs) };
+
+  // re-estimate how opaque the blocks are when the transfer function
+  // changes, as the interactive loop does.
+  std::string const &tfName{ ColorMapManager::getCurrentMapName() };
+  if (tfName!=m_colorMap || frame.scale!=m_scale) {
+    m_colorMap = tfName;
+    m_scale = frame.scale;
+    std::vector<float> alpha;
+    for (glm::vec4 const &k : ColorMapManager::getMapByName(tfName).getKnots()) {
+      alpha.push_back(k.a);
+    }
+    m_collection->updateOpacity(alpha, frame.scale);
+  }
+
+  // cull the shown blocks and load the ones in view first.
+  glm::mat4 const viewProj{
+      m_renderer->getProjectionMatrix()*cam.createViewMatrix() };
+  m_collection->updateView(frame.eye, frame.lookAt, viewProj);
+  classified = classified && waitForView(m_timeoutMs-msSince(start));
+  report.classifyMs = msSince(start);
+
+  auto const loadStart = std::chrono::steady_clock::now();
+  report.wait = waitForBlocks(classified ? m_timeoutMs-report.classifyMs : 0.0,
+                              report);
+  report.loadMs = msSince(loadStart);
+
+  m_renderer->draw();
+  renderer::CpuRaycaster::FrameStats const &stats{ m_renderer->frameStats() };
+  report.renderMs = stats.ms;
+  report.samples = stats.samples;
+  report.loadQueue = m_loader->loadQueueSize();
+  {
+    std::unique_lock<std::mutex> lock(m_statsMutex);
+    report.cpuCacheBlocks = m_stats.CpuCacheSize;
+    report.cancelledLoads = m_stats.CancelledLoads;
+    report.wastedBytes = m_stats.WastedBytes;
+  }
+
+  return m_renderer->framebuffer().writePng(m_outDir+"/"+frame.name+".png");
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+bool
+BatchRunner::classify(double rovMin, double rovMax, double timeoutMs)
+{
+  if (m_haveRange && rovMin==m_rovMin && rovMax==m_rovMax) {
+    return true;
+  }
+  m_haveRange = true;
+  m_rovMin = rovMin;
+  m_rovMax = rovMax;
+
+  m_collection->setRangeMin(rovMin);
+  m_collection->setRangeMax(rovMax);
+  uint64_t const request{ m_collection->getRangeRequests() };
+  m_collection->updateBlockCache();
+
+  auto const start = std::chrono::steady_clock::now();
+  while (m_collection->getRangeServed()<request) {
+    if (msSince(start)>=timeoutMs) {
+      return false;
+    }
+    std::this_thread::sleep_for(POLL_INTERVAL);
+  }
+  return true;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+bool
+BatchRunner::waitForView(double timeoutMs)
+{
+  uint64_t const request{ m_collection->getViewRequests() };
+  auto const start = std::chrono::steady_clock::now();
+  while (m_collection->getViewServed()<request) {
+    if (msSince(start)>=timeoutMs) {
+      return false;
+    }
+    std::this_thread::sleep_for(POLL_INTERVAL);
+  }
+  return true;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+BatchRunner::Wait
+BatchRunner::waitForBlocks(double timeoutMs, FrameReport &report)
+{
+  auto const start = std::chrono::steady_clock::now();
+  size_t lastResident{ 0 };
+  double lastProgressMs{ 0.0 };
+  while (true) {
+    std::shared_ptr<BlockCollection::BlockList const> shown{
+        m_collection->getNonEmptyBlocks() };
+    std::shared_ptr<std::vector<uint8_t> const> inView{
+        m_collection->getInView() };
+
+    report.shown = shown->size();
+    report.inView = 0;
+    report.resident = 0;
+    for (bd::Block const *b : *shown) {
+      if (inView && !( *inView )[b->index()]) {
+        continue;
+      }
+      ++report.inView;
+      if (m_loader->isInMain(b->index())) {
+        ++report.resident;
+      }
+    }
+
+    if (report.resident==report.inView) {
+      return Wait::Resident;
+    }
+
+    double const elapsed{ msSince(start) };
+    if (report.resident!=lastResident) {
+      lastResident = report.resident;
+      lastProgressMs = elapsed;
+    } else if (m_loader->loadQueueSize()==0 &&
+        elapsed-lastProgressMs>=STALL_MS) {
+      return Wait::Stalled;
+    }
+    if (elapsed>=timeoutMs) {
+      return Wait::Timeout;
+    }
+    std::this_thread::sleep_for(POLL_INTERVAL);
+  }
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+std::vector<BatchRunner::FrameReport> const &
+BatchRunner::reports() const
+{
+  return m_reports;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+void
+BatchRunner::writeReport(std::ostream &out) const
+{
+  out << "view,rov_min,rov_max,shown,in_view,resident,wait,classify_ms,"
+         "load_ms,render_ms,samples,cpu_cache_blocks,load_queue,"
+         "cancelled_loads,wasted_bytes\n";
+  for (FrameReport const &r : m_reports) {
+    out << r.name << "," << r.rovMin << "," << r.rovMax << "," << r.shown
+        << "," << r.inView << "," << r.resident << "," << to_string(r.wait)
+        << "," << r.classifyMs << "," << r.loadMs << "," << r.renderMs << ","
+        << r.samples << "," << r.cpuCacheBlocks << "," << r.loadQueue << ","
+        << r.cancelledLoads << "," << r.wastedBytes << "\n";
+  }
+  out.flush();
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+void
+BatchRunner::handle_BlockCacheStatsMessage(BlockCacheStatsMessage &m)
+{
+  std::unique_lock<std::mutex> lock(m_statsMutex);
+  m_stats = m;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+int
+runBatch(std::shared_ptr<BlockCollection> collection,
+         BlockLoader *loader,
+         std::shared_ptr<renderer::BlockRenderer> renderer,
+         CommandLineOptions const &clo)
+{
+  std::shared_ptr<renderer::CpuRaycaster> cpu{
+      std::dynamic_pointer_cast<renderer::CpuRaycaster>(renderer) };
+  if (!cpu) {
+    bd::Err() << "The batch mode needs the cpu renderer.";
+    return 1;
+  }
+
+  BatchRunner runner{ std::move(collection), loader, cpu, clo };
+  BatchScript script;
+  if (!script.open(clo.batchScriptPath, runner.currentFrame())) {
+    return 1;
+  }
+  bd::Info() << script.frames().size() << " views in batch script "
+             << clo.batchScriptPath << ".";
+
+  return runner.run(script.frames()) ? 0 : 1;
+}
+
+} // namespace subvol
@@ -0,0 +1,243 @@
+#ifndef SUBVOL_BATCH_H
+#define SUBVOL_BATCH_H
+
+#include "cmdline.h"
+#include "io/blockcollection.h"
+#include "io/blockloader.h"
+#include "messages/recipient.h"
+#include "renderer/cpuraycaster.h"
+
+#include <glm/glm.hpp>
+
+#include <istream>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace subvol
+{
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief Everything needed to render one view of a batch script.
+///////////////////////////////////////////////////////////////////////////////
+struct BatchFrame
+{
+  std::string name;         ///< Image file name, without the extension.
+  glm::vec3 eye;
+  glm::vec3 lookAt;
+  glm::vec3 up;
+  double rovMin;
+  double rovMax;
+  std::string colorMap;     ///< Empty to keep the renderer's color map.
+  float scale;              ///< Color map scale value.
+  unsigned int width;
+  unsigned int height;
+  glm::vec4 background;
+};
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief A camera path and ROV thresholds for the batch mode.
+///
+/// One command per line, # starts a comment. Commands that change a setting
+/// apply to the views rendered after them:
+///
+///     size <width> <height>
+///     background <r> <g> <b>
+///     colormap <name>
+///     scale <s>
+///     rov <min> <max>
+///     eye <x> <y> <z>
+///     lookat <x> <y> <z>
+///     up <x> <y> <z>
+///
+/// and these render views:
+///
+///     render [name]                      one view
+///     orbit <views> <degrees> [x y z]    turn the eye (and up) about the
+///                                        axis (default 0 1 0) through lookat
+///     fly <views> <x> <y> <z>            move the eye to x y z in a line
+///
+/// A path ends where it was taken to, the next command starts from there.
+/// Views without a name are called frame_0000, frame_0001, ... by their
+/// position in the script.
+///////////////////////////////////////////////////////////////////////////////
+class BatchScript
+{
+public:
+  BatchScript();
+
+
+  ~BatchScript();
+
+
+  /// \brief Read the script at \c path.
+  /// \param initial Settings of the first view, until the script changes them.
+  /// \return false if it can not be read or has a bad line (logged with its
+  ///         line number).
+  bool
+  open(std::string const &path, BatchFrame const &initial);
+
+
+  /// \brief Read a script from \c in, see open().
+  bool
+  parse(std::istream &in, BatchFrame const &initial);
+
+
+  std::vector<BatchFrame> const &
+  frames() const;
+
+
+private:
+  /// \brief Add a view of \c current, named \c name or by its position.
+  void
+  addFrame(BatchFrame const &current, std::string const &name);
+
+
+  std::vector<BatchFrame> m_frames;
+
+}; // class BatchScript
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief Renders the views of a BatchScript without a window.
+///
+/// For each view the ROV range is set and classified, the camera is given to
+/// the collection (which culls the blocks and re-prioritizes the loader),
+/// and then the runner waits until every shown block in view is in main
+/// memory, the loader has nothing left it can load, or the timeout passes.
+/// The view is drawn with the CpuRaycaster and written as a PNG to the out
+/// directory, and a row of timings and loader counters is added to
+/// batch_report.csv there.
+///////////////////////////////////////////////////////////////////////////////
+class BatchRunner
+    : public Recipient
+{
+public:
+  /// \brief How the wait for a view's blocks ended.
+  enum class Wait
+  {
+    Resident,   ///< Every shown block in view was in main memory.
+    Stalled,    ///< The loader stopped with some not loaded (did not fit).
+    Timeout
+  };
+
+
+  /// \brief What happened while rendering a view.
+  struct FrameReport
+  {
+    std::string name;
+    double rovMin;
+    double rovMax;
+    size_t shown;           ///< Blocks the classification shows.
+    size_t inView;          ///< Shown blocks in view (not culled).
+    size_t resident;        ///< Shown blocks in view that were in main.
+    Wait wait;
+    double classifyMs;      ///< Waiting for classification and culling.
+    double loadMs;          ///< Waiting for the blocks in view to load.
+    double renderMs;
+    uint64_t samples;
+    size_t cpuCacheBlocks;  ///< Latest loader stats at render time.
+    size_t loadQueue;
+    uint64_t cancelledLoads;
+    uint64_t wastedBytes;
+  };
+
+
+  BatchRunner(std::shared_ptr<BlockCollection> collection,
+              BlockLoader *loader,
+              std::shared_ptr<renderer::CpuRaycaster> renderer,
+              CommandLineOptions const &clo);
+
+
+  ~BatchRunner() override;
+
+
+  /// \brief Settings of the renderer right now, the first view of a script
+  /// starts from them.
+  BatchFrame
+  currentFrame() const;
+
+
+  /// \brief Render \c frames and write their images and the report.
+  /// \return false if an image or the report could not be written, or a
+  ///         view names a color map that does not exist.
+  bool
+  run(std::vector<BatchFrame> const &frames);
+
+
+  std::vector<FrameReport> const &
+  reports() const;
+
+
+  /// \brief Write the reports as csv, a header and a row per view.
+  void
+  writeReport(std::ostream &out) const;
+
+
+  void
+  handle_BlockCacheStatsMessage(BlockCacheStatsMessage &m) override;
+
+
+private:
+  /// \brief Render one view.
+  /// \return false if its image could not be written.
+  bool
+  renderFrame(BatchFrame const &frame, FrameReport &report);
+
+
+  /// \brief Set the range and wait for it to be classified.
+  /// \return false if the timeout passed first.
+  bool
+  classify(double rovMin, double rovMax, double timeoutMs);
+
+
+  /// \brief Wait for the classification thread to cull the last view
+  /// asked for.
+  /// \return false if the timeout passed first.
+  bool
+  waitForView(double timeoutMs);
+
+
+  /// \brief Wait for the shown blocks in view to be in main memory.
+  Wait
+  waitForBlocks(double timeoutMs, FrameReport &report);
+
+
+  std::shared_ptr<BlockCollection> m_collection;
+  BlockLoader *m_loader;
+  std::shared_ptr<renderer::CpuRaycaster> m_renderer;
+  std::string m_outDir;
+  double m_timeoutMs;
+
+  /// The range and color map the collection last classified and estimated
+  /// opacities for, nothing until the first view.
+  bool m_haveRange;
+  double m_rovMin;
+  double m_rovMax;
+  std::string m_colorMap;
+  float m_scale;
+
+  std::vector<FrameReport> m_reports;
+
+  /// Latest loader stats, delivered on the message thread.
+  mutable std::mutex m_statsMutex;
+  BlockCacheStatsMessage m_stats;
+
+}; // class BatchRunner
+
+
+/// \brief Run the batch script named in \c clo with the cpu renderer that
+/// the StartupOrchestrator made.
+/// \return The exit code, 0 if every view was rendered and written.
+int
+runBatch(std::shared_ptr<BlockCollection> collection,
+         BlockLoader *loader,
+         std::shared_ptr<renderer::BlockRenderer> renderer,
+         CommandLineOptions const &clo);
+
+} // namespace subvol
+
+#endif // ! SUBVOL_BATCH_H
@@ -11,7 +11,8 @@ enum ClassificationType
     : int
 {
   Avg,
-  Rov
+  Rov,
+  Value   ///< Blocks whose [min, max] value range meets the range.
 };
 
 
@@ -1,6 +1,7 @@
 #include "cmdline.h"
 
 #include <iostream>
+#include <stdexcept>
 #include <string>
 
 namespace subvol
@@ -96,6 +97,71 @@ try
       mainMemoryArg("", "main-mem", "Cpu memory to use", false, "1G", "string");
   cmd.add(mainMemoryArg);
 
+  TCLAP::ValueArg<std::string>
+      quantizeArg("", "quantize",
+                  "Store blocks in the cpu cache as none, u8, u16, f16 or auto "
+                  "(smallest format within --quantize-error).",
+                  false, "none", "string");
+  cmd.add(quantizeArg);
+
+  TCLAP::ValueArg<double>
+      quantizeErrorArg("", "quantize-error",
+                       "Max per voxel error (of normalized values) for "
+                       "--quantize auto.",
+                       false, 1.0e-3, "float");
+  cmd.add(quantizeErrorArg);
+
+  TCLAP::ValueArg<double>
+      budgetArg("", "fit-budget",
+                "Raise the min threshold so the shown blocks fit in this "
+                "fraction of the cpu/gpu caches (0 to turn off).",
+                false, 0.0, "float");
+  cmd.add(budgetArg);
+
+  TCLAP::ValueArg<std::string>
+      hugePagesArg("", "huge-pages",
+                   "Back the cpu block buffers with none, thp (transparent) "
+                   "or explicit (reserved pool) huge pages.",
+                   false, "thp", "string");
+  cmd.add(hugePagesArg);
+
+  TCLAP::SwitchArg numaBind("",
+                            "numa-bind",
+                            "Place cpu block buffers on the NUMA node of the "
+                            "load thread.",
+                            cmd, false);
+
+  TCLAP::SwitchArg startupReport("",
+                                 "startup-report",
+                                 "Print a timeline of the startup phases.",
+                                 cmd, false);
+
+  TCLAP::ValueArg<std::string>
+      batchArg("", "batch",
+               "Render the views of a camera path script on the cpu, without "
+               "a window, and exit.",
+               false, "", "string");
+  cmd.add(batchArg);
+
+  TCLAP::ValueArg<std::string>
+      batchOutArg("", "batch-out",
+                  "Directory for the batch images and report.",
+                  false, ".", "string");
+  cmd.add(batchOutArg);
+
+  TCLAP::ValueArg<double>
+      batchTimeoutArg("", "batch-timeout",
+                      "Seconds to wait for a view's blocks to load before "
+                      "rendering it anyway.",
+                      false, 30.0, "double");
+  cmd.add(batchTimeoutArg);
+
+  TCLAP::ValueArg<unsigned int>
+      batchThreadsArg("", "batch-threads",
+                      "Batch render threads, 0 for one per hardware thread.",
+                      false, 0, "uint");
+  cmd.add(batchThreadsArg);
+
   TCLAP::ValueArg<float>
       samplingModifierXArg("", "smod-x", "Sampling modifier", false, 0, "float");
   cmd.add(samplingModifierXArg);
@@ -122,6 +188,16 @@ try
   opts.windowHeight = screenHeightArg.getValue();
   opts.gpuMemoryBytes = static_cast<int64_t>(convertToBytes(gpuMemoryArg.getValue()));
   opts.mainMemoryBytes = static_cast<int64_t>(convertToBytes(mainMemoryArg.getValue()));
+  opts.quantizeMode = bd::to_quantizeMode(quantizeArg.getValue());
+  opts.quantizeError = quantizeErrorArg.getValue();
+  opts.budgetFraction = budgetArg.getValue();
+  opts.hugePages = bd::to_hugePages(hugePagesArg.getValue());
+  opts.numaBind = numaBind.getValue();
+  opts.startupReport = startupReport.getValue();
+  opts.batchScriptPath = batchArg.getValue();
+  opts.batchOutDir = batchOutArg.getValue();
+  opts.batchTimeout = batchTimeoutArg.getValue();
+  opts.batchThreads = batchThreadsArg.getValue();
   opts.smod_x = samplingModifierXArg.getValue();
   opts.smod_y = samplingModifierYArg.getValue();
   opts.smod_z = samplingModifierZArg.getValue();
@@ -132,6 +208,9 @@ try
   std::cout << "Error parsing command line args: " << e.error() << " for argument "
             << e.argId() << std::endl;
   return 0;
+} catch (std::invalid_argument &e) {
+  std::cout << "Error parsing command line args: " << e.what() << std::endl;
+  return 0;
 }
 
 
@@ -173,6 +252,16 @@ printThem(CommandLineOptions &opts)
       << "\nWindow dims: " << opts.windowWidth << " X " << opts.windowHeight
       << "\nCpu memory: " << opts.mainMemoryBytes
       << "\nGpu memory: " << opts.gpuMemoryBytes
+      << "\nQuantize: " << bd::to_string(opts.quantizeMode)
+      << " (max error " << opts.quantizeError << ")"
+      << "\nFit budget: " << opts.budgetFraction
+      << "\nHuge pages: " << bd::to_string(opts.hugePages)
+      << "\nNUMA bind: " << opts.numaBind
+      << "\nStartup report: " << opts.startupReport
+      << "\nBatch script: " << opts.batchScriptPath
+      << "\nBatch out dir: " << opts.batchOutDir
+      << "\nBatch timeout: " << opts.batchTimeout
+      << "\nBatch threads: " << opts.batchThreads
       << std::endl;
 }
 
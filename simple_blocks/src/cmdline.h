@@ -1,6 +1,9 @@
 #ifndef subvol_cmdline_h
 #define subvol_cmdline_h
 
+#include <bd/volume/quantizer.h>
+#include <bd/datastructure/bufferarena.h>
+
 #include <tclap/CmdLine.h>
 #include <string>
 
@@ -46,6 +49,26 @@ struct CommandLineOptions
   int64_t gpuMemoryBytes;
   /// cpu mem to use
   int64_t mainMemoryBytes;
+  /// storage format of blocks in the cpu cache
+  bd::QuantizeMode quantizeMode;
+  /// max per voxel error for quantizeMode auto
+  double quantizeError;
+  /// fraction of the caches the shown blocks should fit in (0 is off)
+  double budgetFraction;
+  /// huge pages for the cpu block buffers
+  bd::HugePages hugePages;
+  /// place cpu buffers on the NUMA node of the thread that fills them
+  bool numaBind;
+  /// print a timeline of the startup phases
+  bool startupReport;
+  /// camera path script to render without a window, empty for interactive
+  std::string batchScriptPath;
+  /// directory for the batch mode images and report
+  std::string batchOutDir;
+  /// seconds to wait for a keyframe's blocks to load in batch mode
+  double batchTimeout;
+  /// render threads in batch mode, 0 for one per hardware thread
+  size_t batchThreads;
   // sampling modifier (modifies the sample rate during reconstruction)
   float smod_x;
   float smod_y;
@@ -180,6 +180,13 @@ ColorMap::setTexture(bd::Texture const &texture)
 }
 
 
+std::vector<glm::vec4> const &
+ColorMap::getKnots() const
+{
+  return m_knots;
+}
+
+
 std::string const &
 ColorMap::getName() const
 {
@@ -202,6 +209,10 @@ ColorMap::generateColorMapTexture(std::string const &name,
     return false;
   }
 
+  if (!ColorMapManager::getGenerateTextures()) {
+    return true;
+  }
+
   bool success{ true };
 
   float const *textureData{ reinterpret_cast<float const *>(func.data()) };
@@ -384,6 +395,8 @@ std::vector<std::string const *> ColorMapManager::s_colorMapNames;
 
 long long ColorMapManager::s_currentMapNameIdx{ 0 };
 
+bool ColorMapManager::s_generateTextures{ true };
+
 
 /* static */
 void
@@ -419,6 +432,22 @@ ColorMapManager::generateDefaultTransferFunctionTextures()
 }
 
 
+/* static */
+void
+ColorMapManager::setGenerateTextures(bool generate)
+{
+  s_generateTextures = generate;
+}
+
+
+/* static */
+bool
+ColorMapManager::getGenerateTextures()
+{
+  return s_generateTextures;
+}
+
+
 /* static */
 const ColorMap &
 ColorMapManager::getMapByName(std::string const &name)
@@ -572,7 +601,12 @@ ColorMap &
 ColorMapManager::newColorMap(std::string const &funcName)
 {
   ColorMap c{ funcName, { }};
+  bool const isNew{ s_maps.find(funcName)==s_maps.end() };
   s_maps[funcName] = c;
+  if (isNew) {
+    // listed, so getMapByName() can make it the current map.
+    s_colorMapNames.push_back(&s_maps.find(funcName)->first);
+  }
 
   return s_maps[funcName];
 }
@@ -73,6 +73,11 @@ public:
   getTexture() const;
 
 
+  /// \brief The rgba texels of the texture, evenly spaced over [0, 1].
+  std::vector<glm::vec4> const &
+  getKnots() const;
+
+
   void
   setTexture(bd::Texture const &texture);
 
@@ -125,6 +130,16 @@ public:
   generateDefaultTransferFunctionTextures();
 
 
+  /// \brief Whether color maps loaded from now on get a texture (they do by
+  /// default). Without a GL context only their knots are kept.
+  static void
+  setGenerateTextures(bool generate);
+
+
+  static bool
+  getGenerateTextures();
+
+
   /// \brief Get the texture of colormap with name.
   /// \throws std::out_of_range if name is not a default colormap
   static
@@ -222,6 +237,7 @@ private:
   /// (pointers are to std::string in s_textures map)
   static std::vector<std::string const *> s_colorMapNames;
   static long long s_currentMapNameIdx;
+  static bool s_generateTextures;
 
 }; // class ColorMapManager
 
@@ -28,5 +28,7 @@ const char *LIGHTING_MAT_UNIFORM_STR = "mat";
 
 const char *VOLUME_MVP_MATRIX_UNIFORM_STR = "mvp";
 const char *VOLUME_TRANSF_SCALER_UNIFORM_STR = "tfScalingVal";
+const char *VOLUME_TEX_OFFSET_UNIFORM_STR = "tex_offset";
+const char *VOLUME_TEX_SCALE_UNIFORM_STR = "tex_scale";
 
 const char *WIREFRAME_MVP_MATRIX_UNIFORM_STR = "mvp";
@@ -32,6 +32,8 @@ extern const char *LIGHTING_MAT_UNIFORM_STR; // = "mat";
 
 extern const char *VOLUME_MVP_MATRIX_UNIFORM_STR; // = "mvp";
 extern const char *VOLUME_TRANSF_SCALER_UNIFORM_STR; // = "tfScalingVal";
+extern const char *VOLUME_TEX_OFFSET_UNIFORM_STR; // = "tex_offset";
+extern const char *VOLUME_TEX_SCALE_UNIFORM_STR; // = "tex_scale";
 
 extern const char *WIREFRAME_MVP_MATRIX_UNIFORM_STR; // = "mvp";
 
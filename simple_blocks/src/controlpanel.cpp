@@ -17,6 +17,7 @@
 #include <QGroupBox>
 #include <QRadioButton>
 #include <QProgressBar>
+#include <QCheckBox>
 
 #ifdef _WIN32
 #define __PRETTY_FUNCTION__ __FUNCSIG__
@@ -41,12 +42,14 @@ ClassificationPanel::ClassificationPanel(QWidget *parent = nullptr)
   m_groupBox = new QGroupBox("Classification Type");
   QRadioButton *averageRadio = new QRadioButton("Average");
   QRadioButton *rovRadio = new QRadioButton("ROV");
+  QRadioButton *valueRadio = new QRadioButton("Value range");
 
   rovRadio->setChecked(true);
 
   QVBoxLayout *vboxLayout = new QVBoxLayout;
   vboxLayout->addWidget(averageRadio);
   vboxLayout->addWidget(rovRadio);
+  vboxLayout->addWidget(valueRadio);
   vboxLayout->addStretch(1);
 
   m_groupBox->setLayout(vboxLayout);
@@ -72,6 +75,14 @@ ClassificationPanel::ClassificationPanel(QWidget *parent = nullptr)
   gridLayout->addWidget(m_currentMin_Label, 0, 1);
   gridLayout->addWidget(m_maxSlider, 1, 0);
   gridLayout->addWidget(m_currentMax_Label, 1, 1);
+
+  m_budgetCheckBox = new QCheckBox("Fit cache budget");
+  m_budgetSpinBox = new QDoubleSpinBox();
+  m_budgetSpinBox->setRange(0.05, 1.0);
+  m_budgetSpinBox->setSingleStep(0.05);
+  m_budgetSpinBox->setValue(0.9);
+  gridLayout->addWidget(m_budgetCheckBox, 2, 0);
+  gridLayout->addWidget(m_budgetSpinBox, 2, 1);
   gridWidget->setLayout(gridLayout);
 
   boxLayout->addWidget(gridWidget);
@@ -100,6 +111,15 @@ ClassificationPanel::ClassificationPanel(QWidget *parent = nullptr)
 
   connect(rovRadio, SIGNAL(clicked(bool)),
           this, SLOT(slot_rovRadioClicked(bool)));
+
+  connect(valueRadio, SIGNAL(clicked(bool)),
+          this, SLOT(slot_valueRadioClicked(bool)));
+
+  connect(m_budgetCheckBox, SIGNAL(toggled(bool)),
+          this, SLOT(slot_budgetChanged()));
+
+  connect(m_budgetSpinBox, SIGNAL(valueChanged(double)),
+          this, SLOT(slot_budgetChanged()));
 }
 
 
@@ -193,6 +213,16 @@ ClassificationPanel::slot_sliderReleased()
 }
 
 
+///////////////////////////////////////////////////////////////////////////////
+void
+ClassificationPanel::slot_budgetChanged()
+{
+  BudgetChangedMessage *m{ new BudgetChangedMessage };
+  m->Fraction = m_budgetCheckBox->isChecked() ? m_budgetSpinBox->value() : 0.0;
+  Broker::send(m);
+}
+
+
 ///////////////////////////////////////////////////////////////////////////////
 void
 ClassificationPanel::slot_averageRadioClicked(bool)
@@ -209,6 +239,14 @@ ClassificationPanel::slot_rovRadioClicked(bool)
 }
 
 
+///////////////////////////////////////////////////////////////////////////////
+void
+ClassificationPanel::slot_valueRadioClicked(bool)
+{
+  emit classificationTypeChanged(ClassificationType::Value);
+}
+
+
 ///////////////////////////////////////////////////////////////////////////////
 //   StatsPanel Impl
 ///////////////////////////////////////////////////////////////////////////////
@@ -221,6 +259,9 @@ StatsPanel::StatsPanel(bd::Volume const &vol,
                        QWidget *parent = nullptr)
     : Recipient{ "StatsPanel" }
     , m_visibleBlocks{ 0 }
+    , m_residentFraction{ 1.0 }
+    , m_autoRange{ false }
+    , m_autoRangeMin{ 0 }
     , m_currentGpuLoadQSize{ 0 }
     , m_totalMainBlocks{ cpuCacheSize }
     , m_totalGPUBlocks{ gpuCacheSize }
@@ -300,6 +341,26 @@ StatsPanel::StatsPanel(bd::Volume const &vol,
   gridLayout->addWidget(m_gpuTexturesAvailValueLabel, 7, 1);
   gridLayout->addWidget(m_gpuTexturesAvailValueBar, 7, 2);
 
+  QLabel *quantizationLabel = new QLabel("Cpu cache ratio: ");
+  m_quantizationValueLabel = new QLabel("1.00 (max err 0)");
+  gridLayout->addWidget(quantizationLabel, 8, 0);
+  gridLayout->addWidget(m_quantizationValueLabel, 8, 1);
+
+  QLabel *prefetchLabel = new QLabel("Prefetch hit rate: ");
+  m_prefetchValueLabel = new QLabel("0 of 0");
+  gridLayout->addWidget(prefetchLabel, 9, 0);
+  gridLayout->addWidget(m_prefetchValueLabel, 9, 1);
+
+  QLabel *wastedLabel = new QLabel("Cancelled loads: ");
+  m_cancelledLoadsValueLabel = new QLabel("0");
+  gridLayout->addWidget(wastedLabel, 10, 0);
+  gridLayout->addWidget(m_cancelledLoadsValueLabel, 10, 1);
+
+  QLabel *residentLabel = new QLabel("Predicted resident: ");
+  m_residentValueLabel = new QLabel("100%");
+  gridLayout->addWidget(residentLabel, 11, 0);
+  gridLayout->addWidget(m_residentValueLabel, 11, 1);
+
   this->setLayout(gridLayout);
 
   connect(this, SIGNAL(updateStatsValues()),
@@ -349,6 +410,15 @@ StatsPanel::updateShownBlocksLabels()
   }
 
   m_compressionValueLabel->setText(QString::asprintf("%f %%", p));
+
+  if (m_autoRange) {
+    m_residentValueLabel->setText(
+        QString::asprintf("%.0f%% (min raised to %g)",
+                          100.0*m_residentFraction, m_autoRangeMin));
+  } else {
+    m_residentValueLabel->setText(
+        QString::asprintf("%.0f%%", 100.0*m_residentFraction));
+  }
 }
 
 
@@ -357,6 +427,9 @@ void
 StatsPanel::handle_ShownBlocksMessage(ShownBlocksMessage &m)
 {
   m_visibleBlocks = m.ShownBlocks;
+  m_residentFraction = m.ResidentFraction;
+  m_autoRange = m.AutoRange;
+  m_autoRangeMin = m.RangeMin;
   updateShownBlocksLabels();
 //  emit updateStatsValues();
 }
@@ -415,7 +488,9 @@ StatsPanel::setStatsValues()
 
   int const gpuCashFilledPerc = int(100*( m.GpuCacheSize/float(m_totalGPUBlocks)));
 
-  m_cpuCacheFilledValueLabel->setText(QString::number(m.CpuCacheSize));
+  m_cpuCacheFilledValueLabel->setText(
+      QString::asprintf("%zu (%.0f MiB committed)",
+                        m.CpuCacheSize, m.CpuCommittedBytes/( 1024.0*1024.0 )));
   m_cpuCacheFilledBar->setValue(cpuCashFilledPerc);
 
   m_gpuCacheFilledValueLabel->setText(QString::number(m.GpuCacheSize));
@@ -424,6 +499,20 @@ StatsPanel::setStatsValues()
   m_cpuLoadQueueValueLabel->setText(QString::number(m.CpuLoadQueueSize));
   m_gpuLoadQueueValueLabel->setText(QString::number(gpuQSize));
 
+  m_quantizationValueLabel->setText(
+      QString::asprintf("%.2f (max err %g)",
+                        m.CompressionRatio, m.MaxQuantizationError));
+
+  m_prefetchValueLabel->setText(
+      QString::asprintf("%.0f%% of %zu (%zu queued)",
+                        100.0*m.PrefetchHitRate, m.PrefetchCount,
+                        m.PrefetchQueueSize));
+
+  m_cancelledLoadsValueLabel->setText(
+      QString::asprintf("%llu (%.1f MiB wasted)",
+                        static_cast<unsigned long long>(m.CancelledLoads),
+                        m.WastedBytes/( 1024.0*1024.0 )));
+
 
 //  m_cpuBuffersAvailValueLabel->setText(QString::number(m.CpuBuffersAvailable));
 //  m_cpuBuffersAvailValueBar->setValue(100 - cpuCashFilledPerc);
@@ -496,6 +585,9 @@ ControlPanel::setcurrentMinMaxSliders(double min, double max)
 void
 ControlPanel::slot_classificationTypeChanged(ClassificationType type)
 {
+  ClassificationTypeChangedMessage *m{ new ClassificationTypeChangedMessage };
+  m->Type = type;
+  Broker::send(m);
 
 //  auto avgCompare = [](bd::FileBlock const &lhs, bd::FileBlock const &rhs) {
 //    return lhs.avg_val < rhs.avg_val;
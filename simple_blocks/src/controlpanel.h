@@ -126,13 +126,24 @@ public slots:
   slot_rovRadioClicked(bool);
 
 
+  void
+  slot_valueRadioClicked(bool);
+
+
   void
   slot_globalRangeChanged(double rmax, double rmin);
 
 
+  void
+  slot_budgetChanged();
+
+
 private:
   QGroupBox *m_groupBox;
 
+  QCheckBox *m_budgetCheckBox;
+  QDoubleSpinBox *m_budgetSpinBox;
+
   QSlider *m_minSlider;
   QSlider *m_maxSlider;
   QLabel *m_currentMin_Label;
@@ -240,7 +251,15 @@ private:
   QLabel *m_gpuTexturesAvailValueLabel;
   QProgressBar *m_gpuTexturesAvailValueBar;
 
+  QLabel *m_quantizationValueLabel;
+  QLabel *m_prefetchValueLabel;
+  QLabel *m_cancelledLoadsValueLabel;
+  QLabel *m_residentValueLabel;
+
   size_t m_visibleBlocks;
+  double m_residentFraction;
+  bool m_autoRange;
+  double m_autoRangeMin;
   size_t m_currentGpuLoadQSize;
 
   size_t const m_totalBlocks;
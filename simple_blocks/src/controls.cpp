@@ -191,7 +191,7 @@ Controls::keyboard_callback(int key, int scancode, int action, int mods)
 
       case GLFW_KEY_T:
         if (mods & GLFW_MOD_SHIFT) {
-          m_renderer->setColorMapTexture(ColorMapManager::getPrevMap().getTexture());
+          m_renderer->setColorMap(ColorMapManager::getPrevMap());
           std::cout << "\nColormap: " << ColorMapManager::getCurrentMapName() << '\n';
         } else if (mods & GLFW_MOD_ALT) {
           std::cout << "\n Current map: \n\t Scaling value: "
@@ -200,7 +200,7 @@ Controls::keyboard_callback(int key, int scancode, int action, int mods)
                     << ColorMapManager::getMapByName(
                         ColorMapManager::getCurrentMapName()).to_string() << std::endl;
         } else {
-          m_renderer->setColorMapTexture(ColorMapManager::getNextMap().getTexture());
+          m_renderer->setColorMap(ColorMapManager::getNextMap());
           std::cout << "\nColormap: " << ColorMapManager::getCurrentMapName() << '\n';
         }
 
@@ -10,6 +10,10 @@
 #include <bd/io/indexfile/indexfile.h>
 #include <bd/io/indexfile/v2/jsonindexfile.h>
 
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
 namespace subvol
 {
 
@@ -17,6 +21,19 @@ using bd::Block;
 using bd::IndexFile;
 using bd::FileBlock;
 
+namespace
+{
+
+/// Changes larger than this fraction of the shown blocks are sent to the
+/// loader as a full classification rather than a delta.
+double const MAX_DELTA_FRACTION{ 0.25 };
+
+/// Blocks that get less than this of their light to the eye are hidden (less
+/// than one step of an 8 bit color).
+float const OCCLUDED_TRANSMITTANCE{ 1.0f/256.0f };
+
+} // namespace
+
 
 ///////////////////////////////////////////////////////////////////////////////
 //BlockCollection::BlockCollection()
@@ -28,15 +45,50 @@ using bd::FileBlock;
 BlockCollection::BlockCollection(BlockLoader *loader,
                                  bd::indexfile::v2::JsonIndexFile const &index)
     : Recipient{ "BlockCollection" }
+    , m_store{ nullptr }
     , m_blocks()
-    , m_nonEmptyBlocks()
+    , m_shown()
+    , m_published{ std::make_shared<BlockList const>() }
     , m_emptyBlocks()
+    , m_rovIndex()
+    , m_avgIndex()
+    , m_valueTree()
+    , m_masks{ index.getOccupancyMasks() }
+    , m_gridOrder{ }
+    , m_boxes{ }
+    , m_octree{ }
+    , m_leafBlocks{ }
+    , m_gridLow{ 0.0f }
+    , m_gridCell{ 1.0f }
+    , m_inView{ nullptr }
+    , m_occlusion{ }
+    , m_blockOpacity{ }
+    , m_view{ }
+    , m_haveView{ false }
+    , m_cellOpacity{ }
+    , m_transmittance{ }
+    , m_cachedIndex{ nullptr }
+    , m_cached{ 0, 0 }
     , m_volume{ index.getVolume() }
     , m_loader{ loader }
     , m_classificationType{ ClassificationType::Rov }
+    , m_requestedType{ ClassificationType::Rov }
+    , m_typeChanged{ false }
+    , m_cacheUpdateRequested{ false }
+    , m_stopClassifier{ false }
+    , m_budgetFraction{ 0 }
+    , m_requestedView{ }
+    , m_viewChanged{ false }
+    , m_requestedAlpha{ }
+    , m_requestedScale{ 1.0f }
+    , m_opacityChanged{ false }
     , m_rangeLow{ 0 }
     , m_rangeHigh{ 0 }
     , m_rangeChanged{ false }
+    , m_rangeRequests{ 0 }
+    , m_rangeServed{ 0 }
+    , m_viewRequests{ 0 }
+    , m_viewServed{ 0 }
 {
   // This is probably a bad place for this, I know.
   // Launch the block loading thread.
@@ -44,8 +96,11 @@ BlockCollection::BlockCollection(BlockLoader *loader,
       std::async(std::launch::async,
                  [loader]() -> int { return ( *loader )(); });
 
-  initBlocksFromFileBlocks(index.getFileBlocks(),
-                           m_volume.block_count());
+  initBlocksFromFileBlocks(index.getFileBlocks());
+
+  m_classifierFuture =
+      std::async(std::launch::async,
+                 [this]() -> int { return classifyLoop(); });
 
   Broker::subscribeRecipient(this);
 }
@@ -54,7 +109,17 @@ BlockCollection::BlockCollection(BlockLoader *loader,
 ///////////////////////////////////////////////////////////////////////////////
 BlockCollection::~BlockCollection()
 {
+  {
+    std::unique_lock<std::mutex> lock(m_classifyMutex);
+    m_stopClassifier = true;
+  }
+  m_classifyWait.notify_all();
+  m_classifierFuture.wait();
+
   if (m_loader) {
+    // the load thread must be done with the loader before it is deleted.
+    m_loader->stop();
+    m_loaderFuture.wait();
     delete m_loader;
   }
   Broker::unsubscribeRecipient(this);
@@ -87,8 +152,7 @@ BlockCollection::~BlockCollection()
 
 ///////////////////////////////////////////////////////////////////////////////
 void
-BlockCollection::initBlocksFromFileBlocks(std::vector<FileBlock> const &fileBlocks,
-                                          glm::u64vec3 const &nb)
+BlockCollection::initBlocksFromFileBlocks(std::vector<FileBlock> const &fileBlocks)
 {
 
   if (fileBlocks.empty()) {
@@ -96,48 +160,284 @@ BlockCollection::initBlocksFromFileBlocks(std::vector<FileBlock> const &fileBloc
     return;
   }
 
-  m_blocks.reserve(fileBlocks.size());
   m_emptyBlocks.reserve(fileBlocks.size());
-  m_nonEmptyBlocks.reserve(fileBlocks.size());
 
-  int every = static_cast<int>( 0.1f*fileBlocks.size());
-  every = every==0 ? 1 : every;
+  m_store.reset(new bd::BlockStore{ fileBlocks });
+  m_blocks.resize(m_store->size());
+  m_shown.reset(m_blocks.size());
+  for (size_t idx{ 0 }; idx<m_blocks.size(); ++idx) {
+    Block *block{ m_store->block(idx) };
+    // hidden until the first filter.
+    block->empty(true);
+    m_blocks[idx] = block;
+  }
+  bd::Info() << "Created " << m_blocks.size() << " blocks ("
+             << m_store->bytes()/( 1024*1024 ) << " MiB).";
+
+  m_rovIndex.build(m_blocks,
+                   [](Block const &b) -> double { return b.rov(); });
+  m_avgIndex.build(m_blocks,
+                   [](Block const &b) -> double { return b.avg(); });
+
+  // value ranges are normalized like the texture data.
+  double const volMin{ m_volume.min() };
+  double const diff{ m_volume.max()-volMin };
+  double const scale{ diff>0 ? 1.0/diff : 1.0 };
+  std::vector<bd::IntervalTree<Block *>::Interval> ranges;
+  ranges.reserve(m_blocks.size());
+  for (Block *b : m_blocks) {
+    FileBlock const &fb{ b->fileBlock() };
+    if (fb.min_val<=fb.max_val) {
+      ranges.push_back({ ( fb.min_val-volMin )*scale,
+                         ( fb.max_val-volMin )*scale, b });
+    }
+  }
+  m_valueTree.build(ranges);
+  if (m_valueTree.size()<m_blocks.size()) {
+    bd::Warn() << m_blocks.size()-m_valueTree.size() << "/" << m_blocks.size()
+               << " blocks have no min/max value in the index file and are "
+                  "never shown when classifying by value. Regenerate the "
+                  "index file to fix this.";
+  }
+
+  if (m_masks.size()==m_blocks.size()) {
+    size_t bricks{ 0 };
+    size_t occupiedBricks{ 0 };
+    for (size_t i{ 0 }; i<m_blocks.size(); ++i) {
+      bricks += m_masks[i].size();
+      occupiedBricks += m_masks[i].occupiedCount();
+      // dilate once here instead of on every load.
+      m_masks[i] = m_masks[i].dilated();
+      m_blocks[i]->occupancy(&m_masks[i]);
+    }
+    bd::Info() << "Occupied sub-bricks: " << occupiedBricks << "/" << bricks;
+  } else if (!m_masks.empty()) {
+    bd::Warn() << "Index file has " << m_masks.size() << " occupancy masks for "
+               << m_blocks.size() << " blocks, not using them.";
+  }
+
+  // the culling result is indexed by block index, so the boxes are too.
+  std::vector<Block const *> byIndex(m_blocks.size(), nullptr);
+  for (Block const *b : m_blocks) {
+    uint64_t const bi{ b->index() };
+    assert(bi<byIndex.size() && "Block indexes are 0 to the number of blocks.");
+    byIndex[bi] = b;
+  }
+  m_boxes.reserve(byIndex.size());
+  for (Block const *b : byIndex) {
+    glm::vec3 const half{ b->worldDims()*0.5f };
+    m_boxes.push_back(b->origin()-half, b->origin()+half);
+  }
+
+  // Renderers order a regular grid without sorting, check the blocks are
+  // where their ijk says.
+  glm::u64vec3 const nb{ m_volume.block_count() };
+  glm::vec3 const cell{ m_blocks[0]->worldDims() };
+  glm::vec3 const lo{ m_blocks[0]->origin()-cell*0.5f };
+  bool isGrid{ m_blocks.size()==nb.x*nb.y*nb.z };
+  for (size_t i{ 0 }; isGrid && i<m_blocks.size(); ++i) {
+    Block const *b{ m_blocks[i] };
+    glm::vec3 const expected{ lo+( glm::vec3(b->ijk())+0.5f )*cell };
+    for (int a{ 0 }; a<3; ++a) {
+      float const eps{ 1e-3f*cell[a] };
+      isGrid = isGrid && b->ijk()[a]<nb[a] &&
+          std::abs(b->worldDims()[a]-cell[a])<=eps &&
+          std::abs(b->origin()[a]-expected[a])<=eps;
+    }
+  }
+  if (isGrid) {
+    m_gridOrder = bd::VisibilityOrder{ nb, lo, cell };
+    m_occlusion = bd::OcclusionGrid{ nb, lo, cell };
+    m_gridLow = lo;
+    m_gridCell = cell;
+
+    std::vector<bd::Octree::Leaf> leaves(m_blocks.size());
+    m_leafBlocks.resize(m_blocks.size());
+    for (Block const *b : m_blocks) {
+      glm::u64vec3 const &ijk{ b->ijk() };
+      size_t const leaf{ ijk.x+nb.x*( ijk.y+nb.y*ijk.z ) };
+      FileBlock const &fb{ b->fileBlock() };
+      leaves[leaf] = { static_cast<float>(( fb.min_val-volMin )*scale),
+                       static_cast<float>(( fb.max_val-volMin )*scale),
+                       static_cast<float>(b->avg()),
+                       static_cast<float>(b->rov()) };
+      m_leafBlocks[leaf] = b->index();
+    }
+    m_octree.build(nb, leaves);
+  } else {
+    bd::Info() << "Blocks are not a regular grid, they are drawn in order of "
+                  "distance from the eye and not tested for occlusion.";
+  }
+
+  // without making the blocks' runtime state, see BlockStore.
+  uint64_t const occupied{ m_store->occupiedVoxels() };
+  uint64_t total{ 0 };
+  for (Block *b : m_blocks) {
+    glm::u64vec3 const ext{ b->voxel_extent() };
+    total += ext.x*ext.y*ext.z;
+  }
+  bd::Info() << "Occupied block voxels: " << occupied << "/" << total << " ("
+             << ( total>0 ? 100.0*occupied/total : 0.0 ) << "%).";
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+int
+BlockCollection::classifyLoop()
+{
+  bd::Info() << "Classification thread started.";
+
+  while (true) {
+    bool typeChanged{ false };
+    bool cacheUpdate{ false };
+    bool viewChanged{ false };
+    bool opacityChanged{ false };
+    double budgetFraction{ 0 };
+    std::vector<float> alpha;
+    float scale{ 1.0f };
+    uint64_t viewRequests{ 0 };
+    {
+      std::unique_lock<std::mutex> lock(m_classifyMutex);
+      m_classifyWait.wait(lock, [this]() -> bool {
+        return m_stopClassifier || m_rangeChanged || m_typeChanged ||
+            m_cacheUpdateRequested || m_viewChanged || m_opacityChanged;
+      });
+      if (m_stopClassifier) {
+        break;
+      }
+
+      typeChanged = m_typeChanged;
+      cacheUpdate = m_cacheUpdateRequested;
+      viewChanged = m_viewChanged;
+      opacityChanged = m_opacityChanged;
+      m_typeChanged = false;
+      m_cacheUpdateRequested = false;
+      m_viewChanged = false;
+      m_opacityChanged = false;
+      m_classificationType = m_requestedType;
+      budgetFraction = m_budgetFraction;
+      if (viewChanged) {
+        m_view = m_requestedView;
+        m_haveView = true;
+      }
+      if (opacityChanged) {
+        alpha.swap(m_requestedAlpha);
+        scale = m_requestedScale;
+      }
+      viewRequests = m_viewRequests;
+    }
+
+    if (typeChanged) {
+      // clears the queue of loadable blocks.
+      m_loader->clearLoadQueue();
+    }
 
-  auto idx = 0ull;
-  for (auto k = 0ull; k<nb.z; ++k) {
-    for (auto j = 0ull; j<nb.y; ++j) {
-      for (auto i = 0ull; i<nb.x; ++i) {
+    // a range change made while filtering sets m_rangeChanged again and is
+    // picked up on the next pass.
+    bool filtered{ false };
+    if (typeChanged || m_rangeChanged.exchange(false)) {
+      // every request counted by now has its range in m_rangeLow/High.
+      uint64_t const requests{ m_rangeRequests };
+      filterBlocks(m_rangeLow, m_rangeHigh, budgetFraction);
+      m_rangeServed = requests;
+      filtered = true;
+    }
 
-        if (idx%every==0) {
-          std::cout << "\rCreating block " << idx;
-        }
+    if (cacheUpdate) {
+      sendToLoader();
+    }
 
-        Block *block{ new Block{{ i, j, k }, fileBlocks[idx] }};
-        m_blocks.push_back(block);
+    if (opacityChanged) {
+      estimateOpacity(alpha, scale);
+    }
 
-        idx++;
+    // the shown blocks are the occluders, so new ones need a new cull.
+    bool const occluding{ m_occlusion.valid() && !m_blockOpacity.empty() };
+    if (m_haveView && ( viewChanged || opacityChanged ||
+        ( filtered && occluding ) )) {
+      cullView();
+    }
+    m_viewServed = viewRequests;
+  }
+
+  bd::Dbg() << "Exiting classification thread.";
+  return 0;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+void
+BlockCollection::filterBlocks(double low, double high, double budgetFraction)
+{
+  size_t const cache{ cacheBlocks() };
+
+  bool autoRange{ false };
+  if (m_classificationType==ClassificationType::Value) {
+    // overlapping value ranges have no order to raise low along, so the
+    // budget is not applied.
+    filterBlocksByValue(low, high);
+  } else {
+    BlockRangeIndex const &index{ classificationIndex() };
+    if (budgetFraction>0) {
+      double const fit{ index.lowForCount(
+          high, static_cast<size_t>(budgetFraction*cache)) };
+      if (fit>low) {
+        low = fit;
+        autoRange = true;
       }
     }
+
+    m_shown.filter(index, low, high);
   }
 
-  std::cout << std::endl;
+  size_t const shown{ m_shown.blocks().size() };
+  ShownBlocksMessage *m{ new ShownBlocksMessage };
+  m->ShownBlocks = static_cast<int>(shown);
+  m->ResidentFraction = shown==0
+                        ? 1.0
+                        : std::min(1.0, cache/static_cast<double>(shown));
+  m->AutoRange = autoRange;
+  m->RangeMin = low;
+  Broker::send(m);
 
+  // publish a copy, readers keep whichever list they already hold.
+  std::atomic_store(&m_published,
+                    std::make_shared<BlockList const>(m_shown.blocks()));
+
+  m_loader->classificationChanged();
+  prefetchAroundRange(low, high);
 }
 
 
+///////////////////////////////////////////////////////////////////////////////
 void
-BlockCollection::filterBlocks()
+BlockCollection::prefetchAroundRange(double rangeLow, double rangeHigh)
 {
-  switch (m_classificationType) {
-    case ClassificationType::Rov:
-      filterBlocksByROV();
-      break;
-    case ClassificationType::Avg:
-      filterBlocksByAverage();
-      break;
-    default:
-      break;
+  m_loader->observeRange(rangeLow, rangeHigh);
+
+  double low{ 0 };
+  double high{ 0 };
+  if (!m_loader->predictedRange(low, high)) {
+    return;
   }
+
+  // the blocks that would become visible if the range kept moving.
+  std::vector<bd::Block *> ahead;
+  if (m_classificationType==ClassificationType::Value) {
+    m_valueTree.overlap(low, high, [&ahead](bd::Block *b) {
+      if (b->empty()) {
+        ahead.push_back(b);
+      }
+    });
+    m_loader->queuePrefetch(ahead);
+    return;
+  }
+
+  BlockRangeIndex const &index{ classificationIndex() };
+  index.forEachDifference(index.find(low, high), m_shown.span(),
+                          [&ahead](bd::Block *b) { ahead.push_back(b); });
+
+  m_loader->queuePrefetch(ahead);
 }
 
 
@@ -145,7 +445,56 @@ BlockCollection::filterBlocks()
 void
 BlockCollection::updateBlockCache()
 {
-  m_loader->queueClassified(m_nonEmptyBlocks, m_emptyBlocks);
+  {
+    std::unique_lock<std::mutex> lock(m_classifyMutex);
+    m_cacheUpdateRequested = true;
+  }
+  m_classifyWait.notify_all();
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+void
+BlockCollection::sendToLoader()
+{
+  if (m_classificationType==ClassificationType::Value) {
+    // no span to diff against, always send the full classification.
+    m_emptyBlocks.clear();
+    for (bd::Block *b : m_blocks) {
+      if (b->empty()) {
+        m_emptyBlocks.push_back(b);
+      }
+    }
+    m_loader->queueClassified(m_shown.blocks(), m_emptyBlocks);
+    m_cachedIndex = nullptr;
+    return;
+  }
+
+  BlockRangeIndex const &index{ classificationIndex() };
+
+  if (m_cachedIndex==&index) {
+    std::vector<bd::Block *> added;
+    std::vector<bd::Block *> removed;
+    index.forEachDifference(m_shown.span(), m_cached,
+                            [&added](bd::Block *b) { added.push_back(b); });
+    index.forEachDifference(m_cached, m_shown.span(),
+                            [&removed](bd::Block *b) { removed.push_back(b); });
+    if (added.size()+removed.size()
+        <=MAX_DELTA_FRACTION*m_shown.span().size()) {
+      m_loader->queueDelta(added, removed);
+      m_cached = m_shown.span();
+      return;
+    }
+  }
+
+  // the hidden blocks are everything outside the shown span.
+  m_emptyBlocks.clear();
+  index.forEachDifference({ 0, index.size() }, m_shown.span(),
+                          [this](bd::Block *b) { m_emptyBlocks.push_back(b); });
+
+  m_loader->queueClassified(m_shown.blocks(), m_emptyBlocks);
+  m_cachedIndex = &index;
+  m_cached = m_shown.span();
 }
 
 
@@ -159,6 +508,7 @@ BlockCollection::loadSomeBlocks()
       10000000;  // <-- this isn't really going to be millis without glfwGetTimerFreq().
   bd::Block *b{ nullptr };
   int i{ 0 };
+  m_loader->releaseHiddenBlocks();
   while (t<MAX_JOB_LENGTH_MS && ( b = m_loader->getNextGpuReadyBlock())) {
     //TODO: use glfwGetTimerFreq() for more accurate timing in loadSomeBlocks().
     uint64_t start{ glfwGetTimerValue() };
@@ -171,6 +521,181 @@ BlockCollection::loadSomeBlocks()
 }
 
 
+///////////////////////////////////////////////////////////////////////////////
+void
+BlockCollection::updateView(glm::vec3 const &eye, glm::vec3 const &lookAt,
+                            glm::mat4 const &viewProj)
+{
+  {
+    std::unique_lock<std::mutex> lock(m_classifyMutex);
+    m_requestedView = View{ eye, lookAt, viewProj };
+    m_viewChanged = true;
+    ++m_viewRequests;
+  }
+  m_classifyWait.notify_all();
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+uint64_t
+BlockCollection::getViewRequests() const
+{
+  return m_viewRequests;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+uint64_t
+BlockCollection::getViewServed() const
+{
+  return m_viewServed;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+void
+BlockCollection::cullView()
+{
+  // we are on the classification thread in here.
+  auto inView = std::make_shared<std::vector<uint8_t>>();
+  bd::Frustum const frustum{ m_view.viewProj };
+  if (m_octree.levels()>0) {
+    // whole subtrees of the grid are in or out of view.
+    inView->assign(m_blocks.size(), 0);
+    m_octree.query(
+        [this, &frustum](bd::Octree::Node const &, glm::u64vec3 const &lo,
+                         glm::u64vec3 const &hi) {
+          glm::vec3 const min{ m_gridLow+glm::vec3{ lo }*m_gridCell };
+          glm::vec3 const max{ m_gridLow+glm::vec3{ hi }*m_gridCell };
+          if (!frustum.intersects(min, max)) {
+            return bd::Octree::Overlap::None;
+          }
+          return frustum.contains(min, max) ? bd::Octree::Overlap::All
+                                            : bd::Octree::Overlap::Partial;
+        },
+        [this, &inView](uint64_t leaf) {
+          ( *inView )[m_leafBlocks[leaf]] = 1;
+        });
+  } else {
+    m_boxes.cull(frustum, *inView);
+  }
+  if (m_occlusion.valid() && !m_blockOpacity.empty()) {
+    hideOccluded(m_view.eye, *inView);
+  }
+  std::shared_ptr<std::vector<uint8_t> const> published{ std::move(inView) };
+  std::atomic_store(&m_inView, published);
+  m_loader->updateView(m_view.eye, m_view.lookAt, published);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+void
+BlockCollection::hideOccluded(glm::vec3 const &eye,
+                              std::vector<uint8_t> &inView)
+{
+  // only the shown blocks are drawn, the rest of the grid is clear.
+  m_cellOpacity.assign(m_occlusion.size(), 0.0f);
+  for (Block const *b : m_shown.blocks()) {
+    m_cellOpacity[m_occlusion.index(b->ijk())] = m_blockOpacity[b->index()];
+  }
+
+  // one band, this thread is already off the render path.
+  m_occlusion.transmittance(m_cellOpacity, eye, m_transmittance, 1);
+
+  for (Block const *b : m_blocks) {
+    if (m_transmittance[m_occlusion.index(b->ijk())]<OCCLUDED_TRANSMITTANCE) {
+      inView[b->index()] = 0;
+    }
+  }
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+void
+BlockCollection::updateOpacity(std::vector<float> const &alpha, float scale)
+{
+  {
+    std::unique_lock<std::mutex> lock(m_classifyMutex);
+    m_requestedAlpha = alpha;
+    m_requestedScale = scale;
+    m_opacityChanged = true;
+    ++m_viewRequests;
+  }
+  m_classifyWait.notify_all();
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+void
+BlockCollection::estimateOpacity(std::vector<float> const &alpha, float scale)
+{
+  m_blockOpacity.assign(m_blocks.size(), 0.0f);
+  if (alpha.empty()) {
+    return;
+  }
+
+  // The transfer function is linear between texel centers, like the
+  // renderers' texture lookup.
+  float const n{ static_cast<float>(alpha.size()) };
+  auto alphaAt = [&alpha, n](float s) {
+    float const u{ std::min(std::max(s*n-0.5f, 0.0f), n-1.0f) };
+    size_t const i{ static_cast<size_t>(u) };
+    size_t const j{ std::min(i+1, alpha.size()-1) };
+    float const f{ u-static_cast<float>(i) };
+    return alpha[i]*( 1.0f-f )+alpha[j]*f;
+  };
+
+  // the smallest opacity in [s0, s1].
+  auto minAlpha = [&alpha, &alphaAt, n](float s0, float s1) {
+    float a{ std::min(alphaAt(s0), alphaAt(s1)) };
+    for (size_t i{ 0 }; i<alpha.size(); ++i) {
+      float const center{ ( static_cast<float>(i)+0.5f )/n };
+      if (center>s0 && center<s1) {
+        a = std::min(a, alpha[i]);
+      }
+    }
+    return a;
+  };
+
+  // value ranges are normalized like the texture data.
+  double const volMin{ m_volume.min() };
+  double const diff{ m_volume.max()-volMin };
+  double const norm{ diff>0 ? 1.0/diff : 1.0 };
+  auto lookup = [volMin, norm, scale](double v) {
+    float const s{ static_cast<float>(( v-volMin )*norm)*scale };
+    return std::min(std::max(s, 0.0f), 1.0f);
+  };
+
+  for (Block const *b : m_blocks) {
+    FileBlock const &fb{ b->fileBlock() };
+
+    // Hiding a block that shows through is worse than drawing a hidden one,
+    // so only the block's most transparent value counts: every voxel is at
+    // least as opaque as the transfer function's least opacity over the
+    // block's value range. Blocks without a value range do not occlude.
+    if (fb.min_val>fb.max_val) {
+      continue;
+    }
+    float const least{ std::min(std::max(
+        minAlpha(lookup(fb.min_val), lookup(fb.max_val)), 0.0f), 1.0f) };
+
+    // The occlusion grid carries light across whole cells, through about as
+    // many voxels as the block is wide.
+    float const width{ static_cast<float>(
+        std::min({ fb.voxel_dims[0], fb.voxel_dims[1], fb.voxel_dims[2] })) };
+    m_blockOpacity[fb.block_index] = 1.0f-std::pow(1.0f-least, width);
+  }
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+std::shared_ptr<std::vector<uint8_t> const>
+BlockCollection::getInView() const
+{
+  return std::atomic_load(&m_inView);
+}
+
+
 ///////////////////////////////////////////////////////////////////////////////
 std::vector<Block *> const &
 BlockCollection::getBlocks() const
@@ -188,10 +713,37 @@ BlockCollection::getBlocks()
 
 
 ///////////////////////////////////////////////////////////////////////////////
-std::vector<Block *> &
-BlockCollection::getNonEmptyBlocks()
+std::shared_ptr<BlockCollection::BlockList const>
+BlockCollection::getNonEmptyBlocks() const
+{
+  return std::atomic_load(&m_published);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+void
+BlockCollection::getResidentBlocks(BlockList const &blocks,
+                                   BlockList &resident) const
+{
+  if (m_loader) {
+    m_loader->residentBlocks(blocks, resident);
+    return;
+  }
+
+  resident.clear();
+  for (bd::Block *b : blocks) {
+    if (b->pixelData()!=nullptr) {
+      resident.push_back(b);
+    }
+  }
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+bd::VisibilityOrder const &
+BlockCollection::getGridOrder() const
 {
-  return m_nonEmptyBlocks;
+  return m_gridOrder;
 }
 
 
@@ -199,7 +751,7 @@ BlockCollection::getNonEmptyBlocks()
 size_t
 BlockCollection::getNumNonEmptyBlocks() const
 {
-  return m_nonEmptyBlocks.size();
+  return getNonEmptyBlocks()->size();
 }
 
 
@@ -222,8 +774,13 @@ BlockCollection::getRangeMin() const
 void
 BlockCollection::setRangeMin(double min)
 {
-  m_rangeLow = min;
-  m_rangeChanged = true;
+  {
+    std::unique_lock<std::mutex> lock(m_classifyMutex);
+    m_rangeLow = min;
+    ++m_rangeRequests;
+    m_rangeChanged = true;
+  }
+  m_classifyWait.notify_all();
 }
 
 
@@ -239,8 +796,13 @@ BlockCollection::getRangeMax() const
 void
 BlockCollection::setRangeMax(double max)
 {
-  m_rangeHigh = max;
-  m_rangeChanged = true;
+  {
+    std::unique_lock<std::mutex> lock(m_classifyMutex);
+    m_rangeHigh = max;
+    ++m_rangeRequests;
+    m_rangeChanged = true;
+  }
+  m_classifyWait.notify_all();
 }
 
 
@@ -253,78 +815,71 @@ BlockCollection::getRangeChanged() const
 
 
 ///////////////////////////////////////////////////////////////////////////////
-void
-BlockCollection::changeClassificationType(ClassificationType type)
+uint64_t
+BlockCollection::getRangeRequests() const
 {
-  m_classificationType = type;
-  // pausing the load thread clears the queue of loadable blocks.
-  m_loader->clearLoadQueue();
-  filterBlocks();
-  // TODO: update for this classification type.
-
+  return m_rangeRequests;
 }
 
 
 ///////////////////////////////////////////////////////////////////////////////
-void
-BlockCollection::filterBlocksByROV()
+uint64_t
+BlockCollection::getRangeServed() const
 {
-  m_nonEmptyBlocks.clear();
-  m_emptyBlocks.clear();
-
-  size_t nBlk{ m_blocks.size() };
-  for (size_t i{ 0 }; i<nBlk; ++i) {
-
-    bd::Block *b{ m_blocks[i] };
-    double rov = b->fileBlock().rov;
+  return m_rangeServed;
+}
 
-    if (rov>=m_rangeLow && rov<=m_rangeHigh) {
-      b->empty(false);
-      m_nonEmptyBlocks.push_back(b);
-    } else {
-      b->empty(true);
-      m_emptyBlocks.push_back(b);
-    }
 
-  } // for
+///////////////////////////////////////////////////////////////////////////////
+void
+BlockCollection::setBudgetFraction(double fraction)
+{
+  {
+    std::unique_lock<std::mutex> lock(m_classifyMutex);
+    m_budgetFraction = fraction;
+    ++m_rangeRequests;
+    m_rangeChanged = true;
+  }
+  m_classifyWait.notify_all();
+}
 
-  ShownBlocksMessage *m{ new ShownBlocksMessage };
-  m->ShownBlocks = m_nonEmptyBlocks.size();
-  Broker::send(m);
 
-  m_rangeChanged = false;
+///////////////////////////////////////////////////////////////////////////////
+size_t
+BlockCollection::cacheBlocks() const
+{
+  return std::min(m_loader->maxGpuBlocks(), m_loader->maxMainBlocks());
 }
 
 
 ///////////////////////////////////////////////////////////////////////////////
 void
-BlockCollection::filterBlocksByAverage()
+BlockCollection::changeClassificationType(ClassificationType type)
 {
-  m_nonEmptyBlocks.clear();
-  m_emptyBlocks.clear();
-
-  size_t nBlk{ m_blocks.size() };
-  for (size_t i{ 0 }; i<nBlk; ++i) {
-
-    bd::Block *b{ m_blocks[i] };
-    double avg = b->fileBlock().avg_val;
+  {
+    std::unique_lock<std::mutex> lock(m_classifyMutex);
+    m_requestedType = type;
+    m_typeChanged = true;
+  }
+  m_classifyWait.notify_all();
 
-    if (avg>=m_rangeLow && avg<=m_rangeHigh) {
-      b->empty(false);
-      m_nonEmptyBlocks.push_back(b);
-    } else {
-      b->empty(true);
-      m_emptyBlocks.push_back(b);
-    }
+}
 
-  } // for
 
-  ShownBlocksMessage *m{ new ShownBlocksMessage };
-  m->ShownBlocks = m_nonEmptyBlocks.size();
-  Broker::send(m);
+///////////////////////////////////////////////////////////////////////////////
+void
+BlockCollection::filterBlocksByValue(double low, double high)
+{
+  m_shown.hideAll();
+  m_valueTree.overlap(low, high, [this](bd::Block *b) { m_shown.show(b); });
+}
 
-  m_rangeChanged = false;
 
+///////////////////////////////////////////////////////////////////////////////
+BlockRangeIndex const &
+BlockCollection::classificationIndex() const
+{
+  return m_classificationType==ClassificationType::Avg ? m_avgIndex : m_rovIndex;
 }
 
 
@@ -344,6 +899,23 @@ BlockCollection::handle_MinRangeChangedMessage(MinRangeChangedMessage &m)
 }
 
 
+///////////////////////////////////////////////////////////////////////////////
+void
+BlockCollection::handle_BudgetChangedMessage(BudgetChangedMessage &m)
+{
+  setBudgetFraction(m.Fraction);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+void
+BlockCollection::handle_ClassificationTypeChangedMessage(
+    ClassificationTypeChangedMessage &m)
+{
+  changeClassificationType(m.Type);
+}
+
+
 
 //IndexFile const &
 //BlockCollection::indexFile() const
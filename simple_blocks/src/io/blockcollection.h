@@ -2,17 +2,28 @@
 #define block_collection_h__
 
 #include "blockloader.h"
+#include "blockrangeindex.h"
 #include "classificationtype.h"
 #include "messages/recipient.h"
 
+#include <bd/datastructure/intervaltree.h>
+#include <bd/datastructure/occlusiongrid.h>
+#include <bd/datastructure/octree.h>
+#include <bd/datastructure/visibilityorder.h>
+#include <bd/geo/frustum.h>
 #include <bd/volume/block.h>
+#include <bd/volume/blockstore.h>
 #include <bd/io/indexfile/indexfile.h>
 #include <bd/io/buffer.h>
 #include <bd/util/util.h>
 #include <bd/io/bufferpool.h>
 
+#include <atomic>
+#include <condition_variable>
 #include <functional>
 #include <list>
+#include <memory>
+#include <mutex>
 #include <vector>
 #include <future>
 #include <bd/io/indexfile/v2/jsonindexfile.h>
@@ -20,10 +31,20 @@
 namespace subvol
 {
 
+///////////////////////////////////////////////////////////////////////////////
+/// \brief Owns the blocks and decides which are shown.
+///
+/// Classification runs on a worker thread: range, classification type and
+/// view changes only wake the worker, which filters and culls the blocks,
+/// talks to the loader and publishes the shown blocks and in-view flags as
+/// immutable lists. Readers take the current lists with getNonEmptyBlocks()
+/// and getInView() and never see them change.
+///////////////////////////////////////////////////////////////////////////////
 class BlockCollection
     : public Recipient
 {
 public:
+  using BlockList = std::vector<bd::Block *>;
 //  BlockCollection();
 
   BlockCollection(BlockLoader *loader, bd::indexfile::v2::JsonIndexFile const &index);
@@ -34,24 +55,65 @@ public:
 
   /// \brief Initializes \c blocks from the provided vector of FileBlock.
   /// \note Blocks are sized to fit it within the world-extent of the volume data.
-  /// \param fileBlocks[in] The FileBlocks generated from the IndexFile.
-  /// \param vd[in]  The voxel dimensions of the volume data
-  /// \param numblocks[in]  The number of blocks to generate in each dimension.
+  /// \note The blocks need not be a grid, each one keeps the ijk index of
+  ///       its FileBlock (an adaptive partition lists them along x).
+  /// \param fileBlocks[in] The FileBlocks generated from the IndexFile. The
+  ///        blocks refer to them, so they must outlive the collection.
   void
-  initBlocksFromFileBlocks(std::vector<bd::FileBlock> const &fileBlocks,
-                           glm::u64vec3 const &numblocks);
+  initBlocksFromFileBlocks(std::vector<bd::FileBlock> const &fileBlocks);
 
 
+  /// \brief Ask the classification thread to send the shown blocks to the
+  /// loader.
+  ///
+  /// If few blocks changed since the last update only the change is sent
+  /// (BlockLoader::queueDelta()), otherwise the whole classification.
   void
-  filterBlocks();
+  updateBlockCache();
 
 
   void
-  updateBlockCache();
+  loadSomeBlocks();
 
 
+  /// \brief Ask the classification thread to cull the blocks for a new
+  /// camera and tell the loader, so blocks in view load first.
+  ///
+  /// Blocks outside of the frustum of \c viewProj, and blocks of a regular
+  /// grid hidden behind the shown blocks (see updateOpacity()), are out of
+  /// view, see getInView(). The blocks are culled again each time the shown
+  /// blocks change.
   void
-  loadSomeBlocks();
+  updateView(glm::vec3 const &eye, glm::vec3 const &lookAt,
+             glm::mat4 const &viewProj);
+
+
+  /// \brief Number of view (or opacity) changes asked for so far.
+  uint64_t
+  getViewRequests() const;
+
+
+  /// \brief How many of the view requests getInView() reflects.
+  uint64_t
+  getViewServed() const;
+
+
+  /// \brief The latest in-view flags, 1 for each block (by block index) in
+  /// view, or nullptr before the first updateView().
+  std::shared_ptr<std::vector<uint8_t> const>
+  getInView() const;
+
+
+  /// \brief Ask the classification thread to estimate how opaque each block
+  /// is with the renderers' transfer function, for the occlusion test of
+  /// updateView(). Counts as a view request.
+  ///
+  /// \param alpha The transfer function's opacity, evenly spaced over [0, 1]
+  ///              (the texels of the colormap texture).
+  /// \param scale Data values are scaled by this before the transfer
+  ///              function lookup.
+  void
+  updateOpacity(std::vector<float> const &alpha, float scale);
 
 
   std::vector<bd::Block *> const &
@@ -62,8 +124,22 @@ public:
   getBlocks();
 
 
-  std::vector<bd::Block *> &
-  getNonEmptyBlocks();
+  /// \brief The latest published list of shown blocks, in no particular
+  /// order. The list is never modified, copy it to sort it.
+  std::shared_ptr<BlockList const>
+  getNonEmptyBlocks() const;
+
+
+  /// \brief The blocks of \c blocks that are read in full into main memory
+  /// (those with pixel data if there is no loader).
+  void
+  getResidentBlocks(BlockList const &blocks, BlockList &resident) const;
+
+
+  /// \brief Back to front order of the block grid, not valid() if the
+  /// blocks are not a regular grid (an adaptive partition).
+  bd::VisibilityOrder const &
+  getGridOrder() const;
 
 
   size_t
@@ -93,6 +169,27 @@ public:
   bool
   getRangeChanged() const;
 
+
+  /// \brief Number of range (or budget) changes asked for so far.
+  uint64_t
+  getRangeRequests() const;
+
+
+  /// \brief How many of the range requests getNonEmptyBlocks() reflects.
+  /// Once it reaches getRangeRequests() the shown blocks are those of the
+  /// last range set.
+  uint64_t
+  getRangeServed() const;
+
+
+  /// \brief Fit the shown blocks in \c fraction of the caches.
+  ///
+  /// While on, the min of the range is raised as far as needed for the
+  /// blocks in [min, max] to fit in \c fraction of the blocks the cpu and
+  /// gpu caches can hold. 0 turns it off.
+  void
+  setBudgetFraction(double fraction);
+
   /// Find the largest non-empty block and return the number of voxels.
   /// \return size_t that is the number of voxels in the largest block.
 //  uint64_t
@@ -100,39 +197,182 @@ public:
 
 
   /// Change the classification type. 
-  /// The blocks are immediatly filtered and loading of the new
+  /// The classification thread refilters the blocks and loading of the new
   /// set of blocks begins.
   void
   changeClassificationType(ClassificationType type);
 
 
+private:
+  /// \brief The classification thread: waits for range, type or cache
+  /// update requests and serves them.
+  int
+  classifyLoop();
+
+
+  /// \brief Update the shown blocks for [low, high] and publish them.
+  ///
+  /// Only blocks whose value crossed a range endpoint since the last call are
+  /// touched (see ShownBlocks), except after the classification type
+  /// changes.
+  /// \param budgetFraction If > 0, low is raised so the shown blocks fit in
+  ///        this fraction of cacheBlocks().
+  void
+  filterBlocks(double low, double high, double budgetFraction);
+
+
+  /// \brief Number of blocks both the cpu and gpu caches can hold.
+  size_t
+  cacheBlocks() const;
+
+
+  /// \brief Send the shown blocks (or the change) to the loader.
   void
-  filterBlocksByROV();
+  sendToLoader();
 
 
+  /// \brief Queue blocks just outside [low, high], in the direction the
+  /// range is being dragged, for prefetching.
   void
-  filterBlocksByAverage();
+  prefetchAroundRange(double low, double high);
 
 
-private:
+  /// \brief Show the blocks whose value range intersects [low, high] (the
+  /// blocks straddling the isovalue if low == high).
+  void
+  filterBlocksByValue(double low, double high);
+
+
+  /// \brief The index for the current classification type.
+  BlockRangeIndex const &
+  classificationIndex() const;
+
+
+  /// \brief The camera updateView() was called with.
+  struct View
+  {
+    glm::vec3 eye;
+    glm::vec3 lookAt;
+    glm::mat4 viewProj;
+  };
+
+
+  /// \brief Cull the blocks for m_view, publish the flags and send them to
+  /// the loader.
+  void
+  cullView();
+
+
+  /// \brief Clear the flags in \c inView of blocks that let almost none of
+  /// their light through the shown blocks in front of them.
+  void
+  hideOccluded(glm::vec3 const &eye, std::vector<uint8_t> &inView);
+
+
+  /// \brief Fill m_blockOpacity, see updateOpacity().
+  void
+  estimateOpacity(std::vector<float> const &alpha, float scale);
+
+
+  /// Every block's state, m_blocks are its views.
+  std::unique_ptr<bd::BlockStore> m_store;
+
   std::vector<bd::Block *> m_blocks;
 
-  std::vector<bd::Block *> m_nonEmptyBlocks;
+  /// The classification thread's working list of shown blocks.
+  ShownBlocks m_shown;
+
+  /// The last published copy of m_shown's blocks. Only accessed through
+  /// std::atomic_load/atomic_store.
+  std::shared_ptr<BlockList const> m_published;
 
+  /// Built from the range index when the block cache is updated.
   std::vector<bd::Block *> m_emptyBlocks;
 
+  BlockRangeIndex m_rovIndex;
+  BlockRangeIndex m_avgIndex;
+
+  /// Each block's [min, max] value range, normalized to the volume's range.
+  bd::IntervalTree<bd::Block *> m_valueTree;
+
+  /// Sub-brick occupancy of each block, dilated (OccupancyMask::dilated()) so
+  /// the loader can skip the empty bricks as they are. Pointed to by the
+  /// blocks, empty if the index file has none.
+  std::vector<bd::OccupancyMask> m_masks;
+
+  bd::VisibilityOrder m_gridOrder;
+
+  /// Each block's world box, in block index order.
+  bd::AabbBatch m_boxes;
+
+  /// Value aggregates over a regular grid of blocks, empty otherwise. Culls
+  /// whole subtrees of the grid at once.
+  bd::Octree m_octree;
+
+  /// Block index of each leaf of m_octree.
+  std::vector<uint64_t> m_leafBlocks;
+
+  /// World min corner and cell size of a regular grid.
+  glm::vec3 m_gridLow;
+  glm::vec3 m_gridCell;
+
+  /// The last culling result. Only accessed through
+  /// std::atomic_load/atomic_store.
+  std::shared_ptr<std::vector<uint8_t> const> m_inView;
+
+  /// Transmittance from the eye through the block grid, not valid() if the
+  /// blocks are not a regular grid.
+  bd::OcclusionGrid m_occlusion;
+
+  /// Each block's estimated opacity by block index, empty until
+  /// updateOpacity().
+  std::vector<float> m_blockOpacity;
+
+  /// The camera last culled for, used by the classification thread only.
+  View m_view;
+  bool m_haveView;
+
+  /// cullView() scratch, one per grid cell.
+  std::vector<float> m_cellOpacity;
+  std::vector<float> m_transmittance;
+
+  /// m_shown's index and span as of the last updateBlockCache().
+  BlockRangeIndex const *m_cachedIndex;
+  BlockRangeIndex::Span m_cached;
+
   bd::Volume m_volume;
 
   BlockLoader *m_loader;
 
   std::future<int> m_loaderFuture;
 
-  ClassificationType m_classificationType;
+  std::future<int> m_classifierFuture;
 
-  double m_rangeLow;
-  double m_rangeHigh;
+  /// Used by the classification thread only.
+  ClassificationType m_classificationType;
 
-  bool m_rangeChanged;
+  /// Guards the requests below and wakes the classification thread.
+  std::mutex m_classifyMutex;
+  std::condition_variable m_classifyWait;
+  ClassificationType m_requestedType;
+  bool m_typeChanged;
+  bool m_cacheUpdateRequested;
+  bool m_stopClassifier;
+  double m_budgetFraction;
+  View m_requestedView;
+  bool m_viewChanged;
+  std::vector<float> m_requestedAlpha;
+  float m_requestedScale;
+  bool m_opacityChanged;
+
+  std::atomic<double> m_rangeLow;
+  std::atomic<double> m_rangeHigh;
+
+  std::atomic_bool m_rangeChanged;
+  std::atomic<uint64_t> m_rangeRequests;
+  std::atomic<uint64_t> m_rangeServed;
+  std::atomic<uint64_t> m_viewRequests;
+  std::atomic<uint64_t> m_viewServed;
 
   std::function<void(size_t)> m_visibleBlocksCb;
 
@@ -145,6 +385,15 @@ public:   /* public message bus handlers */
   void
   handle_MinRangeChangedMessage(MinRangeChangedMessage &m) override;
 
+
+  void
+  handle_BudgetChangedMessage(BudgetChangedMessage &m) override;
+
+
+  void
+  handle_ClassificationTypeChangedMessage(
+      ClassificationTypeChangedMessage &m) override;
+
   //  BlockMemoryManager *m_man;
 
 }; // BlockCollection
@@ -12,30 +12,93 @@
 #include <bd/volume/block.h>
 
 #include <algorithm>
+#include <chrono>
 #include <fstream>
 
 namespace subvol
 {
 
+namespace
+{
+
+/// Weights of the terms in BlockLoader::loadPriority().
+double const ROV_WEIGHT{ 1.0 };
+double const SIZE_WEIGHT{ 1.0 };
+double const FOCUS_WEIGHT{ 2.0 };
+// larger than any in-view priority, see loadPriority().
+double const OUT_OF_VIEW_PENALTY{ ROV_WEIGHT+SIZE_WEIGHT+FOCUS_WEIGHT };
+
+/// Queued blocks re-prioritized per block loaded after the view changes.
+size_t const REKEY_BATCH{ 4096 };
+
+/// Seconds ahead the prefetch predictor looks.
+double const PREFETCH_HORIZON{ 0.5 };
+
+/// Fraction of the cpu buffers that prefetching leaves for demand loads.
+double const PREFETCH_RESERVE{ 0.25 };
+
+
+double
+secondsNow()
+{
+  return std::chrono::duration<double>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+} // namespace
+
+
 BlockLoader::BlockLoader(BLThreadData *threadParams, bd::Volume const &volume)
     : m_stopThread{ false }
-    , m_gpu()
-    , m_main()
-    , m_texs()
+    , m_gpu(threadParams->numBlocks)
+    , m_main(threadParams->numBlocks)
+    , m_evictable(threadParams->numBlocks)
+    , m_pendingRelease(threadParams->numBlocks)
+    , m_atlasTexs()
+    , m_atlas()
     , m_buffs()
-    , m_loadQueue{ }
+    , m_arena{ threadParams->arena }
+    , m_quantizer{ threadParams->quantizeMode, threadParams->quantizeErrorBound }
+    , m_readBuffer()
+    , m_rawBytes{ 0 }
+    , m_storedBytes{ 0 }
+    , m_maxQuantError{ 0.0 }
+    , m_loadQueue{ threadParams->numBlocks }
+    , m_prefetchQueue{ threadParams->numBlocks }
+    , m_queuedBlocks(threadParams->numBlocks, nullptr)
+    , m_predictor{ threadParams->numBlocks, PREFETCH_HORIZON }
+    , m_generation{ 0 }
+    , m_cancelledLoads{ 0 }
+    , m_wastedBytes{ 0 }
+    , m_eye{ 0.0f, 0.0f, 0.0f }
+    , m_viewDir{ 0.0f, 0.0f, -1.0f }
+    , m_haveView{ false }
+    , m_inView{ nullptr }
+    , m_rekeyCursor{ 0 }
+    , m_rekeyRemaining{ 0 }
     , m_gpuReadyQueue{ }
     , m_maxGpuBlocks{ threadParams->maxGpuBlocks }
+    , m_gpuAttached{ threadParams->atlas!=nullptr }
     , m_maxMainBlocks{ threadParams->maxCpuBlocks }
     , m_sizeType{ bd::to_sizeType(threadParams->type) }
     , m_slabDims{ threadParams->slabDims[0], threadParams->slabDims[1] }
     , m_volMin{ volume.min() }
     , m_volDiff{ volume.max()-volume.min() }
+    , m_skipEmptyBricks{ threadParams->hasEmptyValue }
+    , m_emptyValue{ threadParams->emptyValue }
     , m_fileName{ threadParams->filename }
+    , m_in{ threadParams->stream }
     , m_reader{ nullptr }
 {
   m_reader = BlockReaderFactory::New(threadParams->type);
-  m_texs = *( threadParams->texs );
+  m_atlasTexs = *( threadParams->texs );
+  if (threadParams->atlas) {
+    m_atlas = *( threadParams->atlas );
+  } else {
+    // no gpu slots, but still accept every block index.
+    m_atlas = bd::AtlasAllocator({ 1, 1, 1 }, { 1, 1, 1 }, 0,
+                                 threadParams->numBlocks);
+  }
   m_buffs = *( threadParams->buffers );
 }
 
@@ -57,59 +120,101 @@ int
 BlockLoader::operator()()
 {
   bd::Info() << "Load thread started.";
-  raw.open(m_fileName, std::ios::binary);
-  if (!raw.is_open()) {
-    bd::Err() << "The raw file " << m_fileName
-              << " could not be opened. Exiting loader loop.";
-    return -1;
+  if (!m_in) {
+    raw.open(m_fileName, std::ios::binary);
+    if (!raw.is_open()) {
+      bd::Err() << "The raw file " << m_fileName
+                << " could not be opened. Exiting loader loop.";
+      return -1;
+    }
+    m_in = &raw;
   }
 
   while (!m_stopThread) {
 
     BlockCacheStatsMessage *m{ new BlockCacheStatsMessage };
-    m->CpuCacheSize = m_main.size();
 
     m_gpuMutex.lock();
     m->GpuCacheSize = m_gpu.size();
     m_gpuMutex.unlock();
 
     m_loadQueueMutex.lock();
+    m->CpuCacheSize = m_main.size();
+    m->CpuBuffersAvailable = m_buffs.size();
     m->CpuLoadQueueSize = m_loadQueue.size();
+    m->PrefetchQueueSize = m_prefetchQueue.size();
+    m->PrefetchCount = m_predictor.prefetchCount();
+    m->PrefetchHitRate = m_predictor.hitRate();
     m_loadQueueMutex.unlock();
 
-    m->CpuBuffersAvailable = m_buffs.size();
-    m->GpuTexturesAvailable = m_texs.size();
+    m->CancelledLoads = m_cancelledLoads;
+    m->WastedBytes = m_wastedBytes;
+
+    m->CpuCommittedBytes = m_arena ? m_arena->committedBytes() : 0;
+    m->GpuTexturesAvailable = atlasSlotsAvailable();
+    m->CompressionRatio = m_storedBytes==0
+                          ? 1.0
+                          : m_rawBytes/static_cast<double>(m_storedBytes);
+    m->MaxQuantizationError = m_maxQuantError;
     Broker::send(m);
 
-    // get a block marked as visible
-    bd::Block *b{ waitPopLoadQueue() };
+    // get a block marked as visible, or one to prefetch.
+    bool prefetch{ false };
+    char *buf{ nullptr };
+    bd::Block *b{ waitPopLoadQueue(prefetch, buf) };
     if (!b) {
       bd::Info() << "nullptr found in the load queue. Exiting loader loop.";
       break;
     }
 
-    b->pixelData(m_buffs.back());
-    m_buffs.pop_back();
-    m_reader->fillBlockData(b->pixelData(),
-                            &raw,
-                            b->fileBlock().data_offset,
-                            b->fileBlock().voxel_dims,
-                            b->fileBlock().ijk_index,
-                            m_slabDims,
-                            m_volMin,
-                            m_volDiff);
-    m_main.insert(std::make_pair(b->index(), b));
-
-    if (!m_texs.empty()) {
-      b->texture(m_texs.back());
-      m_texs.pop_back();
-      pushGPUReadyQueue(b);
+    // the load thread commits the buffers, so with NUMA binding they are
+    // placed on its node.
+    if (m_arena) {
+      m_arena->commit(buf);
+    }
+
+    LoadTicket ticket{ &m_generation, b, prefetch };
+    if (!readBlock(b, buf, ticket)) {
+      // The block was hidden while it was being read, hand its buffer back.
+      {
+        std::unique_lock<std::mutex> lock(m_loadQueueMutex);
+        m_buffs.push_back(buf);
+      }
+      m_cancelledLoads += 1;
+      m_wastedBytes += ticket.bytesRead;
+      bd::Dbg() << "Cancelled load of block " << b->index() << " after "
+                << ticket.bytesRead << " bytes.";
+      continue;
+    }
+
+    {
+      // Given out with the insert into m_main, so isInMain() and
+      // residentBlocks() see the block's data once they see it in main.
+      // The slot is given under the lock too, so a queueDelta() that hides
+      // the block sees either no slot (and it is not given one here) or the
+      // slot (and puts the block up for release).
+      std::unique_lock<std::mutex> lock(m_loadQueueMutex);
+      b->pixelData(buf);
+      m_main.insert(b->index(), b);
+      if (b->empty()) {
+        m_evictable.insert(b->index(), b);
+      } else if (!prefetch && assignAtlasSlot(b)) {
+        pushGPUReadyQueue(b);
+      }
+      if (prefetch) {
+        m_predictor.prefetched(b->index());
+      }
     }
 
 
   } // while
 
-  raw.close();
+  if (raw.is_open()) {
+    raw.close();
+  }
+  if (m_arena) {
+    bd::Info() << m_arena->usage();
+  }
   bd::Dbg() << "Exiting block loader thread.";
   return 0;
 } // operator()
@@ -117,25 +222,49 @@ BlockLoader::operator()()
 void
 BlockLoader::stop()
 {
-  m_stopThread = true;
+  {
+    // under the lock, so the load thread can not miss the wake up.
+    std::unique_lock<std::mutex> lock(m_loadQueueMutex);
+    m_stopThread = true;
+  }
   m_wait.notify_one();
 }
 
 
 bd::Block *
-BlockLoader::waitPopLoadQueue()
+BlockLoader::waitPopLoadQueue(bool &prefetch, char *&buf)
 {
   std::unique_lock<std::mutex> lock(m_loadQueueMutex);
-  while (m_loadQueue.size()==0 && !m_stopThread) {
+  while (!m_stopThread) {
+    if (m_loadQueue.size()>0 || canPrefetch()) {
+      // Prefetched blocks the user never asked for can fill main memory,
+      // make room by evicting one of them (or any empty block).
+      if (m_buffs.empty()) {
+        evictHidden(1);
+      }
+      if (!m_buffs.empty()) {
+        break;
+      }
+    }
+    // Nothing to load, or every buffer holds a block that may still be
+    // drawn. A block stays queued until a hidden one can be evicted.
     m_wait.wait(m_loadQueueMutex);
   }
   if (m_stopThread) {
     return nullptr;
   }
 
-  bd::Block *b{ m_loadQueue.back() };
+  rekeyLoadQueue(REKEY_BATCH);
+
+  // demand loads always go first.
+  prefetch = m_loadQueue.empty();
+  uint64_t const idx{ prefetch ? m_prefetchQueue.pop() : m_loadQueue.pop() };
+  bd::Block *b{ m_queuedBlocks[idx] };
   assert(b!=nullptr && "A null block was found in the load queue");
-  m_loadQueue.pop_back();
+  m_queuedBlocks[idx] = nullptr;
+
+  buf = m_buffs.back();
+  m_buffs.pop_back();
 
   return b;
 }
@@ -150,7 +279,7 @@ BlockLoader::queueClassified(std::vector<bd::Block *> const &visible,
   // we hold the load queue mutex here because the load thread shouldn't be doing
   // any work while we sort (literally) things out.
   std::unique_lock<std::mutex> lock(m_loadQueueMutex);
-  m_loadQueue.clear();
+  classificationChanged();
 
   {
     // clear the gpu ready queue.
@@ -159,86 +288,438 @@ BlockLoader::queueClassified(std::vector<bd::Block *> const &visible,
     m_gpuReadyQueue.swap(empty_q);
   }
 
-  // remove only empty blocks from the GPU and put the textures 
-  // back in the list of available textures.
-  removeEmptyBlocksFromGpu();
+  // Hidden blocks with an atlas slot (on the gpu or waiting for upload) give
+  // it back on the render thread, see releaseHiddenBlocks(). This list
+  // replaces the last one, every hidden block is in empty.
+  m_pendingRelease.clear();
+  {
+    std::unique_lock<std::mutex> lock_atlas(m_atlasMutex);
+    for (bd::Block *b : empty) {
+      if (m_atlas.slotOf(b->index())!=bd::AtlasAllocator::NO_SLOT) {
+        m_pendingRelease.insert(b->index(), b);
+      }
+    }
+  }
+
+  // the range has settled, stop speculating.
+  clearPrefetchQueue();
+  m_predictor.stopRange();
+  size_t const hitsBefore{ m_predictor.hitCount() };
 
-  // figure out if we must evict blocks from main memory.
   // queue all blocks not in main memory for loading by the loader thread.
   // if the block is already in main, then assign it a texture.
   for (size_t i{ 0 }; i<visible.size(); ++i) {
     bd::Block *vis{ visible[i] };
     assert(vis!=nullptr && "Block was null when iterating visible blocks.");
-    if (m_main.find(vis->index())==m_main.end()) {
-      // The block is not in main, so it needs to be loaded from disk, pushed to main,
-      // and finally pushed to the gpu ready queue.
-      // The load thread (running in operator()) pushes to the
-      // gpu ready queue and the render thread pops from the gpu ready queue and uploads
-      // to the gpu, then pushes the block pointer to the gpu resident queue.
-      assert(m_gpu.find(vis->index())==m_gpu.end() &&
-                 "Block is not in main, but is in gpu!");
-      m_loadQueue.push_back(vis);
-    } else if (m_gpu.find(vis->index())==m_gpu.end()) {
-      // The block is not on the gpu yet, but it is in main,
-      // so push to the gpu queue. If it has a texture, it is ready to go, 
-      // but if it needs a texture, give it one.
-      if (vis->texture()!=nullptr) {
-        pushGPUReadyQueue(vis);
-      } else if (m_texs.size()>0) {
-        vis->texture(m_texs.back());
-        m_texs.pop_back();
-        pushGPUReadyQueue(vis);
+    queueVisible(vis);
+  } // for
+
+  bd::Dbg() << "Prefetch hits: " << m_predictor.hitCount()-hitsBefore
+            << " (hit rate " << m_predictor.hitRate() << " of "
+            << m_predictor.prefetchCount() << " prefetched).";
+
+  // Drop queued blocks that are no longer visible (the classifier marks
+  // them empty). Collect them first, erasing reorders the heap.
+  std::vector<uint64_t> notVisible;
+  for (size_t i{ 0 }; i<m_loadQueue.size(); ++i) {
+    uint64_t const idx{ m_loadQueue.idAt(i) };
+    if (m_queuedBlocks[idx]->empty()) {
+      notVisible.push_back(idx);
+    }
+  }
+  for (uint64_t idx : notVisible) {
+    m_loadQueue.erase(idx);
+    m_queuedBlocks[idx] = nullptr;
+  }
+
+  // The eviction candidates are the hidden blocks in main. Those still
+  // holding a slot may be waiting for upload from their buffer, they become
+  // evictable once releaseHiddenBlocks() takes the slot.
+  m_evictable.clear();
+  for (bd::Block *b : m_main.values()) {
+    if (b->empty() && !m_pendingRelease.contains(b->index())) {
+      m_evictable.insert(b->index(), b);
+    }
+  }
+
+  fitLoadQueue();
+
+  m_wait.notify_all();
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+void
+BlockLoader::queueDelta(std::vector<bd::Block *> const &added,
+                        std::vector<bd::Block *> const &removed)
+{
+  bd::Dbg() << "Added: " << added.size() << ", removed: " << removed.size();
+  std::unique_lock<std::mutex> lock(m_loadQueueMutex);
+  classificationChanged();
+
+  {
+    // Hidden blocks leave the load queue now, and the gpu when the render
+    // thread next calls releaseHiddenBlocks().
+    std::unique_lock<std::mutex> lock_atlas(m_atlasMutex);
+    for (bd::Block *b : removed) {
+      assert(b!=nullptr && "Block was null when iterating removed blocks.");
+      uint64_t const idx{ b->index() };
+      if (m_loadQueue.erase(idx)) {
+        m_queuedBlocks[idx] = nullptr;
+      }
+      if (m_atlas.slotOf(idx)!=bd::AtlasAllocator::NO_SLOT) {
+        // evictable after releaseHiddenBlocks(), see queueClassified().
+        m_pendingRelease.insert(idx, b);
+      } else if (m_main.contains(idx)) {
+        m_evictable.insert(idx, b);
       }
     }
-  } // for
+  }
 
+  clearPrefetchQueue();
+  m_predictor.stopRange();
 
+  for (bd::Block *b : added) {
+    assert(b!=nullptr && "Block was null when iterating added blocks.");
+    m_evictable.erase(b->index());
+    queueVisible(b);
+  }
 
-  // if the load queue is larger than the number of available textures,
-  // this means we won't be able to load them all to the gpu. Scan the
-  // main for empties with textures (there probably won't be any)
-  // we we must evict empty blocks from main and recover their texture and pixel buffers.
+  fitLoadQueue();
 
+  m_wait.notify_all();
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+void
+BlockLoader::queueVisible(bd::Block *vis)
+{
+  // shown again before the render thread got to it, it keeps its slot.
+  m_pendingRelease.erase(vis->index());
+
+  if (!m_main.contains(vis->index())) {
+    // The block is not in main, so it needs to be loaded from disk, pushed to main,
+    // and finally pushed to the gpu ready queue.
+    // The load thread (running in operator()) pushes to the
+    // gpu ready queue and the render thread pops from the gpu ready queue and uploads
+    // to the gpu, then pushes the block pointer to the gpu resident queue.
+    assert(!m_gpu.contains(vis->index()) &&
+               "Block is not in main, but is in gpu!");
+    // Only blocks new to the queue need a sift, a queued block whose
+    // priority did not change is left where it is.
+    double const p{ loadPriority(vis) };
+    if (!m_loadQueue.contains(vis->index())) {
+      m_loadQueue.push(vis->index(), p);
+    } else if (m_loadQueue.priority(vis->index())!=p) {
+      m_loadQueue.update(vis->index(), p);
+    }
+    m_queuedBlocks[vis->index()] = vis;
+  } else if (!m_gpu.contains(vis->index())) {
+    // The block is not on the gpu yet, but it is in main,
+    // so push to the gpu queue. If it has a texture, it is ready to go,
+    // but if it needs a texture, give it one.
+    m_predictor.demanded(vis->index());
+    if (vis->texture()!=nullptr) {
+      pushGPUReadyQueue(vis);
+    } else if (assignAtlasSlot(vis)) {
+      pushGPUReadyQueue(vis);
+    }
+  }
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+size_t
+BlockLoader::evictHidden(size_t n)
+{
+  size_t evicted{ 0 };
+  while (evicted<n && !m_evictable.empty()) {
+    bd::Block *b{ m_evictable.values().back() };
+    assert(b->texture()==nullptr && "Evicting a block that holds a slot.");
+    m_evictable.erase(b->index());
+    m_main.erase(b->index());
+    m_buffs.push_back(b->removePixelData());
+    m_predictor.evicted(b->index());
+    ++evicted;
+  }
+  return evicted;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+void
+BlockLoader::fitLoadQueue()
+{
+  // if the load queue is larger than the number of available textures,
+  // this means we won't be able to load them all to the gpu.
+  // Evict hidden blocks from main to recover their pixel buffers.
+  // Until attachGpu() there are no slots yet, keep what the gpu will hold.
+  // The slots of hidden blocks count as free, they are released before the
+  // blocks in the queue are read and uploaded.
+  size_t const slotsAvailable{ m_gpuAttached
+                               ? atlasSlotsAvailable()+m_pendingRelease.size()
+                               : m_maxGpuBlocks.load() };
   long long num_to_evict{ static_cast<long long>(m_loadQueue.size())-
-                              static_cast<long long>(m_texs.size()) };
+                              static_cast<long long>(slotsAvailable) };
+  if (num_to_evict<=0) {
+    return;
+  }
+
+  bd::Dbg() << "Need to evict " << num_to_evict
+            << " blocks (LQ Size: " << m_loadQueue.size()
+            << ", Atlas slots avail: " << slotsAvailable << ").";
+
+  num_to_evict -= evictHidden(static_cast<size_t>(num_to_evict));
+
+  // If we did not evict enough blocks from main to fit the entire load queue
+  // into memory, then drop the lowest priority blocks that are remaining.
   if (num_to_evict>0) {
-    bd::Dbg() << "Need to evict " << num_to_evict
-              << " blocks (LQ Size: " << m_loadQueue.size()
-              << ", Texs avail: " << m_texs.size() << ").";
-
-    // We have more blocks than there are available memory slots, so we need to
-    // evict some empties.
-    auto it = m_main.begin();
-    auto end = m_main.end();
-    while (num_to_evict>0 && it!=end) {
-      bd::Block *b{ it->second };
-      assert(b!=nullptr && "Block was null when iterating main to evict empty blocks.");
-      if (b->empty()) {
-        char *buff{ b->removePixelData() };
-        m_buffs.push_back(buff);
-        it = m_main.erase(it);
-        --num_to_evict;
-      } else {
-        ++it;
-      }
+    std::vector<std::pair<double, uint64_t>> lowest;
+    lowest.reserve(m_loadQueue.size());
+    for (size_t i{ 0 }; i<m_loadQueue.size(); ++i) {
+      uint64_t const idx{ m_loadQueue.idAt(i) };
+      lowest.push_back({ m_loadQueue.priority(idx), idx });
+    }
+    size_t const n{ std::min(static_cast<size_t>(num_to_evict), lowest.size()) };
+    std::nth_element(lowest.begin(), lowest.begin()+n, lowest.end());
+    for (size_t i{ 0 }; i<n; ++i) {
+      m_loadQueue.erase(lowest[i].second);
+      m_queuedBlocks[lowest[i].second] = nullptr;
     }
+  }
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+void
+BlockLoader::classificationChanged()
+{
+  m_generation += 1;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+uint64_t
+BlockLoader::wastedBytes() const
+{
+  return m_wastedBytes;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+bool
+BlockLoader::isInMain(uint64_t index)
+{
+  std::unique_lock<std::mutex> lock(m_loadQueueMutex);
+  return m_main.contains(index);
+}
+
 
-    // If we did not evict enough blocks from main to fit the entire load queue
-    // into memory, then pop all the blocks out of the load queue that are
-    // remaining.
-    while (num_to_evict>0) {
-      m_loadQueue.pop_back();
-      num_to_evict--;
+///////////////////////////////////////////////////////////////////////////////
+void
+BlockLoader::residentBlocks(std::vector<bd::Block *> const &blocks,
+                           std::vector<bd::Block *> &resident)
+{
+  resident.clear();
+  std::unique_lock<std::mutex> lock(m_loadQueueMutex);
+  for (bd::Block *b : blocks) {
+    if (m_main.contains(b->index())) {
+      resident.push_back(b);
     }
   }
+}
 
-  // sort blocks in ROV descending order
-  std::sort(m_loadQueue.begin(), m_loadQueue.end(),
-            [](bd::Block *lhs, bd::Block *rhs) -> bool {
-              return lhs->fileBlock().rov>rhs->fileBlock().rov;
-            });
 
-  m_wait.notify_all();
+///////////////////////////////////////////////////////////////////////////////
+size_t
+BlockLoader::loadQueueSize()
+{
+  std::unique_lock<std::mutex> lock(m_loadQueueMutex);
+  return m_loadQueue.size();
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+bool
+BlockLoader::isQueued(uint64_t index)
+{
+  std::unique_lock<std::mutex> lock(m_loadQueueMutex);
+  return m_loadQueue.contains(index);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+bool
+BlockLoader::isEvictable(uint64_t index)
+{
+  std::unique_lock<std::mutex> lock(m_loadQueueMutex);
+  return m_evictable.contains(index);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+bool
+BlockLoader::isReleasePending(uint64_t index)
+{
+  std::unique_lock<std::mutex> lock(m_loadQueueMutex);
+  return m_pendingRelease.contains(index);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+size_t
+BlockLoader::freeBuffers()
+{
+  std::unique_lock<std::mutex> lock(m_loadQueueMutex);
+  return m_buffs.size();
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+void
+BlockLoader::updateView(glm::vec3 const &eye, glm::vec3 const &lookAt,
+                        std::shared_ptr<std::vector<uint8_t> const> inView)
+{
+  std::unique_lock<std::mutex> lock(m_loadQueueMutex);
+  m_inView = std::move(inView);
+  glm::vec3 const dir{ lookAt-eye };
+  float const len{ glm::length(dir) };
+  m_eye = eye;
+  m_viewDir = len>0.0f ? dir/len : glm::vec3{ 0.0f, 0.0f, -1.0f };
+  m_haveView = true;
+  m_predictor.observeView(m_viewDir, secondsNow());
+
+  // start over, every queued block has a stale priority.
+  m_rekeyCursor = 0;
+  m_rekeyRemaining = m_loadQueue.size();
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+void
+BlockLoader::observeRange(double min, double max)
+{
+  std::unique_lock<std::mutex> lock(m_loadQueueMutex);
+  m_predictor.observeRange(min, max, secondsNow());
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+bool
+BlockLoader::predictedRange(double &min, double &max)
+{
+  std::unique_lock<std::mutex> lock(m_loadQueueMutex);
+  m_predictor.predictedRange(min, max);
+  return m_predictor.rangeMoving();
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+void
+BlockLoader::queuePrefetch(std::vector<bd::Block *> const &blocks)
+{
+  std::unique_lock<std::mutex> lock(m_loadQueueMutex);
+  clearPrefetchQueue();
+
+  glm::vec3 const viewDir{ m_predictor.predictedViewDir() };
+  for (bd::Block *b : blocks) {
+    uint64_t const idx{ b->index() };
+    if (m_main.contains(idx) || m_loadQueue.contains(idx)) {
+      continue;
+    }
+    m_prefetchQueue.push(idx, loadPriority(b, viewDir));
+    m_queuedBlocks[idx] = b;
+  }
+
+  if (canPrefetch()) {
+    m_wait.notify_all();
+  }
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+bool
+BlockLoader::canPrefetch() const
+{
+  size_t const reserve{
+      static_cast<size_t>(PREFETCH_RESERVE*m_maxMainBlocks) };
+  return m_loadQueue.empty() &&
+      !m_prefetchQueue.empty() &&
+      m_buffs.size()>reserve;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+void
+BlockLoader::clearPrefetchQueue()
+{
+  for (size_t i{ 0 }; i<m_prefetchQueue.size(); ++i) {
+    m_queuedBlocks[m_prefetchQueue.idAt(i)] = nullptr;
+  }
+  m_prefetchQueue.clear();
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+double
+BlockLoader::loadPriority(bd::Block const *b) const
+{
+  return loadPriority(b, m_viewDir);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+double
+BlockLoader::loadPriority(bd::Block const *b, glm::vec3 const &viewDir) const
+{
+  double const rov{ b->rov() };
+  if (!m_haveView) {
+    return rov;
+  }
+
+  glm::vec3 const toBlock{ b->origin()-m_eye };
+  float const dist{ glm::length(toBlock) };
+  float const radius{ 0.5f*glm::length(b->worldDims()) };
+
+  // angular size of the block's bounding sphere (1 when the eye is in it),
+  // which also falls off with distance.
+  double const size{ radius>0.0f ? radius/std::max(dist, radius) : 0.0f };
+
+  // 1 for a block straight ahead, 0 for one directly behind the eye.
+  double const focus{ dist>0.0f
+                      ? 0.5+0.5*glm::dot(toBlock/dist, viewDir)
+                      : 1.0 };
+
+  double const priority{ ROV_WEIGHT*rov+SIZE_WEIGHT*size+FOCUS_WEIGHT*focus };
+
+  // blocks out of view (outside of the frustum or occluded) load after
+  // every block in view.
+  uint64_t const idx{ b->index() };
+  if (m_inView && idx<m_inView->size() && !( *m_inView )[idx]) {
+    return priority-OUT_OF_VIEW_PENALTY;
+  }
+  return priority;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+void
+BlockLoader::rekeyLoadQueue(size_t n)
+{
+  // Walk the heap by position. An update may move an entry across the
+  // cursor, so a few entries can be visited twice or missed until the next
+  // view change, which only costs a slightly stale priority.
+  while (n>0 && m_rekeyRemaining>0 && m_rekeyCursor<m_loadQueue.size()) {
+    uint64_t const idx{ m_loadQueue.idAt(m_rekeyCursor) };
+    m_loadQueue.update(idx, loadPriority(m_queuedBlocks[idx]));
+    ++m_rekeyCursor;
+    --m_rekeyRemaining;
+    --n;
+  }
+  if (m_rekeyCursor>=m_loadQueue.size()) {
+    m_rekeyRemaining = 0;
+  }
 }
 
 
@@ -249,14 +730,24 @@ BlockLoader::getNextGpuReadyBlock()
   //we are on the render thread since it is the only thread that
   //may upload texture data to OGL server.
   std::unique_lock<std::mutex> lock(m_gpuReadyMutex);
-  bd::Block *b{ nullptr };
-  if (m_gpuReadyQueue.size()>0) {
-    b = m_gpuReadyQueue.front();
+  while (m_gpuReadyQueue.size()>0) {
+    bd::Block *b{ m_gpuReadyQueue.front() };
     assert(b!=nullptr && "Block was null in gpuReadyQueue()");
     m_gpuReadyQueue.pop();
+
+    // releaseHiddenBlocks() leaves hidden blocks in the queue without a
+    // slot, and a block shown again may have been queued twice.
+    if (b->texture()==nullptr) {
+      continue;
+    }
+    std::unique_lock<std::mutex> lock_gpu(m_gpuMutex);
+    if (m_gpu.contains(b->index())) {
+      continue;
+    }
+    return b;
   }
 
-  return b;
+  return nullptr;
 }
 
 
@@ -265,10 +756,12 @@ void
 BlockLoader::pushGpuResidentBlock(bd::Block *b)
 {
   assert(b!=nullptr && "Block was nullptr!");
-  assert(b->texture()!=nullptr && "Block had a null texture!");
+
+  // slots are only released on the render thread, between uploads.
+  assert(b->texture()!=nullptr && "Uploaded block had a null texture!");
 
   std::unique_lock<std::mutex> lock(m_gpuMutex);
-  m_gpu.insert(std::make_pair(b->index(), b));
+  m_gpu.insert(b->index(), b);
 }
 
 
@@ -277,6 +770,10 @@ void
 BlockLoader::clearLoadQueue()
 {
   std::unique_lock<std::mutex> lock(m_loadQueueMutex);
+  classificationChanged();
+  for (size_t i{ 0 }; i<m_loadQueue.size(); ++i) {
+    m_queuedBlocks[m_loadQueue.idAt(i)] = nullptr;
+  }
   m_loadQueue.clear();
 }
 
@@ -293,26 +790,176 @@ BlockLoader::maxMainBlocks()
 size_t
 BlockLoader::maxGpuBlocks()
 {
-  return m_maxGpuBlocks;
+  return m_maxGpuBlocks.load();
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+void
+BlockLoader::attachGpu(std::vector<bd::Texture *> const &texs,
+                       bd::AtlasAllocator const &atlas)
+{
+  {
+    std::unique_lock<std::mutex> lock(m_atlasMutex);
+    m_atlasTexs = texs;
+    m_atlas = atlas;
+  }
+  m_maxGpuBlocks = atlas.capacity();
+  m_gpuAttached = true;
+
+  // Blocks read while there were no textures wait in main for a slot.
+  std::unique_lock<std::mutex> lock(m_loadQueueMutex);
+  size_t queued{ 0 };
+  for (bd::Block *b : m_main.values()) {
+    if (!b->empty() && b->texture()==nullptr && assignAtlasSlot(b)) {
+      pushGPUReadyQueue(b);
+      ++queued;
+    }
+  }
+  bd::Dbg() << "Gpu attached, " << queued << " blocks in main queued for upload.";
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+void
+BlockLoader::releaseHiddenBlocks()
+{
+  // The classifier holds the queue lock while it requeues. Rather than stall
+  // the frame, try again on the next one.
+  std::unique_lock<std::mutex> lock(m_loadQueueMutex, std::try_to_lock);
+  if (!lock.owns_lock() || m_pendingRelease.empty()) {
+    return;
+  }
+
+  std::unique_lock<std::mutex> lock_gpu(m_gpuMutex);
+  for (bd::Block *b : m_pendingRelease.values()) {
+    assert(b!=nullptr && "Block was null when iterating hidden blocks.");
+    if (!b->empty()) {
+      continue;
+    }
+    m_gpu.erase(b->index());
+    releaseAtlasSlot(b);
+    // without a slot it is no longer uploaded, its buffer can be taken.
+    if (m_main.contains(b->index())) {
+      m_evictable.insert(b->index(), b);
+    }
+  }
+  m_pendingRelease.clear();
+
+  // the load thread may be waiting for a buffer.
+  m_wait.notify_all();
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+bool
+BlockLoader::assignAtlasSlot(bd::Block *b)
+{
+  std::unique_lock<std::mutex> lock(m_atlasMutex);
+  uint32_t const slot{ m_atlas.acquire(b->index()) };
+  if (slot==bd::AtlasAllocator::NO_SLOT) {
+    return false;
+  }
+
+  b->texture(m_atlasTexs[m_atlas.atlasOf(slot)]);
+  b->textureSlot(m_atlas.voxelOffset(slot),
+                 m_atlas.texOffset(slot),
+                 m_atlas.texScale(slot, b->occupiedExtent()));
+  return true;
 }
 
 
 ///////////////////////////////////////////////////////////////////////////////
 void
-BlockLoader::removeEmptyBlocksFromGpu()
-{
-  for (auto it = m_gpu.begin(); it!=m_gpu.end();) {
-    bd::Block *b{ it->second };
-    assert(b!=nullptr && "Block was null when iterating gpu blocks.");
-    if (b->empty()) {
-      bd::Texture *e{ b->removeTexture() };
-      assert(e!=nullptr && "A block in the GPU list had a null texture.");
-      m_texs.push_back(e);
-      it = m_gpu.erase(it);
-    } else {
-      ++it;
+BlockLoader::releaseAtlasSlot(bd::Block *b)
+{
+  std::unique_lock<std::mutex> lock(m_atlasMutex);
+  b->removeTexture();
+  m_atlas.release(b->index());
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+size_t
+BlockLoader::atlasSlotsAvailable()
+{
+  std::unique_lock<std::mutex> lock(m_atlasMutex);
+  return m_atlas.available();
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+bool
+BlockLoader::readBlock(bd::Block *b, char *buf, LoadTicket &ticket)
+{
+  // only the occupied part of the block is read and kept.
+  glm::u64vec3 const &lo{ b->occupiedOffset() };
+  glm::u64vec3 const &ext{ b->occupiedExtent() };
+  uint64_t const subLo[3]{ lo.x, lo.y, lo.z };
+  uint64_t const subExt[3]{ ext.x, ext.y, ext.z };
+  size_t const n{ ext.x*ext.y*ext.z };
+
+  // The block's mask is dilated (see BlockCollection), so empty sub-bricks
+  // next to occupied ones are still read and interpolation near relevant
+  // voxels is unchanged.
+  bd::OccupancyMask const *skip{ m_skipEmptyBricks ? b->occupancy() : nullptr };
+
+  if (m_quantizer.mode()==bd::QuantizeMode::None) {
+    bool const done{ m_reader->fillBlockData(buf,
+                                             m_in,
+                                             b->fileBlock().data_offset,
+                                             b->fileBlock().voxel_dims,
+                                             b->fileBlock().ijk_index,
+                                             subLo,
+                                             subExt,
+                                             m_slabDims,
+                                             m_volMin,
+                                             m_volDiff,
+                                             &ticket,
+                                             skip,
+                                             m_emptyValue) };
+    if (!done) {
+      return false;
     }
+    b->quantization(bd::QuantizedBlockInfo{ });
+    m_rawBytes += n*sizeof(float);
+    m_storedBytes += n*sizeof(float);
+    return true;
+  }
+
+  // The cpu buffers are too small for the floats, so read into the staging
+  // buffer and quantize from there.
+  m_readBuffer.resize(n);
+  bool const done{ m_reader->fillBlockData(
+      reinterpret_cast<char *>(m_readBuffer.data()),
+      m_in,
+      b->fileBlock().data_offset,
+      b->fileBlock().voxel_dims,
+      b->fileBlock().ijk_index,
+      subLo,
+      subExt,
+      m_slabDims,
+      m_volMin,
+      m_volDiff,
+      &ticket,
+      skip,
+      m_emptyValue) };
+  if (!done || ticket.cancelled()) {
+    return false;
   }
+
+  bd::QuantizedBlockInfo const info{
+      m_quantizer.quantize(m_readBuffer.data(), n, buf) };
+  b->quantization(info);
+
+  m_rawBytes += n*sizeof(float);
+  m_storedBytes += info.bytes;
+  m_maxQuantError = std::max(m_maxQuantError, info.maxError);
+
+  bd::Dbg() << "Block " << b->index() << " stored as " << bd::to_string(info.mode)
+            << ", ratio: " << info.ratio(n)
+            << ", max error: " << info.maxError;
+  return true;
 }
 
 
@@ -5,9 +5,17 @@
 #ifndef bd_blockloader_h
 #define bd_blockloader_h
 
+#include "prefetchpredictor.h"
+
 #include <bd/volume/block.h>
 #include <bd/volume/volume.h>
 #include <bd/util/util.h>
+#include <bd/datastructure/residencytable.h>
+#include <bd/datastructure/atlasallocator.h>
+#include <bd/datastructure/bufferarena.h>
+#include <bd/datastructure/indexedheap.h>
+#include <bd/volume/quantizer.h>
+#include <bd/volume/occupancymask.h>
 
 #include <string>
 #include <atomic>
@@ -19,6 +27,8 @@
 #include <set>
 #include <fstream>
 #include <sstream>
+#include <cassert>
+#include <algorithm>
 
 namespace subvol
 {
@@ -28,25 +38,50 @@ struct BLThreadData
   BLThreadData()
       : maxGpuBlocks{ 0 }
       , maxCpuBlocks{ 0 }
+      , numBlocks{ 0 }
       , type{ bd::DataType::UnsignedCharacter }
       , slabDims{ 0, 0 }
       , filename{ }
+      , stream{ nullptr }
       , texs{ nullptr }
+      , atlas{ nullptr }
       , buffers{ nullptr }
+      , arena{ nullptr }
+      , quantizeMode{ bd::QuantizeMode::None }
+      , quantizeErrorBound{ 0.0 }
+      , hasEmptyValue{ false }
+      , emptyValue{ 0.0f }
   {
   }
 
 
   size_t maxGpuBlocks;
   size_t maxCpuBlocks;
+  // total blocks in the volume (block indexes are 0..numBlocks-1)
+  size_t numBlocks;
   // size of data elements on disk
   bd::DataType type;
   // x, y dims of volume slab
   size_t slabDims[2];
 
   std::string filename;
+  // if not null, the volume is read from it instead of from filename.
+  std::istream *stream;
+  // one atlas texture per atlas in the allocator.
   std::vector<bd::Texture *> *texs;
+  // gpu slots within the atlas textures.
+  bd::AtlasAllocator *atlas;
   std::vector<char *> *buffers;
+  // if not null, the buffers are in it and are committed as they are filled.
+  bd::BufferArena *arena;
+  // storage format of blocks in the cpu cache (buffers must be sized for it).
+  bd::QuantizeMode quantizeMode;
+  // largest error allowed per voxel for QuantizeMode::Auto.
+  double quantizeErrorBound;
+  // normalized value the transfer function makes transparent, if the index
+  // file has one. Empty sub-bricks are only skipped when it is known.
+  bool hasEmptyValue;
+  float emptyValue;
 
 };
 
@@ -122,6 +157,47 @@ struct BLThreadData
 //
 //};
 
+///////////////////////////////////////////////////////////////////////////////
+/// \brief One load of one block, tagged with the classification generation
+/// it was requested in.
+///
+/// A load is cancelled once the generation has moved on and the block is no
+/// longer visible. Prefetch loads are for blocks that are not visible yet, so
+/// they are never cancelled.
+///////////////////////////////////////////////////////////////////////////////
+struct LoadTicket
+{
+  LoadTicket(std::atomic<uint64_t> const *current,
+             bd::Block const *block,
+             bool prefetch)
+      : current{ current }
+      , generation{ current->load() }
+      , block{ block }
+      , prefetch{ prefetch }
+      , bytesRead{ 0 }
+  {
+  }
+
+
+  /// \brief True if the rest of this load should be skipped.
+  bool
+  cancelled() const
+  {
+    return !prefetch &&
+        current->load(std::memory_order_relaxed)!=generation &&
+        block->empty();
+  }
+
+
+  std::atomic<uint64_t> const *current;
+  uint64_t generation;
+  bd::Block const *block;
+  bool prefetch;
+  /// Bytes read from disk for this load so far.
+  uint64_t bytesRead;
+};
+
+
 class BlockReader
 {
 public:
@@ -141,18 +217,31 @@ public:
    * @param offset The byte offset into the file to start reading at
    * @param be The block extent in voxels
    * @param ijk The block index
+   * @param lo Min corner, in block voxels, of the part of the block to read
+   * @param ext Extent in voxels of the part of the block to read
    * @param ve The extent of a slab in the volume
    * @param vMin The min value in the volume
    * @param vDiff The difference of volume max and volume min.
+   * @param ticket If not null, checked between rows and bytes read are
+   *               added to it.
+   * @param mask If not null, voxels in its empty bricks are not read and
+   *             are set to \c emptyValue instead.
+   * @param emptyValue Normalized value for voxels that are not read.
+   * @return false if the ticket was cancelled before the block was done.
    */
-  virtual void
+  virtual bool
   fillBlockData(char *buffer,
                 std::istream *infile,
                 uint64_t offset,
                 uint64_t const be[3],
                 uint64_t const ijk[3],
+                uint64_t const lo[3],
+                uint64_t const ext[3],
                 uint64_t const ve[2],
-                double vMin, double vDiff) = 0;
+                double vMin, double vDiff,
+                LoadTicket *ticket = nullptr,
+                bd::OccupancyMask const *mask = nullptr,
+                float emptyValue = 0.0f) = 0;
 
 };
 
@@ -177,86 +266,70 @@ public:
   }
 
 
-  void
+  bool
   fillBlockData(char *b,                        // buffer to fill
                 std::istream *infile,           // the raw data stream
                 uint64_t offset,                // byte offset into infile of block
                 uint64_t const be[3],           // block dims (in voxels)
                 uint64_t const ijk[3],          // block ijk index
+                uint64_t const lo[3],           // min corner of the part to read
+                uint64_t const ext[3],          // dims of the part to read
                 uint64_t const ve[2],           // slab dims of the entire volume
-                double vMin, double vDiff) override
+                double vMin, double vDiff,
+                LoadTicket *ticket = nullptr,
+                bd::OccupancyMask const *mask = nullptr,
+                float emptyValue = 0.0f) override
   {
-    if (!disk_buf) {
-      // allocate temp space for the block (the entire block is brought into mem).
-      buf_elems = be[0]*be[1]*be[2];
+    if (buf_elems<ext[0]) {
+      // temp space for one row of the part to read. Kd blocks differ in
+      // size, so it grows to the longest row seen.
+      delete[] disk_buf;
+      buf_elems = ext[0];
       disk_buf = new VTy[buf_elems];
     }
 
     size_t const typeSize = sizeof(VTy);
-//    memset(disk_buf, 0, buf_elems*typeSize);
-
-    // Start and end voxel coordinates are used to compute the byte offset into 
-    // the file that we should start/stop reading at.
-    //
-    // start voxel coord = block index w/in volume * block size
-    // (this works because all blocks are the same size).
-    glm::u64vec3 const start{ ijk[0]*be[0],
-                              ijk[1]*be[1],
-                              ijk[2]*be[2] };
-
-    // block end voxel coord = block voxel start + block size
-    glm::u64vec3 const end{ start[0]+be[0],
-                            start[1]+be[1],
-                            start[2]+be[2] };
-
-    // the row length of each block is the extent in the X dimension
-    size_t const blockRowLength{ be[0] };
-    size_t const rowBytes{ blockRowLength*typeSize };
-
-    // Loop through rows and slabs of volume reading rows of voxels into memory.
-    char *temp = reinterpret_cast<char *>(disk_buf);
-    for (uint64_t slab = start.z; slab<end.z; ++slab) {
-      for (uint64_t row = start.y; row<end.y; ++row) {
-
-        // seek to start of row
-        infile->seekg(offset);
-
-        // read the bytes of current row
-        infile->read(temp, rowBytes);
-        temp += rowBytes;
-
-        // offset of next row in voxels
-        offset = bd::to1D(start.x, row+1, slab, ve[0], ve[1]);
-//        offset = bd::to1D(start.x, row, slab, ve[0], ve[1]);
-
-        // convert voxel offset to bytes
-        offset *= typeSize;
-      } // for row
-
-//      std::stringstream filename;
-//      filename << "C:\\Users\\jim\\Desktop\\slabs\\slab-" << ijk[0] << "_" << ijk[1] << "_" << ijk[2] << "-" << slab << ".pgm";
-//      std::ofstream of(filename.str());
-//      
-//      // header
-//      of << "P2\n"
-//        << be[0] << ' ' << be[1] << '\n'
-//        << *std::max_element(disk_buf, disk_buf + (be[0]*be[1])) << '\n';
-//
-//      for (int i = 0; i < be[0]*be[1]; ++i) {
-//        of << disk_buf[i] << ' ';
-//      }
-//
-//      of.flush();
-//      of.close();
 
+    // Loop through rows and slabs of the part to read. Each row is read in
+    // runs of occupied bricks (one run for the whole row without a mask)
+    // and normalized into the pixel buffer; the rest of the row gets the
+    // empty value. Row offsets are relative to the block's first voxel (at
+    // offset), in voxels of the whole volume.
+    float *pixelData = reinterpret_cast<float *>(b);
+    bd::OccupancyMask const noMask;
+    bd::OccupancyMask const &runs{ mask ? *mask : noMask };
+    for (uint64_t slab = lo[2]; slab<lo[2]+ext[2]; ++slab) {
+      for (uint64_t row = lo[1]; row<lo[1]+ext[1]; ++row) {
+
+        if (ticket && ticket->cancelled()) {
+          return false;
+        }
+
+        std::fill(pixelData, pixelData+ext[0], emptyValue);
+        runs.forEachOccupiedRun(row, slab, lo[0], lo[0]+ext[0],
+                                [&](uint64_t x0, uint64_t x1) {
+          assert(x1-x0<=buf_elems && "Run is longer than the row buffer.");
+          size_t const runBytes{ ( x1-x0 )*typeSize };
+
+          // seek to start of run and read it
+          infile->seekg(offset+typeSize*bd::to1D(x0, row, slab, ve[0], ve[1]));
+          infile->read(reinterpret_cast<char *>(disk_buf), runBytes);
+          if (ticket) {
+            ticket->bytesRead += runBytes;
+          }
+
+          //Normalize the data prior to generating the texture.
+          float *out{ pixelData+( x0-lo[0] ) };
+          for (size_t idx{ 0 }; idx<x1-x0; ++idx) {
+            out[idx] = static_cast<float>(( disk_buf[idx]-vMin )/vDiff );
+          }
+        });
+
+        pixelData += ext[0];
+      } // for row
     } // for slab
 
-    float *const pixelData = reinterpret_cast<float *>(b);
-    //Normalize the data prior to generating the texture.
-    for (size_t idx{ 0 }; idx<buf_elems; ++idx) {
-      pixelData[idx] = static_cast<float>(( disk_buf[idx]-vMin )/vDiff );
-    }
-
+    return !( ticket && ticket->cancelled() );
   }
 
 
@@ -313,13 +386,118 @@ public:
 
 
   /// \brief Enqueue the provided blocks for loading.
-  /// First the non-vis blocks are pushed, then the
-  /// vis blocks.
+  ///
+  /// Visible blocks not in main memory are queued (or have their priority
+  /// refreshed if already queued), and queued blocks that are no longer
+  /// visible are dropped. The queue is not rebuilt.
   void
   queueClassified(std::vector<bd::Block *> const &visible,
                   std::vector<bd::Block *> const &empty);
 
 
+  /// \brief Apply a small change of the visible set.
+  ///
+  /// \c added became visible and \c removed became hidden (their empty flags
+  /// already say so) since the last queueClassified() or queueDelta(). Only
+  /// these blocks are looked at, so the cost is O(added + removed) unless
+  /// the load queue outgrows the free atlas slots and has to be trimmed.
+  void
+  queueDelta(std::vector<bd::Block *> const &added,
+             std::vector<bd::Block *> const &removed);
+
+
+  /// \brief The classification changed (e.g. a slider moved), loads of
+  /// blocks that are no longer visible are abandoned.
+  void
+  classificationChanged();
+
+
+  /// \brief Bytes read from disk for loads that were then cancelled.
+  uint64_t
+  wastedBytes() const;
+
+
+  /// \brief True once block \c index has been read into main memory, until
+  /// it is evicted.
+  bool
+  isInMain(uint64_t index);
+
+
+  /// \brief The blocks of \c blocks that are in main memory, in order, for
+  /// readers of their pixel data on other threads (takes the lock once).
+  void
+  residentBlocks(std::vector<bd::Block *> const &blocks,
+                 std::vector<bd::Block *> &resident);
+
+
+  /// \brief Blocks waiting to be read.
+  size_t
+  loadQueueSize();
+
+
+  /// \brief True if block \c index is waiting to be read.
+  bool
+  isQueued(uint64_t index);
+
+
+  /// \brief True if block \c index is in main memory and may be evicted.
+  bool
+  isEvictable(uint64_t index);
+
+
+  /// \brief True if block \c index is hidden and gives its atlas slot back
+  /// on the next releaseHiddenBlocks().
+  bool
+  isReleasePending(uint64_t index);
+
+
+  /// \brief Cpu buffers not holding a block.
+  size_t
+  freeBuffers();
+
+
+  /// \brief Set the camera used to prioritize loads.
+  ///
+  /// Queued blocks are re-prioritized a batch at a time by the load thread,
+  /// so this returns immediately even with a large load queue.
+  ///
+  /// \param inView If not null, 1 for each block (by block index) in view,
+  ///               see BlockCollection::getInView(). Blocks out of view load
+  ///               last.
+  void
+  updateView(glm::vec3 const &eye, glm::vec3 const &lookAt,
+             std::shared_ptr<std::vector<uint8_t> const> inView = nullptr);
+
+
+  /// \brief Record the classification range while it is being dragged.
+  void
+  observeRange(double min, double max);
+
+
+  /// \brief Where the range is expected to be shortly.
+  /// \return false if the range is not moving (nothing worth prefetching).
+  bool
+  predictedRange(double &min, double &max);
+
+
+  /// \brief Replace the prefetch queue with \c blocks.
+  ///
+  /// Prefetched blocks are only read into main memory, and only while the
+  /// load queue is empty and some cpu buffers are kept back for demand loads.
+  void
+  queuePrefetch(std::vector<bd::Block *> const &blocks);
+
+
+  /// \brief Take hidden blocks off the gpu and give their atlas slots back.
+  ///
+  /// Render thread only: the renderers draw with the slots and
+  /// getNextGpuReadyBlock() hands out blocks to upload into them, so they
+  /// are not released under either. Does nothing if the classifier is
+  /// requeueing right now, the blocks are released on a later call.
+  void
+  releaseHiddenBlocks();
+
+
   /// \brief get the next block that is ready to load to gpu.
   /// \returns nullptr if no blocks in queue, or the next loadable block.
   bd::Block *
@@ -342,16 +520,100 @@ public:
   maxGpuBlocks();
 
 
+  /// \brief Hand the loader its atlas textures once there is a GL context.
+  ///
+  /// The loader can be made and started before the textures exist (\c atlas
+  /// of its BLThreadData null), it then reads blocks into main memory and
+  /// keeps as many queued as maxGpuBlocks says the gpu will hold. Visible
+  /// blocks already in main are given slots and queued for upload here.
+  void
+  attachGpu(std::vector<bd::Texture *> const &texs,
+            bd::AtlasAllocator const &atlas);
+
+
 private:
 
+  /// \brief Wait for a block to load and a free cpu buffer to load it into.
+  /// \param prefetch Set true if the block came from the prefetch queue.
+  /// \param buf Set to the buffer taken for the block, it goes back to
+  ///        m_buffs under m_loadQueueMutex if the load is cancelled.
   bd::Block *
-  waitPopLoadQueue();
+  waitPopLoadQueue(bool &prefetch, char *&buf);
+
+
+  /// \brief True if a prefetch may run now (the load queue is empty and
+  /// there are spare cpu buffers). Caller must hold m_loadQueueMutex.
+  bool
+  canPrefetch() const;
+
+
+  /// \brief Drop every prefetch queue entry.
+  /// Caller must hold m_loadQueueMutex.
+  void
+  clearPrefetchQueue();
+
+
+  /// \brief Load priority of \c b from its ROV and, once a view has been
+  /// set, its projected size and how close it is to the view direction.
+  /// Caller must hold m_loadQueueMutex.
+  double
+  loadPriority(bd::Block const *b) const;
+
+
+  /// \brief loadPriority() as if looking along \c viewDir.
+  double
+  loadPriority(bd::Block const *b, glm::vec3 const &viewDir) const;
+
+
+  /// \brief Queue visible \c b for loading, or for upload if it is already
+  /// in main. Caller must hold m_loadQueueMutex.
+  void
+  queueVisible(bd::Block *b);
+
+
+  /// \brief Evict up to \c n hidden blocks from main and take back their
+  /// buffers. Caller must hold m_loadQueueMutex.
+  /// \return The number of blocks evicted.
+  size_t
+  evictHidden(size_t n);
+
+
+  /// \brief If more blocks are queued than there are free atlas slots, evict
+  /// hidden blocks and then drop the lowest priority queued blocks.
+  /// Caller must hold m_loadQueueMutex.
+  void
+  fitLoadQueue();
+
+
+  /// \brief Re-prioritize up to \c n queued blocks for the current view.
+  /// Caller must hold m_loadQueueMutex.
+  void
+  rekeyLoadQueue(size_t n);
+
+
+  /// \brief Give \c b an atlas slot and its atlas texture.
+  /// \return false if no atlas slots are free.
+  bool
+  assignAtlasSlot(bd::Block *b);
 
 
-  /// \brief Loop through gpu blocks (m_gpu) and remove any that are empty.
-  /// Place textures back into m_texs array.
+  /// \brief Take \c b's texture and give its atlas slot back.
   void
-  removeEmptyBlocksFromGpu();
+  releaseAtlasSlot(bd::Block *b);
+
+
+  /// \brief Number of free atlas slots.
+  size_t
+  atlasSlotsAvailable();
+
+
+  /// \brief Read \c b's voxels into \c buf, quantizing them if a
+  /// quantization mode was requested, and set \c b's quantization.
+  /// The buffer is given to \c b only once the read is done, so a block
+  /// with pixel data never has a partly read one.
+  /// \return false if \c ticket was cancelled part way.
+  bool
+  readBlock(bd::Block *b, char *buf, LoadTicket &ticket);
 
 
   /// Push a block that is ready for loading to the GPU.
@@ -362,21 +624,73 @@ private:
 
   std::atomic_bool m_stopThread;
 
-  /// NE-resident on gpu.
+  /// NE-resident on gpu, indexed by block index.
   /// Also NE-resident on cpu.
-  std::unordered_map<uint64_t, bd::Block *> m_gpu;
+  bd::ResidencyTable<bd::Block *> m_gpu;
+
+  /// NE-resident on cpu, indexed by block index.
+  bd::ResidencyTable<bd::Block *> m_main;
+
+  /// The hidden blocks in m_main without an atlas slot, the candidates for
+  /// eviction. A block holding a slot may still be uploaded from its buffer.
+  bd::ResidencyTable<bd::Block *> m_evictable;
 
-  /// NE-resident on cpu.
-  std::unordered_map<uint64_t, bd::Block *> m_main;
+  /// Hidden blocks holding an atlas slot, for releaseHiddenBlocks().
+  /// Guarded by m_loadQueueMutex.
+  bd::ResidencyTable<bd::Block *> m_pendingRelease;
 
-  /// Buffer of reserve textures.
-  std::vector<bd::Texture *> m_texs;
+  /// The atlas textures, indexed by atlas.
+  std::vector<bd::Texture *> m_atlasTexs;
 
-  /// Buffer of reserve buffers.
+  /// Gpu slots within m_atlasTexs.
+  bd::AtlasAllocator m_atlas;
+
+  /// Buffer of reserve buffers. Guarded by m_loadQueueMutex.
   std::vector<char *> m_buffs;
 
-  /// Blocks that will be examined for loading.
-  std::vector<bd::Block *> m_loadQueue;
+  /// Where m_buffs live (or nullptr if they need no commit).
+  bd::BufferArena *m_arena;
+
+  /// Converts blocks to the cpu cache storage format.
+  bd::BlockQuantizer m_quantizer;
+
+  /// Float staging buffer for blocks that are quantized after reading.
+  std::vector<float> m_readBuffer;
+
+  /// Totals over all blocks read, for the cache stats.
+  uint64_t m_rawBytes;
+  uint64_t m_storedBytes;
+  double m_maxQuantError;
+
+  /// Ids of blocks waiting to be loaded, highest priority first.
+  bd::IndexedHeap<double> m_loadQueue;
+
+  /// Ids of non-visible blocks to read while the loader is idle.
+  bd::IndexedHeap<double> m_prefetchQueue;
+
+  /// Block for each id in m_loadQueue or m_prefetchQueue (a block is never
+  /// in both), indexed by block index.
+  std::vector<bd::Block *> m_queuedBlocks;
+
+  /// Predicts the range and view for prefetching, and tracks its hit rate.
+  PrefetchPredictor m_predictor;
+
+  /// Bumped whenever the classification changes, see LoadTicket.
+  std::atomic<uint64_t> m_generation;
+
+  /// Loads cancelled, and the bytes they had read.
+  std::atomic<uint64_t> m_cancelledLoads;
+  std::atomic<uint64_t> m_wastedBytes;
+
+  /// Camera position and view direction for loadPriority().
+  glm::vec3 m_eye;
+  glm::vec3 m_viewDir;
+  bool m_haveView;
+  std::shared_ptr<std::vector<uint8_t> const> m_inView;
+
+  /// Next heap position to re-prioritize, and how many remain.
+  size_t m_rekeyCursor;
+  size_t m_rekeyRemaining;
 
   ///< Blocks with GPU_WAIT status.
   std::queue<bd::Block *> m_gpuReadyQueue;
@@ -384,10 +698,12 @@ private:
   std::mutex m_gpuMutex;
   std::mutex m_gpuReadyMutex;
   std::mutex m_loadQueueMutex;
+  std::mutex m_atlasMutex;
 
   std::condition_variable_any m_wait;
 
-  size_t const m_maxGpuBlocks;
+  std::atomic<size_t> m_maxGpuBlocks;
+  std::atomic_bool m_gpuAttached;          ///< attachGpu() has been called.
   size_t const m_maxMainBlocks;
   size_t const m_sizeType;
 
@@ -396,10 +712,15 @@ private:
 
   double const m_volMin;
   double const m_volDiff;                  ///< diff = volMax - volMin
+  bool const m_skipEmptyBricks;            ///< Don't read empty sub-bricks.
+  float const m_emptyValue;                ///< Value of voxels not read.
 
   std::string m_fileName;
   std::ifstream raw;
 
+  /// The volume data, raw or BLThreadData::stream.
+  std::istream *m_in;
+
   BlockReader *m_reader;
 
 }; // class BlockLoader
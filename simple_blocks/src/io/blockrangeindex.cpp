@@ -0,0 +1,170 @@
+#include "blockrangeindex.h"
+
+#include <cassert>
+#include <limits>
+#include <numeric>
+
+namespace subvol
+{
+
+///////////////////////////////////////////////////////////////////////////////
+BlockRangeIndex::BlockRangeIndex()
+    : m_keys{ }
+    , m_blocks{ }
+{
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+void
+BlockRangeIndex::build(std::vector<bd::Block *> const &blocks,
+                       std::function<double(bd::Block const &)> const &key)
+{
+  size_t const n{ blocks.size() };
+
+  std::vector<double> keys(n);
+  for (size_t i{ 0 }; i<n; ++i) {
+    keys[i] = key(*blocks[i]);
+  }
+
+  std::vector<size_t> order(n);
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(order.begin(), order.end(),
+            [&keys](size_t a, size_t b) { return keys[a]<keys[b]; });
+
+  m_keys.resize(n);
+  m_blocks.resize(n);
+  for (size_t i{ 0 }; i<n; ++i) {
+    m_keys[i] = keys[order[i]];
+    m_blocks[i] = blocks[order[i]];
+  }
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+BlockRangeIndex::Span
+BlockRangeIndex::find(double low, double high) const
+{
+  size_t const first{ static_cast<size_t>(
+      std::lower_bound(m_keys.begin(), m_keys.end(), low)-m_keys.begin()) };
+  if (high<low) {
+    return { first, first };
+  }
+
+  size_t const last{ static_cast<size_t>(
+      std::upper_bound(m_keys.begin()+first, m_keys.end(), high)-m_keys.begin()) };
+  return { first, last };
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+double
+BlockRangeIndex::lowForCount(double high, size_t count) const
+{
+  // the blocks up to high are [0, end), a low threshold at position p keeps
+  // [p, end).
+  size_t const end{ static_cast<size_t>(
+      std::upper_bound(m_keys.begin(), m_keys.end(), high)-m_keys.begin()) };
+  if (end<=count) {
+    return -std::numeric_limits<double>::infinity();
+  }
+
+  size_t const p{ end-count };
+  double const key{ m_keys[p] };
+  if (p==0 || m_keys[p-1]<key) {
+    return key;
+  }
+
+  // blocks below p share the key at p, skip past all of them.
+  size_t const next{ static_cast<size_t>(
+      std::upper_bound(m_keys.begin()+p, m_keys.end(), key)-m_keys.begin()) };
+  if (next>=end) {
+    return std::numeric_limits<double>::infinity();
+  }
+  return m_keys[next];
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+ShownBlocks::ShownBlocks()
+    : m_blocks{ }
+    , m_pos{ }
+    , m_index{ nullptr }
+    , m_span{ 0, 0 }
+{
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+void
+ShownBlocks::reset(size_t numBlocks)
+{
+  m_blocks.clear();
+  m_blocks.reserve(numBlocks);
+  m_pos.assign(numBlocks, 0);
+  m_index = nullptr;
+  m_span = { 0, 0 };
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+void
+ShownBlocks::filter(BlockRangeIndex const &index, double low, double high)
+{
+  BlockRangeIndex::Span const next{ index.find(low, high) };
+
+  if (m_index!=&index) {
+    // the span says nothing about this index, start over.
+    hideAll();
+    index.forEach(next, [this](bd::Block *b) { show(b); });
+  } else {
+    index.forEachDifference(m_span, next, [this](bd::Block *b) { hide(b); });
+    index.forEachDifference(next, m_span, [this](bd::Block *b) { show(b); });
+  }
+
+  m_index = &index;
+  m_span = next;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+void
+ShownBlocks::show(bd::Block *b)
+{
+  assert(b->index()<m_pos.size() && "Block index past reset() size.");
+  b->empty(false);
+  m_pos[b->index()] = m_blocks.size();
+  m_blocks.push_back(b);
+  m_index = nullptr;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+void
+ShownBlocks::hide(bd::Block *b)
+{
+  size_t const pos{ m_pos[b->index()] };
+  assert(pos<m_blocks.size() && m_blocks[pos]==b && "Block is not shown.");
+  b->empty(true);
+
+  bd::Block *last{ m_blocks.back() };
+  m_blocks[pos] = last;
+  m_pos[last->index()] = pos;
+  m_blocks.pop_back();
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+void
+ShownBlocks::hideAll()
+{
+  for (bd::Block *b : m_blocks) {
+    b->empty(true);
+  }
+  m_blocks.clear();
+  m_index = nullptr;
+  m_span = { 0, 0 };
+}
+
+} // namespace subvol
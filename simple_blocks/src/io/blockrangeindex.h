@@ -0,0 +1,207 @@
+#ifndef subvol_blockrangeindex_h
+#define subvol_blockrangeindex_h
+
+#include <bd/volume/block.h>
+
+#include <algorithm>
+#include <functional>
+#include <vector>
+#include <cstddef>
+
+namespace subvol
+{
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief Blocks sorted by a classification value (rov, avg, ...) so the
+/// blocks inside a [low, high] range can be found with two binary searches.
+///
+/// Because the index is sorted, the blocks in any range are a contiguous run
+/// of positions (a Span). Moving the range endpoints changes the run only at
+/// its ends, so the blocks entering and leaving the range are found without
+/// looking at the blocks that stayed.
+///////////////////////////////////////////////////////////////////////////////
+class BlockRangeIndex
+{
+public:
+  /// \brief Positions [first, last) in the sorted order.
+  struct Span
+  {
+    size_t first;
+    size_t last;
+
+    size_t
+    size() const
+    {
+      return last>first ? last-first : 0;
+    }
+  };
+
+
+  BlockRangeIndex();
+
+
+  /// \brief Sort \c blocks by \c key.
+  void
+  build(std::vector<bd::Block *> const &blocks,
+        std::function<double(bd::Block const &)> const &key);
+
+
+  /// \brief The blocks with key in [low, high] (empty if low > high).
+  Span
+  find(double low, double high) const;
+
+
+  /// \brief The smallest low threshold that leaves at most \c count blocks
+  /// in [low, high].
+  ///
+  /// Blocks with equal keys are all in or all out, so fewer than \c count
+  /// blocks may fit. Returns -infinity if every block up to \c high fits and
+  /// +infinity if none can.
+  double
+  lowForCount(double high, size_t count) const;
+
+
+  /// \brief Call \c f for each block in \c in that is not in \c notIn.
+  template<class F>
+  void
+  forEachDifference(Span const &in, Span const &notIn, F f) const;
+
+
+  /// \brief Call \c f for each block in \c s.
+  template<class F>
+  void
+  forEach(Span const &s, F f) const;
+
+
+  bd::Block *
+  at(size_t pos) const
+  {
+    return m_blocks[pos];
+  }
+
+
+  size_t
+  size() const
+  {
+    return m_blocks.size();
+  }
+
+
+private:
+  std::vector<double> m_keys;         ///< Sorted keys.
+  std::vector<bd::Block *> m_blocks;  ///< m_blocks[i] has key m_keys[i].
+
+}; // class BlockRangeIndex
+
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief The shown blocks, kept as a list as the range moves along a
+/// BlockRangeIndex.
+///
+/// The position of each shown block in the list is kept by block index, so
+/// hiding a block swaps the last block into its place. A filter step costs
+/// only the blocks that entered or left the range, the list is in no
+/// particular order.
+///////////////////////////////////////////////////////////////////////////////
+class ShownBlocks
+{
+public:
+  ShownBlocks();
+
+
+  /// \brief Forget the shown blocks, \c numBlocks is one past the largest
+  /// block index.
+  void
+  reset(size_t numBlocks);
+
+
+  /// \brief Show the blocks of \c index in [low, high] and hide the rest.
+  ///
+  /// Only the blocks between the old and new endpoints change, unless the
+  /// blocks were last shown through another index (or show()).
+  void
+  filter(BlockRangeIndex const &index, double low, double high);
+
+
+  /// \brief Show \c b, which must be hidden.
+  void
+  show(bd::Block *b);
+
+
+  /// \brief Hide \c b, which must be shown.
+  void
+  hide(bd::Block *b);
+
+
+  /// \brief Hide every shown block.
+  void
+  hideAll();
+
+
+  std::vector<bd::Block *> const &
+  blocks() const
+  {
+    return m_blocks;
+  }
+
+
+  /// \brief The index the blocks were last filtered through, nullptr if
+  /// none or blocks were shown since.
+  BlockRangeIndex const *
+  index() const
+  {
+    return m_index;
+  }
+
+
+  /// \brief The shown blocks' positions in *index().
+  BlockRangeIndex::Span const &
+  span() const
+  {
+    return m_span;
+  }
+
+
+private:
+  std::vector<bd::Block *> m_blocks;  ///< The shown blocks.
+  std::vector<size_t> m_pos;          ///< m_blocks position by block index.
+  BlockRangeIndex const *m_index;
+  BlockRangeIndex::Span m_span;
+
+}; // class ShownBlocks
+
+
+///////////////////////////////////////////////////////////////////////////////
+template<class F>
+void
+BlockRangeIndex::forEachDifference(Span const &in, Span const &notIn, F f) const
+{
+  if (notIn.size()==0) {
+    forEach(in, f);
+    return;
+  }
+
+  // the part of \c in below notIn and the part above it.
+  size_t const belowEnd{ std::min(in.last, notIn.first) };
+  for (size_t i{ in.first }; i<belowEnd; ++i) {
+    f(m_blocks[i]);
+  }
+  for (size_t i{ std::max(in.first, notIn.last) }; i<in.last; ++i) {
+    f(m_blocks[i]);
+  }
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+template<class F>
+void
+BlockRangeIndex::forEach(Span const &s, F f) const
+{
+  for (size_t i{ s.first }; i<s.last; ++i) {
+    f(m_blocks[i]);
+  }
+}
+
+} // namespace subvol
+
+#endif // ! subvol_blockrangeindex_h
@@ -0,0 +1,221 @@
+#include "prefetchpredictor.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+namespace subvol
+{
+
+namespace
+{
+
+/// Weight of the newest sample in the velocity averages.
+double const SMOOTHING{ 0.5 };
+
+/// Observations further apart than this (seconds) restart the velocity.
+double const MAX_GAP{ 1.0 };
+
+/// Slower than this (range units per second) counts as not moving.
+double const MIN_RANGE_SPEED{ 1.0e-6 };
+
+
+double
+smooth(double avg, double sample)
+{
+  return SMOOTHING*sample+( 1.0-SMOOTHING )*avg;
+}
+
+} // namespace
+
+
+///////////////////////////////////////////////////////////////////////////////
+PrefetchPredictor::PrefetchPredictor(size_t numBlocks, double horizon)
+    : m_horizon{ horizon }
+    , m_min{ 0 }
+    , m_max{ 0 }
+    , m_rangeTime{ 0 }
+    , m_minVel{ 0 }
+    , m_maxVel{ 0 }
+    , m_haveRange{ false }
+    , m_viewDir{ 0, 0, -1 }
+    , m_rotAxis{ 0, 1, 0 }
+    , m_viewTime{ 0 }
+    , m_angVel{ 0 }
+    , m_haveView{ false }
+    , m_isPrefetched(numBlocks, false)
+    , m_prefetchCount{ 0 }
+    , m_hitCount{ 0 }
+{
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+void
+PrefetchPredictor::observeRange(double min, double max, double seconds)
+{
+  double const dt{ seconds-m_rangeTime };
+  if (!m_haveRange || dt>MAX_GAP) {
+    m_minVel = 0;
+    m_maxVel = 0;
+  } else if (dt>0) {
+    m_minVel = smooth(m_minVel, ( min-m_min )/dt);
+    m_maxVel = smooth(m_maxVel, ( max-m_max )/dt);
+  }
+
+  m_min = min;
+  m_max = max;
+  m_rangeTime = seconds;
+  m_haveRange = true;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+void
+PrefetchPredictor::observeView(glm::vec3 const &viewDir, double seconds)
+{
+  double const dt{ seconds-m_viewTime };
+  if (!m_haveView || dt>MAX_GAP) {
+    m_angVel = 0;
+  } else if (dt>0) {
+    float const cosAngle{ glm::clamp(glm::dot(m_viewDir, viewDir), -1.0f, 1.0f) };
+    double const angle{ std::acos(cosAngle) };
+    glm::vec3 const axis{ glm::cross(m_viewDir, viewDir) };
+    float const len{ glm::length(axis) };
+    if (len>1.0e-6f) {
+      m_rotAxis = axis/len;
+    }
+    m_angVel = smooth(m_angVel, angle/dt);
+  }
+
+  m_viewDir = viewDir;
+  m_viewTime = seconds;
+  m_haveView = true;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+void
+PrefetchPredictor::stopRange()
+{
+  m_minVel = 0;
+  m_maxVel = 0;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+void
+PrefetchPredictor::predictedRange(double &min, double &max) const
+{
+  min = std::min(m_min, m_min+m_minVel*m_horizon);
+  max = std::max(m_max, m_max+m_maxVel*m_horizon);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+bool
+PrefetchPredictor::rangeMoving() const
+{
+  return std::abs(m_minVel)>MIN_RANGE_SPEED || std::abs(m_maxVel)>MIN_RANGE_SPEED;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+glm::vec3
+PrefetchPredictor::predictedViewDir() const
+{
+  // Rodrigues' rotation of m_viewDir about m_rotAxis.
+  float const theta{ static_cast<float>(m_angVel*m_horizon) };
+  float const c{ std::cos(theta) };
+  float const s{ std::sin(theta) };
+  glm::vec3 const &v{ m_viewDir };
+  glm::vec3 const &k{ m_rotAxis };
+  return v*c+glm::cross(k, v)*s+k*glm::dot(k, v)*( 1.0f-c );
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+double
+PrefetchPredictor::minVelocity() const
+{
+  return m_minVel;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+double
+PrefetchPredictor::maxVelocity() const
+{
+  return m_maxVel;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+double
+PrefetchPredictor::angularVelocity() const
+{
+  return m_angVel;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+void
+PrefetchPredictor::prefetched(uint64_t idx)
+{
+  assert(idx<m_isPrefetched.size() && "Block index out of range.");
+  if (!m_isPrefetched[idx]) {
+    m_isPrefetched[idx] = true;
+    ++m_prefetchCount;
+  }
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+bool
+PrefetchPredictor::demanded(uint64_t idx)
+{
+  assert(idx<m_isPrefetched.size() && "Block index out of range.");
+  if (m_isPrefetched[idx]) {
+    m_isPrefetched[idx] = false;
+    ++m_hitCount;
+    return true;
+  }
+  return false;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+void
+PrefetchPredictor::evicted(uint64_t idx)
+{
+  assert(idx<m_isPrefetched.size() && "Block index out of range.");
+  m_isPrefetched[idx] = false;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+size_t
+PrefetchPredictor::prefetchCount() const
+{
+  return m_prefetchCount;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+size_t
+PrefetchPredictor::hitCount() const
+{
+  return m_hitCount;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+double
+PrefetchPredictor::hitRate() const
+{
+  return m_prefetchCount==0
+         ? 0.0
+         : static_cast<double>(m_hitCount)/m_prefetchCount;
+}
+
+} // namespace subvol
@@ -0,0 +1,132 @@
+#ifndef subvol_prefetchpredictor_h
+#define subvol_prefetchpredictor_h
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+namespace subvol
+{
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief Guesses where the classification range and the camera are heading
+/// so the loader can prefetch blocks before they are asked for.
+///
+/// Slider and camera velocities are smoothed with an exponential moving
+/// average of the changes reported to observeRange() and observeView(), and
+/// predictions extrapolate them \c horizon seconds ahead.
+///
+/// Prefetched blocks are tracked by index so the hit rate (prefetched blocks
+/// that were later asked for) can be reported.
+///////////////////////////////////////////////////////////////////////////////
+class PrefetchPredictor
+{
+public:
+  /// \param numBlocks Block indexes are in [0, numBlocks).
+  /// \param horizon Seconds ahead to predict.
+  PrefetchPredictor(size_t numBlocks, double horizon);
+
+
+  /// \brief Record the classification range at time \c seconds.
+  void
+  observeRange(double min, double max, double seconds);
+
+
+  /// \brief Record the (normalized) view direction at time \c seconds.
+  void
+  observeView(glm::vec3 const &viewDir, double seconds);
+
+
+  /// \brief Forget the slider velocity (the drag ended).
+  void
+  stopRange();
+
+
+  /// \brief The range expected \c horizon seconds from the last observation.
+  /// Each end only ever grows the current range: [min, max] is contained in
+  /// the prediction.
+  void
+  predictedRange(double &min, double &max) const;
+
+
+  /// \brief True if the slider is moving fast enough to predict from.
+  bool
+  rangeMoving() const;
+
+
+  /// \brief The view direction expected \c horizon seconds from the last
+  /// observation (the last direction rotated by the angular velocity).
+  glm::vec3
+  predictedViewDir() const;
+
+
+  /// \brief Smoothed speed of the min/max ends, in range units per second.
+  double
+  minVelocity() const;
+
+
+  double
+  maxVelocity() const;
+
+
+  /// \brief Smoothed camera angular speed in radians per second.
+  double
+  angularVelocity() const;
+
+
+  /// \brief Remember that block \c idx was prefetched.
+  void
+  prefetched(uint64_t idx);
+
+
+  /// \brief Block \c idx was asked for by a demand load.
+  /// \return true if it had been prefetched (a hit).
+  bool
+  demanded(uint64_t idx);
+
+
+  /// \brief Block \c idx left the cache, a prefetch of it can no longer hit.
+  void
+  evicted(uint64_t idx);
+
+
+  size_t
+  prefetchCount() const;
+
+
+  size_t
+  hitCount() const;
+
+
+  /// \brief hitCount() / prefetchCount(), or 0 if nothing was prefetched.
+  double
+  hitRate() const;
+
+
+private:
+  double m_horizon;
+
+  double m_min;
+  double m_max;
+  double m_rangeTime;
+  double m_minVel;
+  double m_maxVel;
+  bool m_haveRange;
+
+  glm::vec3 m_viewDir;
+  glm::vec3 m_rotAxis;       ///< Axis the view direction is turning about.
+  double m_viewTime;
+  double m_angVel;
+  bool m_haveView;
+
+  std::vector<bool> m_isPrefetched;
+  size_t m_prefetchCount;
+  size_t m_hitCount;
+
+}; // class PrefetchPredictor
+
+} // namespace subvol
+
+#endif // ! subvol_prefetchpredictor_h
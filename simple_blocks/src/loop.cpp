@@ -4,6 +4,7 @@
 
 #include "loop.h"
 #include "renderhelp.h"
+#include "colormap.h"
 
 #include <bd/log/gl_log.h>
 
@@ -15,13 +16,19 @@ namespace renderhelp
 {
 
 ///////////////////////////////////////////////////////////////////////////////
-Loop::Loop(GLFWwindow *window, std::shared_ptr<bd::Renderer> r,
+Loop::Loop(GLFWwindow *window, std::shared_ptr<renderer::BlockRenderer> r,
            std::shared_ptr<subvol::BlockCollection> c)
     : _window{ window }
     , _renderer{ std::move(r) }
     , _collection{ std::move(c) }
     , m_timeOfLastJob{ 0 }
     , m_tf{ 1.0/glfwGetTimerFrequency() }
+    , m_numFrames{ 0 }
+    , m_lastEye{ 0, 0, 0 }
+    , m_lastLookAt{ 0, 0, 0 }
+    , m_lastViewProj{ 1.0f }
+    , m_lastTfName{ }
+    , m_lastTfScale{ 0.0f }
 {
 }
 
@@ -63,8 +70,33 @@ Loop::tick(float now)
     m_timeOfLastJob = timeNow();
   }
 
-  if (_collection->getRangeChanged()) {
-    _collection->filterBlocks();
+  // re-estimate how opaque the blocks are when the transfer function
+  // changes.
+  bool viewChanged{ false };
+  std::string const &tfName{ ColorMapManager::getCurrentMapName() };
+  float const tfScale{ _renderer->getColorMapScaleValue() };
+  if (tfName!=m_lastTfName || tfScale!=m_lastTfScale) {
+    m_lastTfName = tfName;
+    m_lastTfScale = tfScale;
+    std::vector<float> alpha;
+    for (glm::vec4 const &k : ColorMapManager::getMapByName(tfName).getKnots()) {
+      alpha.push_back(k.a);
+    }
+    _collection->updateOpacity(alpha, tfScale);
+    viewChanged = true;
+  }
+
+  // cull the blocks and re-prioritize the load queue when the camera moves
+  // (or the projection changes). The culling runs on the classification
+  // thread, which also culls again when the shown blocks change.
+  bd::Camera const &cam{ _renderer->getCamera() };
+  glm::mat4 const viewProj{ _renderer->getProjectionMatrix()*cam.createViewMatrix() };
+  if (viewChanged || cam.getEye()!=m_lastEye ||
+      cam.getLookAt()!=m_lastLookAt || viewProj!=m_lastViewProj) {
+    m_lastEye = cam.getEye();
+    m_lastLookAt = cam.getLookAt();
+    m_lastViewProj = viewProj;
+    _collection->updateView(m_lastEye, m_lastLookAt, viewProj);
   }
 
   _renderer->draw();
@@ -13,6 +13,7 @@
 
 #include <bd/graphics/renderer.h>
 #include <memory>
+#include <string>
 namespace subvol
 {
 namespace renderhelp
@@ -21,7 +22,7 @@ namespace renderhelp
 class Loop
 {
 public:
-  Loop(GLFWwindow *, std::shared_ptr<bd::Renderer> r,
+  Loop(GLFWwindow *, std::shared_ptr<renderer::BlockRenderer> r,
        std::shared_ptr<subvol::BlockCollection> c);
 
 
@@ -44,7 +45,7 @@ protected:
 
 protected:
   GLFWwindow *_window;
-  std::shared_ptr<bd::Renderer> _renderer;
+  std::shared_ptr<renderer::BlockRenderer> _renderer;
   std::shared_ptr<BlockCollection> _collection;
   uint64_t _frameCount;
 
@@ -52,6 +53,13 @@ private:
   float m_timeOfLastJob;
   double const m_tf;
   uint32_t m_numFrames;
+  // camera last given to the block loader.
+  glm::vec3 m_lastEye;
+  glm::vec3 m_lastLookAt;
+  glm::mat4 m_lastViewProj;
+  // transfer function the view was last culled with.
+  std::string m_lastTfName;
+  float m_lastTfScale;
 
 };
 
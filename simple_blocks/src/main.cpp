@@ -6,6 +6,8 @@
 #include "constants.h"
 #include "colormap.h"
 #include "renderhelp.h"
+#include "startup.h"
+#include "batch.h"
 #include "controlpanel.h"
 #include "io/blockcollection.h"
 #include "semathing.h"
@@ -72,82 +74,6 @@ printBlocks(subvol::BlockCollection *bcol)
 }
 
 
-/////////////////////////////////////////////////////////////////////////////////
-//std::shared_ptr<bd::IndexFile>
-//openIndexFile(subvol::CommandLineOptions const &clo)
-//{
-//  // Read the index file to get values from it that we need to populate
-//  // the CommandLineOptions struct.
-//  std::shared_ptr<bd::IndexFile> indexFile{
-//      bd::IndexFile::fromBinaryIndexFile(clo.indexFilePath) };
-//  if (indexFile == nullptr) {
-//    bd::Err() << "Could open the index file.";
-//  }
-//
-//  return indexFile;
-//}
-
-
-/////////////////////////////////////////////////////////////////////////////////
-// Since the IndexFileHeader contains most of the options needed to
-// render the volume, we copy those over into the CommandLineOptions struct.
-// Without an index file these options are provided via argv anyway.
-void
-updateCommandLineOptionsFromIndexFile(subvol::CommandLineOptions &clo,
-                                      bd::indexfile::v2::JsonIndexFile const &indexFile)
-{
-  bd::Dbg() << "Updating command line options from index file.";
-  auto minmaxE =
-      std::minmax_element(indexFile.getFileBlocks().begin(),
-                          indexFile.getFileBlocks().end(),
-                          [](bd::FileBlock const &lhs, bd::FileBlock const &rhs)
-                              -> bool {
-                            return lhs.rov<rhs.rov;
-                          });
-
-  renderhelp::g_rovMin = ( *minmaxE.first ).rov;
-  renderhelp::g_rovMax = ( *minmaxE.second ).rov;
-
-  clo.vol_w = indexFile.getVolume().voxelDims().x;
-  clo.vol_h = indexFile.getVolume().voxelDims().y;
-  clo.vol_d = indexFile.getVolume().voxelDims().z;
-  clo.numblk_x = indexFile.getVolume().block_count().x;
-  clo.numblk_y = indexFile.getVolume().block_count().y;
-  clo.numblk_z = indexFile.getVolume().block_count().z;
-  clo.dataType = bd::to_string(indexFile.getDatType());
-}
-
-
-/////////////////////////////////////////////////////////////////////////////////
-GLFWwindow *
-init_gl(subvol::CommandLineOptions &clo)
-{
-
-  subvol::printThem(clo);
-
-  // Initialize OpenGL and GLFW and generate our transfer function textures.
-  GLFWwindow *window{ nullptr };
-  window = subvol::renderhelp::initGLContext(clo.windowWidth, clo.windowHeight);
-  if (window==nullptr) {
-    bd::Err() << "Could not initialize GLFW, exiting.";
-    return nullptr;
-  }
-  bd::Info() << "Open GL initialized.";
-
-  int64_t totalMemory{ 0 };
-  subvol::renderhelp::queryGPUMemory(&totalMemory);
-  bd::Info() << "GPU memory: " << ( totalMemory*1e-6 ) << "MB";
-
-  if (clo.gpuMemoryBytes>totalMemory) {
-    bd::Warn() << "Requested m_gpu memory, " << clo.gpuMemoryBytes
-               << " greater than actual GPU memory, using " << totalMemory << " bytes.";
-    clo.gpuMemoryBytes = static_cast<size_t>(totalMemory);
-  }
-
-  return window;
-
-} // init_gl
-
 } // namespace subvol
 
 
@@ -166,36 +92,30 @@ try
     //    return 1;
   }
 
-  // Open the index file if possible, then setup the BlockCollection
-  // and give away ownership of the index file to the BlockCollection.
-  //std::shared_ptr<bd::IndexFile> indexFile{ std::make_shared<bd::IndexFile>() };
-  bd::indexfile::v2::JsonIndexFile indexFile;
-  if (!clo.indexFilePath.empty()) {
-    if (!indexFile.open(clo.indexFilePath)) {
-      bd::Err() << "Could not read index file " << clo.indexFilePath;
-      return 1;
-    }
-    // there are some CL opts that can be specified in the index file, so we 
-    // read those into our CommandLineOptions struct.
-    updateCommandLineOptionsFromIndexFile(clo, indexFile);
-  }
-
+  // Parse the index file, make the loader and blocks and start loading them
+  // while the GL context is made.
   bd::Info() << "Initializing subvol...";
-  GLFWwindow *window{ subvol::init_gl(clo) };
-  if (window==nullptr) {
+  subvol::StartupOrchestrator startup(clo);
+  bool const started{ startup.run() };
+  if (clo.startupReport) {
+    startup.printReport(std::cout);
+  }
+  if (!started) {
     bd::Err() << "Could not initialize subvol. Exiting...";
     return 1;
   }
 
-  subvol::BlockLoader *loader{
-      subvol::renderhelp::initializeBlockLoader(indexFile, clo) };
-
-  std::shared_ptr<subvol::BlockCollection> bc{
-      subvol::renderhelp::initializeBlockCollection(loader, indexFile, clo) };
-
+  if (!clo.batchScriptPath.empty()) {
+    // No window or control panel, render the script's views and exit.
+    return subvol::runBatch(startup.collection(), startup.loader(),
+                            startup.renderer(), clo);
+  }
 
-  std::shared_ptr<subvol::renderer::BlockRenderer> br{
-      subvol::renderhelp::initializeRenderer(bc, indexFile.getVolume(), clo) };
+  GLFWwindow *window{ startup.window() };
+  bd::indexfile::v2::JsonIndexFile const &indexFile{ startup.indexFile() };
+  subvol::BlockLoader *loader{ startup.loader() };
+  std::shared_ptr<subvol::BlockCollection> bc{ startup.collection() };
+  std::shared_ptr<subvol::renderer::BlockRenderer> br{ startup.renderer() };
 
   subvol::renderhelp::initializeControls(window, br);
 //  subvol::renderhelp::BenchmarkLoop loop(window, br, bc, glm::vec3{ 1,0,0 });
@@ -17,6 +17,8 @@ enum class MessageType
   RENDER_STATS_MESSAGE,
   SLICESET_CHANGED_MESSAGE,
   BLOCK_LOADED_MESSAGE,
+  BUDGET_CHANGED_MESSAGE,
+  CLASSIFICATION_TYPE_CHANGED_MESSAGE,
 };
 
 class Recipient;
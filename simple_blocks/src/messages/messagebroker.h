@@ -84,9 +84,10 @@ private:
       }
       m_recipientsMutex.unlock();
 
+      bool const last{ m->type==MessageType::EMPTY_MESSAGE };
       delete m;
 
-      if (m->type==MessageType::EMPTY_MESSAGE) {
+      if (last) {
         break;
       }
 
@@ -3,6 +3,7 @@
 
 #include "message.h"
 #include "sliceset.h"
+#include "classificationtype.h"
 
 #include <iostream>
 
@@ -24,6 +25,10 @@ class SliceSetChangedMessage;
 
 class BlockLoadedMessage;
 
+class BudgetChangedMessage;
+
+class ClassificationTypeChangedMessage;
+
 class Recipient
 {
 public:
@@ -87,6 +92,18 @@ public:
   }
 
 
+  virtual void
+  handle_BudgetChangedMessage(BudgetChangedMessage &)
+  {
+  }
+
+
+  virtual void
+  handle_ClassificationTypeChangedMessage(ClassificationTypeChangedMessage &)
+  {
+  }
+
+
   std::string const &
   name() const
   {
@@ -134,6 +151,9 @@ public:
   ShownBlocksMessage()
       : Message(MessageType::SHOWN_BLOCKS_MESSAGE)
       , ShownBlocks{ 0 }
+      , ResidentFraction{ 1.0 }
+      , AutoRange{ false }
+      , RangeMin{ 0 }
   {
   }
 
@@ -151,6 +171,11 @@ public:
 
 
   int ShownBlocks;
+  // fraction of the shown blocks that fit in the cpu/gpu caches.
+  double ResidentFraction;
+  // true if the range min was raised to fit the budget, to RangeMin.
+  bool AutoRange;
+  double RangeMin;
 };
 
 /////////////////////////////////////////////////////////////////////////////// 
@@ -235,7 +260,23 @@ public:
   size_t CpuLoadQueueSize;
   size_t GpuLoadQueueSize;
   size_t CpuBuffersAvailable;
+  // bytes of the cpu buffer arena committed so far.
+  uint64_t CpuCommittedBytes;
   size_t GpuTexturesAvailable;
+  // uncompressed / stored bytes of all blocks read so far.
+  double CompressionRatio;
+  // largest quantization error of any block read so far.
+  double MaxQuantizationError;
+  // blocks waiting to be prefetched.
+  size_t PrefetchQueueSize;
+  // blocks prefetched so far.
+  size_t PrefetchCount;
+  // fraction of prefetched blocks that were later asked for.
+  double PrefetchHitRate;
+  // loads abandoned because their block was hidden while being read.
+  uint64_t CancelledLoads;
+  // bytes read by the abandoned loads.
+  uint64_t WastedBytes;
 };
 
 class SliceSetChangedMessage
@@ -291,5 +332,62 @@ public:
   size_t GpuLoadQueueSize;
 };
 
+///////////////////////////////////////////////////////////////////////////////
+class BudgetChangedMessage
+    : public Message
+{
+public:
+
+  BudgetChangedMessage()
+      : Message{ MessageType::BUDGET_CHANGED_MESSAGE }
+      , Fraction{ 0 }
+  {
+  }
+
+
+  virtual ~BudgetChangedMessage()
+  {
+  }
+
+
+  void
+  operator()(Recipient &r) override
+  {
+    r.handle_BudgetChangedMessage(*this);
+  }
+
+
+  // fraction of the cache the shown blocks should fit in, 0 to turn off.
+  double Fraction;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+class ClassificationTypeChangedMessage
+    : public Message
+{
+public:
+
+  ClassificationTypeChangedMessage()
+      : Message{ MessageType::CLASSIFICATION_TYPE_CHANGED_MESSAGE }
+      , Type{ ClassificationType::Rov }
+  {
+  }
+
+
+  virtual ~ClassificationTypeChangedMessage()
+  {
+  }
+
+
+  void
+  operator()(Recipient &r) override
+  {
+    r.handle_ClassificationTypeChangedMessage(*this);
+  }
+
+
+  ClassificationType Type;
+};
+
 } // namespace subvol
 #endif // RECIPIENT_H
@@ -64,6 +64,10 @@ BlockingRaycaster::BlockingRaycaster(std::shared_ptr<subvol::BlockCollection> bc
   , m_alphaBlending{}
   , m_wireframeShader{}
   , m_blockCollection{ std::move(bc) }
+  , m_shownBlocks{ nullptr }
+  , m_nonEmptyBlocks{ }
+  , m_sortedEyeCell{ 0, 0, 0 }
+  , m_inView{ nullptr }
   , m_cube{ cube_verts, cube_indices }
   , m_axis{ }
   , m_volume{ v }
@@ -93,7 +97,8 @@ void
 BlockingRaycaster::draw()
 {
   gl_check(glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT));
-  sortBlocks();
+  sortBlocks(*m_blockCollection, m_shownBlocks, m_nonEmptyBlocks,
+             m_sortedEyeCell, m_inView);
   // drawAxis();
 //  if (_drawNonEmptyBoundingBoxes) {
     drawNonEmptyBoundingBoxes();
@@ -108,12 +113,16 @@ BlockingRaycaster::drawNonEmptyBoundingBoxes()
 {
 
 //   size_t const nblk{ ;
-   auto &blocks = m_blockCollection->getNonEmptyBlocks();
+   auto &blocks = m_nonEmptyBlocks;
    auto nblk = blocks.size();
+   std::vector<uint8_t> const *inView{ m_inView.get() };
   m_wireframeShader->bind();
    for (size_t i{ 0 }; i < nblk; ++i) {
 
      bd::Block *b{ ( blocks[i] ) };
+     if (inView && !( *inView )[b->index()]) {
+       continue;
+     }
 
      setWorldMatrix(b->transform());
      m_wireframeShader->setUniform(WIREFRAME_MVP_MATRIX_UNIFORM_STR,
@@ -140,14 +149,25 @@ BlockingRaycaster::drawAxis()
 void
 BlockingRaycaster::drawNonEmptyBlocks()
 {
-  std::vector<bd::Block*> const &non_empties = m_blockCollection->getNonEmptyBlocks();
+  std::vector<bd::Block*> const &non_empties = m_nonEmptyBlocks;
   m_alphaBlending->bind();
+  gl_check(glBindSampler(m_volumeSampler, BLOCK_TEXTURE_UNIT));
+
+  // Blocks share a few atlas textures, so only rebind when the atlas changes.
+  bd::Texture const *boundAtlas{ nullptr };
+  // skip blocks the collection found out of view (culled or occluded).
+  std::vector<uint8_t> const *inView{ m_inView.get() };
   for (auto &b : non_empties) {
+    if (inView && !( *inView )[b->index()]) {
+      continue;
+    }
     if (b->status() & bd::Block::GPU_RES) {
       setWorldMatrix(b->transform());
-      b->texture()->bind(BLOCK_TEXTURE_UNIT);
+      if (b->texture() != boundAtlas) {
+        boundAtlas = b->texture();
+        boundAtlas->bind(BLOCK_TEXTURE_UNIT);
+      }
       setUniforms(*b);
-      gl_check(glBindSampler(m_volumeSampler, BLOCK_TEXTURE_UNIT));
       m_cube.draw();
     }
   }
@@ -180,30 +200,14 @@ BlockingRaycaster::setUniforms(bd::Block const &b)
 //  m_alphaBlending->setUniform("threshold", 200.f);
   m_alphaBlending->setUniform("gamma", 2.2f);
   m_alphaBlending->setUniform("volume", BLOCK_TEXTURE_UNIT);
+  m_alphaBlending->setUniform(VOLUME_TEX_OFFSET_UNIFORM_STR, b.texOffset());
+  m_alphaBlending->setUniform(VOLUME_TEX_SCALE_UNIFORM_STR, b.texScale());
 //  m_alphaBlending->setUniform("jitter", 1);
 
   // glClear(GL_COLOR_BUFFER_BIT);
 }
 
 
-///////////////////////////////////////////////////////////////////////////////
-void
-BlockingRaycaster::sortBlocks()
-{
-  glm::vec3 const eye{ getCamera().getEye() };
-
-  // Sort the blocks by their distance from the camera.
-  // The origin of each block is used.
-  std::vector<bd::Block*> &non_empties{ m_blockCollection->getNonEmptyBlocks() };
-  std::sort(non_empties.begin(), non_empties.end(),
-            [&eye](bd::Block *a, bd::Block *b) {
-              float a_dist = glm::distance(eye, a->origin());
-              float b_dist = glm::distance(eye, b->origin());
-              return a_dist > b_dist;
-            });
-}
-
-
 ///////////////////////////////////////////////////////////////////////////////
 void
 BlockingRaycaster::initShaders()
@@ -69,11 +69,6 @@ public:
   handle_ROVChangingMessage(subvol::ROVChangingMessage &r) override;
 
 private:
-  ///////////////////////////////////////////////////////////////////////////////
-  void
-  sortBlocks();
-
-
   ///////////////////////////////////////////////////////////////////////////////
   void
   initShaders();
@@ -92,6 +87,12 @@ private:
   std::unique_ptr<bd::ShaderProgram> m_alphaBlending;
   std::unique_ptr<bd::ShaderProgram> m_wireframeShader;
   std::shared_ptr<subvol::BlockCollection> m_blockCollection;
+  /// The collection's list m_nonEmptyBlocks was copied from.
+  std::shared_ptr<subvol::BlockCollection::BlockList const> m_shownBlocks;
+  std::vector<bd::Block *> m_nonEmptyBlocks;  ///< Blocks to draw, sorted.
+  glm::i64vec3 m_sortedEyeCell;  ///< Grid cell of the eye at the last sort.
+  /// In-view flags by block index for this frame, nullptr draws all.
+  std::shared_ptr<std::vector<uint8_t> const> m_inView;
 
   bd::Mesh m_cube;
   bd::CoordinateAxis m_axis;
@@ -7,6 +7,8 @@
 #include <bd/log/gl_log.h>
 #include <GL/glew.h>
 
+#include <algorithm>
+
 namespace subvol
 {
 namespace renderer
@@ -19,5 +21,50 @@ BlockRenderer::setBackgroundColor(glm::vec4 const &c)
 };
 
 
+///////////////////////////////////////////////////////////////////////////////
+void
+BlockRenderer::sortBlocks(
+    BlockCollection const &collection,
+    std::shared_ptr<BlockCollection::BlockList const> &shown,
+    std::vector<bd::Block *> &blocks,
+    glm::i64vec3 &eyeCell,
+    std::shared_ptr<std::vector<uint8_t> const> &inView)
+{
+  // take the newest list of shown blocks, if it changed.
+  std::shared_ptr<BlockCollection::BlockList const> newest{
+      collection.getNonEmptyBlocks() };
+  bool const changed{ newest!=shown };
+  if (changed) {
+    shown = newest;
+    blocks.assign(newest->begin(), newest->end());
+  }
+  inView = collection.getInView();
+
+  glm::vec3 const eye{ getCamera().getEye() };
+
+  // A grid of blocks is ordered from the eye's cell, so the order only
+  // changes when the eye moves to another cell.
+  bd::VisibilityOrder const &grid{ collection.getGridOrder() };
+  if (grid.valid()) {
+    glm::i64vec3 const cell{ grid.eyeCell(eye) };
+    if (changed || cell!=eyeCell) {
+      grid.sort(blocks, cell,
+                [](bd::Block const *b) { return b->ijk(); });
+      eyeCell = cell;
+    }
+    return;
+  }
+
+  // Sort the blocks by their distance from the camera.
+  // The origin of each block is used.
+  std::sort(blocks.begin(), blocks.end(),
+            [&eye](bd::Block *a, bd::Block *b) {
+              float a_dist = glm::distance(eye, a->origin());
+              float b_dist = glm::distance(eye, b->origin());
+              return a_dist > b_dist;
+            });
+}
+
+
 } // namespace renderer
 } // namespace subvol
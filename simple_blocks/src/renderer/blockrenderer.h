@@ -5,11 +5,17 @@
 #ifndef SUBVOL_BLOCKRENDERER_H
 #define SUBVOL_BLOCKRENDERER_H
 
+#include "colormap.h"
+#include "io/blockcollection.h"
+
 #include <bd/graphics/texture.h>
 #include <bd/graphics/renderer.h>
 
 #include <glm/glm.hpp>
 
+#include <memory>
+#include <vector>
+
 namespace subvol
 {
 namespace renderer
@@ -28,6 +34,15 @@ public:
   }
 
 
+  /// \brief Set the transfer function, by default its texture.
+  /// Renderers that do not sample a texture use the knots instead.
+  virtual void
+  setColorMap(ColorMap const &cmap)
+  {
+    setColorMapTexture(cmap.getTexture());
+  }
+
+
   virtual void
   setColorMapScaleValue(float val)
   {
@@ -124,6 +139,26 @@ public:
   };
 
 protected:
+  /// \brief Take the newest shown blocks and in-view flags from
+  /// \c collection and sort the blocks back to front (for painter's
+  /// algorithm).
+  ///
+  /// A regular grid of blocks is put in grid order, kept while the camera
+  /// stays in one block's cell. Otherwise the distance from the camera to
+  /// the origin of each block is used, in decending order.
+  ///
+  /// \param shown The list \c blocks was copied from.
+  /// \param blocks The shown blocks, sorted.
+  /// \param eyeCell Grid cell of the eye at the last sort.
+  /// \param inView In-view flags by block index, nullptr draws all.
+  void
+  sortBlocks(BlockCollection const &collection,
+             std::shared_ptr<BlockCollection::BlockList const> &shown,
+             std::vector<bd::Block *> &blocks,
+             glm::i64vec3 &eyeCell,
+             std::shared_ptr<std::vector<uint8_t> const> &inView);
+
+
   float _tfuncScaleValue;
   /// True to draw bounding boxes.
   bool _drawNonEmptyBoundingBoxes;
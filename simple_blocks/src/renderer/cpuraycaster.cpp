@@ -0,0 +1,610 @@
+#include "cpuraycaster.h"
+
+#include <bd/log/logger.h>
+#include <bd/volume/quantizer.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <limits>
+
+#if defined(__SSE__)
+#include <xmmintrin.h>
+#endif
+
+namespace subvol
+{
+namespace renderer
+{
+
+namespace
+{
+
+/// Screen tiles are TILE_SIZE pixels square.
+unsigned int const TILE_SIZE{ 32 };
+
+/// Rays take this many samples per voxel.
+float const STEPS_PER_VOXEL{ 2.0f };
+
+/// Rays stop once this opaque.
+float const OPAQUE_ALPHA{ 0.99f };
+
+/// Entries in the color lookup table.
+size_t const LUT_SIZE{ 1024 };
+
+/// Slack, in voxels, for samples on the faces of a block's occupied part.
+float const VOXEL_EPSILON{ 1e-3f };
+
+/// Slack, in cells, for block faces on cell faces.
+float const CELL_EPSILON{ 1e-4f };
+
+/// Most cells in the grid, cells grow past the smallest block beyond it.
+size_t const MAX_GRID_CELLS{ size_t{ 1 } << 22 };
+
+
+/// \brief Where a ray through \c ndc enters the box [lo, hi], and its
+/// direction.
+/// \return false if the ray misses the box.
+bool
+rayThroughPixel(glm::mat4 const &invViewProj, glm::vec2 const &ndc,
+                glm::vec3 const &lo, glm::vec3 const &hi,
+                glm::vec3 &origin, glm::vec3 &dir, float &tEnter, float &tExit)
+{
+  glm::vec4 const n{ invViewProj*glm::vec4{ ndc, -1.0f, 1.0f }};
+  glm::vec4 const f{ invViewProj*glm::vec4{ ndc, 1.0f, 1.0f }};
+  origin = glm::vec3{ n }/n.w;
+  dir = glm::normalize(glm::vec3{ f }/f.w-origin);
+
+  tEnter = 0.0f;
+  tExit = std::numeric_limits<float>::max();
+  for (int a{ 0 }; a<3; ++a) {
+    if (dir[a]==0.0f) {
+      if (origin[a]<lo[a] || origin[a]>hi[a]) {
+        return false;
+      }
+      continue;
+    }
+    float t0{ ( lo[a]-origin[a] )/dir[a] };
+    float t1{ ( hi[a]-origin[a] )/dir[a] };
+    if (t0>t1) {
+      std::swap(t0, t1);
+    }
+    tEnter = std::max(tEnter, t0);
+    tExit = std::min(tExit, t1);
+  }
+  return tEnter<tExit;
+}
+
+} // namespace
+
+
+///////////////////////////////////////////////////////////////////////////////
+CpuRaycaster::CpuRaycaster(std::shared_ptr<subvol::BlockCollection> bc,
+                           bd::Volume const &v,
+                           size_t threads)
+    : m_blockCollection{ std::move(bc) }
+    , m_volume{ v }
+    , m_pool{ threads }
+    , m_framebuffer{ }
+    , m_stats{ }
+    , m_lut{ }
+    , m_bricks{ }
+    , m_cellEntries{ }
+    , m_grid{ }
+    , m_usedCells{ }
+    , m_gridDims{ 0, 0, 0 }
+    , m_gridMin{ 0.0f }
+    , m_cellSize{ 1.0f }
+    , m_cellInv{ 1.0f }
+    , m_step{ 1.0f }
+    , m_voxelSize{ 1.0f }
+    , m_dequantized{ }
+    , m_frame{ 0 }
+{
+  _tfuncScaleValue = 1.0f;
+  _drawNonEmptyBoundingBoxes = false;
+  _drawNonEmptyBlocks = true;
+  _rangeChanging = false;
+  _shouldUseLighting = false;
+  _backgroundColor = { 0.0f, 0.0f, 0.0f, 1.0f };
+  _colorMap = nullptr;
+
+  // A grey ramp until a color map is given.
+  setColorMapKnots({ { 0.0f, 0.0f, 0.0f, 0.0f }, { 1.0f, 1.0f, 1.0f, 1.0f } });
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+CpuRaycaster::~CpuRaycaster() noexcept
+{
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+bool
+CpuRaycaster::initialize()
+{
+  bd::Info() << "Cpu ray caster using " << m_pool.size() << " threads.";
+  return true;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+void
+CpuRaycaster::draw()
+{
+  std::shared_ptr<BlockCollection::BlockList const> shown{
+      m_blockCollection ? m_blockCollection->getNonEmptyBlocks() : nullptr };
+  if (!shown || !_drawNonEmptyBlocks) {
+    drawBlocks({ });
+    return;
+  }
+
+  // Blocks still being read already have their buffers, draw only those
+  // the loader has finished.
+  BlockCollection::BlockList resident;
+  m_blockCollection->getResidentBlocks(*shown, resident);
+  drawBlocks(resident);
+  m_stats.notResident += shown->size()-resident.size();
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+void
+CpuRaycaster::drawBlocks(std::vector<bd::Block *> const &blocks)
+{
+  auto const start = std::chrono::steady_clock::now();
+  m_stats = FrameStats{ };
+  ++m_frame;
+
+  unsigned int const w{ getViewPortWidth() };
+  unsigned int const h{ getViewPortHeight() };
+  if (m_framebuffer.width()!=w || m_framebuffer.height()!=h) {
+    m_framebuffer.resize(w, h);
+  }
+
+  buildGrid(blocks);
+
+  if (m_bricks.empty()) {
+    m_framebuffer.clear(_backgroundColor);
+  } else {
+    glm::mat4 const invViewProj{
+        glm::inverse(getProjectionMatrix()*getViewMatrix()) };
+    size_t const tilesX{ ( w+TILE_SIZE-1 )/TILE_SIZE };
+    size_t const tilesY{ ( h+TILE_SIZE-1 )/TILE_SIZE };
+    m_stats.tiles = tilesX*tilesY;
+
+    std::atomic<uint64_t> samples{ 0 };
+    size_t const steals{ m_pool.steals() };
+    m_pool.run(m_stats.tiles, [&](size_t t, size_t) {
+      samples += renderTile(t, invViewProj);
+    });
+    m_stats.samples = samples.load();
+    m_stats.steals = m_pool.steals()-steals;
+  }
+
+  m_stats.ms = std::chrono::duration<double, std::milli>(
+      std::chrono::steady_clock::now()-start).count();
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+void
+CpuRaycaster::buildGrid(std::vector<bd::Block *> const &blocks)
+{
+  for (size_t c : m_usedCells) {
+    m_grid[c] = 0;
+  }
+  m_usedCells.clear();
+  m_cellEntries.clear();
+  m_bricks.clear();
+
+  // Quantized blocks are expanded first, on the pool.
+  std::vector<bd::Block *> drawn;
+  std::vector<Dequantized *> expand;
+  std::vector<bd::Block *> expandBlocks;
+  for (bd::Block *b : blocks) {
+    if (b->pixelData()==nullptr) {
+      m_stats.notResident += 1;
+      continue;
+    }
+    drawn.push_back(b);
+    if (b->quantization().mode==bd::QuantizeMode::None) {
+      continue;
+    }
+    // A reload may reuse the buffer, so the load count tells them apart.
+    Dequantized &d{ m_dequantized[b->index()] };
+    d.frame = m_frame;
+    if (d.source!=b->pixelData() || d.load!=b->loadCount() || d.voxels.empty()) {
+      d.source = b->pixelData();
+      d.load = b->loadCount();
+      expand.push_back(&d);
+      expandBlocks.push_back(b);
+    }
+  }
+  m_pool.run(expand.size(), [&](size_t i, size_t) {
+    bd::Block *b{ expandBlocks[i] };
+    glm::u64vec3 const &ext{ b->occupiedExtent() };
+    size_t const n{ ext.x*ext.y*ext.z };
+    expand[i]->voxels.resize(n);
+    bd::BlockQuantizer::dequantize(b->quantization(), b->pixelData(), n,
+                                   expand[i]->voxels.data());
+  });
+  m_stats.dequantized = expand.size();
+
+  // Blocks that were not drawn give up their voxels.
+  for (auto it = m_dequantized.begin(); it!=m_dequantized.end();) {
+    if (it->second.frame!=m_frame) {
+      it = m_dequantized.erase(it);
+    } else {
+      ++it;
+    }
+  }
+
+  if (drawn.empty()) {
+    return;
+  }
+
+  // The grid covers the drawn blocks' world boxes with cells the size of
+  // the smallest block. Regular grids get one block per cell, kd blocks
+  // of other sizes cover several cells.
+  glm::vec3 lo{ std::numeric_limits<float>::max() };
+  glm::vec3 hi{ -std::numeric_limits<float>::max() };
+  m_cellSize = glm::vec3{ std::numeric_limits<float>::max() };
+  for (bd::Block *b : drawn) {
+    glm::vec3 const &wd{ b->worldDims() };
+    lo = glm::min(lo, b->origin()-0.5f*wd);
+    hi = glm::max(hi, b->origin()+0.5f*wd);
+    m_cellSize = glm::min(m_cellSize, wd);
+  }
+  m_cellSize = glm::max(m_cellSize, glm::vec3{ std::numeric_limits<float>::min() });
+
+  glm::vec3 cells{ glm::max(glm::ceil(( hi-lo )/m_cellSize-CELL_EPSILON),
+                            glm::vec3{ 1.0f }) };
+  double const total{ double(cells.x)*cells.y*cells.z };
+  if (total>MAX_GRID_CELLS) {
+    m_cellSize *= static_cast<float>(std::cbrt(total/MAX_GRID_CELLS));
+    cells = glm::max(glm::ceil(( hi-lo )/m_cellSize-CELL_EPSILON),
+                     glm::vec3{ 1.0f });
+  }
+  m_gridDims = glm::ivec3{ cells };
+  m_gridMin = lo;
+  m_cellInv = 1.0f/m_cellSize;
+  size_t const gridCells{ size_t(m_gridDims.x)*m_gridDims.y*m_gridDims.z };
+  if (m_grid.size()!=gridCells) {
+    m_grid.assign(gridCells, 0);
+  }
+
+  m_voxelSize = std::numeric_limits<float>::max();
+  m_bricks.reserve(drawn.size());
+  for (bd::Block *b : drawn) {
+    // The block's [0,1] coords span the centers of its first and last
+    // voxels (see Block::occupiedLow()).
+    glm::vec3 const vd{ b->voxel_extent() };
+    glm::vec3 const &wd{ b->worldDims() };
+    Brick brick;
+    for (int a{ 0 }; a<3; ++a) {
+      brick.scale[a] = vd[a]>1.0f ? ( vd[a]-1.0f )/wd[a] : 0.0f;
+      if (vd[a]>1.0f) {
+        m_voxelSize = std::min(m_voxelSize, wd[a]/( vd[a]-1.0f ));
+      }
+    }
+    glm::u64vec3 const &ext{ b->occupiedExtent() };
+    brick.bias = ( b->origin()-0.5f*wd )*brick.scale+glm::vec3{ b->occupiedOffset() };
+    brick.maxVoxel = glm::vec3{ ext }-1.0f;
+    brick.rowStride = ext.x;
+    brick.slabStride = ext.x*ext.y;
+    brick.voxels = b->quantization().mode==bd::QuantizeMode::None
+                   ? reinterpret_cast<float const *>(b->pixelData())
+                   : m_dequantized[b->index()].voxels.data();
+    m_bricks.push_back(brick);
+    uint32_t const brickIndex{ static_cast<uint32_t>(m_bricks.size()-1) };
+
+    // Every cell the block's box overlaps lists it.
+    glm::ivec3 const c0{ glm::clamp(
+        glm::ivec3{ glm::floor(( b->origin()-0.5f*wd-m_gridMin )*m_cellInv+CELL_EPSILON) },
+        glm::ivec3{ 0 }, m_gridDims-1) };
+    glm::ivec3 const c1{ glm::clamp(
+        glm::ivec3{ glm::ceil(( b->origin()+0.5f*wd-m_gridMin )*m_cellInv-CELL_EPSILON) }-1,
+        c0, m_gridDims-1) };
+    for (int k{ c0.z }; k<=c1.z; ++k)
+    for (int j{ c0.y }; j<=c1.y; ++j)
+    for (int i{ c0.x }; i<=c1.x; ++i) {
+      size_t const cell{ i+m_gridDims.x*( j+size_t(m_gridDims.y)*k ) };
+      if (m_grid[cell]==0) {
+        m_usedCells.push_back(cell);
+      }
+      m_cellEntries.push_back({ brickIndex, m_grid[cell] });
+      m_grid[cell] = static_cast<uint32_t>(m_cellEntries.size());
+    }
+  }
+  m_stats.blocks = m_bricks.size();
+
+  if (m_voxelSize==std::numeric_limits<float>::max()) {
+    m_voxelSize = std::min(m_cellSize.x, std::min(m_cellSize.y, m_cellSize.z));
+  }
+  m_step = m_voxelSize/STEPS_PER_VOXEL;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+uint32_t
+CpuRaycaster::cellAt(int i, int j, int k) const
+{
+  return m_grid[i+m_gridDims.x*( j+size_t(m_gridDims.y)*k )];
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+bool
+CpuRaycaster::sample(Brick const &b, glm::vec3 const &p, float &value) const
+{
+  glm::vec3 v{ p*b.scale-b.bias };
+  for (int a{ 0 }; a<3; ++a) {
+    if (v[a]< -VOXEL_EPSILON || v[a]>b.maxVoxel[a]+VOXEL_EPSILON) {
+      return false;
+    }
+    v[a] = glm::clamp(v[a], 0.0f, b.maxVoxel[a]);
+  }
+
+  size_t const x0{ static_cast<size_t>(v.x) };
+  size_t const y0{ static_cast<size_t>(v.y) };
+  size_t const z0{ static_cast<size_t>(v.z) };
+  float const fx{ v.x-x0 };
+  float const fy{ v.y-y0 };
+  float const fz{ v.z-z0 };
+  // Past the last voxel the weight of the next one is 0.
+  size_t const dx{ fx>0.0f ? 1u : 0u };
+  size_t const dy{ fy>0.0f ? b.rowStride : 0u };
+  size_t const dz{ fz>0.0f ? b.slabStride : 0u };
+
+  float const *c{ b.voxels+x0+y0*b.rowStride+z0*b.slabStride };
+  float const c00{ c[0]+fx*( c[dx]-c[0] ) };
+  float const c10{ c[dy]+fx*( c[dy+dx]-c[dy] ) };
+  float const c01{ c[dz]+fx*( c[dz+dx]-c[dz] ) };
+  float const c11{ c[dz+dy]+fx*( c[dz+dy+dx]-c[dz+dy] ) };
+  float const c0{ c00+fy*( c10-c00 ) };
+  float const c1{ c01+fy*( c11-c01 ) };
+  value = c0+fz*( c1-c0 );
+  return true;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+glm::vec4
+CpuRaycaster::classify(float value) const
+{
+  // The shaders look up the color map at value * scale.
+  float const c{ glm::clamp(value*_tfuncScaleValue, 0.0f, 1.0f) };
+  return m_lut[static_cast<size_t>(c*( LUT_SIZE-1 )+0.5f)];
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+uint64_t
+CpuRaycaster::renderTile(size_t t, glm::mat4 const &invViewProj)
+{
+  unsigned int const w{ m_framebuffer.width() };
+  unsigned int const h{ m_framebuffer.height() };
+  unsigned int const tilesX{ ( w+TILE_SIZE-1 )/TILE_SIZE };
+  unsigned int const x0{ static_cast<unsigned int>(t%tilesX)*TILE_SIZE };
+  unsigned int const y0{ static_cast<unsigned int>(t/tilesX)*TILE_SIZE };
+  unsigned int const x1{ std::min(w, x0+TILE_SIZE) };
+  unsigned int const y1{ std::min(h, y0+TILE_SIZE) };
+
+  glm::vec3 const lo{ m_gridMin };
+  glm::vec3 const hi{ m_gridMin+glm::vec3{ m_gridDims }*m_cellSize };
+  glm::vec4 const &bg{ _backgroundColor };
+  uint64_t samples{ 0 };
+
+  // One 2x2 packet of rays at a time, the lanes as structures of arrays.
+  alignas(16) float ox[4], oy[4], oz[4];
+  alignas(16) float dx[4], dy[4], dz[4];
+  alignas(16) float tNow[4], tEnd[4];
+  alignas(16) float r[4], g[4], b[4], a[4];
+  alignas(16) float px[4], py[4], pz[4];
+  alignas(16) float sr[4], sg[4], sb[4], sa[4], adv[4];
+
+  for (unsigned int y{ y0 }; y<y1; y += 2) {
+    for (unsigned int x{ x0 }; x<x1; x += 2) {
+
+      for (int l{ 0 }; l<4; ++l) {
+        unsigned int const lx{ x+( l & 1 ) };
+        unsigned int const ly{ y+( l >> 1 ) };
+        r[l] = g[l] = b[l] = a[l] = 0.0f;
+        glm::vec3 o{ 0.0f };
+        glm::vec3 d{ 0.0f, 0.0f, -1.0f };
+        float t0{ 0.0f };
+        float t1{ 0.0f };
+        if (lx<x1 && ly<y1) {
+          glm::vec2 const ndc{ ( lx+0.5f )/w*2.0f-1.0f, ( ly+0.5f )/h*2.0f-1.0f };
+          if (!rayThroughPixel(invViewProj, ndc, lo, hi, o, d, t0, t1)) {
+            t0 = t1 = 0.0f;
+          }
+        }
+        ox[l] = o.x; oy[l] = o.y; oz[l] = o.z;
+        dx[l] = d.x; dy[l] = d.y; dz[l] = d.z;
+        // Sample at the middle of the first step.
+        tNow[l] = t0+0.5f*m_step;
+        tEnd[l] = t1;
+      }
+
+      while (true) {
+        int active{ 0 };
+#if defined(__SSE__)
+        __m128 const t4{ _mm_load_ps(tNow) };
+        active = _mm_movemask_ps(_mm_and_ps(
+            _mm_cmplt_ps(t4, _mm_load_ps(tEnd)),
+            _mm_cmplt_ps(_mm_load_ps(a), _mm_set1_ps(OPAQUE_ALPHA))));
+        _mm_store_ps(px, _mm_add_ps(_mm_load_ps(ox), _mm_mul_ps(t4, _mm_load_ps(dx))));
+        _mm_store_ps(py, _mm_add_ps(_mm_load_ps(oy), _mm_mul_ps(t4, _mm_load_ps(dy))));
+        _mm_store_ps(pz, _mm_add_ps(_mm_load_ps(oz), _mm_mul_ps(t4, _mm_load_ps(dz))));
+#else
+        for (int l{ 0 }; l<4; ++l) {
+          if (tNow[l]<tEnd[l] && a[l]<OPAQUE_ALPHA) {
+            active |= 1 << l;
+          }
+          px[l] = ox[l]+tNow[l]*dx[l];
+          py[l] = oy[l]+tNow[l]*dy[l];
+          pz[l] = oz[l]+tNow[l]*dz[l];
+        }
+#endif
+        if (active==0) {
+          break;
+        }
+
+        // Gathers are per ray.
+        for (int l{ 0 }; l<4; ++l) {
+          sr[l] = sg[l] = sb[l] = sa[l] = 0.0f;
+          adv[l] = ( active & ( 1 << l ) ) ? m_step : 0.0f;
+          if (adv[l]==0.0f) {
+            continue;
+          }
+
+          glm::vec3 const p{ px[l], py[l], pz[l] };
+          glm::vec3 const cell{ ( p-m_gridMin )*m_cellInv };
+          int const i{ glm::clamp(static_cast<int>(cell.x), 0, m_gridDims.x-1) };
+          int const j{ glm::clamp(static_cast<int>(cell.y), 0, m_gridDims.y-1) };
+          int const k{ glm::clamp(static_cast<int>(cell.z), 0, m_gridDims.z-1) };
+          uint32_t entry{ cellAt(i, j, k) };
+
+          if (entry==0) {
+            // Skip to the first sample past this cell.
+            glm::vec3 const d{ dx[l], dy[l], dz[l] };
+            glm::vec3 const o{ ox[l], oy[l], oz[l] };
+            glm::ivec3 const ijk{ i, j, k };
+            float tCell{ std::numeric_limits<float>::max() };
+            for (int c{ 0 }; c<3; ++c) {
+              if (d[c]!=0.0f) {
+                float const face{ m_gridMin[c]+
+                                  ( ijk[c]+( d[c]>0.0f ? 1 : 0 ) )*m_cellSize[c] };
+                tCell = std::min(tCell, ( face-o[c] )/d[c]);
+              }
+            }
+            adv[l] = m_step*std::max(1.0f, std::ceil(( tCell-tNow[l] )/m_step));
+            continue;
+          }
+
+          // Kd blocks share cells, the one holding p is sampled.
+          float v{ 0.0f };
+          bool hit{ false };
+          for (; entry!=0 && !hit; entry = m_cellEntries[entry-1].next) {
+            hit = sample(m_bricks[m_cellEntries[entry-1].brick], p, v);
+          }
+          if (hit) {
+            glm::vec4 const c{ classify(v) };
+            sr[l] = c.r;
+            sg[l] = c.g;
+            sb[l] = c.b;
+            sa[l] = c.a;
+            ++samples;
+          }
+        }
+
+        // Front to back: C += (1 - A) a c, A += (1 - A) a.
+#if defined(__SSE__)
+        __m128 const alpha{ _mm_load_ps(a) };
+        __m128 const wgt{ _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(1.0f), alpha),
+                                     _mm_load_ps(sa)) };
+        _mm_store_ps(r, _mm_add_ps(_mm_load_ps(r), _mm_mul_ps(wgt, _mm_load_ps(sr))));
+        _mm_store_ps(g, _mm_add_ps(_mm_load_ps(g), _mm_mul_ps(wgt, _mm_load_ps(sg))));
+        _mm_store_ps(b, _mm_add_ps(_mm_load_ps(b), _mm_mul_ps(wgt, _mm_load_ps(sb))));
+        _mm_store_ps(a, _mm_add_ps(alpha, wgt));
+        _mm_store_ps(tNow, _mm_add_ps(_mm_load_ps(tNow), _mm_load_ps(adv)));
+#else
+        for (int l{ 0 }; l<4; ++l) {
+          float const wgt{ ( 1.0f-a[l] )*sa[l] };
+          r[l] += wgt*sr[l];
+          g[l] += wgt*sg[l];
+          b[l] += wgt*sb[l];
+          a[l] += wgt;
+          tNow[l] += adv[l];
+        }
+#endif
+      } // while
+
+      for (int l{ 0 }; l<4; ++l) {
+        unsigned int const lx{ x+( l & 1 ) };
+        unsigned int const ly{ y+( l >> 1 ) };
+        if (lx<x1 && ly<y1) {
+          float const rest{ 1.0f-a[l] };
+          m_framebuffer.pixel(lx, ly) = { r[l]+rest*bg.r, g[l]+rest*bg.g,
+                                          b[l]+rest*bg.b, a[l]+rest*bg.a };
+        }
+      }
+    }
+  }
+
+  return samples;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+void
+CpuRaycaster::setColorMap(ColorMap const &cmap)
+{
+  setColorMapKnots(cmap.getKnots());
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+void
+CpuRaycaster::setColorMapKnots(std::vector<glm::vec4> const &knots)
+{
+  m_lut.assign(LUT_SIZE, glm::vec4{ 0.0f });
+  if (knots.empty()) {
+    return;
+  }
+
+  // Linear between texel centers and clamped at the ends, as the 1D
+  // texture is sampled. The alpha is for one voxel, rays take a sample
+  // every 1 / STEPS_PER_VOXEL voxels.
+  float const n{ static_cast<float>(knots.size()) };
+  for (size_t i{ 0 }; i<LUT_SIZE; ++i) {
+    float const s{ i/float( LUT_SIZE-1 )*n-0.5f };
+    float const c{ glm::clamp(s, 0.0f, n-1.0f) };
+    size_t const k0{ static_cast<size_t>(c) };
+    size_t const k1{ std::min(k0+1, knots.size()-1) };
+    glm::vec4 rgba{ glm::mix(knots[k0], knots[k1], c-k0) };
+    rgba.a = 1.0f-std::pow(1.0f-glm::clamp(rgba.a, 0.0f, 1.0f),
+                           1.0f/STEPS_PER_VOXEL);
+    m_lut[i] = rgba;
+  }
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+void
+CpuRaycaster::setBackgroundColor(glm::vec4 const &c)
+{
+  // No glClearColor(), there may not be a GL context.
+  _backgroundColor = c;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+bd::Framebuffer const &
+CpuRaycaster::framebuffer() const
+{
+  return m_framebuffer;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+CpuRaycaster::FrameStats const &
+CpuRaycaster::frameStats() const
+{
+  return m_stats;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+size_t
+CpuRaycaster::threads() const
+{
+  return m_pool.size();
+}
+
+} // namespace renderer
+} // namespace subvol
@@ -0,0 +1,199 @@
+#ifndef SUBVOL_CPURAYCASTER_H
+#define SUBVOL_CPURAYCASTER_H
+
+#include "io/blockcollection.h"
+#include "blockrenderer.h"
+
+#include <bd/graphics/framebuffer.h>
+#include <bd/util/workstealingpool.h>
+#include <bd/volume/block.h>
+#include <bd/volume/volume.h>
+
+#include <glm/glm.hpp>
+
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace subvol
+{
+namespace renderer
+{
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief Ray casts the blocks in main memory on the cpu, for nodes without
+/// a gpu and as a reference for the gpu renderers.
+///
+/// Each frame the non-empty blocks that the loader has read are put in a
+/// grid over their world boxes, with cells the size of the smallest block,
+/// so both regular and kd partitioned volumes are placed. Rays through the
+/// pixel centers march the grid at half a voxel per step, front to back,
+/// and stop once they are nearly opaque. Cells without a drawn block are
+/// skipped in one step. Samples are
+/// trilinear within the occupied part of a block (the part that is loaded
+/// and that the gpu renderers draw), looked up in the color map and
+/// composited with opacity corrected for the step length.
+///
+/// The image is split into tiles that run on a work-stealing pool, each
+/// tile marches 2x2 packets of rays together. The image is in framebuffer()
+/// (the window is not touched, nothing here needs a GL context).
+///////////////////////////////////////////////////////////////////////////////
+class CpuRaycaster
+    : public BlockRenderer
+{
+public:
+  /// \brief What the last frame did.
+  struct FrameStats
+  {
+    double ms;            ///< Time in drawBlocks().
+    size_t blocks;        ///< Blocks drawn.
+    size_t notResident;   ///< Non-empty blocks skipped, not loaded.
+    size_t dequantized;   ///< Blocks expanded to floats this frame.
+    uint64_t samples;     ///< Samples taken.
+    size_t tiles;
+    size_t steals;        ///< Tiles run by a worker other than their own.
+  };
+
+
+  /// \param bc Blocks to draw, may be nullptr if only drawBlocks() is used.
+  /// \param threads Render threads, 0 for one per hardware thread.
+  CpuRaycaster(std::shared_ptr<subvol::BlockCollection> bc,
+               bd::Volume const &v,
+               size_t threads = 0);
+
+
+  ~CpuRaycaster() noexcept override;
+
+
+  bool
+  initialize() override;
+
+
+  /// \brief Draw the collection's non-empty blocks that are in main memory.
+  void
+  draw() override;
+
+
+  /// \brief Draw \c blocks (those with pixel data) into framebuffer().
+  void
+  drawBlocks(std::vector<bd::Block *> const &blocks);
+
+
+  /// \brief Sample the color map's knots (its texture is not used).
+  void
+  setColorMap(ColorMap const &cmap) override;
+
+
+  /// \brief Set the transfer function from rgba texels evenly spaced over
+  /// [0,1], as ColorMap::getKnots() returns them.
+  void
+  setColorMapKnots(std::vector<glm::vec4> const &knots);
+
+
+  void
+  setBackgroundColor(glm::vec4 const &c) override;
+
+
+  bd::Framebuffer const &
+  framebuffer() const;
+
+
+  FrameStats const &
+  frameStats() const;
+
+
+  /// \brief Render threads, including the one calling draw().
+  size_t
+  threads() const;
+
+
+private:
+  /// \brief A drawn block, as the rays see it.
+  struct Brick
+  {
+    float const *voxels;  ///< occupiedExtent() floats, x fastest.
+    glm::vec3 scale;      ///< World to occupied voxel coords:
+    glm::vec3 bias;       ///<   voxel = p * scale - bias.
+    glm::vec3 maxVoxel;   ///< occupiedExtent() - 1.
+    size_t rowStride;
+    size_t slabStride;
+  };
+
+
+  /// \brief Voxels of a quantized block, expanded once while it stays
+  /// resident from the same load.
+  struct Dequantized
+  {
+    char const *source;
+    uint32_t load;        ///< The block's loadCount() when expanded.
+    std::vector<float> voxels;
+    uint64_t frame;       ///< Last frame the block was drawn in.
+  };
+
+
+  /// \brief A brick overlapping a cell, cells list theirs through next.
+  struct CellEntry
+  {
+    uint32_t brick;       ///< Index into m_bricks.
+    uint32_t next;        ///< Index into m_cellEntries + 1, 0 at the end.
+  };
+
+
+  /// \brief Fill m_bricks and m_grid from the blocks with pixel data.
+  void
+  buildGrid(std::vector<bd::Block *> const &blocks);
+
+
+  /// \brief Ray cast tile \c t.
+  /// \return The samples taken.
+  uint64_t
+  renderTile(size_t t, glm::mat4 const &invViewProj);
+
+
+  /// \brief First entry of cell (i,j,k), index into m_cellEntries + 1,
+  /// 0 if no brick overlaps it.
+  uint32_t
+  cellAt(int i, int j, int k) const;
+
+
+  /// \brief Trilinear sample of \c b at world point \c p.
+  /// \return false if \c p is outside the occupied part of \c b.
+  bool
+  sample(Brick const &b, glm::vec3 const &p, float &value) const;
+
+
+  /// \brief Opacity corrected color for a volume value.
+  glm::vec4
+  classify(float value) const;
+
+
+  std::shared_ptr<subvol::BlockCollection> m_blockCollection;
+  bd::Volume m_volume;
+  bd::WorkStealingPool m_pool;
+  bd::Framebuffer m_framebuffer;
+  FrameStats m_stats;
+
+  /// The color map at evenly spaced values, alpha corrected for the step.
+  std::vector<glm::vec4> m_lut;
+
+  std::vector<Brick> m_bricks;
+  std::vector<CellEntry> m_cellEntries;
+  /// First entry of each cell (see cellAt()).
+  std::vector<uint32_t> m_grid;
+  std::vector<size_t> m_usedCells;  ///< Cells set in m_grid this frame.
+  glm::ivec3 m_gridDims;
+  glm::vec3 m_gridMin;          ///< World min corner of the grid.
+  glm::vec3 m_cellSize;
+  glm::vec3 m_cellInv;
+  float m_step;                 ///< World distance between samples.
+  float m_voxelSize;            ///< Smallest voxel edge, the unit of opacity.
+
+  std::unordered_map<size_t, Dequantized> m_dequantized;
+  uint64_t m_frame;
+
+}; // class CpuRaycaster
+
+} // namespace renderer
+} // namespace subvol
+
+#endif // SUBVOL_CPURAYCASTER_H
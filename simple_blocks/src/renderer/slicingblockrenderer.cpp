@@ -19,6 +19,9 @@
 #include <glm/gtx/string_cast.hpp>
 #include <bd/log/gl_log.h>
 
+#include <algorithm>
+#include <cmath>
+
 #ifdef USE_NV_TOOLS
 #include <nvToolsExt.h>
 #endif
@@ -51,6 +54,8 @@ SlicingBlockRenderer::SlicingBlockRenderer(glm::vec3 smod,
 
     , m_colorMapTexture{ nullptr }
     , m_volume{ v }
+    , m_selectedSliceSet{ SliceSet::NoneOfEm }
+    , m_slicesReversed{ false }
     , m_currentShader{ nullptr }
     , m_volumeShader{ nullptr }
     , m_volumeShaderLighting{ nullptr }
@@ -61,11 +66,15 @@ SlicingBlockRenderer::SlicingBlockRenderer(glm::vec3 smod,
     , m_axisVao{ nullptr }
 
     , m_collection{ std::move(blockCollection) }
-    , m_nonEmptyBlocks{ nullptr }
+    , m_shownBlocks{ nullptr }
+    , m_nonEmptyBlocks{ }
+    , m_sortedEyeCell{ 0, 0, 0 }
+    , m_inView{ nullptr }
+    , m_sliceDraws{ }
+    , m_sliceMvps{ }
     , m_blocks{ nullptr }
 {
   m_blocks = &( m_collection->getBlocks());
-  m_nonEmptyBlocks = &( m_collection->getNonEmptyBlocks());
 }
 
 
@@ -237,7 +246,8 @@ SlicingBlockRenderer::draw()
 {
   // We need to draw in reverse-visibility order (painters algorithm!)
   // so the transparency looks correct.
-  sortBlocks();
+  sortBlocks(*m_collection, m_shownBlocks, m_nonEmptyBlocks, m_sortedEyeCell,
+             m_inView);
   //TODO: only sort if rotated beyond a limit.
 
 
@@ -265,10 +275,14 @@ SlicingBlockRenderer::drawNonEmptyBoundingBoxes()
 {
   m_wireframeShader->bind();
   m_boxesVao->bind();
-  size_t const nblk{ m_nonEmptyBlocks->size() };
+  std::vector<uint8_t> const *inView{ m_inView.get() };
+  size_t const nblk{ m_nonEmptyBlocks.size() };
   for (size_t i{ 0 }; i < nblk; ++i) {
 
-    bd::Block *b{ ( *m_nonEmptyBlocks )[i] };
+    bd::Block *b{ m_nonEmptyBlocks[i] };
+    if (inView && !( *inView )[b->index()]) {
+      continue;
+    }
 
     setWorldMatrix(b->transform());
     m_wireframeShader->setUniform(WIREFRAME_MVP_MATRIX_UNIFORM_STR,
@@ -340,24 +354,45 @@ SlicingBlockRenderer::drawNonEmptyBlocks_Forward()
   }
 
   m_quadsVao->bind();
+  gl_check(glBindSampler(m_sampler_state, BLOCK_TEXTURE_UNIT));
 
-  size_t const nBlk{ m_nonEmptyBlocks->size() };
-  NVTOOLS_PUSH_RANGE("DrawNonEmptyBlocks", 0);
+  // skip blocks the collection found out of view (culled or occluded).
+  std::vector<uint8_t> const *inView{ m_inView.get() };
+
+  // Queue the slices to draw first, so the MVP matrices of all of the blocks
+  // are computed in one pass.
+  m_sliceDraws.clear();
+  m_sliceMvps.clear();
+  size_t const nBlk{ m_nonEmptyBlocks.size() };
   for (size_t i{ 0 }; i < nBlk; ++i) {
-    bd::Block *b{ ( *m_nonEmptyBlocks )[i] };
+    bd::Block *b{ m_nonEmptyBlocks[i] };
+    if (inView && !( *inView )[b->index()]) {
+      continue;
+    }
 
     // only render if the block's texture data has been uploaded to GPU.
     if (b->status() & bd::Block::GPU_RES) {
-      setWorldMatrix(b->transform());
-      b->texture()->bind(BLOCK_TEXTURE_UNIT);
-      gl_check(glBindSampler(m_sampler_state, BLOCK_TEXTURE_UNIT));
+      queueOccupiedSlices(*b, baseVertex);
+    }
+  }
+  m_sliceMvps.compute(getProjectionMatrix() * getViewMatrix());
+  std::vector<glm::mat4> const &mvps{ m_sliceMvps.matrices() };
 
-      m_currentShader->setUniform(VOLUME_MVP_MATRIX_UNIFORM_STR,
-                                  getWorldViewProjectionMatrix());
+  // Blocks share a few atlas textures, so only rebind when the atlas changes.
+  bd::Texture const *boundAtlas{ nullptr };
 
-      drawSlices(baseVertex.first, baseVertex.second,
-                 m_numSlicesPerBlock[bd::ordinal<SliceSet>(m_selectedSliceSet)]);
+  NVTOOLS_PUSH_RANGE("DrawNonEmptyBlocks", 0);
+  for (size_t i{ 0 }; i < m_sliceDraws.size(); ++i) {
+    SliceDraw const &d{ m_sliceDraws[i] };
+    if (d.atlas != boundAtlas) {
+      boundAtlas = d.atlas;
+      boundAtlas->bind(BLOCK_TEXTURE_UNIT);
     }
+
+    m_currentShader->setUniform(VOLUME_MVP_MATRIX_UNIFORM_STR, mvps[i]);
+    m_currentShader->setUniform(VOLUME_TEX_OFFSET_UNIFORM_STR, d.texOffset);
+    m_currentShader->setUniform(VOLUME_TEX_SCALE_UNIFORM_STR, d.texScale);
+    drawSlices(d.baseVertex, baseVertex.second, d.numSlices);
   }
   NVTOOLS_POP_RANGE
 
@@ -366,6 +401,69 @@ SlicingBlockRenderer::drawNonEmptyBlocks_Forward()
 }
 
 
+////////////////////////////////////////////////////////////////////////////////
+void
+SlicingBlockRenderer::queueOccupiedSlices(bd::Block &b,
+                                          std::pair<int, int> const &baseVertex)
+{
+  // the axis the selected slices are stacked along.
+  int a{ 0 };
+  switch (m_selectedSliceSet) {
+    case SliceSet::XZ:
+      a = 1;
+      break;
+    case SliceSet::XY:
+      a = 2;
+      break;
+    default:
+      break;
+  }
+
+  // Slice i of n is at i/(n-1) of the whole block. b.transform() only covers
+  // the occupied part, so along the slicing axis the whole block is used
+  // instead, and only the slices that cross the occupied part are drawn.
+  // They are the same slices a whole block would draw there, so the
+  // compositing does not change.
+  glm::u64 const n{ m_numSlicesPerBlock[a] };
+  glm::mat4 world{ b.transform() };
+  glm::vec3 texOffset{ b.texOffset() };
+  glm::vec3 texScale{ b.texScale() };
+  glm::u64 first{ 0 };
+  glm::u64 last{ n - 1 };
+
+  float const lo{ b.occupiedLow()[a] };
+  float const hi{ b.occupiedHigh()[a] };
+  if (n > 1 && hi > lo) {
+    float const eps{ 1e-4f };
+    float const firstSlice{ std::ceil(lo * ( n - 1 ) - eps) };
+    float const lastSlice{ std::floor(hi * ( n - 1 ) + eps) };
+    if (lastSlice < firstSlice) {
+      // thinner than the slice spacing, and between two slices.
+      return;
+    }
+    first = static_cast<glm::u64>(firstSlice);
+    last = std::min(static_cast<glm::u64>(lastSlice), n - 1);
+
+    world[a][a] = b.worldDims()[a];
+    world[3][a] = b.origin()[a];
+    texOffset[a] -= texScale[a] * lo / ( hi - lo );
+    texScale[a] /= hi - lo;
+  }
+
+  // the world matrix only scales and translates (see Block::transform()).
+  m_sliceMvps.push_back(glm::vec3{ world[3] },
+                        { world[0][0], world[1][1], world[2][2] });
+
+  // the reversed slices are stored from the max corner down.
+  glm::u64 const firstQuad{ m_slicesReversed ? n - 1 - last : first };
+  int const verts_per_quad{ 4 };
+  m_sliceDraws.push_back(
+      { b.texture(), texOffset, texScale,
+        baseVertex.first + static_cast<int>(verts_per_quad * firstQuad),
+        static_cast<unsigned int>(last - first + 1) });
+}
+
+
 ////////////////////////////////////////////////////////////////////////////////
 std::pair<int, int>
 SlicingBlockRenderer::computeBaseVertexFromViewDir(glm::vec3 const &viewdir)
@@ -444,29 +542,13 @@ SlicingBlockRenderer::computeBaseVertexFromViewDir(glm::vec3 const &viewdir)
   }
 
   m_selectedSliceSet = newSelected;
+  m_slicesReversed = !isPos;
 
   return std::make_pair(baseVertex, elementOffset);
 
 }
 
 
-///////////////////////////////////////////////////////////////////////////////
-void
-SlicingBlockRenderer::sortBlocks()
-{
-  glm::vec3 const eye{ getCamera().getEye() };
-
-  // Sort the blocks by their distance from the camera.
-  // The origin of each block is used.
-  std::sort(m_nonEmptyBlocks->begin(), m_nonEmptyBlocks->end(),
-            [&eye](bd::Block *a, bd::Block *b) {
-              float a_dist = glm::distance(eye, a->origin());
-              float b_dist = glm::distance(eye, b->origin());
-              return a_dist > b_dist;
-            });
-}
-
-
 ///////////////////////////////////////////////////////////////////////////////
 void
 SlicingBlockRenderer::handle_ROVChangingMessage(ROVChangingMessage &r)
@@ -12,6 +12,7 @@
 #include "blockrenderer.h"
 #include "nvtools.h"
 
+#include <bd/geo/mvpbatch.h>
 #include <bd/graphics/renderer.h>
 #include <bd/graphics/shader.h>
 #include <bd/graphics/texture.h>
@@ -121,6 +122,12 @@ private:
   drawSlices(int baseVertex, int elementOffset, unsigned int numSlices) const;
 
 
+  /// \brief Queue the slices of \c b that cross its occupied part in
+  /// m_sliceDraws, and its world matrix in m_sliceMvps.
+  void
+  queueOccupiedSlices(bd::Block &b, std::pair<int, int> const &baseVertex);
+
+
   /// \brief Draw the coordinate axis.
   void
   drawAxis() const;
@@ -137,12 +144,6 @@ private:
   computeBaseVertexFromViewDir(glm::vec3 const &viewdir);
 
 
-  /// \brief Sort visible blocks by distance from the camera (for painter's algorithm)
-  /// Distance is from camera to center of each block. Order is decending.
-  void
-  sortBlocks();
-
-
   float m_tfuncScaleValue;
   /// True to draw bounding boxes.
   bool m_drawNonEmptyBoundingBoxes;
@@ -160,6 +161,8 @@ private:
   bd::Volume const &m_volume;
 
   SliceSet m_selectedSliceSet;
+  /// True if the selected slices are drawn from the max to the min corner.
+  bool m_slicesReversed;
 
   unsigned int m_sampler_state;
   /// Current shader being used (lighting, flat, wire, etc).
@@ -172,7 +175,24 @@ private:
   std::unique_ptr<bd::VertexArrayObject> m_axisVao;
   std::shared_ptr<BlockCollection> m_collection;
 
-  std::vector<bd::Block *> *m_nonEmptyBlocks;  ///< Non-empty blocks to draw.
+  /// The collection's list m_nonEmptyBlocks was copied from.
+  std::shared_ptr<BlockCollection::BlockList const> m_shownBlocks;
+  std::vector<bd::Block *> m_nonEmptyBlocks;  ///< Non-empty blocks to draw, sorted.
+  glm::i64vec3 m_sortedEyeCell;             ///< Grid cell of the eye at the last sort.
+  /// In-view flags by block index for this frame, nullptr draws all.
+  std::shared_ptr<std::vector<uint8_t> const> m_inView;
+
+  /// The slices of one block to draw this frame.
+  struct SliceDraw
+  {
+    bd::Texture const *atlas;
+    glm::vec3 texOffset;
+    glm::vec3 texScale;
+    int baseVertex;
+    unsigned int numSlices;
+  };
+  std::vector<SliceDraw> m_sliceDraws;
+  bd::MvpBatch m_sliceMvps;  ///< One per m_sliceDraws, computed together.
   std::vector<bd::Block *> *m_blocks;       ///< All the blocks!
 
 public:
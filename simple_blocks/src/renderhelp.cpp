@@ -15,6 +15,7 @@
 #include "constants.h"
 #include "renderer/slicingblockrenderer.h"
 #include "renderer/blockraycaster.h"
+#include "renderer/cpuraycaster.h"
 
 #include <bd/log/logger.h>
 #include <bd/log/gl_log.h>
@@ -43,16 +44,37 @@ s_error_callback(int error, const char *description)
 
 
 /////////////////////////////////////////////////////////////////////////////////
+/// \brief Reserve \c num buffers of \c sz bytes, they are committed by the
+/// loader as it fills them.
 void
-initializeMemoryBuffers(std::vector<char *> *buffers, size_t num, size_t sz)
+initializeMemoryBuffers(BLThreadData *tdata, size_t num, size_t sz,
+                        subvol::CommandLineOptions const &clo)
 {
-  buffers->resize(num, nullptr);
-  char *mem{ new char[num * sz] };
-
+  tdata->arena = new bd::BufferArena("cpu blocks", sz, num, clo.hugePages,
+                                     clo.numaBind);
+  tdata->buffers->resize(num, nullptr);
   for (size_t i{ 0 }; i < num; ++i) {
-    char *idx = mem + i * sz;
-    ( *buffers )[i] = idx;
+    ( *tdata->buffers )[i] = tdata->arena->buffer(i);
   }
+  bd::Info() << tdata->arena->usage();
+}
+
+
+/////////////////////////////////////////////////////////////////////////////////
+/// \brief Number of float blocks that fit in \c gpuBytes, at most the
+/// number of blocks in the index file.
+size_t
+maxGpuBlocks(bd::indexfile::v2::JsonIndexFile const &indexFile,
+             int64_t gpuBytes)
+{
+  glm::u64vec3 dims = indexFile.getVolume().block_dims();
+  uint64_t blockBytes = dims.x * dims.y * dims.z * sizeof(float);
+  if (blockBytes == 0 || gpuBytes <= 0) {
+    return 0;
+  }
+  size_t const numBlocks{ indexFile.getFileBlocks().size() };
+  size_t const fit{ static_cast<size_t>(gpuBytes) / blockBytes };
+  return fit > numBlocks ? numBlocks : fit;
 }
 } // namespace
 
@@ -117,6 +139,7 @@ initGLContext(int screenWidth, int screenHeight)
   return window;
 } // initGLContext()
 
+///////////////////////////////////////////////////////////////////////////////
 BlockLoader *
 initializeBlockLoader(bd::indexfile::v2::JsonIndexFile const &indexFile,
                       subvol::CommandLineOptions const &clo)
@@ -124,58 +147,59 @@ initializeBlockLoader(bd::indexfile::v2::JsonIndexFile const &indexFile,
   glm::u64vec3 dims = indexFile.getVolume().block_dims();
   bd::DataType type = indexFile.getDatType();
 
-  // Number of bytes on the GPU for each block (sizeof(float)).
-  uint64_t blockBytes = dims.x * dims.y * dims.z * sizeof(float);
+  // Number of bytes in main memory for each block, which is less than
+  // the gpu block bytes if blocks are quantized.
+  uint64_t cpuBlockBytes = dims.x * dims.y * dims.z *
+      bd::BlockQuantizer::bytesPerVoxel(clo.quantizeMode);
 
   BLThreadData *tdata{ new BLThreadData() };
   size_t numBlocks{ indexFile.getFileBlocks().size() };
 
   // Provided block dimensions were such that we got 0 for the block bytes,
   // so lets not allow rendering of any blocks at all.
-  if (blockBytes == 0) {
+  if (cpuBlockBytes == 0) {
     tdata->maxCpuBlocks = 0;
     tdata->maxGpuBlocks = 0;
     bd::Warn() << "Blocks have a dimension that is 0."; //, so I can't go on.";
   } else {
-    bd::Info() << "Block texture size (bytes): " << blockBytes;
+    bd::Info() << "Block cpu buffer size (bytes): " << cpuBlockBytes
+               << " (quantize: " << bd::to_string(clo.quantizeMode) << ")";
 
     // Find max cpu blocks (assert no larger than actual number of blocks).
-    tdata->maxCpuBlocks = clo.mainMemoryBytes / blockBytes;
+    tdata->maxCpuBlocks = clo.mainMemoryBytes / cpuBlockBytes;
     tdata->maxCpuBlocks = tdata->maxCpuBlocks > numBlocks
                           ? numBlocks
                           : tdata->maxCpuBlocks;
 
-    // Find max gpu blocks (assert no larger than actual number of blocks).
-    tdata->maxGpuBlocks = clo.gpuMemoryBytes / blockBytes;
-    tdata->maxGpuBlocks = tdata->maxGpuBlocks > numBlocks
-                          ? numBlocks
-                          : tdata->maxGpuBlocks;
+    // What the gpu is expected to hold, until initializeGpuTextures() knows.
+    // The batch mode draws from main memory, there is no gpu to fit.
+    tdata->maxGpuBlocks = clo.batchScriptPath.empty()
+                          ? maxGpuBlocks(indexFile, clo.gpuMemoryBytes)
+                          : tdata->maxCpuBlocks;
   } // else
 
+  tdata->numBlocks = numBlocks;
   tdata->type = type;
   tdata->slabDims[0] = indexFile.getVolume().voxelDims().x;
   tdata->slabDims[1] = indexFile.getVolume().voxelDims().y;
   tdata->filename = clo.rawFilePath;
+  tdata->quantizeMode = clo.quantizeMode;
+  tdata->quantizeErrorBound = clo.quantizeError;
+  tdata->hasEmptyValue = indexFile.hasEmptyValue();
+  tdata->emptyValue = static_cast<float>(indexFile.getEmptyValue());
 
+  // The atlas textures need a GL context, they are attached later by
+  // initializeGpuTextures().
   tdata->texs = new std::vector<bd::Texture *>();
+  tdata->atlas = nullptr;
   tdata->buffers = new std::vector<char *>();
 
   // ugh, such cringe! more global data = more ugh!
   //  g_blThreadData = *tdata;
 
   bd::Info() << "Max cpu blocks: " << tdata->maxCpuBlocks;
-  bd::Info() << "Max GPU blocks: " << tdata->maxGpuBlocks;
-
-  bd::Texture::GenTextures3d(tdata->maxGpuBlocks,
-                             bd::DataType::Float,
-                             bd::Texture::Format::R32F,
-                             bd::Texture::Format::RED,
-                             dims.x, dims.y, dims.z,
-                             tdata->texs);
 
-  bd::Info() << "Generated " << tdata->texs->size() << " textures.";
-
-  initializeMemoryBuffers(tdata->buffers, tdata->maxCpuBlocks, blockBytes);
+  initializeMemoryBuffers(tdata, tdata->maxCpuBlocks, cpuBlockBytes, clo);
   bd::Info() << "Generated " << tdata->buffers->size() << " main memory buffers.";
 
   BlockLoader *loader{ new BlockLoader(tdata, indexFile.getVolume()) };
@@ -183,6 +207,55 @@ initializeBlockLoader(bd::indexfile::v2::JsonIndexFile const &indexFile,
 }
 
 
+///////////////////////////////////////////////////////////////////////////////
+void
+initializeGpuTextures(BlockLoader *loader,
+                      bd::indexfile::v2::JsonIndexFile const &indexFile,
+                      subvol::CommandLineOptions const &clo)
+{
+  glm::u64vec3 dims = indexFile.getVolume().block_dims();
+  size_t numBlocks{ indexFile.getFileBlocks().size() };
+
+  // Number of bytes on the GPU for each block (sizeof(float)).
+  bd::Info() << "Block texture size (bytes): "
+             << dims.x * dims.y * dims.z * sizeof(float);
+
+  size_t const maxGpu{ maxGpuBlocks(indexFile, clo.gpuMemoryBytes) };
+  bd::Info() << "Max GPU blocks: " << maxGpu;
+
+  // Pack the gpu block slots into as few 3D atlas textures as the driver
+  // allows, rather than one texture per block.
+  GLint max3dTexSize{ 0 };
+  gl_check(glGetIntegerv(GL_MAX_3D_TEXTURE_SIZE, &max3dTexSize));
+  glm::u64 const maxAtlasSide{ static_cast<glm::u64>(max3dTexSize) };
+  bd::AtlasAllocator const atlas(dims,
+                                 { maxAtlasSide, maxAtlasSide, maxAtlasSide },
+                                 maxGpu,
+                                 numBlocks);
+
+  std::vector<bd::Texture *> texs;
+  for (size_t i{ 0 }; i < atlas.atlasCount(); ++i) {
+    glm::u64vec3 const atlasDims{ atlas.atlasDims(i) };
+    std::vector<bd::Texture *> atlasTex;
+    bd::Texture::GenTextures3d(1,
+                               bd::DataType::Float,
+                               bd::Texture::Format::R32F,
+                               bd::Texture::Format::RED,
+                               atlasDims.x, atlasDims.y, atlasDims.z,
+                               &atlasTex);
+    texs.push_back(atlasTex[0]);
+    bd::Info() << "Atlas " << i << ": " << atlasDims.x << "x" << atlasDims.y
+               << "x" << atlasDims.z;
+  }
+
+  bd::Info() << "Generated " << texs.size() << " atlas textures for "
+             << atlas.capacity() << " gpu blocks ("
+             << atlas.slotsPerAtlas() << " blocks per atlas).";
+
+  loader->attachGpu(texs, atlas);
+}
+
+
 /////////////////////////////////////////////////////////////////////////////////
 BlockCollection *
 initializeBlockCollection(BlockLoader *loader,
@@ -192,6 +265,7 @@ initializeBlockCollection(BlockLoader *loader,
   BlockCollection *bc{ new BlockCollection(loader, indexFile) };
   bc->setRangeMin(0);
   bc->setRangeMax(0);
+  bc->setBudgetFraction(clo.budgetFraction);
   bc->changeClassificationType(ClassificationType::Rov);
   //  g_blockCollection = std::shared_ptr<BlockCollection>(bc);
 
@@ -249,14 +323,12 @@ setRendererInitialTransferFunction(bool loaded, std::string const &name,
   if (loaded) {
 
     // The color map was loaded so, give it to the renderer.
-    renderer.setColorMapTexture(
-        ColorMapManager::getMapByName(name).getTexture());
+    renderer.setColorMap(ColorMapManager::getMapByName(name));
 
   } else {
 
-    renderer.setColorMapTexture(
-        ColorMapManager::getMapByName(
-            ColorMapManager::getCurrentMapName()).getTexture());
+    renderer.setColorMap(
+        ColorMapManager::getMapByName(ColorMapManager::getCurrentMapName()));
 
   }
 }
@@ -392,6 +464,35 @@ initializeRenderer(std::shared_ptr<BlockCollection> bc,
 }
 
 
+///////////////////////////////////////////////////////////////////////////////
+std::shared_ptr<renderer::BlockRenderer>
+initializeCpuRenderer(std::shared_ptr<BlockCollection> bc,
+                      bd::Volume const &v,
+                      subvol::CommandLineOptions const &clo)
+{
+  // the color maps are only sampled, they do not need textures.
+  ColorMapManager::setGenerateTextures(false);
+  bool loaded = initializeTransferFunctions(clo);
+
+  renderer::BlockRenderer *br =
+      new renderer::CpuRaycaster(bc, v, clo.batchThreads);
+  br->initialize();
+
+  setRendererInitialTransferFunction(loaded, "USER", *br);
+
+  br->setViewport(clo.windowWidth, clo.windowHeight);
+  br->setBackgroundColor({ 0.15, 0.15, 0.15, 0.0 });
+  br->setFov(50.0);
+  br->getCamera().setEye({ 0, 0, 4 });
+  br->getCamera().setLookAt({ 0, 0, 0 });
+  br->getCamera().setUp({ 0, 1, 0 });
+  br->setViewMatrix(br->getCamera().createViewMatrix());
+  br->setDrawNonEmptyBlocks(true);
+
+  return std::shared_ptr<renderer::BlockRenderer>(br);
+}
+
+
 ///////////////////////////////////////////////////////////////////////////////
 void
 queryGPUMemory(int64_t *total, int64_t *avail)
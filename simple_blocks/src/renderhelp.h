@@ -56,11 +56,20 @@ GLFWwindow *
 initGLContext(int screenWidth, int screenHeight);
 
 
+/// \brief Make the loader and its cpu buffers, no GL context is needed.
 BlockLoader *
 initializeBlockLoader(bd::indexfile::v2::JsonIndexFile const &indexFile,
                       subvol::CommandLineOptions const &clo);
 
 
+/// \brief Make the atlas textures for clo.gpuMemoryBytes and give them to
+/// \c loader. Needs the GL context.
+void
+initializeGpuTextures(BlockLoader *loader,
+                      bd::indexfile::v2::JsonIndexFile const &indexFile,
+                      subvol::CommandLineOptions const &clo);
+
+
 BlockCollection *
 initializeBlockCollection(BlockLoader *loader,
                           bd::indexfile::v2::JsonIndexFile const &indexFile,
@@ -102,6 +111,14 @@ initializeRenderer(std::shared_ptr<BlockCollection> bc,
                    subvol::CommandLineOptions const &clo);
 
 
+/// \brief Make a CpuRaycaster set up like initializeRenderer()'s renderer,
+/// without a GL context.
+std::shared_ptr<renderer::BlockRenderer>
+initializeCpuRenderer(std::shared_ptr<BlockCollection> bc,
+                      bd::Volume const &v,
+                      subvol::CommandLineOptions const &clo);
+
+
 /// \brief Get the total and avail memory on the gpu in bytes.
 /// If no pointer to avail is provided then just total is returned.
 void
@@ -0,0 +1,304 @@
+#include "startup.h"
+#include "renderhelp.h"
+
+#include <bd/log/logger.h>
+
+#include <algorithm>
+#include <future>
+#include <iomanip>
+
+namespace subvol
+{
+
+namespace
+{
+
+/// Width of the bars in the startup report.
+int const REPORT_BAR_WIDTH{ 40 };
+
+
+/////////////////////////////////////////////////////////////////////////////////
+// Since the IndexFileHeader contains most of the options needed to
+// render the volume, we copy those over into the CommandLineOptions struct.
+// Without an index file these options are provided via argv anyway.
+void
+updateCommandLineOptionsFromIndexFile(subvol::CommandLineOptions &clo,
+                                      bd::indexfile::v2::JsonIndexFile const &indexFile)
+{
+  bd::Dbg() << "Updating command line options from index file.";
+  auto minmaxE =
+      std::minmax_element(indexFile.getFileBlocks().begin(),
+                          indexFile.getFileBlocks().end(),
+                          [](bd::FileBlock const &lhs, bd::FileBlock const &rhs)
+                              -> bool {
+                            return lhs.rov<rhs.rov;
+                          });
+
+  if (minmaxE.first!=indexFile.getFileBlocks().end()) {
+    renderhelp::g_rovMin = ( *minmaxE.first ).rov;
+    renderhelp::g_rovMax = ( *minmaxE.second ).rov;
+  }
+
+  clo.vol_w = indexFile.getVolume().voxelDims().x;
+  clo.vol_h = indexFile.getVolume().voxelDims().y;
+  clo.vol_d = indexFile.getVolume().voxelDims().z;
+  clo.numblk_x = indexFile.getVolume().block_count().x;
+  clo.numblk_y = indexFile.getVolume().block_count().y;
+  clo.numblk_z = indexFile.getVolume().block_count().z;
+  clo.dataType = bd::to_string(indexFile.getDatType());
+}
+
+} // namespace
+
+
+///////////////////////////////////////////////////////////////////////////////
+StartupOrchestrator::StartupOrchestrator(CommandLineOptions &clo)
+    : m_clo{ clo }
+    , m_headless{ !clo.batchScriptPath.empty() }
+    , m_indexFile{ }
+    , m_window{ nullptr }
+    , m_loader{ nullptr }
+    , m_collection{ nullptr }
+    , m_renderer{ nullptr }
+    , m_gpuTotalBytes{ 0 }
+    , m_start{ std::chrono::steady_clock::now() }
+    , m_phasesMutex{ }
+    , m_phases{ }
+{
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+StartupOrchestrator::~StartupOrchestrator()
+{
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+template<class F>
+bool
+StartupOrchestrator::phase(char const *name, char const *thread, F f)
+{
+  double const start{ sinceStart() };
+  bool const ok{ f() };
+  double const end{ sinceStart() };
+
+  std::unique_lock<std::mutex> lock(m_phasesMutex);
+  m_phases.push_back({ name, thread, start, end, ok });
+  return ok;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+double
+StartupOrchestrator::sinceStart() const
+{
+  return std::chrono::duration<double, std::milli>(
+      std::chrono::steady_clock::now()-m_start).count();
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+bool
+StartupOrchestrator::run()
+{
+  m_start = std::chrono::steady_clock::now();
+
+  if (m_headless) {
+    // No window or GL context, the loader keeps the blocks in main memory.
+    bool ok{ runCpuPhases("main") };
+    subvol::printThem(m_clo);
+    return ok && phase("renderer", "main", [this]() -> bool {
+      m_renderer = renderhelp::initializeCpuRenderer(m_collection,
+                                                     m_indexFile.getVolume(),
+                                                     m_clo);
+      return m_renderer!=nullptr;
+    });
+  }
+
+  // The two sides touch disjoint parts of m_clo: the worker writes the
+  // volume options from the index file, the main thread only reads the
+  // window size. The gpu memory is clamped after both are done.
+  std::future<bool> cpu{ std::async(std::launch::async, [this]() {
+    return runCpuPhases("worker");
+  }) };
+  bool const glOk{ runGlPhases() };
+  bool const cpuOk{ cpu.get() };
+  if (!glOk || !cpuOk) {
+    return false;
+  }
+
+  if (m_clo.gpuMemoryBytes>m_gpuTotalBytes) {
+    bd::Warn() << "Requested m_gpu memory, " << m_clo.gpuMemoryBytes
+               << " greater than actual GPU memory, using " << m_gpuTotalBytes
+               << " bytes.";
+    m_clo.gpuMemoryBytes = m_gpuTotalBytes;
+  }
+  subvol::printThem(m_clo);
+
+  bool ok{ phase("atlas textures", "main", [this]() -> bool {
+    size_t const expected{ m_loader->maxGpuBlocks() };
+    renderhelp::initializeGpuTextures(m_loader, m_indexFile, m_clo);
+
+    // The first classification fit its budget to the expected gpu blocks.
+    if (m_loader->maxGpuBlocks()!=expected && m_clo.budgetFraction>0.0) {
+      m_collection->setBudgetFraction(m_clo.budgetFraction);
+    }
+    return true;
+  }) };
+
+  ok = ok && phase("renderer", "main", [this]() -> bool {
+    m_renderer =
+        renderhelp::initializeRenderer(m_collection, m_indexFile.getVolume(), m_clo);
+    return m_renderer!=nullptr;
+  });
+
+  return ok;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+bool
+StartupOrchestrator::runCpuPhases(char const *thread)
+{
+  bool ok{ phase("index file", thread, [this]() -> bool {
+    if (m_clo.indexFilePath.empty()) {
+      return true;
+    }
+    if (!m_indexFile.open(m_clo.indexFilePath)) {
+      bd::Err() << "Could not read index file " << m_clo.indexFilePath;
+      return false;
+    }
+    // there are some CL opts that can be specified in the index file, so we
+    // read those into our CommandLineOptions struct.
+    updateCommandLineOptionsFromIndexFile(m_clo, m_indexFile);
+    return true;
+  }) };
+
+  ok = ok && phase("cpu buffers, loader", thread, [this]() -> bool {
+    m_loader = renderhelp::initializeBlockLoader(m_indexFile, m_clo);
+    return m_loader!=nullptr;
+  });
+
+  // Starts the load thread and the first classification.
+  ok = ok && phase("blocks, classify", thread, [this]() -> bool {
+    m_collection.reset(
+        renderhelp::initializeBlockCollection(m_loader, m_indexFile, m_clo));
+    return m_collection!=nullptr;
+  });
+
+  return ok;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+bool
+StartupOrchestrator::runGlPhases()
+{
+  bool ok{ phase("gl context", "main", [this]() -> bool {
+    // Initialize OpenGL and GLFW.
+    m_window = renderhelp::initGLContext(m_clo.windowWidth, m_clo.windowHeight);
+    if (m_window==nullptr) {
+      bd::Err() << "Could not initialize GLFW, exiting.";
+      return false;
+    }
+    bd::Info() << "Open GL initialized.";
+    return true;
+  }) };
+
+  ok = ok && phase("gpu memory", "main", [this]() -> bool {
+    renderhelp::queryGPUMemory(&m_gpuTotalBytes);
+    bd::Info() << "GPU memory: " << ( m_gpuTotalBytes*1e-6 ) << "MB";
+    return true;
+  });
+
+  return ok;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+void
+StartupOrchestrator::printReport(std::ostream &out) const
+{
+  std::vector<Phase> phases;
+  {
+    std::unique_lock<std::mutex> lock(m_phasesMutex);
+    phases = m_phases;
+  }
+  std::sort(phases.begin(), phases.end(),
+            [](Phase const &a, Phase const &b) { return a.startMs<b.startMs; });
+
+  double total{ 0.0 };
+  for (Phase const &p : phases) {
+    total = std::max(total, p.endMs);
+  }
+
+  std::ios::fmtflags const flags{ out.flags() };
+  std::streamsize const precision{ out.precision() };
+  out << "Startup timeline (ms):\n"
+      << std::left << std::setw(22) << "  phase" << std::setw(8) << "thread"
+      << std::right << std::setw(10) << "start" << std::setw(10) << "end"
+      << std::setw(10) << "took" << "\n";
+
+  out << std::fixed << std::setprecision(1);
+  for (Phase const &p : phases) {
+    int const from{ total>0.0
+                    ? static_cast<int>(p.startMs/total*REPORT_BAR_WIDTH)
+                    : 0 };
+    int const to{ total>0.0
+                  ? static_cast<int>(p.endMs/total*REPORT_BAR_WIDTH)
+                  : 0 };
+    out << "  " << std::left << std::setw(20) << p.name << std::setw(8)
+        << p.thread << std::right << std::setw(10) << p.startMs
+        << std::setw(10) << p.endMs << std::setw(10) << p.endMs-p.startMs
+        << "  |" << std::string(from, ' ')
+        << std::string(std::max(1, to-from), '#')
+        << std::string(std::max(0, REPORT_BAR_WIDTH-std::max(to, from+1)), ' ')
+        << "|" << ( p.ok ? "" : " failed" ) << "\n";
+  }
+  out << "  total " << total << " ms" << std::endl;
+  out.flags(flags);
+  out.precision(precision);
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+GLFWwindow *
+StartupOrchestrator::window() const
+{
+  return m_window;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+BlockLoader *
+StartupOrchestrator::loader() const
+{
+  return m_loader;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+std::shared_ptr<BlockCollection>
+StartupOrchestrator::collection() const
+{
+  return m_collection;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+std::shared_ptr<renderer::BlockRenderer>
+StartupOrchestrator::renderer() const
+{
+  return m_renderer;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+bd::indexfile::v2::JsonIndexFile const &
+StartupOrchestrator::indexFile() const
+{
+  return m_indexFile;
+}
+
+} // namespace subvol
@@ -0,0 +1,134 @@
+#ifndef SUBVOL_STARTUP_H
+#define SUBVOL_STARTUP_H
+
+#include <GLFW/glfw3.h>
+
+#include "cmdline.h"
+#include "io/blockloader.h"
+#include "io/blockcollection.h"
+#include "renderer/blockrenderer.h"
+
+#include <bd/io/indexfile/v2/jsonindexfile.h>
+
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace subvol
+{
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief Runs the startup phases of simple_blocks, overlapping the ones
+/// that do not need a GL context with the ones that do.
+///
+/// A worker thread parses the index file, makes the loader and its cpu
+/// buffers and then the blocks. Making the blocks starts the loader and the
+/// first classification, so blocks stream into main memory while the main
+/// thread (GLFW must be used from it) makes the window and GL context and
+/// queries the gpu memory. Once both are done the atlas textures are made
+/// and handed to the loader, which queues the blocks it has read for upload,
+/// and then the renderer is made.
+///
+/// In batch mode (CommandLineOptions::batchScriptPath set) there is no window
+/// or GL context: only the cpu phases run, the loader keeps blocks in main
+/// memory and the renderer is a CpuRaycaster.
+///
+/// Each phase is timed, printReport() prints the timeline.
+///////////////////////////////////////////////////////////////////////////////
+class StartupOrchestrator
+{
+public:
+  explicit StartupOrchestrator(CommandLineOptions &clo);
+
+
+  ~StartupOrchestrator();
+
+
+  /// \brief Run every phase.
+  /// \return false if a phase failed (the reason has been logged).
+  bool
+  run();
+
+
+  /// \brief Print when each phase started and ended, and on which thread.
+  void
+  printReport(std::ostream &out) const;
+
+
+  GLFWwindow *
+  window() const;
+
+
+  BlockLoader *
+  loader() const;
+
+
+  std::shared_ptr<BlockCollection>
+  collection() const;
+
+
+  std::shared_ptr<renderer::BlockRenderer>
+  renderer() const;
+
+
+  bd::indexfile::v2::JsonIndexFile const &
+  indexFile() const;
+
+
+private:
+  struct Phase
+  {
+    std::string name;
+    std::string thread;
+    double startMs;   ///< Since the start of run().
+    double endMs;
+    bool ok;
+  };
+
+
+  /// \brief Run \c f, a phase named \c name, and record its times.
+  template<class F>
+  bool
+  phase(char const *name, char const *thread, F f);
+
+
+  /// \brief Index file, cpu buffers and loader, blocks (worker thread, or
+  /// the main thread in batch mode).
+  bool
+  runCpuPhases(char const *thread);
+
+
+  /// \brief Window, GL context and gpu memory query (main thread).
+  bool
+  runGlPhases();
+
+
+  double
+  sinceStart() const;
+
+
+  CommandLineOptions &m_clo;
+  bool const m_headless;
+  bd::indexfile::v2::JsonIndexFile m_indexFile;
+
+  GLFWwindow *m_window;
+  BlockLoader *m_loader;
+  std::shared_ptr<BlockCollection> m_collection;
+  std::shared_ptr<renderer::BlockRenderer> m_renderer;
+
+  /// Gpu memory reported by the driver.
+  int64_t m_gpuTotalBytes;
+
+  std::chrono::steady_clock::time_point m_start;
+
+  mutable std::mutex m_phasesMutex;
+  std::vector<Phase> m_phases;
+
+}; // class StartupOrchestrator
+
+} // namespace subvol
+
+#endif // ! SUBVOL_STARTUP_H
@@ -0,0 +1,131 @@
+#include <batch.h>
+
+#include <catch.hpp>
+
+#include <sstream>
+#include <string>
+
+namespace
+{
+
+using subvol::BatchFrame;
+using subvol::BatchScript;
+
+BatchFrame
+initialFrame()
+{
+  BatchFrame f;
+  f.eye = { 0.0f, 0.0f, 4.0f };
+  f.lookAt = { 0.0f, 0.0f, 0.0f };
+  f.up = { 0.0f, 1.0f, 0.0f };
+  f.rovMin = 0.0;
+  f.rovMax = 1.0;
+  f.scale = 1.0f;
+  f.width = 640;
+  f.height = 480;
+  f.background = { 0.0f, 0.0f, 0.0f, 1.0f };
+  return f;
+}
+
+
+bool
+parse(BatchScript &script, std::string const &text)
+{
+  std::istringstream in{ text };
+  return script.parse(in, initialFrame());
+}
+
+
+bool
+near(glm::vec3 const &a, glm::vec3 const &b)
+{
+  return glm::length(a - b) < 1e-4f;
+}
+
+} // namespace
+
+
+TEST_CASE("BatchScript settings apply to the views after them", "[batch]")
+{
+  BatchScript script;
+  REQUIRE(parse(script,
+                "# two views\n"
+                "render first\n"
+                "\n"
+                "size 100 50   # smaller\n"
+                "rov 0.25 0.5\n"
+                "colormap RAINBOW\n"
+                "scale 2\n"
+                "eye 1 2 3\n"
+                "lookat 0 1 0\n"
+                "background 1 1 1\n"
+                "render\n"));
+
+  std::vector<BatchFrame> const &f{ script.frames() };
+  REQUIRE(f.size() == 2);
+
+  REQUIRE(f[0].name == "first");
+  REQUIRE(f[0].width == 640);
+  REQUIRE(f[0].rovMax == 1.0);
+  REQUIRE(f[0].colorMap.empty());
+  REQUIRE(near(f[0].eye, { 0.0f, 0.0f, 4.0f }));
+
+  REQUIRE(f[1].name == "frame_0001");
+  REQUIRE(f[1].width == 100);
+  REQUIRE(f[1].height == 50);
+  REQUIRE(f[1].rovMin == 0.25);
+  REQUIRE(f[1].rovMax == 0.5);
+  REQUIRE(f[1].colorMap == "RAINBOW");
+  REQUIRE(f[1].scale == 2.0f);
+  REQUIRE(near(f[1].eye, { 1.0f, 2.0f, 3.0f }));
+  REQUIRE(near(f[1].lookAt, { 0.0f, 1.0f, 0.0f }));
+  REQUIRE(f[1].background.r == 1.0f);
+}
+
+
+TEST_CASE("BatchScript orbit and fly make camera paths", "[batch]")
+{
+  BatchScript script;
+  REQUIRE(parse(script,
+                "orbit 4 360\n"
+                "orbit 2 180 1 0 0\n"
+                "fly 2 0 0 -2\n"));
+
+  std::vector<BatchFrame> const &f{ script.frames() };
+  REQUIRE(f.size() == 8);
+
+  // a quarter turn about y at a time, ending where it started.
+  REQUIRE(near(f[0].eye, { 4.0f, 0.0f, 0.0f }));
+  REQUIRE(near(f[1].eye, { 0.0f, 0.0f, -4.0f }));
+  REQUIRE(near(f[3].eye, { 0.0f, 0.0f, 4.0f }));
+  REQUIRE(near(f[3].up, { 0.0f, 1.0f, 0.0f }));
+
+  // over the top about x, the up vector turns with the eye.
+  REQUIRE(near(f[4].eye, { 0.0f, -4.0f, 0.0f }));
+  REQUIRE(near(f[5].eye, { 0.0f, 0.0f, -4.0f }));
+  REQUIRE(near(f[5].up, { 0.0f, -1.0f, 0.0f }));
+
+  // straight on from there.
+  REQUIRE(near(f[6].eye, { 0.0f, 0.0f, -3.0f }));
+  REQUIRE(near(f[7].eye, { 0.0f, 0.0f, -2.0f }));
+  REQUIRE(f[7].name == "frame_0007");
+}
+
+
+TEST_CASE("BatchScript rejects bad lines", "[batch]")
+{
+  BatchScript script;
+  REQUIRE(parse(script, "render\n"));
+  REQUIRE(script.frames().size() == 1);
+
+  for (char const *bad : { "zoom 2\n", "size 0 10\n", "rov 0.5 0.25\n",
+                           "eye 1 2\n", "eye 1 2 3 4\n", "orbit 0 90\n",
+                           "orbit 4 90 0 0 0\n", "fly 2 1 2\n",
+                           "render a b\n", "scale -1\n" }) {
+    INFO(bad);
+    REQUIRE_FALSE(parse(script, "render\n" + std::string(bad) + "render\n"));
+    REQUIRE(script.frames().empty());
+  }
+
+  REQUIRE_FALSE(script.open("no_such_script.txt", initialFrame()));
+}
@@ -2,8 +2,726 @@
 // Created by jim on 2/12/17.
 //
 
-#include <blockloader.h>
+#include <io/blockloader.h>
+#include <messages/messagebroker.h>
+
+#include "testblocks.h"
+
+#include <bd/datastructure/residencytable.h>
+#include <bd/graphics/texture.h>
+#include <bd/util/util.h>
+#include <bd/volume/block.h>
+#include <bd/volume/blockstore.h>
 
 #include <catch.hpp>
 
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <future>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <sstream>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace
+{
+
+using testblocks::makeBlocks;
+using BlockMap = std::unordered_map<uint64_t, bd::Block *>;
+using BlockTable = bd::ResidencyTable<bd::Block *>;
+
+// 96^3 blocks
+size_t const NUM_BLOCKS{ 884736 };
+int const BENCH_ITERS{ 10 };
+
+
+bool
+isResident(BlockMap const &m, uint64_t idx)
+{
+  return m.find(idx) != m.end();
+}
+
+
+bool
+isResident(BlockTable const &t, uint64_t idx)
+{
+  return t.contains(idx);
+}
+
+
+/// \brief The lookup and scan work done by BlockLoader::queueClassified(),
+/// parameterized on the residency container so the old map-based layout can
+/// be timed against the residency table.
+template<class Residency>
+size_t
+classifyPass(std::vector<bd::Block *> const &visible,
+             Residency const &main,
+             Residency const &gpu,
+             std::vector<bd::Block *> &loadQueue)
+{
+  loadQueue.clear();
+  size_t gpuReady{ 0 };
+  for (bd::Block *b : visible) {
+    if (!isResident(main, b->index())) {
+      loadQueue.push_back(b);
+    } else if (!isResident(gpu, b->index())) {
+      ++gpuReady;
+    }
+  }
+
+  // the classification also scanned every gpu resident block for hidden
+  // ones.
+  size_t emptyOnGpu{ 0 };
+  for (auto const &e : gpu) {
+    emptyOnGpu += e.second->empty() ? 1 : 0;
+  }
+
+  return gpuReady + emptyOnGpu;
+}
+
+
+template<>
+size_t
+classifyPass<BlockTable>(std::vector<bd::Block *> const &visible,
+                         BlockTable const &main,
+                         BlockTable const &gpu,
+                         std::vector<bd::Block *> &loadQueue)
+{
+  loadQueue.clear();
+  size_t gpuReady{ 0 };
+  for (bd::Block *b : visible) {
+    if (!isResident(main, b->index())) {
+      loadQueue.push_back(b);
+    } else if (!isResident(gpu, b->index())) {
+      ++gpuReady;
+    }
+  }
+
+  size_t emptyOnGpu{ 0 };
+  for (bd::Block *b : gpu.values()) {
+    emptyOnGpu += b->empty() ? 1 : 0;
+  }
+
+  return gpuReady + emptyOnGpu;
+}
+
+
+template<class F>
+double
+timeMillis(F f)
+{
+  auto start = std::chrono::high_resolution_clock::now();
+  for (int i{ 0 }; i < BENCH_ITERS; ++i) {
+    f();
+  }
+  auto end = std::chrono::high_resolution_clock::now();
+  return std::chrono::duration<double, std::milli>(end - start).count()
+      / BENCH_ITERS;
+}
+
+
+/// \brief Volume data in memory that calls \c onRead before read number
+/// \c hookAt (counting from 0), to act in the middle of a load.
+class HookedBuf : public std::stringbuf
+{
+public:
+  explicit HookedBuf(std::string const &data)
+      : std::stringbuf{ data, std::ios::in }
+      , hookAt{ std::numeric_limits<size_t>::max() }
+      , onRead{ }
+      , m_reads{ 0 }
+  {
+  }
+
+
+  size_t hookAt;
+  std::function<void()> onRead;
+
+
+protected:
+  std::streamsize
+  xsgetn(char *s, std::streamsize n) override
+  {
+    if (m_reads++ == hookAt && onRead) {
+      onRead();
+    }
+    return std::stringbuf::xsgetn(s, n);
+  }
+
+
+private:
+  size_t m_reads;
+};
+
+
+/// \brief A BlockLoader over a 4^3 volume of 2^3 blocks read from memory,
+/// with a cpu buffer and a gpu slot for every block. All blocks start
+/// hidden.
+struct SmallLoader
+{
+  static size_t const NUM{ 8 };
+
+  SmallLoader()
+      : fbs{ }
+      , store{ nullptr }
+      , data{ std::string(4 * 4 * 4, '\x01') }
+      , in{ &data }
+      , storage(NUM, std::vector<char>(2 * 2 * 2 * sizeof(float)))
+      , buffs{ }
+      , tex{ bd::Texture::Target::Tex3D }
+      , texs{ &tex }
+      , atlas{ { 2, 2, 2 }, { 1024, 1024, 1024 }, NUM, NUM }
+      , tdata{ }
+      , vol{ }
+      , loader{ nullptr }
+      , thread{ }
+  {
+    for (uint64_t i{ 0 }; i < NUM; ++i) {
+      bd::FileBlock fb;
+      fb.block_index = i;
+      fb.ijk_index[0] = i % 2;
+      fb.ijk_index[1] = ( i / 2 ) % 2;
+      fb.ijk_index[2] = i / 4;
+      fb.data_offset = bd::to1D(2 * fb.ijk_index[0], 2 * fb.ijk_index[1],
+                                2 * fb.ijk_index[2], 4, 4);
+      for (int a{ 0 }; a < 3; ++a) {
+        fb.voxel_dims[a] = 2;
+        fb.world_dims[a] = 0.5;
+      }
+      fbs.push_back(fb);
+    }
+    store.reset(new bd::BlockStore{ fbs });
+    for (size_t i{ 0 }; i < NUM; ++i) {
+      block(i)->empty(true);
+      buffs.push_back(storage[i].data());
+    }
+
+    tdata.numBlocks = NUM;
+    tdata.maxCpuBlocks = NUM;
+    tdata.maxGpuBlocks = NUM;
+    tdata.slabDims[0] = 4;
+    tdata.slabDims[1] = 4;
+    tdata.stream = &in;
+    tdata.texs = &texs;
+    tdata.atlas = &atlas;
+    tdata.buffers = &buffs;
+    loader.reset(new subvol::BlockLoader{ &tdata, vol });
+  }
+
+
+  ~SmallLoader()
+  {
+    stop();
+  }
+
+
+  bd::Block *
+  block(size_t i)
+  {
+    return store->block(i);
+  }
+
+
+  /// \brief Show the blocks in \c shown and hide the rest, and list them.
+  void
+  classify(std::vector<size_t> const &shown,
+           std::vector<bd::Block *> &visible,
+           std::vector<bd::Block *> &empty)
+  {
+    visible.clear();
+    empty.clear();
+    for (size_t i{ 0 }; i < NUM; ++i) {
+      bool const isShown{
+          std::find(shown.begin(), shown.end(), i) != shown.end() };
+      block(i)->empty(!isShown);
+      ( isShown ? visible : empty ).push_back(block(i));
+    }
+  }
+
+
+  void
+  start()
+  {
+    // the load thread posts its stats through the broker, so it has to be up.
+    static bool const brokerStarted{ ( subvol::Broker::start(), true ) };
+    (void)brokerStarted;
+
+    thread = std::async(std::launch::async,
+                        [this]() -> int { return ( *loader )(); });
+  }
+
+
+  void
+  stop()
+  {
+    if (thread.valid()) {
+      loader->stop();
+      thread.wait();
+    }
+  }
+
+
+  std::vector<bd::FileBlock> fbs;
+  std::unique_ptr<bd::BlockStore> store;
+  HookedBuf data;
+  std::istream in;
+  std::vector<std::vector<char>> storage;
+  std::vector<char *> buffs;
+  bd::Texture tex;
+  std::vector<bd::Texture *> texs;
+  bd::AtlasAllocator atlas;
+  subvol::BLThreadData tdata;
+  bd::Volume vol;
+  std::unique_ptr<subvol::BlockLoader> loader;
+  std::future<int> thread;
+};
+
+
+/// \brief Poll \c done for up to a few seconds.
+template<class F>
+bool
+waitFor(F done)
+{
+  auto const end = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+  while (!done()) {
+    if (std::chrono::steady_clock::now() > end) {
+      return false;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  return true;
+}
+
+} // namespace
+
+
+TEST_CASE("fillBlockData reads only the occupied part of a block",
+          "[blockloader][occupied]")
+{
+  // 8x6x4 volume of 4x3x2 blocks, each voxel holds x + 10y + 50z.
+  uint64_t const ve[2]{ 8, 6 };
+  std::string raw;
+  for (uint8_t z{ 0 }; z < 4; ++z) {
+    for (uint8_t y{ 0 }; y < 6; ++y) {
+      for (uint8_t x{ 0 }; x < 8; ++x) {
+        raw.push_back(static_cast<char>(x + 10 * y + 50 * z));
+      }
+    }
+  }
+  std::istringstream is{ raw };
+
+  uint64_t const be[3]{ 4, 3, 2 };
+  uint64_t const ijk[3]{ 1, 1, 1 };
+  uint64_t const offset{ bd::to1D(4, 3, 2, ve[0], ve[1]) };
+  subvol::BlockReaderSpec<uint8_t> reader;
+
+  SECTION("whole block")
+  {
+    uint64_t const lo[3]{ 0, 0, 0 };
+    std::vector<float> buf(4 * 3 * 2);
+    REQUIRE(reader.fillBlockData(reinterpret_cast<char *>(buf.data()), &is,
+                                 offset, be, ijk, lo, be, ve, 0.0, 1.0));
+    REQUIRE(buf[0] == 4 + 30 + 100);
+    // first voxel of the second slab of the block.
+    REQUIRE(buf[12] == 4 + 30 + 150);
+    REQUIRE(buf[23] == 7 + 50 + 150);
+  }
+
+  SECTION("sub-box")
+  {
+    uint64_t const lo[3]{ 1, 0, 1 };
+    uint64_t const ext[3]{ 2, 3, 1 };
+    std::vector<float> buf(2 * 3 * 1);
+    REQUIRE(reader.fillBlockData(reinterpret_cast<char *>(buf.data()), &is,
+                                 offset, be, ijk, lo, ext, ve, 0.0, 1.0));
+    for (uint64_t y{ 0 }; y < 3; ++y) {
+      for (uint64_t x{ 0 }; x < 2; ++x) {
+        REQUIRE(buf[x + 2 * y] == ( 5 + x ) + 10 * ( 3 + y ) + 50 * 3);
+      }
+    }
+  }
+}
+
+
+TEST_CASE("fillBlockData reads kd blocks larger than the first one",
+          "[blockloader][kd]")
+{
+  // 16x2x1 volume, voxel value is x + 16y.
+  uint64_t const ve[2]{ 16, 2 };
+  std::string raw;
+  for (uint8_t i{ 0 }; i < 16 * 2; ++i) {
+    raw.push_back(static_cast<char>(i));
+  }
+  std::istringstream is{ raw };
+  subvol::BlockReaderSpec<uint8_t> reader;
+  uint64_t const lo[3]{ 0, 0, 0 };
+
+  // a 2x1x1 block, then the whole 16x2x1 volume as one block.
+  uint64_t const small[3]{ 2, 1, 1 };
+  uint64_t const smallIjk[3]{ 0, 0, 0 };
+  std::vector<float> buf(2);
+  REQUIRE(reader.fillBlockData(reinterpret_cast<char *>(buf.data()), &is,
+                               3, small, smallIjk, lo, small, ve, 0.0, 1.0));
+  REQUIRE(buf[1] == 4);
+
+  uint64_t const big[3]{ 16, 2, 1 };
+  uint64_t const bigIjk[3]{ 1, 0, 0 };
+  buf.assign(16 * 2, -1.0f);
+  REQUIRE(reader.fillBlockData(reinterpret_cast<char *>(buf.data()), &is,
+                               0, big, bigIjk, lo, big, ve, 0.0, 1.0));
+  for (size_t i{ 0 }; i < buf.size(); ++i) {
+    REQUIRE(buf[i] == i);
+  }
+}
+
+
+TEST_CASE("fillBlockData skips empty sub-bricks", "[blockloader][occupied]")
+{
+  // One 16x4x2 block of 4^3 bricks (4x1x1 bricks), voxel value is x.
+  uint64_t const ve[2]{ 16, 4 };
+  std::string raw;
+  for (uint8_t i{ 0 }; i < 16 * 4 * 2; ++i) {
+    raw.push_back(static_cast<char>(i % 16));
+  }
+  std::istringstream is{ raw };
+
+  uint64_t const be[3]{ 16, 4, 2 };
+  uint64_t const ijk[3]{ 0, 0, 0 };
+  uint64_t const lo[3]{ 0, 0, 0 };
+  subvol::BlockReaderSpec<uint8_t> reader;
+
+  bd::OccupancyMask mask{ { 16, 4, 2 }, 4 };
+  mask.occupied({ 1, 0, 0 }, false);
+  mask.occupied({ 2, 0, 0 }, false);
+
+  std::atomic<uint64_t> const gen{ 0 };
+  subvol::LoadTicket ticket{ &gen, nullptr, true };
+  std::vector<float> buf(16 * 4 * 2);
+  REQUIRE(reader.fillBlockData(reinterpret_cast<char *>(buf.data()), &is,
+                               0, be, ijk, lo, be, ve, 0.0, 1.0, &ticket,
+                               &mask, -1.0f));
+
+  // half of each row is read.
+  REQUIRE(ticket.bytesRead == 16 * 4 * 2 / 2);
+  for (uint64_t r{ 0 }; r < 4 * 2; ++r) {
+    for (uint64_t x{ 0 }; x < 16; ++x) {
+      float const expected{ x >= 4 && x < 12 ? -1.0f : static_cast<float>(x) };
+      REQUIRE(buf[x + 16 * r] == expected);
+    }
+  }
+}
+
+
+TEST_CASE("BlockLoader cancels the load of a block hidden mid-read",
+          "[blockloader][cancel]")
+{
+  SmallLoader t;
+  std::vector<bd::Block *> visible;
+  std::vector<bd::Block *> empty;
+  t.classify({ 5 }, visible, empty);
+
+  // 2 rows of 2 slabs per block, hide the block while its second row is
+  // read as the classifier would (flag first, then the generation).
+  t.data.hookAt = 1;
+  t.data.onRead = [&t]() {
+    t.block(5)->empty(true);
+    t.loader->classificationChanged();
+  };
+  t.loader->queueClassified(visible, empty);
+  t.start();
+
+  REQUIRE(waitFor([&t]() { return t.loader->wastedBytes() > 0; }));
+  t.stop();
+
+  REQUIRE_FALSE(t.loader->isInMain(5));
+  REQUIRE(t.block(5)->pixelData() == nullptr);
+  REQUIRE(t.loader->freeBuffers() == size_t{ SmallLoader::NUM });
+  REQUIRE(t.loader->getNextGpuReadyBlock() == nullptr);
+}
+
+
+TEST_CASE("queueDelta leaves the loader as queueClassified does",
+          "[blockloader][delta]")
+{
+  SmallLoader full;
+  SmallLoader delta;
+  std::vector<bd::Block *> visible;
+  std::vector<bd::Block *> empty;
+
+  // load blocks 0-3 in both, they get slots and wait for upload.
+  for (SmallLoader *t : { &full, &delta }) {
+    t->classify({ 0, 1, 2, 3 }, visible, empty);
+    t->loader->queueClassified(visible, empty);
+    t->start();
+    REQUIRE(waitFor([t]() {
+      for (size_t i{ 0 }; i < 4; ++i) {
+        if (!t->loader->isInMain(i)) {
+          return false;
+        }
+      }
+      return true;
+    }));
+    t->stop();
+  }
+
+  // hide 2 and 3, show 4 and 5.
+  full.classify({ 0, 1, 4, 5 }, visible, empty);
+  full.loader->queueClassified(visible, empty);
+  delta.classify({ 0, 1, 4, 5 }, visible, empty);
+  delta.loader->queueDelta({ delta.block(4), delta.block(5) },
+                           { delta.block(2), delta.block(3) });
+
+  for (size_t i{ 0 }; i < SmallLoader::NUM; ++i) {
+    INFO("block " << i);
+    REQUIRE(full.loader->isQueued(i) == delta.loader->isQueued(i));
+    REQUIRE(full.loader->isInMain(i) == delta.loader->isInMain(i));
+    REQUIRE(full.loader->isReleasePending(i)
+                == delta.loader->isReleasePending(i));
+    REQUIRE(full.loader->isEvictable(i) == delta.loader->isEvictable(i));
+  }
+
+  for (SmallLoader *t : { &full, &delta }) {
+    REQUIRE(t->loader->isQueued(4));
+    REQUIRE(t->loader->isQueued(5));
+
+    // the hidden blocks may still be uploaded from their buffers, so they
+    // keep them until their slots are released.
+    for (size_t i : { 2, 3 }) {
+      REQUIRE(t->loader->isReleasePending(i));
+      REQUIRE_FALSE(t->loader->isEvictable(i));
+      REQUIRE(t->block(i)->texture() != nullptr);
+    }
+  }
+
+  SECTION("releaseHiddenBlocks() frees the hidden blocks' slots")
+  {
+    for (SmallLoader *t : { &full, &delta }) {
+      t->loader->releaseHiddenBlocks();
+
+      std::vector<uint64_t> uploads;
+      while (bd::Block *b = t->loader->getNextGpuReadyBlock()) {
+        uploads.push_back(b->index());
+        t->loader->pushGpuResidentBlock(b);
+      }
+      std::sort(uploads.begin(), uploads.end());
+      REQUIRE(uploads == std::vector<uint64_t>({ 0, 1 }));
+
+      for (size_t i : { 2, 3 }) {
+        REQUIRE_FALSE(t->loader->isReleasePending(i));
+        REQUIRE(t->loader->isEvictable(i));
+        REQUIRE(t->block(i)->texture() == nullptr);
+      }
+    }
+  }
+}
+
+
+TEST_CASE("queueClassified residency lookups at 884k blocks",
+          "[.][bench][blockloader]")
+{
+  std::vector<bd::Block> blocks{ makeBlocks(NUM_BLOCKS) };
+
+  std::vector<bd::Block *> visible;
+  std::vector<bd::Block *> empty;
+  for (bd::Block &b : blocks) {
+    b.empty(b.fileBlock().rov < 0.5);
+    if (b.empty()) {
+      empty.push_back(&b);
+    } else {
+      visible.push_back(&b);
+    }
+  }
+
+  // Every 4th block is in main memory, every 8th is also on the gpu.
+  BlockMap mainMap;
+  BlockMap gpuMap;
+  BlockTable mainTable{ NUM_BLOCKS };
+  BlockTable gpuTable{ NUM_BLOCKS };
+  for (size_t i{ 0 }; i < NUM_BLOCKS; i += 4) {
+    mainMap.insert(std::make_pair(i, &blocks[i]));
+    mainTable.insert(i, &blocks[i]);
+    if (i % 8 == 0) {
+      gpuMap.insert(std::make_pair(i, &blocks[i]));
+      gpuTable.insert(i, &blocks[i]);
+    }
+  }
+
+  std::vector<bd::Block *> lqMap;
+  std::vector<bd::Block *> lqTable;
+  lqMap.reserve(NUM_BLOCKS);
+  lqTable.reserve(NUM_BLOCKS);
+
+  size_t resMap{ 0 };
+  size_t resTable{ 0 };
+  double const msMap{ timeMillis([&]() {
+    resMap = classifyPass(visible, mainMap, gpuMap, lqMap);
+  }) };
+  double const msTable{ timeMillis([&]() {
+    resTable = classifyPass(visible, mainTable, gpuTable, lqTable);
+  }) };
+
+  REQUIRE(resMap == resTable);
+  REQUIRE(lqMap.size() == lqTable.size());
+
+  // The loader itself, with an empty cache (everything visible is queued).
+  subvol::BLThreadData tdata;
+  std::vector<bd::Texture *> texs;
+  std::vector<char *> buffs;
+  tdata.numBlocks = NUM_BLOCKS;
+  tdata.maxCpuBlocks = 0;
+  tdata.maxGpuBlocks = 0;
+  tdata.texs = &texs;
+  tdata.buffers = &buffs;
+  bd::Volume vol;
+  subvol::BlockLoader loader{ &tdata, vol };
+  double const msLoader{ timeMillis([&]() {
+    loader.queueClassified(visible, empty);
+  }) };
+
+  std::cout << "queueClassified lookups, " << NUM_BLOCKS << " blocks, "
+            << visible.size() << " visible:\n"
+            << "  unordered_map:   " << msMap << " ms\n"
+            << "  ResidencyTable:  " << msTable << " ms\n"
+            << "  BlockLoader::queueClassified (cold cache): "
+            << msLoader << " ms" << std::endl;
+}
+
+
+TEST_CASE("queueClassified re-prioritizes incrementally",
+          "[.][bench][blockloader]")
+{
+  std::vector<bd::Block> blocks{ makeBlocks(NUM_BLOCKS) };
+
+  std::vector<bd::Block *> visible;
+  std::vector<bd::Block *> empty;
+  for (bd::Block &b : blocks) {
+    // ~100k queued blocks
+    b.empty(b.fileBlock().rov < 0.885);
+    if (b.empty()) {
+      empty.push_back(&b);
+    } else {
+      visible.push_back(&b);
+    }
+  }
+
+  subvol::BLThreadData tdata;
+  std::vector<bd::Texture *> texs;
+  std::vector<char *> buffs;
+  // enough gpu slots that nothing is trimmed from the queue.
+  bd::AtlasAllocator atlas{ { 1, 1, 1 }, { 1024, 1024, 1024 },
+                            NUM_BLOCKS, NUM_BLOCKS };
+  tdata.numBlocks = NUM_BLOCKS;
+  tdata.texs = &texs;
+  tdata.atlas = &atlas;
+  tdata.buffers = &buffs;
+  bd::Volume vol;
+  subvol::BlockLoader loader{ &tdata, vol };
+
+  auto once = [](std::function<void()> f) -> double {
+    auto start = std::chrono::high_resolution_clock::now();
+    f();
+    auto end = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count();
+  };
+
+  double const msFirst{ once([&]() {
+    loader.queueClassified(visible, empty);
+  }) };
+  double const msAgain{ once([&]() {
+    loader.queueClassified(visible, empty);
+  }) };
+  double const msView{ once([&]() {
+    loader.updateView({ 0, 0, 10 }, { 0, 0, 0 });
+  }) };
+  double const msAfterView{ once([&]() {
+    loader.queueClassified(visible, empty);
+  }) };
+
+  std::cout << "Load queue with " << visible.size() << " blocks:\n"
+            << "  first queueClassified:       " << msFirst << " ms\n"
+            << "  unchanged queueClassified:   " << msAgain << " ms\n"
+            << "  updateView:                  " << msView << " ms\n"
+            << "  queueClassified after view:  " << msAfterView << " ms"
+            << std::endl;
+}
+
+
+TEST_CASE("queueDelta vs queueClassified on small range changes",
+          "[.][bench][blockloader]")
+{
+  int const STEPS{ 20 };
+  double const STEP{ 0.001 };
+  double const START{ 0.885 };
+
+  std::vector<bd::Block> blocks{ makeBlocks(NUM_BLOCKS) };
+
+  bd::AtlasAllocator atlas{ { 1, 1, 1 }, { 1024, 1024, 1024 },
+                            NUM_BLOCKS, NUM_BLOCKS };
+  std::vector<bd::Texture *> texs;
+  std::vector<char *> buffs;
+  subvol::BLThreadData tdata;
+  tdata.numBlocks = NUM_BLOCKS;
+  tdata.texs = &texs;
+  tdata.atlas = &atlas;
+  tdata.buffers = &buffs;
+  bd::Volume vol;
+  subvol::BlockLoader full{ &tdata, vol };
+  subvol::BlockLoader delta{ &tdata, vol };
+
+  auto classify = [&blocks](double low,
+                            std::vector<bd::Block *> &visible,
+                            std::vector<bd::Block *> &empty) {
+    visible.clear();
+    empty.clear();
+    for (bd::Block &b : blocks) {
+      b.empty(b.fileBlock().rov < low);
+      ( b.empty() ? empty : visible ).push_back(&b);
+    }
+  };
+
+  std::vector<bd::Block *> visible;
+  std::vector<bd::Block *> empty;
+  classify(START, visible, empty);
+  full.queueClassified(visible, empty);
+  delta.queueClassified(visible, empty);
+
+  // lower the min threshold a step at a time, ~900 blocks become visible
+  // per step. Only the loader calls are timed.
+  double msFull{ 0 };
+  double msDelta{ 0 };
+  size_t numAdded{ 0 };
+  for (int i{ 1 }; i <= STEPS; ++i) {
+    double const low{ START - i * STEP };
+    double const prev{ low + STEP };
+    classify(low, visible, empty);
+
+    std::vector<bd::Block *> added;
+    for (bd::Block &b : blocks) {
+      double const rov{ b.fileBlock().rov };
+      if (rov >= low && rov < prev) {
+        added.push_back(&b);
+      }
+    }
+    numAdded += added.size();
+
+    auto start = std::chrono::high_resolution_clock::now();
+    full.queueClassified(visible, empty);
+    auto mid = std::chrono::high_resolution_clock::now();
+    delta.queueDelta(added, { });
+    auto end = std::chrono::high_resolution_clock::now();
+
+    msFull += std::chrono::duration<double, std::milli>(mid - start).count();
+    msDelta += std::chrono::duration<double, std::milli>(end - mid).count();
+  }
+
+  REQUIRE(numAdded > 0);
 
+  std::cout << "Small range changes, " << visible.size() << " visible, "
+            << numAdded / STEPS << " added per step:\n"
+            << "  queueClassified: " << msFull / STEPS << " ms\n"
+            << "  queueDelta:      " << msDelta / STEPS << " ms" << std::endl;
+}
@@ -0,0 +1,288 @@
+#include <io/blockrangeindex.h>
+
+#include "testblocks.h"
+
+#include <bd/volume/block.h>
+
+#include <catch.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <numeric>
+#include <vector>
+
+using subvol::BlockRangeIndex;
+using subvol::ShownBlocks;
+using testblocks::makeBlocks;
+using testblocks::pointers;
+
+namespace
+{
+
+std::vector<uint64_t>
+indexes(BlockRangeIndex const &index, BlockRangeIndex::Span const &s)
+{
+  std::vector<uint64_t> idx;
+  index.forEach(s, [&idx](bd::Block *b) { idx.push_back(b->index()); });
+  std::sort(idx.begin(), idx.end());
+  return idx;
+}
+
+
+std::vector<uint64_t>
+scan(std::vector<bd::Block *> const &blocks, double low, double high)
+{
+  std::vector<uint64_t> idx;
+  for (bd::Block *b : blocks) {
+    double const rov{ b->fileBlock().rov };
+    if (rov>=low && rov<=high) {
+      idx.push_back(b->index());
+    }
+  }
+  return idx;
+}
+
+
+double
+rovKey(bd::Block const &b)
+{
+  return b.fileBlock().rov;
+}
+
+} // namespace
+
+
+TEST_CASE("find() matches a linear scan", "[rangeindex]")
+{
+  std::vector<bd::Block> blocks{ makeBlocks(5000) };
+  std::vector<bd::Block *> ptrs{ pointers(blocks) };
+  BlockRangeIndex index;
+  index.build(ptrs, rovKey);
+
+  REQUIRE(index.size()==ptrs.size());
+
+  double const ranges[][2]{
+      { 0.0, 1.0 }, { 0.25, 0.5 }, { 0.5, 0.5 }, { 0.999, 2.0 },
+      { -1.0, -0.5 }, { 0.6, 0.4 } };
+  for (auto const &r : ranges) {
+    REQUIRE(indexes(index, index.find(r[0], r[1]))==scan(ptrs, r[0], r[1]));
+  }
+
+  SECTION("low > high is empty")
+  {
+    REQUIRE(index.find(0.6, 0.4).size()==0);
+  }
+}
+
+
+TEST_CASE("forEachDifference() gives the blocks entering and leaving",
+          "[rangeindex]")
+{
+  std::vector<bd::Block> blocks{ makeBlocks(5000) };
+  std::vector<bd::Block *> ptrs{ pointers(blocks) };
+  BlockRangeIndex index;
+  index.build(ptrs, rovKey);
+
+  auto check = [&](double l0, double h0, double l1, double h1) {
+    BlockRangeIndex::Span const a{ index.find(l0, h0) };
+    BlockRangeIndex::Span const b{ index.find(l1, h1) };
+
+    std::vector<uint64_t> added;
+    index.forEachDifference(b, a, [&added](bd::Block *blk) {
+      added.push_back(blk->index());
+    });
+    std::vector<uint64_t> removed;
+    index.forEachDifference(a, b, [&removed](bd::Block *blk) {
+      removed.push_back(blk->index());
+    });
+    std::sort(added.begin(), added.end());
+    std::sort(removed.begin(), removed.end());
+
+    std::vector<uint64_t> const before{ scan(ptrs, l0, h0) };
+    std::vector<uint64_t> const after{ scan(ptrs, l1, h1) };
+    std::vector<uint64_t> expectAdded;
+    std::set_difference(after.begin(), after.end(), before.begin(), before.end(),
+                        std::back_inserter(expectAdded));
+    std::vector<uint64_t> expectRemoved;
+    std::set_difference(before.begin(), before.end(), after.begin(), after.end(),
+                        std::back_inserter(expectRemoved));
+
+    REQUIRE(added==expectAdded);
+    REQUIRE(removed==expectRemoved);
+  };
+
+  // grow, shrink, slide, disjoint, empty to full and back.
+  check(0.2, 0.4, 0.1, 0.5);
+  check(0.1, 0.5, 0.2, 0.4);
+  check(0.2, 0.4, 0.3, 0.6);
+  check(0.1, 0.2, 0.7, 0.9);
+  check(0.6, 0.4, 0.0, 1.0);
+  check(0.0, 1.0, 0.6, 0.4);
+}
+
+
+TEST_CASE("lowForCount() picks the largest range that fits", "[rangeindex]")
+{
+  std::vector<bd::Block> blocks{ makeBlocks(5000) };
+  std::vector<bd::Block *> ptrs{ pointers(blocks) };
+  BlockRangeIndex index;
+  index.build(ptrs, rovKey);
+
+  for (size_t count : { size_t(0), size_t(1), size_t(7), size_t(100),
+                        size_t(2500), size_t(4999) }) {
+    for (double high : { 1.0, 0.5 }) {
+      double const low{ index.lowForCount(high, count) };
+      BlockRangeIndex::Span const s{ index.find(low, high) };
+      REQUIRE(s.size()<=count);
+
+      // the next smaller key would not fit.
+      BlockRangeIndex::Span const all{ index.find(0.0, high) };
+      size_t const kept{ s.size()>0 ? s.first : all.last };
+      if (kept>all.first) {
+        double const lower{ index.at(kept-1)->fileBlock().rov };
+        REQUIRE(index.find(lower, high).size()>count);
+      }
+    }
+  }
+
+  SECTION("everything fits")
+  {
+    REQUIRE(index.find(index.lowForCount(1.0, 5000), 1.0).size()==5000);
+  }
+
+  SECTION("ties that cannot fit leave nothing")
+  {
+    // 1000 distinct rov values, so 5 blocks share each.
+    REQUIRE(index.find(index.lowForCount(1.0, 3), 1.0).size()==0);
+  }
+}
+
+
+TEST_CASE("ShownBlocks keeps the blocks of the range", "[rangeindex]")
+{
+  std::vector<bd::Block> blocks{ makeBlocks(5000) };
+  std::vector<bd::Block *> ptrs{ pointers(blocks) };
+  BlockRangeIndex rov;
+  rov.build(ptrs, rovKey);
+  BlockRangeIndex byIndex;
+  byIndex.build(ptrs, [](bd::Block const &b) {
+    return static_cast<double>(b.index());
+  });
+
+  for (bd::Block *b : ptrs) {
+    b->empty(true);
+  }
+  ShownBlocks shown;
+  shown.reset(ptrs.size());
+
+  auto check = [&](std::vector<uint64_t> const &expect) {
+    std::vector<uint64_t> idx;
+    for (bd::Block *b : shown.blocks()) {
+      idx.push_back(b->index());
+    }
+    std::sort(idx.begin(), idx.end());
+    REQUIRE(idx==expect);
+
+    size_t notEmpty{ 0 };
+    for (bd::Block *b : ptrs) {
+      notEmpty += b->empty() ? 0 : 1;
+    }
+    REQUIRE(notEmpty==expect.size());
+  };
+
+  // grow, shrink, slide, disjoint, empty to full and back.
+  double const ranges[][2]{
+      { 0.2, 0.4 }, { 0.1, 0.5 }, { 0.2, 0.4 }, { 0.3, 0.6 }, { 0.7, 0.9 },
+      { 0.6, 0.4 }, { 0.0, 1.0 }, { 0.6, 0.4 } };
+  for (auto const &r : ranges) {
+    shown.filter(rov, r[0], r[1]);
+    REQUIRE(shown.index()==&rov);
+    check(scan(ptrs, r[0], r[1]));
+  }
+
+  SECTION("another index starts over")
+  {
+    shown.filter(rov, 0.2, 0.4);
+    shown.filter(byIndex, 100, 199);
+    std::vector<uint64_t> expect(100);
+    std::iota(expect.begin(), expect.end(), 100);
+    check(expect);
+  }
+
+  SECTION("show() and hideAll()")
+  {
+    shown.filter(rov, 0.2, 0.4);
+    shown.hideAll();
+    check({ });
+
+    shown.show(ptrs[3]);
+    shown.show(ptrs[1]);
+    REQUIRE(shown.index()==nullptr);
+    check({ 1, 3 });
+
+    shown.hide(ptrs[1]);
+    check({ 3 });
+
+    shown.filter(rov, 0.2, 0.4);
+    check(scan(ptrs, 0.2, 0.4));
+  }
+}
+
+
+TEST_CASE("range index vs full scan filtering at 884k blocks",
+          "[.][bench][rangeindex]")
+{
+  size_t const NUM_BLOCKS{ 884736 };
+  int const STEPS{ 100 };
+
+  std::vector<bd::Block> blocks{ makeBlocks(NUM_BLOCKS) };
+  std::vector<bd::Block *> ptrs{ pointers(blocks) };
+  BlockRangeIndex index;
+
+  auto start = std::chrono::high_resolution_clock::now();
+  index.build(ptrs, rovKey);
+  double const msBuild{ std::chrono::duration<double, std::milli>(
+      std::chrono::high_resolution_clock::now()-start).count() };
+
+  // the slider creeping up by 0.001 per tick.
+  std::vector<bd::Block *> shown;
+  size_t scanned{ 0 };
+  start = std::chrono::high_resolution_clock::now();
+  for (int i{ 0 }; i<STEPS; ++i) {
+    double const low{ 0.2+i*0.001 };
+    shown.clear();
+    for (bd::Block *b : ptrs) {
+      double const rov{ b->fileBlock().rov };
+      if (rov>=low && rov<=0.8) {
+        shown.push_back(b);
+      }
+    }
+    scanned += shown.size();
+  }
+  double const msScan{ std::chrono::duration<double, std::milli>(
+      std::chrono::high_resolution_clock::now()-start).count()/STEPS };
+
+  // ShownBlocks::filter() is what BlockCollection runs per tick.
+  for (bd::Block *b : ptrs) {
+    b->empty(true);
+  }
+  ShownBlocks filtered;
+  filtered.reset(ptrs.size());
+  filtered.filter(index, 0.2, 0.8);
+  start = std::chrono::high_resolution_clock::now();
+  for (int i{ 0 }; i<STEPS; ++i) {
+    filtered.filter(index, 0.2+i*0.001, 0.8);
+  }
+  double const msDelta{ std::chrono::duration<double, std::milli>(
+      std::chrono::high_resolution_clock::now()-start).count()/STEPS };
+
+  REQUIRE(filtered.blocks().size()==shown.size());
+
+  std::cout << "range filtering, " << NUM_BLOCKS << " blocks\n"
+            << "  index build:          " << msBuild << " ms\n"
+            << "  full scan per tick:   " << msScan << " ms\n"
+            << "  filter per tick:      " << msDelta << " ms ("
+            << scanned << " scanned)"
+            << std::endl;
+}
@@ -0,0 +1,365 @@
+#include <renderer/cpuraycaster.h>
+
+#include <bd/graphics/framebuffer.h>
+#include <bd/volume/block.h>
+#include <bd/volume/quantizer.h>
+#include <bd/volume/volume.h>
+
+#include <catch.hpp>
+
+#include <algorithm>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+using subvol::renderer::CpuRaycaster;
+
+/// A value of 0 is clear, 0.5 opaque green, 1 opaque red.
+std::vector<glm::vec4> const GREEN_RED{
+    { 0.0f, 0.0f, 0.0f, 0.0f },
+    { 0.0f, 1.0f, 0.0f, 1.0f },
+    { 1.0f, 0.0f, 0.0f, 1.0f } };
+
+glm::vec4 const BACKGROUND{ 0.0f, 0.0f, 0.5f, 1.0f };
+
+
+/// \brief The blocks of a volume spanning [-0.5, 0.5]^3, each with a
+/// buffer of floats filled by \c value(block, p) at voxel centers \c p.
+struct TestVolume
+{
+  using Value = std::function<float(size_t, glm::vec3 const &)>;
+
+
+  /// \brief A regular grid of \c count blocks of \c voxels^3.
+  TestVolume(glm::u64vec3 const &count, uint64_t voxels, Value value)
+      : volume{ count * voxels, count }
+  {
+    glm::vec3 const wd{ 1.0f / glm::vec3{ count } };
+    for (uint64_t k{ 0 }; k < count.z; ++k)
+    for (uint64_t j{ 0 }; j < count.y; ++j)
+    for (uint64_t i{ 0 }; i < count.x; ++i) {
+      glm::vec3 const ijk{ glm::u64vec3{ i, j, k } };
+      add(-0.5f + ijk * wd, wd, { i, j, k }, glm::u64vec3{ voxels }, value);
+    }
+  }
+
+
+  /// \brief No blocks yet, add() them.
+  explicit TestVolume(bd::Volume const &v)
+      : volume{ v }
+  {
+  }
+
+
+  /// \brief Add a block with min corner \c lo and world dims \c wd.
+  void
+  add(glm::vec3 const &lo, glm::vec3 const &wd, glm::u64vec3 const &ijk,
+      glm::u64vec3 const &voxels, Value const &value)
+  {
+    bd::FileBlock fb;
+    fb.block_index = blocks.size();
+    for (int a{ 0 }; a < 3; ++a) {
+      fb.ijk_index[a] = ijk[a];
+      fb.voxel_dims[a] = voxels[a];
+      fb.world_dims[a] = wd[a];
+    }
+    glm::vec3 const origin{ lo + 0.5f * wd };
+    fb.world_oigin[0] = origin.x;
+    fb.world_oigin[1] = origin.y;
+    fb.world_oigin[2] = origin.z;
+    blocks.emplace_back(new bd::Block{ ijk, fb });
+
+    std::vector<float> data(voxels.x * voxels.y * voxels.z);
+    size_t n{ 0 };
+    for (uint64_t z{ 0 }; z < voxels.z; ++z)
+    for (uint64_t y{ 0 }; y < voxels.y; ++y)
+    for (uint64_t x{ 0 }; x < voxels.x; ++x) {
+      // world position of the voxel center.
+      glm::vec3 const xyz{ glm::u64vec3{ x, y, z } };
+      glm::vec3 const p{ lo + xyz / ( glm::vec3{ voxels } - 1.0f ) * wd };
+      data[n++] = value(fb.block_index, p);
+    }
+    buffers.push_back(std::move(data));
+    blocks.back()->pixelData(reinterpret_cast<char *>(buffers.back().data()));
+  }
+
+
+  std::vector<bd::Block *>
+  all() const
+  {
+    std::vector<bd::Block *> v;
+    for (auto const &b : blocks) {
+      v.push_back(b.get());
+    }
+    return v;
+  }
+
+
+  bd::Volume volume;
+  std::vector<std::unique_ptr<bd::Block>> blocks;
+  std::vector<std::vector<float>> buffers;
+};
+
+
+void
+lookFromFront(CpuRaycaster &rc, unsigned int w, unsigned int h)
+{
+  rc.setViewport(w, h);
+  rc.setBackgroundColor(BACKGROUND);
+  rc.getCamera().setEye({ 0.0f, 0.0f, 4.0f });
+  rc.getCamera().setLookAt({ 0.0f, 0.0f, 0.0f });
+  rc.getCamera().setUp({ 0.0f, 1.0f, 0.0f });
+  rc.setViewMatrix(rc.getCamera().createViewMatrix());
+}
+
+
+/// \brief Equal within the spacing of the color lookup table.
+bool
+same(glm::vec4 const &a, glm::vec4 const &b)
+{
+  return glm::all(glm::lessThan(glm::abs(a - b), glm::vec4{ 0.01f }));
+}
+
+} // namespace
+
+
+TEST_CASE("CpuRaycaster without blocks draws the background",
+          "[cpuraycaster]")
+{
+  TestVolume tv{ { 1, 1, 1 }, 4, [](size_t, glm::vec3 const &) { return 1.0f; } };
+  CpuRaycaster rc{ nullptr, tv.volume, 2 };
+  REQUIRE(rc.initialize());
+  lookFromFront(rc, 16, 8);
+
+  rc.draw();
+  REQUIRE(rc.framebuffer().width() == 16);
+  REQUIRE(rc.framebuffer().height() == 8);
+  REQUIRE(same(rc.framebuffer().pixel(8, 4), BACKGROUND));
+
+  // blocks without pixel data are not drawn.
+  tv.blocks[0]->removePixelData();
+  rc.drawBlocks(tv.all());
+  REQUIRE(same(rc.framebuffer().pixel(8, 4), BACKGROUND));
+  REQUIRE(rc.frameStats().notResident == 1);
+  REQUIRE(rc.frameStats().blocks == 0);
+}
+
+
+TEST_CASE("CpuRaycaster draws an opaque block", "[cpuraycaster]")
+{
+  TestVolume tv{ { 1, 1, 1 }, 8, [](size_t, glm::vec3 const &) { return 1.0f; } };
+  CpuRaycaster rc{ nullptr, tv.volume, 2 };
+  rc.setColorMapKnots(GREEN_RED);
+  lookFromFront(rc, 64, 64);
+
+  rc.drawBlocks(tv.all());
+  bd::Framebuffer const &fb{ rc.framebuffer() };
+  REQUIRE(same(fb.pixel(32, 32), { 1.0f, 0.0f, 0.0f, 1.0f }));
+  REQUIRE(same(fb.pixel(0, 0), BACKGROUND));
+  REQUIRE(same(fb.pixel(63, 63), BACKGROUND));
+  REQUIRE(rc.frameStats().blocks == 1);
+  // opaque at the first sample.
+  REQUIRE(rc.frameStats().samples > 0);
+  REQUIRE(rc.frameStats().tiles == 4);
+
+  // the scale maps 1 to 0.5, green.
+  rc.setColorMapScaleValue(0.5f);
+  rc.drawBlocks(tv.all());
+  REQUIRE(same(rc.framebuffer().pixel(32, 32), { 0.0f, 1.0f, 0.0f, 1.0f }));
+}
+
+
+TEST_CASE("CpuRaycaster composites front to back", "[cpuraycaster]")
+{
+  // two blocks along z, the front one (k = 1, nearer the eye) red.
+  TestVolume tv{ { 1, 1, 2 }, 8,
+                 [](size_t b, glm::vec3 const &) { return b == 1 ? 1.0f : 0.5f; } };
+  CpuRaycaster rc{ nullptr, tv.volume, 2 };
+  rc.setColorMapKnots(GREEN_RED);
+  lookFromFront(rc, 32, 32);
+
+  rc.drawBlocks(tv.all());
+  REQUIRE(same(rc.framebuffer().pixel(16, 16), { 1.0f, 0.0f, 0.0f, 1.0f }));
+
+  // without the front block the back one shows.
+  rc.drawBlocks({ tv.blocks[0].get() });
+  REQUIRE(same(rc.framebuffer().pixel(16, 16), { 0.0f, 1.0f, 0.0f, 1.0f }));
+
+  // a partly transparent front block lets some of the back one through.
+  std::vector<glm::vec4> const seeThrough{
+      { 0.0f, 0.0f, 0.0f, 0.0f },
+      { 0.0f, 1.0f, 0.0f, 1.0f },
+      { 1.0f, 0.0f, 0.0f, 0.05f } };
+  rc.setColorMapKnots(seeThrough);
+  rc.drawBlocks(tv.all());
+  glm::vec4 const &c{ rc.framebuffer().pixel(16, 16) };
+  REQUIRE(c.r > 0.1f);
+  REQUIRE(c.g > 0.1f);
+  REQUIRE(c.r + c.g == Approx(1.0f).epsilon(0.01));
+}
+
+
+TEST_CASE("CpuRaycaster images do not depend on the thread count",
+          "[cpuraycaster]")
+{
+  // a soft sphere over 3x3x3 blocks.
+  TestVolume tv{ { 3, 3, 3 }, 16, [](size_t, glm::vec3 const &p) {
+    return std::max(0.0f, 1.0f - 2.0f * glm::length(p));
+  } };
+  std::vector<glm::vec4> const ramp{
+      { 0.0f, 0.0f, 0.0f, 0.0f },
+      { 0.2f, 0.4f, 1.0f, 0.05f },
+      { 1.0f, 0.8f, 0.2f, 0.2f },
+      { 1.0f, 1.0f, 1.0f, 0.6f } };
+
+  bd::Framebuffer images[2];
+  size_t const threads[2]{ 1, 4 };
+  for (int i{ 0 }; i < 2; ++i) {
+    CpuRaycaster rc{ nullptr, tv.volume, threads[i] };
+    REQUIRE(rc.threads() == threads[i]);
+    rc.setColorMapKnots(ramp);
+    lookFromFront(rc, 100, 70);
+    rc.getCamera().setEye({ 1.5f, 1.0f, 2.5f });
+    rc.setViewMatrix(rc.getCamera().createViewMatrix());
+    rc.drawBlocks(tv.all());
+    images[i] = rc.framebuffer();
+  }
+
+  REQUIRE(images[0].maxDifference(images[1]) == 0);
+  // the sphere is in the middle, not in the corner.
+  REQUIRE_FALSE(same(images[0].pixel(50, 35), BACKGROUND));
+  REQUIRE(same(images[0].pixel(0, 0), BACKGROUND));
+}
+
+
+TEST_CASE("CpuRaycaster draws quantized blocks", "[cpuraycaster]")
+{
+  TestVolume tv{ { 2, 2, 2 }, 12, [](size_t, glm::vec3 const &p) {
+    return glm::clamp(0.5f + p.x, 0.0f, 1.0f);
+  } };
+  std::vector<glm::vec4> const ramp{
+      { 0.0f, 0.0f, 1.0f, 0.02f },
+      { 1.0f, 0.0f, 0.0f, 0.1f } };
+
+  CpuRaycaster rc{ nullptr, tv.volume, 2 };
+  rc.setColorMapKnots(ramp);
+  lookFromFront(rc, 48, 48);
+  rc.drawBlocks(tv.all());
+  bd::Framebuffer const floats{ rc.framebuffer() };
+
+  // 16 bit blocks in the same buffers.
+  bd::BlockQuantizer const q{ bd::QuantizeMode::U16, 1e-3 };
+  for (size_t b{ 0 }; b < tv.blocks.size(); ++b) {
+    std::vector<float> &data{ tv.buffers[b] };
+    tv.blocks[b]->quantization(
+        q.quantize(data.data(), data.size(), reinterpret_cast<char *>(data.data())));
+  }
+  rc.drawBlocks(tv.all());
+  REQUIRE(rc.frameStats().dequantized == tv.blocks.size());
+  REQUIRE(rc.framebuffer().maxDifference(floats) <= 1);
+
+  // they stay expanded while their buffers do not change.
+  rc.drawBlocks(tv.all());
+  REQUIRE(rc.frameStats().dequantized == 0);
+}
+
+
+TEST_CASE("CpuRaycaster re-expands a block reloaded into the same buffer",
+          "[cpuraycaster]")
+{
+  TestVolume tv{ { 1, 1, 1 }, 8, [](size_t, glm::vec3 const &) { return 0.5f; } };
+  bd::BlockQuantizer const q{ bd::QuantizeMode::U8, 1e-2 };
+  std::vector<float> &data{ tv.buffers[0] };
+  char *buf{ reinterpret_cast<char *>(data.data()) };
+  tv.blocks[0]->quantization(q.quantize(data.data(), data.size(), buf));
+
+  CpuRaycaster rc{ nullptr, tv.volume, 1 };
+  rc.setColorMapKnots(GREEN_RED);
+  lookFromFront(rc, 8, 8);
+  rc.drawBlocks(tv.all());
+  REQUIRE(rc.frameStats().dequantized == 1);
+  REQUIRE(same(rc.framebuffer().pixel(4, 4), { 0.0f, 1.0f, 0.0f, 1.0f }));
+
+  // evicted, then read again into the same buffer with other voxels.
+  tv.blocks[0]->removePixelData();
+  std::vector<float> const red(data.size(), 1.0f);
+  tv.blocks[0]->quantization(q.quantize(red.data(), red.size(), buf));
+  tv.blocks[0]->pixelData(buf);
+  rc.drawBlocks(tv.all());
+  REQUIRE(rc.frameStats().dequantized == 1);
+  REQUIRE(same(rc.framebuffer().pixel(4, 4), { 1.0f, 0.0f, 0.0f, 1.0f }));
+}
+
+
+TEST_CASE("CpuRaycaster places kd blocks by their world boxes",
+          "[cpuraycaster]")
+{
+  // x is a ramp, so any split of the volume samples the same values.
+  TestVolume::Value const ramp{ [](size_t, glm::vec3 const &p) {
+    return glm::clamp(0.5f + p.x, 0.0f, 1.0f);
+  } };
+  std::vector<glm::vec4> const knots{
+      { 0.0f, 0.0f, 1.0f, 0.05f },
+      { 1.0f, 0.0f, 0.0f, 0.2f } };
+
+  TestVolume grid{ { 2, 2, 2 }, 9, ramp };
+
+  // A kd split: the left half in one block, the right half in two, of
+  // different voxel counts. Kd volumes number their blocks along x.
+  TestVolume kd{ bd::Volume{ { 17, 17, 17 }, { 3, 1, 1 } } };
+  kd.add({ -0.5f, -0.5f, -0.5f }, { 0.5f, 1.0f, 1.0f }, { 0, 0, 0 },
+         { 9, 17, 17 }, ramp);
+  kd.add({ 0.0f, -0.5f, -0.5f }, { 0.5f, 0.25f, 1.0f }, { 1, 0, 0 },
+         { 9, 5, 17 }, ramp);
+  kd.add({ 0.0f, -0.25f, -0.5f }, { 0.5f, 0.75f, 1.0f }, { 2, 0, 0 },
+         { 9, 13, 17 }, ramp);
+
+  CpuRaycaster rc{ nullptr, grid.volume, 2 };
+  rc.setColorMapKnots(knots);
+  lookFromFront(rc, 40, 40);
+  rc.drawBlocks(grid.all());
+  bd::Framebuffer const expected{ rc.framebuffer() };
+
+  CpuRaycaster rcKd{ nullptr, kd.volume, 2 };
+  rcKd.setColorMapKnots(knots);
+  lookFromFront(rcKd, 40, 40);
+  rcKd.drawBlocks(kd.all());
+  REQUIRE(rcKd.frameStats().blocks == 3);
+  REQUIRE_FALSE(same(rcKd.framebuffer().pixel(20, 20), BACKGROUND));
+  REQUIRE(rcKd.framebuffer().maxDifference(expected) <= 2);
+}
+
+
+TEST_CASE("CpuRaycaster 1 thread vs all threads",
+          "[.][bench][cpuraycaster]")
+{
+  TestVolume tv{ { 4, 4, 4 }, 32, [](size_t, glm::vec3 const &p) {
+    return std::max(0.0f, 1.0f - 2.0f * glm::length(p));
+  } };
+  std::vector<glm::vec4> const ramp{
+      { 0.0f, 0.0f, 0.0f, 0.0f },
+      { 0.2f, 0.4f, 1.0f, 0.02f },
+      { 1.0f, 0.8f, 0.2f, 0.1f } };
+
+  for (size_t threads : { size_t{ 1 }, size_t{ 0 } }) {
+    CpuRaycaster rc{ nullptr, tv.volume, threads };
+    rc.setColorMapKnots(ramp);
+    lookFromFront(rc, 512, 512);
+    rc.drawBlocks(tv.all());  // warm up
+
+    double best{ 1e30 };
+    for (int i{ 0 }; i < 5; ++i) {
+      rc.drawBlocks(tv.all());
+      best = std::min(best, rc.frameStats().ms);
+    }
+    std::cout << "512x512, 64 blocks of 32^3, " << rc.threads()
+              << " threads: " << best << " ms, "
+              << rc.frameStats().samples << " samples, "
+              << rc.frameStats().steals << " tiles stolen" << std::endl;
+  }
+}
@@ -0,0 +1,86 @@
+#include <io/prefetchpredictor.h>
+
+#include <catch.hpp>
+
+#include <cmath>
+
+
+TEST_CASE("PrefetchPredictor extrapolates the slider", "[prefetch]")
+{
+  subvol::PrefetchPredictor p{ 10, 0.5 };
+
+  double lo{ 0 };
+  double hi{ 0 };
+
+  p.observeRange(0.2, 0.8, 1.0);
+  REQUIRE_FALSE(p.rangeMoving());
+  p.predictedRange(lo, hi);
+  REQUIRE(lo == Approx(0.2));
+  REQUIRE(hi == Approx(0.8));
+
+  // min dragged down at 0.1/s, max held.
+  p.observeRange(0.19, 0.8, 1.1);
+  p.observeRange(0.18, 0.8, 1.2);
+  REQUIRE(p.rangeMoving());
+  REQUIRE(p.minVelocity() < 0.0);
+  REQUIRE(p.maxVelocity() == Approx(0.0));
+
+  p.predictedRange(lo, hi);
+  REQUIRE(lo < 0.18);
+  REQUIRE(lo > 0.18 - 0.1 * 0.5 - 1e-9);
+  REQUIRE(hi == Approx(0.8));
+
+  // a long pause restarts the velocity.
+  p.observeRange(0.18, 0.8, 5.0);
+  REQUIRE_FALSE(p.rangeMoving());
+
+  p.observeRange(0.18, 0.85, 5.1);
+  REQUIRE(p.rangeMoving());
+  p.stopRange();
+  REQUIRE_FALSE(p.rangeMoving());
+}
+
+
+TEST_CASE("PrefetchPredictor extrapolates camera rotation", "[prefetch]")
+{
+  subvol::PrefetchPredictor p{ 10, 1.0 };
+
+  float const step{ 0.1f };
+  for (int i{ 0 }; i < 8; ++i) {
+    float const a{ step * i };
+    p.observeView({ std::sin(a), 0.0f, -std::cos(a) }, 0.1 * i);
+  }
+
+  // 1 rad/s about +y (turning from -z towards +x).
+  REQUIRE(p.angularVelocity() == Approx(1.0).epsilon(0.01));
+
+  glm::vec3 const d{ p.predictedViewDir() };
+  float const expect{ step * 7 + 1.0f };
+  REQUIRE(d.x == Approx(std::sin(expect)).epsilon(0.01));
+  REQUIRE(d.z == Approx(-std::cos(expect)).epsilon(0.01));
+}
+
+
+TEST_CASE("PrefetchPredictor hit rate", "[prefetch]")
+{
+  subvol::PrefetchPredictor p{ 10, 0.5 };
+  REQUIRE(p.hitRate() == 0.0);
+
+  p.prefetched(1);
+  p.prefetched(2);
+  p.prefetched(2);
+  p.prefetched(3);
+  p.prefetched(4);
+  REQUIRE(p.prefetchCount() == 4);
+
+  REQUIRE(p.demanded(2));
+  REQUIRE_FALSE(p.demanded(2));
+  REQUIRE_FALSE(p.demanded(7));
+
+  p.evicted(3);
+  REQUIRE_FALSE(p.demanded(3));
+
+  REQUIRE(p.demanded(4));
+  REQUIRE(p.hitCount() == 2);
+  REQUIRE(p.hitRate() == Approx(0.5));
+}
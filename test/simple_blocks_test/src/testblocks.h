@@ -0,0 +1,46 @@
+#ifndef simple_blocks_test_testblocks_h
+#define simple_blocks_test_testblocks_h
+
+#include <bd/io/fileblock.h>
+#include <bd/volume/block.h>
+
+#include <vector>
+#include <cstddef>
+
+namespace testblocks
+{
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief \c n standalone blocks with block_index i and rov scattered over
+/// [0, 1) in steps of 0.001, so blocks in a range are spread across the
+/// index order.
+inline std::vector<bd::Block>
+makeBlocks(size_t n)
+{
+  std::vector<bd::Block> blocks;
+  blocks.reserve(n);
+  for (size_t i{ 0 }; i < n; ++i) {
+    bd::FileBlock fb;
+    fb.block_index = i;
+    fb.rov = static_cast<double>(( i * 2654435761ull ) % 1000) / 1000.0;
+    blocks.emplace_back(glm::u64vec3{ 0, 0, 0 }, fb);
+  }
+  return blocks;
+}
+
+
+///////////////////////////////////////////////////////////////////////////////
+inline std::vector<bd::Block *>
+pointers(std::vector<bd::Block> &blocks)
+{
+  std::vector<bd::Block *> ptrs;
+  ptrs.reserve(blocks.size());
+  for (bd::Block &b : blocks) {
+    ptrs.push_back(&b);
+  }
+  return ptrs;
+}
+
+} // namespace testblocks
+
+#endif // ! simple_blocks_test_testblocks_h